@@ -11,34 +11,68 @@
 #ifndef _AUTH_MGR_H_
 #define _AUTH_MGR_H_
 
+struct auth_ctx_map;
+
 struct auth_map
 {
-	TSS_BOOL full;
 	TPM_AUTHHANDLE tpm_handle;
 	TCS_CONTEXT_HANDLE tcs_ctx;
+	TSS_BOOL in_use; /* checked by a command that hasn't released it yet, don't swap out */
 	BYTE *swap; /* These 'swap' variables manage blobs received from TPM_SaveAuthContext */
 	UINT32 swap_size;
+	struct auth_ctx_map *ctx; /* record of the TCS context that opened this session */
+	struct auth_map *hash_next; /* next session in the same tpm_handle bucket */
+	struct auth_map *ctx_next; /* next session opened by the same TCS context */
+	struct auth_map *lru_prev, *lru_next; /* place in the list of swappable sessions */
 };
 
-/*
- * it appears that there's no way to query a v1.1 TPM for the
- * max number of simultaneous auth sessions. We'll make the
- * default relatively large and let the TPM return
- * TCPA_RESOURCES to tell us when we cross the line.
- */
-#define TSS_DEFAULT_AUTH_TABLE_SIZE	16
-#define TSS_DEFAULT_OVERFLOW_AUTHS	16
+/* the sessions opened by a single TCS context */
+struct auth_ctx_map
+{
+	TCS_CONTEXT_HANDLE tcs_ctx;
+	UINT32 opened;
+	struct auth_map *sessions;
+	struct auth_ctx_map *next; /* next context in the same bucket */
+};
+
+/* both the session and the context tables are hashed into this many buckets */
+#define TSS_AUTH_MGR_HASH_SIZE	32
+#define TSS_AUTH_MGR_HASH(h)	(((h) ^ ((h) >> 8) ^ ((h) >> 16) ^ ((h) >> 24)) % \
+				 TSS_AUTH_MGR_HASH_SIZE)
+
+/* a thread waiting in the queue for an auth slot to open */
+struct auth_waiter
+{
+	COND_VAR cond;
+	TSS_BOOL signaled; /* set once the waiter has been handed a free slot */
+	struct auth_waiter *next;
+};
+
+/* how long, in seconds, a request may wait in the queue for an auth slot before it fails with
+ * TCPA_E_RESOURCES */
+#define TSS_AUTH_WAIT_TIMEOUT	30
 
 struct _auth_mgr
 {
 	short max_auth_sessions;
 	short open_auth_sessions;
-	UINT32 sleeping_threads;
-	COND_VAR **overflow;	/* queue of TCS contexts waiting for an auth session to become
-				 * available */
-	unsigned int of_head, of_tail;	/* head and tail of the overflow queue */
-	struct auth_map *auth_mapper; /* table of currently tracked auth sessions */
-	UINT32 auth_mapper_size, overflow_size;
+	/* FIFO queue of threads waiting for an auth session to become available */
+	struct auth_waiter *wait_head, *wait_tail;
+	UINT32 sleeping_threads;	/* current depth of the wait queue, woken waiters not counted */
+	UINT32 max_sleeping_threads;	/* deepest the queue has been */
+	UINT32 wait_timeouts;		/* waits that gave up after TSS_AUTH_WAIT_TIMEOUT */
+	UINT32 waits;			/* waits that ended with a slot */
+	UINT64 wait_ms_total;		/* time spent in those waits */
+	UINT32 wait_ms_max;		/* longest of those waits */
+	/* slots handed to woken waiters that haven't opened their session in them yet. New
+	 * requests see these as taken, so they can't slip in ahead of the waiter. */
+	UINT32 reserved_slots;
+	struct auth_map *auth_mapper[TSS_AUTH_MGR_HASH_SIZE]; /* currently tracked auth
+								 * sessions, by TPM handle */
+	struct auth_ctx_map *ctx_mapper[TSS_AUTH_MGR_HASH_SIZE]; /* sessions by TCS context */
+	/* sessions that are loaded in the TPM and not held by a command, least recently used
+	 * first. These are the candidates for TPM_SaveAuthContext. */
+	struct auth_map lru;
 } auth_mgr;
 
 MUTEX_DECLARE_INIT(auth_mgr_lock);
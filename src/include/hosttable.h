@@ -17,6 +17,9 @@
 
 #define CONNECTION_TYPE_TCP_PERSISTANT	1
 
+/* must be a power of two */
+#define HOST_TABLE_BUCKETS		128
+
 struct host_table_entry {
 	struct host_table_entry *next;
 	TSS_HCONTEXT tspContext;
@@ -28,11 +31,18 @@ struct host_table_entry {
 	MUTEX_DECLARE(lock);
 };
 
-struct host_table {
+/* entries are hashed by TSP context. A lookup only locks the entry's bucket, the
+ * table lock is taken to add or remove an entry. Lock order is table, bucket, entry. */
+struct host_table_bucket {
 	struct host_table_entry *entries;
 	MUTEX_DECLARE(lock);
 };
 
+struct host_table {
+	struct host_table_bucket buckets[HOST_TABLE_BUCKETS];
+	MUTEX_DECLARE(lock);
+};
+
 struct host_table_entry *get_table_entry(TCS_CONTEXT_HANDLE);
 void put_table_entry(struct host_table_entry *);
 TSS_RESULT __tspi_add_table_entry(TSS_HCONTEXT, BYTE *, int, struct host_table_entry **);
@@ -12,26 +12,47 @@
 #define _MEMMGR_H_
 
 /*
- * For each TSP context, there is one memTable, which holds a list of memEntry's,
- * each of which holds a pointer to some malloc'd memory that's been returned to
- * the user. The memTable also can point to other memTable's which would be
- * created if multiple TSP contexts were opened.
+ * For each TSP context, there is one memTable, which holds a memEntry for each
+ * piece of memory that's been returned to the user. The memEntry's are hashed
+ * by the pointer handed out, so that free_tspi() can find one without a list
+ * walk, and the memTable's are hashed by context handle in SpiMemoryTable.
  *
+ * The memory returned to the user is malloc'd on its own, since whatever the
+ * app doesn't free through the TSS is left to it to free(). Only the
+ * memEntry's are carved out of chunks owned by the memTable. A freed memEntry
+ * goes on the table's free list, and the chunks are released along with the
+ * table at Tspi_Context_FreeMemory(NULL) or Tspi_Context_Close.
  */
 
+#define TSP_MEMTABLE_BUCKETS	32
+#define TSP_MEM_CHUNK_SIZE	4096
+#define TSP_MEM_MIN_ENTRY_BUCKETS	64
+
 struct memEntry {
 	void *memPointer;
 	struct memEntry *nextEntry;
 };
 
+struct memChunk {
+	struct memChunk *next;
+	UINT32 used;
+	UINT32 size;
+	/* malloc'd memory is aligned for anything, so data[] is too */
+	BYTE data[] __attribute__((aligned(16)));
+};
+
 struct memTable {
 	TSS_HCONTEXT tspContext;
-	struct memEntry *entries;
+	struct memEntry **entries;
+	UINT32 numBuckets;
+	UINT32 numEntries;
+	struct memEntry *freeEntries;
+	struct memChunk *chunks;
 	struct memTable *nextTable;
 };
 
 MUTEX_DECLARE_INIT(memtable_lock);
 
-struct memTable *SpiMemoryTable = NULL;
+struct memTable *SpiMemoryTable[TSP_MEMTABLE_BUCKETS];
 
 #endif
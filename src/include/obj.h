@@ -28,13 +28,38 @@
 /* When TRUE, the key has been created and cannot be altered */
 #define TSS_OBJ_FLAG_KEY_SET	0x00000020
 
+/* Object handles are TSP_OBJ_HANDLE_BASE plus a slot number in the handle table in
+ * the low TSP_OBJ_SLOT_BITS and that slot's generation above it. The table is
+ * allocated a page of slots at a time. */
+#define TSP_OBJ_HANDLE_BASE	0xC0000000
+#define TSP_OBJ_SLOT_BITS	18
+#define TSP_OBJ_SLOT_MASK	((1 << TSP_OBJ_SLOT_BITS) - 1)
+#define TSP_OBJ_GEN_MASK	(~TSP_OBJ_HANDLE_BASE >> TSP_OBJ_SLOT_BITS)
+#define TSP_OBJ_PAGE_SLOTS	1024
+#define TSP_OBJ_MAX_PAGES	((1 << TSP_OBJ_SLOT_BITS) / TSP_OBJ_PAGE_SLOTS)
+
 /* structures */
+struct obj_list;
+
 struct tsp_object {
 	UINT32 handle;
 	UINT32 tspContext;
 	TSS_FLAG flags;
 	void *data;
 	struct tsp_object *next;
+	struct tsp_object *prev;
+	struct obj_list *list;
+	/* links into the chain of objects belonging to tspContext */
+	struct tsp_object *ctx_next;
+	struct tsp_object **ctx_pprev;
+};
+
+struct obj_slot {
+	struct tsp_object *obj;
+	/* for a context object's slot, the objects opened in that context */
+	struct tsp_object *children;
+	UINT32 gen;
+	UINT32 next_free;
 };
 
 struct obj_list {
@@ -46,7 +71,6 @@ struct obj_list {
 TSS_RESULT	   obj_getTpmObject(UINT32, TSS_HOBJECT *);
 TSS_HOBJECT	   obj_GetPolicyOfObject(UINT32, UINT32);
 void		   __tspi_obj_list_init();
-TSS_HOBJECT	   obj_get_next_handle();
 TSS_RESULT	   obj_list_add(struct obj_list *, UINT32, TSS_FLAG, void *, TSS_HOBJECT *);
 TSS_RESULT	   obj_list_remove(struct obj_list *, void (*)(void *), TSS_HOBJECT, TSS_HCONTEXT);
 void		   obj_list_put(struct obj_list *);
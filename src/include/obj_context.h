@@ -23,7 +23,19 @@
 #define TSS_CONTEXT_FLAGS_TPM_VERSION_2			0x80
 #define TSS_CONTEXT_FLAGS_TPM_VERSION_MASK		0xc0
 
+/* the most continued OIAP sessions a context keeps for reuse. The TPM's number of auth
+ * sessions usually sets a lower limit, see auth_pool_limit() */
+#define TSP_AUTH_POOL_SIZE				8
+
 /* structures */
+
+/* an OIAP session of the context's pool, see secret_PerformAuth_OIAP_Pooled() */
+struct tr_auth_pool_entry {
+	TCS_AUTHHANDLE handle;
+	TPM_NONCE nonce;	/* idle: the TPM's last NonceEven, busy: the NonceOdd sent */
+	TSS_BOOL reused;	/* busy: the session was taken from the pool */
+};
+
 struct tr_context_obj {
 	TSS_FLAG silentMode, flags;
 	UINT32 hashMode;
@@ -32,6 +44,11 @@ struct tr_context_obj {
 	UINT32 machineNameLength;
 	UINT32 connection_policy, current_connection;
 	struct tcs_api_table *tcs_api;
+	/* idle sessions are ready for a command, busy ones are out on one. The most recently
+	 * used idle session is at the end, the oldest busy one at the start. */
+	struct tr_auth_pool_entry auth_idle[TSP_AUTH_POOL_SIZE];
+	struct tr_auth_pool_entry auth_busy[TSP_AUTH_POOL_SIZE];
+	UINT32 num_auth_idle, num_auth_busy;
 #ifdef TSS_BUILD_TRANSPORT
 	/* transport session support */
 	TSS_HKEY transKey;
@@ -78,6 +95,11 @@ TSS_RESULT obj_context_transport_close(TSS_HCONTEXT, TSS_HKEY, TSS_HPOLICY, TSS_
 TSS_RESULT obj_context_set_tpm_version(TSS_HCONTEXT, UINT32);
 TSS_RESULT obj_context_get_tpm_version(TSS_HCONTEXT, UINT32 *);
 TSS_RESULT obj_context_get_loadkey_ordinal(TSS_HCONTEXT, TPM_COMMAND_CODE *);
+TSS_BOOL   obj_context_auth_pool_get(TSS_HCONTEXT, TPM_AUTH *);
+void       obj_context_auth_pool_busy(TSS_HCONTEXT, TPM_AUTH *);
+TSS_BOOL   obj_context_auth_pool_done(TSS_HCONTEXT, TPM_AUTH *, TSS_BOOL *);
+TSS_BOOL   obj_context_auth_pool_put(TSS_HCONTEXT, TPM_AUTH *, UINT32, TCS_AUTHHANDLE *);
+UINT32     obj_context_auth_pool_flush(TSS_HCONTEXT, TCS_AUTHHANDLE *);
 void       obj_context_close(TSS_HCONTEXT);
 
 struct tcs_api_table *obj_context_get_tcs_api(TSS_HCONTEXT);
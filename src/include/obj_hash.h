@@ -18,8 +18,8 @@ struct tr_hash_obj {
 	UINT32 type;
 	BYTE *hashData;
 	UINT32 hashSize;
-	UINT32 hashUpdateSize;
-	BYTE *hashUpdateBuffer;
+	Trspi_HashCtx hashUpdateCtx;	/* running hash of the UpdateHashValue data */
+	TSS_BOOL hashUpdatePending;	/* hashData doesn't include the latest update yet */
 };
 
 /* obj_hash.c */
@@ -34,6 +34,9 @@ struct tr_rsakey_obj {
 		TPM_PCR_INFO_LONG infolong;
 	} pcrInfo;
 	UINT32 pcrInfoType;
+#ifdef TSS_BUILD_ASYM_CRYPTO
+	void *pubKeyCache;	/* OpenSSL key built from key.pubKey, see obj_rsakey_get_pub_rsa() */
+#endif
 };
 
 /* obj_rsakey.c */
@@ -72,6 +75,9 @@ TSS_RESULT obj_rsakey_get_policy(TSS_HKEY, UINT32, TSS_HPOLICY *, TSS_BOOL *);
 TSS_RESULT obj_rsakey_get_policies(TSS_HKEY, TSS_HPOLICY *, TSS_HPOLICY *, TSS_BOOL *);
 TSS_RESULT obj_rsakey_get_blob(TSS_HKEY, UINT32 *, BYTE **);
 TSS_RESULT obj_rsakey_get_priv_blob(TSS_HKEY, UINT32 *, BYTE **);
+#ifdef TSS_BUILD_ASYM_CRYPTO
+TSS_RESULT obj_rsakey_get_pub_rsa(TSS_HKEY, UINT16 *, UINT16 *, UINT32 *, void **);
+#endif
 TSS_RESULT obj_rsakey_get_pub_blob(TSS_HKEY, UINT32 *, BYTE **);
 TSS_RESULT obj_rsakey_get_version(TSS_HKEY, UINT32 *, BYTE **);
 TSS_RESULT obj_rsakey_get_exponent(TSS_HKEY, UINT32 *, BYTE **);
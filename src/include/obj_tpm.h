@@ -12,6 +12,17 @@
 #define _OBJ_TPM_H_
 
 /* structures */
+/* the values the event log says a PCR should hold after each of the last num_values of its
+ * first num_events events, so that a PCR read before later events were logged can still be
+ * matched. Only the last TR_EVLOG_REPLAY_HISTORY values are kept. */
+struct tr_evlog_replay {
+	UINT32 num_events;
+	UINT32 num_values;
+	TPM_DIGEST *values;
+};
+
+#define TR_EVLOG_REPLAY_HISTORY	1024
+
 struct tr_tpm_obj {
 	TSS_HPOLICY policy;
 #ifdef TSS_BUILD_TSS12
@@ -47,6 +58,9 @@ struct tr_tpm_obj {
 	BYTE *PlatformConfCred;
 	UINT32 ConformanceCredSize;
 	BYTE *ConformanceCred;
+	/* event log replay state, one entry per PCR, grown as PCRs are replayed */
+	UINT32 num_replay_pcrs;
+	struct tr_evlog_replay *replay;
 };
 
 /* prototypes */
@@ -68,6 +82,9 @@ void       obj_tpm_remove_policy_refs(TSS_HPOLICY, TSS_HCONTEXT);
 TSS_RESULT obj_tpm_get_current_counter(TSS_HTPM, TSS_COUNTER_ID *);
 TSS_RESULT obj_tpm_set_cred(TSS_HTPM, TSS_FLAG, UINT32, BYTE *);
 TSS_RESULT obj_tpm_get_cred(TSS_HTPM, TSS_FLAG, UINT32 *, BYTE **);
+TSS_RESULT obj_tpm_get_replay(TSS_HTPM, UINT32, UINT32 *, TPM_DIGEST *);
+TSS_RESULT obj_tpm_set_replay(TSS_HTPM, UINT32, UINT32, UINT32, UINT32, TPM_DIGEST *);
+TSS_RESULT obj_tpm_get_replay_values(TSS_HTPM, UINT32, UINT32 *, UINT32 *, TPM_DIGEST **);
 
 #define TPM_LIST_DECLARE		struct obj_list tpm_list
 #define TPM_LIST_DECLARE_EXTERN		extern struct obj_list tpm_list
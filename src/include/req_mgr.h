@@ -14,13 +14,56 @@
 
 #include "threads.h"
 
+/* priority classes of TPM commands, lower values are dispatched first */
+#define TSS_REQ_PRIO_HIGH	0	/* latency critical: quote, unseal, sign, PCR access */
+#define TSS_REQ_PRIO_NORMAL	1
+#define TSS_REQ_PRIO_LOW	2	/* bulk: random numbers, capabilities, self tests */
+#define TSS_REQ_PRIO_NUM	3
+
+/* a queued request that has had this many other requests dispatched ahead of it is sent
+ * next regardless of its class, so that low priority requests can't be starved */
+#define TSS_REQ_MGR_MAX_BYPASS	32
+
+/* the most TPM key handles the request manager's shadow of the TPM key slots will hold, and
+ * the number of request bytes it needs to see to follow the commands that change them */
+#define TSS_REQ_MGR_MAX_KEY_SLOTS	64
+#define TSS_REQ_MGR_TRACK_SIZE		25
+
+struct tpm_req
+{
+	BYTE *blob;
+	TSS_RESULT result;
+	TCS_CONTEXT_HANDLE context;
+	UINT64 enqueued_at;	/* trm->num_dispatched at submit time */
+	int done;
+	COND_DECLARE(cond);
+	struct tpm_req *next;
+};
+
+struct tpm_req_queue
+{
+	struct tpm_req *head, *tail;
+	TCS_CONTEXT_HANDLE last_ctx;	/* context last served from this class */
+};
+
 struct tpm_req_mgr
 {
 	MUTEX_DECLARE(queue_lock);
+	COND_DECLARE(dispatch_cond);
+	struct tpm_req_queue queue[TSS_REQ_PRIO_NUM];
+	THREAD_TYPE dispatcher;
+	int running;
+	int shutdown;
+	UINT64 num_dispatched;
 };
 
 TSS_RESULT req_mgr_init();
+TSS_RESULT req_mgr_start();
 TSS_RESULT req_mgr_final();
 TSS_RESULT req_mgr_submit_req(BYTE *);
+void	   req_mgr_cmd_begin(TCS_CONTEXT_HANDLE, UINT32);
+void	   req_mgr_cmd_end();
+TSS_RESULT req_mgr_key_slot_is_loaded(TCPA_KEY_HANDLE, TSS_BOOL *);
+TSS_RESULT req_mgr_key_slots_used(UINT32 *, UINT32 *);
 
 #endif
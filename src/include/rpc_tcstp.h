@@ -38,4 +38,7 @@ struct tcsd_comm_data {
 #define TCSD_INIT_TXBUF_SIZE	1024
 #define TCSD_INCR_TXBUF_SIZE	4096
 
+/* the most sub-requests a TCSD_ORD_BATCH packet may carry */
+#define TCSD_BATCH_MAX_REQS	32
+
 #endif
@@ -18,6 +18,7 @@
 /* Auth session, context and TPM caps support are always compiled in. TPM caps
  * are necessary so that the TCSD can know what type of TPM its talking to */
 DECLARE_TCSTP_FUNC(OpenContext);
+DECLARE_TCSTP_FUNC(Batch);
 DECLARE_TCSTP_FUNC(CloseContext);
 DECLARE_TCSTP_FUNC(OIAP);
 DECLARE_TCSTP_FUNC(OSAP);
@@ -178,11 +179,13 @@ DECLARE_TCSTP_FUNC(LogPcrEvent);
 DECLARE_TCSTP_FUNC(GetPcrEvent);
 DECLARE_TCSTP_FUNC(GetPcrEventsByPcr);
 DECLARE_TCSTP_FUNC(GetPcrEventLog);
+DECLARE_TCSTP_FUNC(GetPcrEventLogPage);
 #else
 #define tcs_wrap_LogPcrEvent		tcs_wrap_Error
 #define tcs_wrap_GetPcrEvent		tcs_wrap_Error
 #define tcs_wrap_GetPcrEventsByPcr	tcs_wrap_Error
 #define tcs_wrap_GetPcrEventLog		tcs_wrap_Error
+#define tcs_wrap_GetPcrEventLogPage	tcs_wrap_Error
 #endif
 
 #ifdef TSS_BUILD_SELFTEST
@@ -394,13 +397,12 @@ void LoadBlob_PCR_EVENT(UINT64 *, BYTE *, TSS_PCR_EVENT *);
 TSS_RESULT UnloadBlob_PCR_EVENT(UINT64 *, BYTE *, TSS_PCR_EVENT *);
 int setData(TCSD_PACKET_TYPE, unsigned int, void *, int, struct tcsd_comm_data *);
 UINT32 getData(TCSD_PACKET_TYPE, unsigned int, void *, int, struct tcsd_comm_data *);
+UINT32 getDataView(unsigned int, BYTE **, UINT32, struct tcsd_comm_data *);
 void initData(struct tcsd_comm_data *, int);
-int recv_from_socket(int, void *, int);
-int send_to_socket(int, void *, int);
+int recv_from_socket(int, void *, int, struct timespec *);
+int send_to_socket(int, void *, int, struct timespec *);
 TSS_RESULT getTCSDPacket(struct tcsd_thread_data *);
 
-MUTEX_DECLARE_EXTERN(tcsp_lock);
-
 #endif
 
 
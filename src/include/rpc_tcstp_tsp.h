@@ -20,6 +20,7 @@ int setData(TCSD_PACKET_TYPE,int,void *,int,struct tcsd_comm_data *);
 UINT32 getData(TCSD_PACKET_TYPE,int,void *,int,struct tcsd_comm_data *);
 void initData(struct tcsd_comm_data *, int);
 TSS_RESULT sendTCSDPacket(struct host_table_entry *);
+TSS_RESULT sendTCSDBatch(struct host_table_entry *, UINT32, struct tcsd_comm_data *);
 TSS_RESULT send_init(struct host_table_entry *);
 TSS_RESULT tcs_sendit(struct host_table_entry *);
 
@@ -43,11 +44,13 @@ TSS_RESULT RPC_OSAP_TP(struct host_table_entry *,TCPA_ENTITY_TYPE,UINT32,TCPA_NO
 TSS_RESULT RPC_LogPcrEvent_TP(struct host_table_entry *,TSS_PCR_EVENT,UINT32 *);
 TSS_RESULT RPC_GetPcrEvent_TP(struct host_table_entry *,UINT32,UINT32 *,TSS_PCR_EVENT **);
 TSS_RESULT RPC_GetPcrEventLog_TP(struct host_table_entry *,UINT32 *,TSS_PCR_EVENT **);
+TSS_RESULT RPC_GetPcrEventLogPage_TP(struct host_table_entry *,UINT32 *,UINT32 *,UINT32,UINT32 *,TSS_PCR_EVENT **);
 TSS_RESULT RPC_GetPcrEventsByPcr_TP(struct host_table_entry *,UINT32,UINT32,UINT32 *,TSS_PCR_EVENT **);
 #else
 #define RPC_LogPcrEvent_TP(...)		TSPERR(TSS_E_INTERNAL_ERROR)
 #define RPC_GetPcrEvent_TP(...)		TSPERR(TSS_E_INTERNAL_ERROR)
 #define RPC_GetPcrEventLog_TP(...)	TSPERR(TSS_E_INTERNAL_ERROR)
+#define RPC_GetPcrEventLogPage_TP(...)	TSPERR(TSS_E_INTERNAL_ERROR)
 #define RPC_GetPcrEventsByPcr_TP(...)	TSPERR(TSS_E_INTERNAL_ERROR)
 #endif
 
@@ -162,10 +165,12 @@ TSS_RESULT RPC_ChangeAuthAsymFinish_TP(struct host_table_entry *,TCS_KEY_HANDLE,
 #ifdef TSS_BUILD_PCR_EXTEND
 TSS_RESULT RPC_Extend_TP(struct host_table_entry *,TCPA_PCRINDEX,TCPA_DIGEST,TCPA_PCRVALUE *);
 TSS_RESULT RPC_PcrRead_TP(struct host_table_entry *,TCPA_PCRINDEX,TCPA_PCRVALUE *);
+TSS_RESULT RPC_PcrReadBatch_TP(struct host_table_entry *,UINT32,UINT32 *,TCPA_PCRVALUE *);
 TSS_RESULT RPC_PcrReset_TP(struct host_table_entry *,UINT32,BYTE *);
 #else
 #define RPC_Extend_TP(...)	TSPERR(TSS_E_INTERNAL_ERROR)
 #define RPC_PcrRead_TP(...)	TSPERR(TSS_E_INTERNAL_ERROR)
+#define RPC_PcrReadBatch_TP(...)	TSPERR(TSS_E_INTERNAL_ERROR)
 #define RPC_PcrReset_TP(...)	TSPERR(TSS_E_INTERNAL_ERROR)
 #endif
 
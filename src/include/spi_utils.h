@@ -37,6 +37,9 @@ MUTEX_DECLARE_EXTERN(mem_cache_lock);
 #ifndef MIN
 #define MIN(a,b) ((a) < (b) ? (a) : (b))
 #endif
+#ifndef MAX
+#define MAX(a,b) ((a) > (b) ? (a) : (b))
+#endif
 
 #define BOOL(x)		((x) == 0) ? FALSE : TRUE
 #define INVBOOL(x)	((x) == 0) ? TRUE : FALSE
@@ -53,6 +56,7 @@ MUTEX_DECLARE_EXTERN(mem_cache_lock);
 void *calloc_tspi(TSS_HCONTEXT, UINT32);
 TSS_RESULT free_tspi(TSS_HCONTEXT, void *);
 TSS_RESULT __tspi_add_mem_entry(TSS_HCONTEXT, void *);
+void __tspi_close_mem_table(TSS_HCONTEXT);
 void * __no_optimize __tspi_memset(void *, int, size_t);
 
 /* secrets.c */
@@ -61,6 +65,9 @@ TSS_RESULT policy_UsesAuth(TSS_HPOLICY, TSS_BOOL *);
 
 TSS_RESULT secret_PerformAuth_OIAP(TSS_HOBJECT, UINT32, TSS_HPOLICY, TSS_BOOL, TCPA_DIGEST *,
 				   TPM_AUTH *);
+TSS_RESULT secret_PerformAuth_OIAP_Pooled(TSS_HOBJECT, UINT32, TSS_HPOLICY, TCPA_DIGEST *,
+					  TPM_AUTH *);
+TSS_BOOL   auth_pool_retry(TSS_HCONTEXT, TSS_RESULT, TPM_AUTH *);
 #if 0
 TSS_RESULT secret_PerformXOR_OSAP(TSS_HPOLICY, TSS_HPOLICY, TSS_HPOLICY, TSS_HOBJECT,
 				  UINT16, UINT32, TCPA_ENCAUTH *, TCPA_ENCAUTH *,
@@ -129,6 +136,8 @@ TSS_RESULT internal_GetCap(TSS_HCONTEXT, TSS_FLAG, UINT32, UINT32 *, BYTE **);
  * the TPM has TSS_DEFAULT_NUM_PCRS pcrs */
 #define TSS_DEFAULT_NUM_PCRS		16
 #define TSS_LOCAL_RANDOM_DEVICE		"/dev/urandom"
+/* size of the per-thread buffer get_local_random() serves nonces from */
+#define TSS_LOCAL_RANDOM_BUF_SIZE	512
 #define TSS_LOCALHOST_STRING		"localhost"
 TSS_RESULT get_local_random(TSS_HCONTEXT, TSS_BOOL, UINT32, BYTE **);
 
@@ -145,6 +154,11 @@ extern TSS_VERSION VERSION_1_1;
 
 TSS_RESULT __tspi_rsa_encrypt(TSS_HKEY, UINT32, BYTE*, UINT32*, BYTE*);
 TSS_RESULT __tspi_rsa_verify(TSS_HKEY, UINT32, UINT32, BYTE*, UINT32, BYTE*);
+void      *__tspi_rsa_pubkey_new(BYTE *, UINT32);
+void       __tspi_rsa_pubkey_get(void *);
+void       __tspi_rsa_pubkey_put(void *);
+TSS_RESULT __tspi_rsa_pubkey_encrypt(void *, UINT16, UINT32, BYTE *, UINT32 *, BYTE *);
+TSS_RESULT __tspi_rsa_pubkey_verify(void *, UINT32, UINT32, BYTE *, UINT32, BYTE *);
 
 TSS_RESULT Init_AuthNonce(TCS_CONTEXT_HANDLE, TSS_BOOL, TPM_AUTH *);
 TSS_BOOL validateReturnAuth(BYTE *, BYTE *, TPM_AUTH *);
@@ -243,6 +257,7 @@ TSS_RESULT RPC_ConvertMigrationBlob(TSS_HCONTEXT, TCS_KEY_HANDLE, UINT32, BYTE *
 TSS_RESULT Transport_ConvertMigrationBlob(TSS_HCONTEXT, TCS_KEY_HANDLE, UINT32, BYTE *, UINT32,
 				     BYTE *, TPM_AUTH *, UINT32 *, BYTE **);
 TSS_RESULT RPC_PcrRead(TSS_HCONTEXT, TCPA_PCRINDEX, TCPA_PCRVALUE *);
+TSS_RESULT RPC_PcrReadBatch(TSS_HCONTEXT, UINT32, UINT32 *, TCPA_PCRVALUE *);
 TSS_RESULT Transport_PcrRead(TSS_HCONTEXT, TCPA_PCRINDEX, TCPA_PCRVALUE *);
 TSS_RESULT RPC_PcrReset(TSS_HCONTEXT, UINT32, BYTE *);
 TSS_RESULT Transport_PcrReset(TSS_HCONTEXT, UINT32, BYTE *);
@@ -332,6 +347,7 @@ TSS_RESULT Transport_AuthorizeMigrationKey(TSS_HCONTEXT, TCPA_MIGRATE_SCHEME, UI
 TSS_RESULT RPC_GetPcrEvent(TSS_HCONTEXT, UINT32, UINT32 *, TSS_PCR_EVENT **);
 TSS_RESULT RPC_GetPcrEventsByPcr(TSS_HCONTEXT, UINT32, UINT32, UINT32 *, TSS_PCR_EVENT **);
 TSS_RESULT RPC_GetPcrEventLog(TSS_HCONTEXT, UINT32 *, TSS_PCR_EVENT **);
+TSS_RESULT RPC_GetPcrEventLogPage(TSS_HCONTEXT, UINT32 *, UINT32 *, UINT32, UINT32 *, TSS_PCR_EVENT **);
 TSS_RESULT RPC_Quote(TSS_HCONTEXT, TCS_KEY_HANDLE, TCPA_NONCE *, UINT32, BYTE *, TPM_AUTH *,
 			UINT32 *, BYTE **, UINT32 *, BYTE **);
 TSS_RESULT Transport_Quote(TSS_HCONTEXT, TCS_KEY_HANDLE, TCPA_NONCE *, UINT32, BYTE *, TPM_AUTH *,
@@ -485,6 +501,8 @@ struct tcs_api_table {
 #ifdef TSS_BUILD_PCR_EXTEND
 	TSS_RESULT (*Extend)(TSS_HCONTEXT, TCPA_PCRINDEX, TCPA_DIGEST, TCPA_PCRVALUE *);
 	TSS_RESULT (*PcrRead)(TSS_HCONTEXT, TCPA_PCRINDEX, TCPA_PCRVALUE *);
+	/* NULL when the PCRs can only be read one at a time */
+	TSS_RESULT (*PcrReadBatch)(TSS_HCONTEXT, UINT32, UINT32 *, TCPA_PCRVALUE *);
 	TSS_RESULT (*PcrReset)(TSS_HCONTEXT, UINT32, BYTE *);
 #endif
 #ifdef TSS_BUILD_QUOTE
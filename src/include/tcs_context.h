@@ -19,6 +19,16 @@ struct keys_loaded
 	struct keys_loaded *next;
 };
 
+/* the keys a context has loaded are kept in a small hash set keyed by TCS key handle, so
+ * that checking a key against its context on every authorized command stays cheap */
+#define TCS_CTX_KEYS_HASH_SIZE	16
+#define TCS_CTX_KEYS_HASH(h)	((h) % TCS_CTX_KEYS_HASH_SIZE)
+
+/* open contexts are hashed by context handle. Handles are issued in sequence, so the low bits
+ * spread them evenly across the buckets */
+#define TCS_CTX_HASH_SIZE	256
+#define TCS_CTX_HASH(h)		((h) % TCS_CTX_HASH_SIZE)
+
 #define TSS_CONTEXT_FLAG_TRANSPORT_EXCLUSIVE	0x1
 #define TSS_CONTEXT_FLAG_TRANSPORT_ENCRYPTED	0x2
 #define TSS_CONTEXT_FLAG_TRANSPORT_ENABLED	0x4
@@ -27,9 +37,8 @@ struct tcs_context {
 	TSS_FLAG flags;
 	TPM_TRANSHANDLE transHandle;
 	TCS_CONTEXT_HANDLE handle;
-	COND_VAR cond; /* used in waiting for an auth ctx to become available */
-	struct keys_loaded *keys;
-	struct tcs_context *next;
+	struct keys_loaded *keys[TCS_CTX_KEYS_HASH_SIZE];
+	struct tcs_context *next; /* next context in the same hash bucket */
 };
 
 #endif
@@ -16,9 +16,7 @@ void       ps_close_disk_cache();
 TSS_BOOL   ps_is_key_registered(TCPA_STORE_PUBKEY *);
 TSS_RESULT getParentUUIDByUUID(TSS_UUID *, TSS_UUID *);
 TSS_RESULT isUUIDRegistered(TSS_UUID *, TSS_BOOL *);
-void       disk_cache_shift(struct key_disk_cache *);
 TSS_RESULT ps_remove_key(TSS_UUID *);
-TSS_RESULT clean_disk_cache(int);
 TSS_RESULT ps_get_key_by_uuid(TSS_UUID *, BYTE *, UINT16 *);
 TSS_RESULT ps_get_key_by_cache_entry(struct key_disk_cache *, BYTE *, UINT16 *);
 TSS_RESULT ps_is_pub_registered(TCPA_STORE_PUBKEY *);
@@ -57,10 +57,16 @@ struct key_disk_cache
         TSS_UUID uuid;
         TSS_UUID parent_uuid;
         struct key_disk_cache *next;
+	/* system PS only: the record's size on disk and the hash index links */
+	UINT32 record_size;
+	UINT32 pub_digest;
+	struct key_disk_cache *uuid_hnext, *pub_hnext;
 };
 
 /* The current PS version */
 #define TSSPS_VERSION	1
+/* The current system PS version, see init_disk_cache() */
+#define TSSPS_SYSTEM_VERSION	2
 
 /* offsets into each key on disk. These should be passed a (struct key_disk_cache *) */
 #define TSSPS_VERSION_OFFSET		(0)
@@ -75,6 +81,10 @@ struct key_disk_cache
 #define TSSPS_PUB_DATA_OFFSET(c)      ((c)->offset + (2 * sizeof(TSS_UUID)) + (3 * sizeof(UINT16)) + sizeof(UINT32))
 #define TSSPS_BLOB_DATA_OFFSET(c)     ((c)->offset + (2 * sizeof(TSS_UUID)) + (3 * sizeof(UINT16)) + sizeof(UINT32) + (c)->pub_data_size)
 #define TSSPS_VENDOR_DATA_OFFSET(c)   ((c)->offset + (2 * sizeof(TSS_UUID)) + (3 * sizeof(UINT16)) + sizeof(UINT32) + (c)->pub_data_size + (c)->blob_size)
+/* version 2 system PS records are prefixed by the number of bytes they take up on disk */
+#define TSSPS_RECORD_SIZE_OFFSET(c)   ((c)->offset - sizeof(UINT32))
+#define TSSPS_RECORD_HEADER_SIZE      ((2 * sizeof(TSS_UUID)) + (3 * sizeof(UINT16)) + sizeof(UINT32))
+#define TSSPS_RECORD_DATA_SIZE(c)     (TSSPS_RECORD_HEADER_SIZE + (c)->pub_data_size + (c)->blob_size + (c)->vendor_data_size)
 
 /* XXX Get rid of this, there's no reason to set an arbitrary limit */
 #define MAX_KEY_CHILDREN	10
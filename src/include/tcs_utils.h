@@ -24,14 +24,34 @@ struct key_mem_cache
 	TCS_KEY_HANDLE tcs_handle;
 	UINT16 flags;
 	int ref_cnt;
+	int pin_cnt;	/* number of in-flight commands using tpm_handle */
 	UINT32 time_stamp;
 	TSS_UUID uuid;
 	TSS_UUID p_uuid;
 	TSS_KEY *blob;
+	UINT32 pub_digest;	/* hash of blob->pubKey, the key of the pubkey index */
+	BYTE *swap;		/* TPM_SaveKeyContext blob, set while the key is swapped out */
+	UINT32 swap_size;
 	struct key_mem_cache *parent;
 	struct key_mem_cache *next, *prev;
+	/* position in the LRU list of keys holding a TPM slot, see evictFirstKey() */
+	struct key_mem_cache *lru_next, *lru_prev;
+	/* chains of the key manager's hash indexes, see tcs_key_mem_cache.c */
+	struct key_mem_cache *tcs_hnext, *tpm_hnext, *uuid_hnext, *pub_hnext;
 };
 
+/*
+ * TCS resource locking. Each piece of TCS state has its own lock, so that two TCSD threads
+ * only serialize on the TPM device itself (the request manager's queue_lock). When more than
+ * one lock must be held, they are taken in this order:
+ *
+ *   mem_cache_lock -> disk_cache_lock -> auth_mgr_lock -> tcs_ctx_lock -> event log lock
+ *
+ * mem_cache_lock and disk_cache_lock are recursive, since the key load and PS paths call
+ * back into themselves. A TPM key slot handed out by the key manager is pinned until the
+ * dispatcher calls key_mgr_unpin_all(), so another thread can't evict it before the command
+ * using it reaches the TPM.
+ */
 extern struct key_mem_cache *key_mem_cache_head;
 MUTEX_DECLARE_EXTERN(mem_cache_lock);
 
@@ -70,6 +90,7 @@ TSS_RESULT get_tpm_metrics(struct tpm_properties *);
 TSS_RESULT auth_mgr_init();
 TSS_RESULT auth_mgr_final();
 TSS_RESULT auth_mgr_check(TCS_CONTEXT_HANDLE, TPM_AUTHHANDLE *);
+void       auth_mgr_check_done();
 TSS_RESULT auth_mgr_release_auth_handle(TCS_AUTHHANDLE, TCS_CONTEXT_HANDLE, TSS_BOOL);
 void       auth_mgr_release_auth(TPM_AUTH *, TPM_AUTH *, TCS_CONTEXT_HANDLE);
 TSS_RESULT auth_mgr_oiap(TCS_CONTEXT_HANDLE, TCS_AUTHHANDLE *, TCPA_NONCE *);
@@ -79,6 +100,7 @@ TSS_RESULT auth_mgr_close_context(TCS_CONTEXT_HANDLE);
 TSS_RESULT auth_mgr_swap_out(TCS_CONTEXT_HANDLE);
 TSS_BOOL   auth_mgr_req_new(TCS_CONTEXT_HANDLE);
 TSS_RESULT auth_mgr_add(TCS_CONTEXT_HANDLE, TPM_AUTHHANDLE);
+void	   auth_mgr_report();
 
 TSS_RESULT event_log_init();
 TSS_RESULT event_log_final();
@@ -94,6 +116,8 @@ TSS_RESULT owner_evict_init();
 
 #define next( x ) x = x->next
 
+TSS_RESULT key_mgr_init();
+void key_mgr_unpin_all();
 TSS_RESULT key_mgr_dec_ref_count(TCS_KEY_HANDLE);
 TSS_RESULT key_mgr_inc_ref_count(TCS_KEY_HANDLE);
 void key_mgr_ref_count();
@@ -102,17 +126,22 @@ TSS_RESULT key_mgr_load_by_uuid(TCS_CONTEXT_HANDLE, TSS_UUID *, TCS_LOADKEY_INFO
 TSS_RESULT key_mgr_load_by_blob(TCS_CONTEXT_HANDLE, TCS_KEY_HANDLE, UINT32, BYTE *,
 				TPM_AUTH *, TCS_KEY_HANDLE *, TCS_KEY_HANDLE *);
 TSS_RESULT key_mgr_evict(TCS_CONTEXT_HANDLE, TCS_KEY_HANDLE);
+TSS_RESULT key_mgr_swap_in(TCS_KEY_HANDLE, TCPA_KEY_HANDLE *);
+TSS_RESULT TPM_SaveKeyContext(TCPA_KEY_HANDLE, UINT32 *, BYTE **);
+TSS_RESULT TPM_LoadKeyContext(UINT32, BYTE *, TCPA_KEY_HANDLE *);
 
 
 extern TCS_CONTEXT_HANDLE InternalContext;
 
 TSS_RESULT mc_update_time_stamp(TCPA_KEY_HANDLE);
 TCS_KEY_HANDLE getNextTcsKeyHandle();
+UINT32 getNextTimeStamp();
 TCPA_STORE_PUBKEY *getParentPubBySlot(TCPA_KEY_HANDLE slot);
 TCPA_STORE_PUBKEY *mc_get_pub_by_slot(TCPA_KEY_HANDLE);
 TCPA_STORE_PUBKEY *mc_get_pub_by_handle(TCS_KEY_HANDLE);
 TSS_UUID *mc_get_uuid_by_pub(TCPA_STORE_PUBKEY *);
 TSS_RESULT mc_get_handles_by_uuid(TSS_UUID *, TCS_KEY_HANDLE *, TCPA_KEY_HANDLE *);
+struct key_mem_cache *mc_get_entry_by_uuid(TSS_UUID *);
 TCS_KEY_HANDLE mc_get_handle_by_encdata(BYTE *);
 TSS_RESULT mc_update_encdata(BYTE *, BYTE *);
 TSS_RESULT mc_find_next_ownerevict_uuid(TSS_UUID *);
@@ -128,8 +157,10 @@ TSS_RESULT mc_set_slot_by_slot(TCPA_KEY_HANDLE, TCPA_KEY_HANDLE);
 TSS_RESULT mc_set_slot_by_handle(TCS_KEY_HANDLE, TCPA_KEY_HANDLE);
 TCPA_KEY_HANDLE mc_get_slot_by_handle(TCS_KEY_HANDLE);
 TCPA_KEY_HANDLE mc_get_slot_by_handle_lock(TCS_KEY_HANDLE);
+void mc_pin_key_by_handle(TCS_KEY_HANDLE);
 TCPA_KEY_HANDLE mc_get_slot_by_pub(TCPA_STORE_PUBKEY *);
 TCS_KEY_HANDLE mc_get_handle_by_pub(TCPA_STORE_PUBKEY *, TCS_KEY_HANDLE);
+TCS_KEY_HANDLE mc_get_handle_by_slot(TCPA_KEY_HANDLE);
 TCPA_STORE_PUBKEY *mc_get_parent_pub_by_pub(TCPA_STORE_PUBKEY *);
 TSS_BOOL isKeyRegistered(TCPA_STORE_PUBKEY *);
 TSS_RESULT mc_get_blob_by_pub(TCPA_STORE_PUBKEY *, TSS_KEY **);
@@ -150,7 +181,6 @@ TSS_RESULT context_close_auth(TCS_CONTEXT_HANDLE);
 TSS_RESULT checkContextForAuth(TCS_CONTEXT_HANDLE, TCS_AUTHHANDLE);
 TSS_RESULT addContextForAuth(TCS_CONTEXT_HANDLE, TCS_AUTHHANDLE);
 TSS_RESULT ctx_verify_context(TCS_CONTEXT_HANDLE);
-COND_VAR *ctx_get_cond_var(TCS_CONTEXT_HANDLE);
 TSS_RESULT ctx_mark_key_loaded(TCS_CONTEXT_HANDLE, TCS_KEY_HANDLE);
 TSS_RESULT ctx_remove_key_loaded(TCS_CONTEXT_HANDLE, TCS_KEY_HANDLE);
 TSS_BOOL ctx_has_key_loaded(TCS_CONTEXT_HANDLE, TCS_KEY_HANDLE);
@@ -163,10 +193,12 @@ TSS_RESULT ctx_set_transport_disabled(TCS_CONTEXT_HANDLE, TCS_HANDLE *);
 #ifdef TSS_BUILD_KEY
 #define CTX_ref_count_keys(c)	ctx_ref_count_keys(c)
 #define KEY_MGR_ref_count()	key_mgr_ref_count()
+#define KEY_MGR_unpin_all()	key_mgr_unpin_all()
 TSS_RESULT ensureKeyIsLoaded(TCS_CONTEXT_HANDLE, TCS_KEY_HANDLE, TCPA_KEY_HANDLE *);
 #else
 #define CTX_ref_count_keys(c)
 #define KEY_MGR_ref_count()
+#define KEY_MGR_unpin_all()
 #define ensureKeyIsLoaded(...)	(1 /* XXX non-zero return will indicate failure */)
 #endif
 
@@ -179,6 +211,7 @@ TSS_RESULT get_current_version(TPM_VERSION *);
 void LogData(char *string, UINT32 data);
 void LogResult(char *string, TSS_RESULT result);
 TSS_RESULT canILoadThisKey(TCPA_KEY_PARMS *parms, TSS_BOOL *);
+void key_parms_cache_flush();
 TSS_RESULT internal_EvictByKeySlot(TCPA_KEY_HANDLE slot);
 
 TSS_RESULT clearKeysFromChip(TCS_CONTEXT_HANDLE hContext);
@@ -314,6 +347,14 @@ TSS_RESULT TCSP_FlushSpecific_Common(UINT32, TPM_RESOURCE_TYPE);
 						TSS_PCR_EVENT ** ppEvents	/* out */
 	    );
 
+	TSS_RESULT TCS_GetPcrEventLogPage_Internal(TCS_CONTEXT_HANDLE hContext,	/* in */
+						    UINT32 * pPcrIndex,	/* in, out */
+						    UINT32 * pEventIndex,	/* in, out */
+						    UINT32 MaxBytes,	/* in */
+						    UINT32 * pEventCount,	/* in, out */
+						    TSS_PCR_EVENT ** ppEvents	/* out */
+	    );
+
 	TSS_RESULT TCS_RegisterKey_Internal(TCS_CONTEXT_HANDLE hContext,	/* in */
 					     TSS_UUID *WrappingKeyUUID,	/* in */
 					     TSS_UUID *KeyUUID,	/* in  */
@@ -29,7 +29,7 @@ struct platform_class
 struct tcsd_config
 {
 	int port;		/* port the TCSD will listen on */
-	unsigned int num_threads;	/* max number of threads the TCSD allows simultaneously */
+	unsigned int num_threads;	/* number of worker threads servicing requests */
 	char *system_ps_dir;	/* the directory the system PS file sits in */
 	char *system_ps_file;	/* the name of the system PS file */
 	char *firmware_log_file;/* the name of the firmware PCR event file */
@@ -105,6 +105,9 @@ struct tcg_platform_spec {
 #define TCSD_OPTION_DISABLE_IPV6 0x4000
 
 #define TSS_TCP_RPC_MAX_DATA_LEN	1048576
+/* the most event data a single page of the PCR event log may carry, leaving room in the packet
+ * for the encoding of the events */
+#define TCSD_EVLOG_PAGE_MAX_BYTES	(TSS_TCP_RPC_MAX_DATA_LEN / 2)
 #define TSS_TCP_RPC_BAD_PACKET_TYPE	0x10000000
 
 enum tcsd_config_option_code {
@@ -139,28 +142,46 @@ TSS_RESULT ps_dirs_init();
 void	   tcsd_signal_handler(int);
 
 /* threading structures */
+
+/* One of these exists per connected TSP. It is owned by the poll loop while the connection is
+ * idle and by a single worker thread while one of its requests is being serviced. */
 struct tcsd_thread_data
 {
 	int sock;
 	UINT32 context;
-	THREAD_TYPE *thread_id;
 	char *hostname;
 	struct tcsd_comm_data comm;
+	struct tcsd_thread_data *next_ready;	/* work queue link */
+	struct tcsd_thread_data *prev, *next;	/* list of all connections */
 };
 
 struct tcsd_thread_mgr
 {
 	MUTEX_DECLARE(lock);
-	struct tcsd_thread_data *thread_data;
+	COND_DECLARE(ready_cond);
+	THREAD_TYPE *threads;			/* the worker pool */
+	struct tcsd_thread_data *conns;		/* all open connections */
+	struct tcsd_thread_data *ready_head, *ready_tail;	/* connections with a request */
 
+	int epoll_fd;
 	int shutdown;
+	UINT32 num_conns;
 	UINT32 num_active_threads;
 	UINT32 max_threads;
 };
 
+extern struct tcsd_thread_mgr *tm;
+
+/* a request that has started arriving must be completely received within this many seconds,
+ * and its reply sent within as many again */
+#define TCSD_CONN_RECV_TIMEOUT	30
+#define TCSD_CONN_SEND_TIMEOUT	30
+
 TSS_RESULT tcsd_threads_init();
+TSS_RESULT tcsd_threads_start();
 TSS_RESULT tcsd_threads_final();
-TSS_RESULT tcsd_thread_create(int, char *);
+TSS_RESULT tcsd_conn_create(int, char *);
+void	   tcsd_conn_ready(struct tcsd_thread_data *);
 void	   *tcsd_thread_run(void *);
 void	   thread_signal_init();
 
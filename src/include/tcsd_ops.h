@@ -27,6 +27,7 @@
 #define LOADKEYBYUUID			TCSD_ORD_LOADKEYBYUUID
 #define CREATEWRAPKEY			TCSD_ORD_CREATEWRAPKEY
 #define GETPCREVENTLOG			TCSD_ORD_GETPCREVENTLOG
+#define GETPCREVENTLOGPAGE		TCSD_ORD_GETPCREVENTLOGPAGE
 #define OIAP				TCSD_ORD_OIAP
 #define OSAP				TCSD_ORD_OSAP
 #define TERMINATEHANDLE			TCSD_ORD_TERMINATEHANDLE
@@ -184,8 +184,14 @@ enum TCSD_ORD {
 	TCSD_ORD_KEYCONTROLOWNER = 121,
 	TCSD_ORD_DSAP = 122,
 
+	/* several TCSD requests in one packet, see tcs_wrap_Batch() */
+	TCSD_ORD_BATCH = 123,
+
+	/* the PCR event log a page at a time, see TCS_GetPcrEventLogPage_Internal() */
+	TCSD_ORD_GETPCREVENTLOGPAGE = 124,
+
 	/* Last */
-	TCSD_LAST_ORD = 123
+	TCSD_LAST_ORD = 125
 };
 #define TCSD_MAX_NUM_ORDS TCSD_LAST_ORD
 
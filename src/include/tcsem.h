@@ -11,23 +11,47 @@
 #ifndef _TCSEM_H_
 #define _TCSEM_H_
 
+/* PCRs are assigned to the external logs by a 32 bit mask in tcsd.conf */
+#define EVLOG_MAX_PCRS		32
+#define EVLOG_INDEX_INIT_SIZE	64
+
+/* The file offset of each entry of an external event log, by PCR and event number. The log
+ * files only ever grow, so each call just indexes the entries appended since the last one
+ * instead of parsing the whole file again. */
+struct ext_log_index {
+	char *path;		/* the log file the offsets are for */
+	long parsed;		/* the file has been indexed up to this offset */
+	UINT32 num[EVLOG_MAX_PCRS];
+	UINT32 size[EVLOG_MAX_PCRS];
+	long *offsets[EVLOG_MAX_PCRS];
+};
+
 struct ext_log_source {
         int (*open)(void *, FILE **);
         TSS_RESULT (*get_entries_by_pcr)(FILE *, UINT32, UINT32, UINT32 *, TSS_PCR_EVENT **);
         TSS_RESULT (*get_entry)(FILE *, UINT32, UINT32 *, TSS_PCR_EVENT **);
         int (*close)(FILE *);
+	/* used by the ext_log_* routines: index the entries from index->parsed to the end
+	 * of the file and read the entry at the current file position */
+	TSS_RESULT (*index_entries)(FILE *, struct ext_log_index *);
+	TSS_RESULT (*read_entry)(FILE *, TSS_PCR_EVENT *);
+	struct ext_log_index *index;
 };
 
-struct event_wrapper {
-	TSS_PCR_EVENT event;
-	struct event_wrapper *next;
+/* the events logged through the TCS for one PCR, in the order they were logged */
+struct event_list {
+	UINT32 num;
+	UINT32 size;
+	TSS_PCR_EVENT *events;
 };
 
+#define EVLOG_LIST_INIT_SIZE	16
+
 struct event_log {
 	MUTEX_DECLARE(lock);
 	struct ext_log_source *firmware_source;
 	struct ext_log_source *kernel_source;
-	struct event_wrapper **lists;
+	struct event_list *lists;
 };
 
 /* include the compiled-in log sources and struct references here */
@@ -53,10 +77,19 @@ TSS_RESULT copy_pcr_event(TSS_PCR_EVENT *, TSS_PCR_EVENT *);
 TSS_RESULT event_log_add(TSS_PCR_EVENT *, UINT32 *);
 TSS_PCR_EVENT *get_pcr_event(UINT32, UINT32);
 UINT32 get_num_events(UINT32);
-TSS_PCR_EVENT *concat_pcr_events(TSS_PCR_EVENT **, UINT32, TSS_PCR_EVENT *, UINT32);
 UINT32 get_pcr_event_size(TSS_PCR_EVENT *);
 void free_external_events(UINT32, TSS_PCR_EVENT *);
 
+TSS_RESULT ext_log_index_open(struct ext_log_index *, char *);
+void ext_log_index_free(struct ext_log_index *);
+TSS_RESULT ext_log_index_add(struct ext_log_index *, UINT32, long);
+int ext_log_skip(FILE *, UINT32);
+TSS_RESULT ext_log_event_alloc(TSS_PCR_EVENT *, UINT32);
+TSS_RESULT ext_log_get_entries_by_pcr(struct ext_log_source *, FILE *, UINT32, UINT32, UINT32 *,
+				      TSS_PCR_EVENT **);
+TSS_RESULT ext_log_get_entry(struct ext_log_source *, FILE *, UINT32, UINT32 *,
+			     TSS_PCR_EVENT **);
+
 extern struct event_log *tcs_event_log;
 
 #endif
@@ -14,6 +14,11 @@
 #include "threads.h"
 
 extern struct key_disk_cache *key_disk_cache_head;
+/* unused records in the system PS file, available for reuse */
+extern struct key_disk_cache *free_disk_cache_head;
+/* number of records in the file (in use and free), the offset of its end and the
+ * number of bytes taken up by free records */
+extern UINT32 ps_num_records, ps_file_end, ps_free_bytes;
 /* file handles for the persistent stores */
 extern int system_ps_fd;
 /* The lock that surrounds all manipulations of the disk cache */
@@ -26,9 +31,20 @@ void		   ps_destroy();
 
 TSS_RESULT  read_data(int, void *, UINT32);
 TSS_RESULT  write_data(int, void *, UINT32);
+TSS_RESULT  psfile_read(int, UINT32, void *, UINT32);
+TSS_RESULT  psfile_write(int, UINT32, void *, UINT32);
+void	    psfile_unmap();
+TSS_RESULT  psfile_rewrite(int);
 
-int		   write_key_init(int, UINT32, UINT32, UINT32);
-TSS_RESULT	   cache_key(UINT32, UINT16, TSS_UUID *, TSS_UUID *, UINT16, UINT32, UINT32);
+TSS_RESULT	   cache_key(struct key_disk_cache *, UINT32, UINT32, UINT16, TSS_UUID *,
+			     TSS_UUID *, UINT16, UINT32, UINT32, UINT32);
+UINT32		   disk_cache_hash(BYTE *, UINT32);
+struct key_disk_cache *disk_cache_find_by_uuid(TSS_UUID *);
+struct key_disk_cache *disk_cache_find_by_pub(int, TCPA_STORE_PUBKEY *);
+struct key_disk_cache *disk_cache_find_free(UINT32);
+void		   disk_cache_release(struct key_disk_cache *);
+void		   disk_cache_free_records();
+TSS_BOOL	   disk_cache_needs_compaction();
 TSS_RESULT	   UnloadBlob_KEY_PS(UINT16 *, BYTE *, TSS_KEY *);
 TSS_RESULT	   psfile_get_parent_uuid_by_uuid(int, TSS_UUID *, TSS_UUID *);
 TSS_RESULT	   psfile_remove_key_by_uuid(int, TSS_UUID *);
@@ -49,7 +65,6 @@ TSS_RESULT	   psfile_get_key_by_pub(int, TCPA_STORE_PUBKEY *, UINT32 *, BYTE **)
 TSS_RESULT	   ps_remove_key(TSS_UUID *);
 int		   init_disk_cache(int);
 int		   close_disk_cache(int);
-TSS_RESULT	   clean_disk_cache(int);
 
 TSS_RESULT	   ps_write_key(TSS_UUID *, TSS_UUID *, BYTE *, UINT32, BYTE *, UINT32);
 TSS_RESULT	   ps_get_key_by_uuid(TSS_UUID *, BYTE *, UINT16 *);
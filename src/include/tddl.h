@@ -27,6 +27,12 @@ struct tpm_device_node {
 #define TDDL_TXBUF_SIZE		2048
 #define TDDL_UNDEF		-1
 
+/* tag, paramSize and returnCode of a TPM response */
+#define TDDL_RSP_HDR_LEN	10
+
+/* seconds to wait on a software TPM connection, overridden by TCSD_TCP_DEVICE_TIMEOUT */
+#define TDDL_TCP_DEFAULT_TIMEOUT	60
+
 TSS_RESULT Tddli_Open(void);
 
 TSS_RESULT Tddli_TransmitData(BYTE *pTransmitBuf,
@@ -22,13 +22,29 @@
 #define MUTEX_DECLARE(m)	pthread_mutex_t m
 #define MUTEX_DECLARE_INIT(m)	pthread_mutex_t m = PTHREAD_MUTEX_INITIALIZER
 #define MUTEX_DECLARE_EXTERN(m)	extern pthread_mutex_t m
+#define MUTEX_INIT_RECURSIVE(m)	do { \
+					pthread_mutexattr_t _attr; \
+					pthread_mutexattr_init(&_attr); \
+					pthread_mutexattr_settype(&_attr, PTHREAD_MUTEX_RECURSIVE); \
+					pthread_mutex_init(&m, &_attr); \
+					pthread_mutexattr_destroy(&_attr); \
+				} while (0)
+
+/* reader/writer lock abstractions */
+#define RWLOCK_DECLARE_INIT(l)	pthread_rwlock_t l = PTHREAD_RWLOCK_INITIALIZER
+#define RWLOCK_RDLOCK(l)	pthread_rwlock_rdlock(&l)
+#define RWLOCK_WRLOCK(l)	pthread_rwlock_wrlock(&l)
+#define RWLOCK_UNLOCK(l)	pthread_rwlock_unlock(&l)
 
 /* condition variable abstractions */
 #define COND_DECLARE(c)		pthread_cond_t c
 #define COND_INIT(c)		pthread_cond_init(&c, NULL)
 #define COND_VAR		pthread_cond_t
 #define COND_WAIT(c,m)		pthread_cond_wait(c,m)
+#define COND_TIMEDWAIT(c,m,t)	pthread_cond_timedwait(c,m,t)
 #define COND_SIGNAL(c)		pthread_cond_signal(c)
+#define COND_BROADCAST(c)	pthread_cond_broadcast(c)
+#define COND_DESTROY(c)		pthread_cond_destroy(&c)
 
 /* thread abstractions */
 #define THREAD_ID			((THREAD_TYPE)pthread_self())
@@ -42,6 +58,10 @@
 #define THREAD_CREATE(a,b,c,d)		pthread_create(a,b,c,d)
 #define THREAD_SET_SIGNAL_MASK		pthread_sigmask
 #define THREAD_NULL			(THREAD_TYPE *)0
+#define THREAD_LOCAL			__thread
+#define THREAD_ONCE_DECLARE_INIT(o)	pthread_once_t o = PTHREAD_ONCE_INIT
+#define THREAD_ONCE(o,f)		pthread_once(&o, f)
+#define THREAD_ATFORK(p,a,c)		pthread_atfork(p,a,c)
 
 #else
 
@@ -142,6 +142,8 @@ typedef struct _Trspi_HashCtx {
 TSS_RESULT Trspi_HashInit(Trspi_HashCtx *c, UINT32 type);
 TSS_RESULT Trspi_HashUpdate(Trspi_HashCtx *c, UINT32 size, BYTE *data);
 TSS_RESULT Trspi_HashFinal(Trspi_HashCtx *c, BYTE *out_digest);
+/* Start @dst as a copy of the unfinished hash @src, which can carry on independently */
+TSS_RESULT Trspi_HashCopy(Trspi_HashCtx *dst, Trspi_HashCtx *src);
 
 /* Functions to support incremental hashing */
 TSS_RESULT Trspi_Hash_UINT16(Trspi_HashCtx *c, UINT16 i);
@@ -251,6 +253,42 @@ BYTE *Trspi_Native_To_UNICODE(BYTE *string, unsigned *len);
  * is non-NULL, *len will be set to the size of the returned buffer. */
 BYTE *Trspi_UNICODE_To_Native(BYTE *string, unsigned *len);
 
+/* PCR Functions */
+
+/* Read ulPcrCount PCRs, sending the reads to the TCSD together. On success,
+ * *prgbPcrValues holds the ulPcrCount PCR values back to back, in the order of
+ * pulPcrIndices, and should be freed with Tspi_Context_FreeMemory. */
+TSS_RESULT Trspi_TPM_PcrReadBatch(TSS_HTPM hTPM, UINT32 ulPcrCount, UINT32 *pulPcrIndices,
+				  UINT32 *pulPcrValuesLength, BYTE **prgbPcrValues);
+
+/* Get up to *pulEventNumber events of the PCR event log, starting with event
+ * *pulFirstEvent of PCR *pulPcrIndex and continuing through the higher PCRs in
+ * the order Tspi_TPM_GetEventLog returns them, carrying at most ulMaxBytes of
+ * event data, 0 meaning the TCS's limit. Start a walk of the whole log at 0, 0.
+ * On return *pulPcrIndex and *pulFirstEvent say where the next page starts, and
+ * *pulEventNumber holds the number of events in *prgbPcrEvents, which is at
+ * least one until the end of the log has been reached. Events logged while the
+ * log is being walked don't move those not yet read. The events should be
+ * freed with Tspi_Context_FreeMemory. */
+TSS_RESULT Trspi_TPM_GetEventLogPage(TSS_HTPM hTPM, UINT32 *pulPcrIndex, UINT32 *pulFirstEvent,
+				     UINT32 ulMaxBytes, UINT32 *pulEventNumber,
+				     TSS_PCR_EVENT **prgbPcrEvents);
+
+/* Set the value of each PCR selected in hPcrs to the one its event log extends it to,
+ * starting from all zeros. hTPM remembers where each PCR's replay got to, so calling this
+ * again only hashes the events logged since. */
+TSS_RESULT Trspi_TPM_ReplayEventLog(TSS_HTPM hTPM, TSS_HPCRS hPcrs);
+
+/* Replay the event logs of the PCRs selected in hPcrs as Trspi_TPM_ReplayEventLog does and
+ * set *pbValid to whether they match hPcrs, as filled in by Tspi_TPM_Quote (the PCR values)
+ * or Tspi_TPM_Quote2 (the composite hash). The PCRs may have been read before the latest
+ * events were logged, so a match with an earlier state of the log is valid too. On a match,
+ * (*prgulEventCounts)[i] holds the number of PCR i's events the quote covers, for each of
+ * the *pulPcrCount PCRs, and only those events are vouched for. Free the array with
+ * Tspi_Context_FreeMemory. */
+TSS_RESULT Trspi_TPM_VerifyEventLog(TSS_HTPM hTPM, TSS_HPCRS hPcrs, TSS_BOOL *pbValid,
+				    UINT32 *pulPcrCount, UINT32 **prgulEventCounts);
+
 /* Error Functions */
 
 /* return a human readable string based on the result */
@@ -44,8 +44,30 @@
 #include "tcs_tsp.h"
 #include "tcs_utils.h"
 #include "tcslog.h"
+#include "tcsd_wrap.h"
+#include "tcsd.h"
 
 struct key_disk_cache *key_disk_cache_head = NULL;
+struct key_disk_cache *free_disk_cache_head = NULL;
+UINT32 ps_num_records = 0, ps_file_end = 0, ps_free_bytes = 0;
+
+/*
+ * The disk cache is indexed by UUID and by a digest of the public key so that lookups
+ * don't have to walk every registered key (and read its pub data off disk). The
+ * indexes only hold valid entries and are protected by disk_cache_lock.
+ */
+#define TSSPS_HASH_BITS		12
+#define TSSPS_HASH_SIZE		(1 << TSSPS_HASH_BITS)
+
+static struct key_disk_cache *uuid_index[TSSPS_HASH_SIZE];
+static struct key_disk_cache *pub_index[TSSPS_HASH_SIZE];
+
+#define DC_UUID_BUCKET(u)	(&uuid_index[disk_cache_hash((BYTE *)(u), sizeof(TSS_UUID)) & \
+					     (TSSPS_HASH_SIZE - 1)])
+#define DC_PUB_BUCKET(d)	(&pub_index[(d) & (TSSPS_HASH_SIZE - 1)])
+
+/* don't bother compacting the file until at least this many bytes are free */
+#define TSSPS_COMPACT_MIN	(64 * 1024)
 
 
 TSS_RESULT
@@ -83,233 +105,227 @@ write_data(int fd, void *data, UINT32 size)
 	return TSS_SUCCESS;
 }
 
-/*
- * called by write_key_init to find the next available location in the PS file to
- * write a new key to.
- */
-int
-find_write_offset(UINT32 pub_data_size, UINT32 blob_size, UINT32 vendor_data_size)
+UINT32
+disk_cache_hash(BYTE *data, UINT32 size)
 {
-	struct key_disk_cache *tmp;
-	unsigned int offset;
+	UINT32 hash = 2166136261U, i;
 
-	MUTEX_LOCK(disk_cache_lock);
+	for (i = 0; i < size; i++) {
+		hash ^= data[i];
+		hash *= 16777619U;
+	}
 
-	tmp = key_disk_cache_head;
-	while (tmp) {
-		/* if we find a deleted key of the right size, return its offset */
-		if (!(tmp->flags & CACHE_FLAG_VALID) &&
-		    tmp->pub_data_size == pub_data_size &&
-		    tmp->blob_size == blob_size &&
-		    tmp->vendor_data_size == vendor_data_size) {
-			offset = tmp->offset;
-			MUTEX_UNLOCK(disk_cache_lock);
-			return offset;
+	return hash;
+}
+
+static void
+disk_cache_index_add(struct key_disk_cache *c)
+{
+	struct key_disk_cache **bucket;
+
+	bucket = DC_UUID_BUCKET(&c->uuid);
+	c->uuid_hnext = *bucket;
+	*bucket = c;
+
+	bucket = DC_PUB_BUCKET(c->pub_digest);
+	c->pub_hnext = *bucket;
+	*bucket = c;
+}
+
+static void
+disk_cache_index_remove(struct key_disk_cache *c)
+{
+	struct key_disk_cache **p;
+
+	for (p = DC_UUID_BUCKET(&c->uuid); *p; p = &(*p)->uuid_hnext) {
+		if (*p == c) {
+			*p = c->uuid_hnext;
+			break;
 		}
-		tmp = tmp->next;
 	}
 
-	MUTEX_UNLOCK(disk_cache_lock);
+	for (p = DC_PUB_BUCKET(c->pub_digest); *p; p = &(*p)->pub_hnext) {
+		if (*p == c) {
+			*p = c->pub_hnext;
+			break;
+		}
+	}
 
-	/* no correctly sized holes */
-	return -1;
+	c->uuid_hnext = c->pub_hnext = NULL;
 }
 
 /*
- * move the file pointer to the point where the next key can be written and return
- * that offset
+ * return the valid disk cache entry registered under uuid, or NULL. The disk cache
+ * must be locked by the caller.
  */
-int
-write_key_init(int fd, UINT32 pub_data_size, UINT32 blob_size, UINT32 vendor_data_size)
+struct key_disk_cache *
+disk_cache_find_by_uuid(TSS_UUID *uuid)
 {
-	UINT32 num_keys;
-	BYTE version;
-	int rc, offset;
-
-	/* seek to the PS version */
-	rc = lseek(fd, TSSPS_VERSION_OFFSET, SEEK_SET);
-	if (rc == ((off_t) - 1)) {
-		LogError("lseek: %s", strerror(errno));
-		return -1;
-	}
+	struct key_disk_cache *c;
 
-	/* go to NUM_KEYS */
-	rc = lseek(fd, TSSPS_NUM_KEYS_OFFSET, SEEK_SET);
-	if (rc == ((off_t) - 1)) {
-		LogError("lseek: %s", strerror(errno));
-		return -1;
+	for (c = *DC_UUID_BUCKET(uuid); c; c = c->uuid_hnext) {
+		if ((c->flags & CACHE_FLAG_VALID) && !memcmp(uuid, &c->uuid, sizeof(TSS_UUID)))
+			return c;
 	}
 
-	/* read the number of keys */
-	rc = read(fd, &num_keys, sizeof(UINT32));
-	num_keys = LE_32(num_keys);
-	if (rc == -1) {
-		LogError("read of %zd bytes: %s", sizeof(UINT32), strerror(errno));
-		return -1;
-	} else if (rc == 0) {
-		/* This is the first key being written */
-		num_keys = 1;
-		version = 1;
-
-		/* seek to the PS version */
-		rc = lseek(fd, TSSPS_VERSION_OFFSET, SEEK_SET);
-		if (rc == ((off_t) - 1)) {
-			LogError("lseek: %s", strerror(errno));
-			return -1;
-		}
-
-		/* write out the version info byte */
-		if ((rc = write_data(fd, &version, sizeof(BYTE)))) {
-			LogError("%s", __FUNCTION__);
-			return rc;
-		}
+	return NULL;
+}
 
-		rc = lseek(fd, TSSPS_NUM_KEYS_OFFSET, SEEK_SET);
-		if (rc == ((off_t) - 1)) {
-			LogError("lseek: %s", strerror(errno));
-			return -1;
+/*
+ * return the valid disk cache entry whose public key matches pub, or NULL. Only
+ * entries whose digest matches have their pub data compared. The caller must hold
+ * the file (see get_file()).
+ */
+struct key_disk_cache *
+disk_cache_find_by_pub(int fd, TCPA_STORE_PUBKEY *pub)
+{
+	struct key_disk_cache *c;
+	UINT32 digest = disk_cache_hash(pub->key, pub->keyLength);
+	BYTE tmp_buffer[2048];
+
+	for (c = *DC_PUB_BUCKET(digest); c; c = c->pub_hnext) {
+		if (c->pub_digest != digest || c->pub_data_size != pub->keyLength ||
+		    !(c->flags & CACHE_FLAG_VALID))
+			continue;
+
+		if (c->pub_data_size > sizeof(tmp_buffer)) {
+			LogError("Source buffer size too big! Size:  %d", c->pub_data_size);
+			continue;
 		}
 
-                num_keys = LE_32(num_keys);
-		if ((rc = write_data(fd, &num_keys, sizeof(UINT32)))) {
-			LogError("%s", __FUNCTION__);
-			return rc;
-		}
+		if (psfile_read(fd, TSSPS_PUB_DATA_OFFSET(c), tmp_buffer, c->pub_data_size))
+			continue;
 
-		/* return the offset */
-		return (TSSPS_NUM_KEYS_OFFSET + sizeof(UINT32));
+		if (!memcmp(tmp_buffer, pub->key, c->pub_data_size))
+			return c;
 	}
 
-	/* if there is a hole in the file we can write to, find it */
-	offset = find_write_offset(pub_data_size, blob_size, vendor_data_size);
+	return NULL;
+}
 
-	if (offset != -1) {
-		/* we found a hole, seek to it and don't increment the # of keys on disk */
-		rc = lseek(fd, offset, SEEK_SET);
-	} else {
-		/* we didn't find a hole, increment the number of keys on disk and seek
-		 * to the end of the file
-		 */
-		num_keys++;
-
-		/* go to the beginning */
-		rc = lseek(fd, TSSPS_NUM_KEYS_OFFSET, SEEK_SET);
-		if (rc == ((off_t) - 1)) {
-			LogError("lseek: %s", strerror(errno));
-			return -1;
-		}
-                num_keys = LE_32(num_keys);
-		if ((rc = write_data(fd, &num_keys, sizeof(UINT32)))) {
-			LogError("%s", __FUNCTION__);
-			return rc;
+/*
+ * return the smallest free record in the file that can hold size bytes of key data,
+ * or NULL if a new record must be appended. The disk cache must be locked by the
+ * caller.
+ */
+struct key_disk_cache *
+disk_cache_find_free(UINT32 size)
+{
+	struct key_disk_cache *tmp, *best = NULL;
+
+	for (tmp = free_disk_cache_head; tmp; tmp = tmp->next) {
+		if (tmp->record_size < size)
+			continue;
+		if (best == NULL || tmp->record_size < best->record_size) {
+			best = tmp;
+			if (best->record_size == size)
+				break;
 		}
-
-		rc = lseek(fd, 0, SEEK_END);
-	}
-	if (rc == ((off_t) - 1)) {
-		LogError("lseek: %s", strerror(errno));
-		return -1;
 	}
 
-	/* lseek returns the number of bytes of offset from the beginning of the file */
-	return rc;
+	return best;
 }
 
 /*
- * add a new cache entry for a written key
+ * add a new cache entry for a key written at offset. If the key was written into
+ * the free record hole, hole is taken off the free list and reused, otherwise the
+ * key was appended to the file.
  */
 TSS_RESULT
-cache_key(UINT32 offset, UINT16 flags,
-		TSS_UUID *uuid, TSS_UUID *parent_uuid,
-		UINT16 pub_data_size, UINT32 blob_size,
-		UINT32 vendor_data_size)
+cache_key(struct key_disk_cache *hole, UINT32 offset, UINT32 record_size, UINT16 flags,
+	  TSS_UUID *uuid, TSS_UUID *parent_uuid, UINT16 pub_data_size, UINT32 blob_size,
+	  UINT32 vendor_data_size, UINT32 pub_digest)
 {
-	struct key_disk_cache *tmp;
+	struct key_disk_cache *tmp, **p;
 
 	MUTEX_LOCK(disk_cache_lock);
 
-	tmp = key_disk_cache_head;
-
-	for (; tmp; tmp = tmp->next) {
-		/* reuse an invalidated key cache entry */
-		if (!(tmp->flags & CACHE_FLAG_VALID))
-			goto fill_cache_entry;
-	}
-
-	tmp = malloc(sizeof(struct key_disk_cache));
-	if (tmp == NULL) {
-		LogError("malloc of %zd bytes failed.", sizeof(struct key_disk_cache));
-		MUTEX_UNLOCK(disk_cache_lock);
-		return TCSERR(TSS_E_OUTOFMEMORY);
+	if (hole) {
+		for (p = &free_disk_cache_head; *p; p = &(*p)->next) {
+			if (*p == hole) {
+				*p = hole->next;
+				break;
+			}
+		}
+		ps_free_bytes -= hole->record_size + sizeof(UINT32);
+		tmp = hole;
+	} else {
+		tmp = malloc(sizeof(struct key_disk_cache));
+		if (tmp == NULL) {
+			LogError("malloc of %zd bytes failed.", sizeof(struct key_disk_cache));
+			MUTEX_UNLOCK(disk_cache_lock);
+			return TCSERR(TSS_E_OUTOFMEMORY);
+		}
+		ps_num_records++;
+		if (offset + record_size > ps_file_end)
+			ps_file_end = offset + record_size;
 	}
 	tmp->next = key_disk_cache_head;
 	key_disk_cache_head = tmp;
 
-fill_cache_entry:
 	tmp->offset = offset;
 #ifdef TSS_DEBUG
 	if (offset == 0)
 		LogDebug("Storing key with file offset==0!!!");
 #endif
+	tmp->record_size = record_size;
 	tmp->flags = flags;
 	tmp->blob_size = blob_size;
 	tmp->pub_data_size = pub_data_size;
 	tmp->vendor_data_size = vendor_data_size;
+	tmp->pub_digest = pub_digest;
 	memcpy(&tmp->uuid, uuid, sizeof(TSS_UUID));
 	memcpy(&tmp->parent_uuid, parent_uuid, sizeof(TSS_UUID));
 
+	disk_cache_index_add(tmp);
+
 	MUTEX_UNLOCK(disk_cache_lock);
 	return TSS_SUCCESS;
 }
 
 /*
- * read into the PS file and return the number of keys
+ * move the (already invalidated on disk) entry c off the disk cache and onto the
+ * free list. The disk cache must be locked by the caller.
  */
-int
-get_num_keys_in_file(int fd)
+void
+disk_cache_release(struct key_disk_cache *c)
 {
-	UINT32 num_keys;
-	int rc;
+	struct key_disk_cache **p;
 
-	/* go to the number of keys */
-	rc = lseek(fd, TSSPS_NUM_KEYS_OFFSET, SEEK_SET);
-	if (rc == ((off_t) - 1)) {
-		LogError("lseek: %s", strerror(errno));
-		return 0;
-	}
-
-	rc = read(fd, &num_keys, sizeof(UINT32));
-	if (rc < 0) {
-		LogError("read of %zd bytes: %s", sizeof(UINT32), strerror(errno));
-		return 0;
-	} else if ((unsigned)rc < sizeof(UINT32)) {
-		num_keys = 0;
+	for (p = &key_disk_cache_head; *p; p = &(*p)->next) {
+		if (*p == c) {
+			*p = c->next;
+			break;
+		}
 	}
-        num_keys = LE_32(num_keys);
+	disk_cache_index_remove(c);
 
-	return num_keys;
+	c->flags &= ~CACHE_FLAG_VALID;
+	c->next = free_disk_cache_head;
+	free_disk_cache_head = c;
+	ps_free_bytes += c->record_size + sizeof(UINT32);
 }
 
-/*
- * count the number of valid keys in the cache
- */
-int
-get_num_keys()
+void
+disk_cache_free_records()
 {
-	int num_keys = 0;
-	struct key_disk_cache *tmp;
-
-	MUTEX_LOCK(disk_cache_lock);
-
-	tmp = key_disk_cache_head;
+	struct key_disk_cache *tmp, *tmp_next;
 
-	for (; tmp; tmp = tmp->next) {
-		if (tmp->flags & CACHE_FLAG_VALID)
-			num_keys++;
+	for (tmp = free_disk_cache_head; tmp; tmp = tmp_next) {
+		tmp_next = tmp->next;
+		free(tmp);
 	}
+	free_disk_cache_head = NULL;
+	ps_free_bytes = 0;
+}
 
-	MUTEX_UNLOCK(disk_cache_lock);
-	return num_keys;
+/*
+ * the file is compacted online once more than half of it is made up of free records
+ */
+TSS_BOOL
+disk_cache_needs_compaction()
+{
+	return (ps_free_bytes > TSSPS_COMPACT_MIN && ps_free_bytes > ps_file_end / 2);
 }
 
 /*
@@ -342,6 +358,20 @@ get_num_keys()
  * [BYTE[]   vendor_data0     ]
  * [...]
  *
+ * Version 2 (system PS only):  cached?
+ * [BYTE     PS version = '\2']
+ * [UINT32   num_records      ]
+ * [UINT32   record_size0     ] yes
+ * [TSS_UUID uuid0            ] yes
+ * [...      as version 1     ]
+ * [BYTE[]   vendor_data0     ]
+ * [BYTE[]   unused0          ]
+ * [...]
+ *
+ * In version 2, unregistering a key only clears CACHE_FLAG_VALID in its record. The
+ * free record is reused by a later key that fits in record_size0 bytes, and the file
+ * is rewritten without free records once they take up too much of it. Version 1
+ * files are converted to version 2 when the TCSD starts.
  */
 /*
  * read the PS file pointed to by fd and create a cache based on it
@@ -349,11 +379,12 @@ get_num_keys()
 int
 init_disk_cache(int fd)
 {
-	UINT32 num_keys = get_num_keys_in_file(fd);
-	UINT16 i;
+	UINT32 num_keys, i, offset, record_size = 0;
 	UINT64 tmp_offset;
-	int rc = 0, offset;
-	struct key_disk_cache *tmp, *prev = NULL;
+	int rc = 0;
+	struct stat stat_buf;
+	struct key_disk_cache c;
+	BYTE version, hdr[TSSPS_RECORD_HEADER_SIZE], *pub = NULL;
 	BYTE srk_blob[2048];
 	TSS_KEY srk_key;
 #ifdef TSS_DEBUG
@@ -362,153 +393,169 @@ init_disk_cache(int fd)
 
 	MUTEX_LOCK(disk_cache_lock);
 
-	if (num_keys == 0) {
-		key_disk_cache_head = NULL;
-		MUTEX_UNLOCK(disk_cache_lock);
-		return 0;
-	} else {
-		key_disk_cache_head = tmp = calloc(1, sizeof(struct key_disk_cache));
-		if (tmp == NULL) {
-			LogError("malloc of %zd bytes failed.",
-						sizeof(struct key_disk_cache));
-			rc = -1;
-			goto err_exit;
-		}
-	}
+	key_disk_cache_head = free_disk_cache_head = NULL;
+	ps_num_records = ps_free_bytes = 0;
+	ps_file_end = TSSPS_KEYS_OFFSET;
 
-	/* make sure the file pointer is where we expect, just after the number
-	 * of keys on disk at the head of the file
-	 */
-	offset = lseek(fd, TSSPS_KEYS_OFFSET, SEEK_SET);
-	if (offset == ((off_t) - 1)) {
-		LogError("lseek: %s", strerror(errno));
+	if (fstat(fd, &stat_buf)) {
+		LogError("fstat: %s", strerror(errno));
 		rc = -1;
 		goto err_exit;
 	}
 
-	for (i=0; i<num_keys; i++) {
-		offset = lseek(fd, 0, SEEK_CUR);
-		if (offset == ((off_t) - 1)) {
-			LogError("lseek: %s", strerror(errno));
+	if (stat_buf.st_size == 0) {
+		/* a new file, write out an empty version 2 header */
+		version = TSSPS_SYSTEM_VERSION;
+		num_keys = 0;
+		if (psfile_write(fd, TSSPS_VERSION_OFFSET, &version, sizeof(BYTE)) ||
+		    psfile_write(fd, TSSPS_NUM_KEYS_OFFSET, &num_keys, sizeof(UINT32)))
 			rc = -1;
-			goto err_exit;
-		}
-		tmp->offset = offset;
-#ifdef TSS_DEBUG
-		if (offset == 0)
-			LogDebug("Storing key with file offset==0!!!");
-#endif
-		/* read UUID */
-		if ((rc = read_data(fd, (void *)&tmp->uuid, sizeof(TSS_UUID)))) {
-			LogError("%s", __FUNCTION__);
-			goto err_exit;
-		}
+		goto err_exit;
+	}
 
-		/* read parent UUID */
-		if ((rc = read_data(fd, (void *)&tmp->parent_uuid, sizeof(TSS_UUID)))) {
-			LogError("%s", __FUNCTION__);
-			goto err_exit;
-		}
+	if (psfile_read(fd, TSSPS_VERSION_OFFSET, &version, sizeof(BYTE)) ||
+	    psfile_read(fd, TSSPS_NUM_KEYS_OFFSET, &num_keys, sizeof(UINT32))) {
+		rc = -1;
+		goto err_exit;
+	}
+	num_keys = LE_32(num_keys);
 
-		/* pub data size */
-		if ((rc = read_data(fd, &tmp->pub_data_size, sizeof(UINT16)))) {
-			LogError("%s", __FUNCTION__);
-			goto err_exit;
-		}
-                tmp->pub_data_size = LE_16(tmp->pub_data_size);
+	if (version != 1 && version != TSSPS_SYSTEM_VERSION) {
+		LogError("system PS file %s has unknown version %u",
+			 tcsd_options.system_ps_file, version);
+		rc = -1;
+		goto err_exit;
+	}
 
-		DBG_ASSERT(tmp->pub_data_size <= 2048 && tmp->pub_data_size > 0);
+	offset = TSSPS_KEYS_OFFSET;
+	for (i = 0; i < num_keys; i++) {
+		if (version == TSSPS_SYSTEM_VERSION) {
+			if ((rc = psfile_read(fd, offset, &record_size, sizeof(UINT32))))
+				goto err_exit;
+			record_size = LE_32(record_size);
+			offset += sizeof(UINT32);
+		}
 
-		/* blob size */
-		if ((rc = read_data(fd, &tmp->blob_size, sizeof(UINT16)))) {
-			LogError("%s", __FUNCTION__);
+		if ((rc = psfile_read(fd, offset, hdr, sizeof(hdr))))
 			goto err_exit;
-		}
-                tmp->blob_size = LE_16(tmp->blob_size);
-		DBG_ASSERT(tmp->blob_size <= 4096 && tmp->blob_size > 0);
 
-		/* vendor data size */
-		if ((rc = read_data(fd, &tmp->vendor_data_size, sizeof(UINT32)))) {
-			LogError("%s", __FUNCTION__);
+		memset(&c, 0, sizeof(c));
+		c.offset = offset;
+		memcpy(&c.uuid, hdr, sizeof(TSS_UUID));
+		memcpy(&c.parent_uuid, &hdr[sizeof(TSS_UUID)], sizeof(TSS_UUID));
+		memcpy(&c.pub_data_size, &hdr[TSSPS_PUB_DATA_SIZE_OFFSET(&c) - offset],
+		       sizeof(UINT16));
+		c.pub_data_size = LE_16(c.pub_data_size);
+		memcpy(&c.blob_size, &hdr[TSSPS_BLOB_SIZE_OFFSET(&c) - offset], sizeof(UINT16));
+		c.blob_size = LE_16(c.blob_size);
+		memcpy(&c.vendor_data_size, &hdr[TSSPS_VENDOR_SIZE_OFFSET(&c) - offset],
+		       sizeof(UINT32));
+		c.vendor_data_size = LE_32(c.vendor_data_size);
+		memcpy(&c.flags, &hdr[TSSPS_CACHE_FLAGS_OFFSET(&c) - offset], sizeof(UINT16));
+		c.flags = LE_16(c.flags);
+
+		DBG_ASSERT(c.pub_data_size <= 2048 && c.pub_data_size > 0);
+		DBG_ASSERT(c.blob_size <= 4096 && c.blob_size > 0);
+
+		if (version != TSSPS_SYSTEM_VERSION)
+			record_size = TSSPS_RECORD_DATA_SIZE(&c);
+		else if (record_size < TSSPS_RECORD_DATA_SIZE(&c)) {
+			LogError("system PS record at offset %u is corrupt", offset);
+			rc = -1;
 			goto err_exit;
 		}
-                tmp->vendor_data_size = LE_32(tmp->vendor_data_size);
 
-		/* cache flags */
-		if ((rc = read_data(fd, &tmp->flags, sizeof(UINT16)))) {
-			LogError("%s", __FUNCTION__);
+		if ((off_t)offset + record_size > stat_buf.st_size) {
+			LogError("system PS file is truncated at record %u", i);
+			rc = -1;
 			goto err_exit;
 		}
-                tmp->flags = LE_16(tmp->flags);
 
+		if (c.flags & CACHE_FLAG_VALID) {
 #ifdef TSS_DEBUG
-		if (tmp->flags & CACHE_FLAG_VALID)
 			valid_keys++;
 #endif
-		/* fast forward over the pub key */
-		offset = lseek(fd, tmp->pub_data_size, SEEK_CUR);
-		if (offset == ((off_t) - 1)) {
-			LogError("lseek: %s", strerror(errno));
-			rc = -1;
-			goto err_exit;
-		}
-
-		/* if this is the SRK, load it into memory, since its already loaded in
-		 * the chip */
-		if (!memcmp(&SRK_UUID, &tmp->uuid, sizeof(TSS_UUID))) {
-			/* read SRK blob from disk */
-			if ((rc = read_data(fd, srk_blob, tmp->blob_size))) {
-				LogError("%s", __FUNCTION__);
+			if ((pub = malloc(c.pub_data_size)) == NULL) {
+				LogError("malloc of %u bytes failed.", c.pub_data_size);
+				rc = -1;
 				goto err_exit;
 			}
-
-			tmp_offset = 0;
-			if ((rc = UnloadBlob_TSS_KEY(&tmp_offset, srk_blob, &srk_key)))
+			if ((rc = psfile_read(fd, TSSPS_PUB_DATA_OFFSET(&c), pub, c.pub_data_size)))
 				goto err_exit;
-			/* add to the mem cache */
-			if ((rc = mc_add_entry_init(SRK_TPM_HANDLE, SRK_TPM_HANDLE, &srk_key,
-						    &SRK_UUID))) {
-				LogError("Error adding SRK to mem cache.");
+			c.pub_digest = disk_cache_hash(pub, c.pub_data_size);
+			free(pub);
+			pub = NULL;
+
+			/* if this is the SRK, load it into memory, since its already loaded in
+			 * the chip */
+			if (!memcmp(&SRK_UUID, &c.uuid, sizeof(TSS_UUID))) {
+				if (c.blob_size > sizeof(srk_blob)) {
+					LogError("SRK blob too large: %u", c.blob_size);
+					rc = -1;
+					goto err_exit;
+				}
+
+				/* read SRK blob from disk */
+				if ((rc = psfile_read(fd, TSSPS_BLOB_DATA_OFFSET(&c), srk_blob,
+						      c.blob_size)))
+					goto err_exit;
+
+				tmp_offset = 0;
+				if ((rc = UnloadBlob_TSS_KEY(&tmp_offset, srk_blob, &srk_key)))
+					goto err_exit;
+				/* add to the mem cache */
+				if ((rc = mc_add_entry_init(SRK_TPM_HANDLE, SRK_TPM_HANDLE,
+							    &srk_key, &SRK_UUID))) {
+					LogError("Error adding SRK to mem cache.");
+					destroy_key_refs(&srk_key);
+					goto err_exit;
+				}
 				destroy_key_refs(&srk_key);
-				goto err_exit;
 			}
-			destroy_key_refs(&srk_key);
-		} else {
-			/* fast forward over the blob */
-			offset = lseek(fd, tmp->blob_size, SEEK_CUR);
-			if (offset == ((off_t) - 1)) {
-				LogError("lseek: %s", strerror(errno));
+
+			if ((rc = cache_key(NULL, offset, record_size, c.flags, &c.uuid,
+					    &c.parent_uuid, c.pub_data_size, c.blob_size,
+					    c.vendor_data_size, c.pub_digest))) {
 				rc = -1;
 				goto err_exit;
 			}
+		} else {
+			/* a free record, keep it around to be reused */
+			struct key_disk_cache *tmp = malloc(sizeof(struct key_disk_cache));
 
-			/* fast forward over the vendor data */
-			offset = lseek(fd, tmp->vendor_data_size, SEEK_CUR);
-			if (offset == ((off_t) - 1)) {
-				LogError("lseek: %s", strerror(errno));
+			if (tmp == NULL) {
+				LogError("malloc of %zd bytes failed.",
+					 sizeof(struct key_disk_cache));
 				rc = -1;
 				goto err_exit;
 			}
+			memcpy(tmp, &c, sizeof(c));
+			tmp->record_size = record_size;
+			tmp->next = free_disk_cache_head;
+			free_disk_cache_head = tmp;
+			ps_free_bytes += record_size + sizeof(UINT32);
+			ps_num_records++;
 		}
 
-		tmp->next = calloc(1, sizeof(struct key_disk_cache));
-		if (tmp->next == NULL) {
-			LogError("malloc of %zd bytes failed.",
-					sizeof(struct key_disk_cache));
-			rc = -1;
-			goto err_exit;
-		}
-		prev = tmp;
-		tmp = tmp->next;
+		offset += record_size;
 	}
+	ps_file_end = offset;
 
-	/* delete the dangling, unfilled cache entry */
-	free(tmp);
-	prev->next = NULL;
-	rc = 0;
 	LogDebug("%s: found %d valid key(s) on disk.\n", __FUNCTION__, valid_keys);
 
+	if (version != TSSPS_SYSTEM_VERSION) {
+		/* this drops the blanked keys left by trousers 0.2.0 and before, too */
+		LogInfo("Converting system PS file %s to version %d",
+			tcsd_options.system_ps_file, TSSPS_SYSTEM_VERSION);
+		if (psfile_rewrite(fd))
+			rc = -1;
+	} else if (disk_cache_needs_compaction()) {
+		if (psfile_rewrite(fd))
+			LogError("Compaction of the system PS file failed.");
+	}
+
 err_exit:
+	free(pub);
 	MUTEX_UNLOCK(disk_cache_lock);
 	return rc;
 }
@@ -518,17 +565,18 @@ close_disk_cache(int fd)
 {
 	struct key_disk_cache *tmp, *tmp_next;
 
-	if (key_disk_cache_head == NULL)
-		return 0;
-
 	MUTEX_LOCK(disk_cache_lock);
-	tmp = key_disk_cache_head;
 
-	do {
+	for (tmp = key_disk_cache_head; tmp; tmp = tmp_next) {
 		tmp_next = tmp->next;
 		free(tmp);
-		tmp = tmp_next;
-	} while (tmp);
+	}
+	key_disk_cache_head = NULL;
+	disk_cache_free_records();
+
+	memset(uuid_index, 0, sizeof(uuid_index));
+	memset(pub_index, 0, sizeof(pub_index));
+	psfile_unmap();
 
 	MUTEX_UNLOCK(disk_cache_lock);
 
@@ -17,6 +17,7 @@
 #include <sys/types.h>
 #include <sys/file.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #if defined (HAVE_BYTEORDER_H)
 #include <sys/byteorder.h>
 #elif defined (HTOLE_DEFINED)
@@ -54,10 +55,22 @@ MUTEX_DECLARE(disk_cache_lock);
 
 static struct flock fl;
 
+/* a read-only mapping of the system PS file, protected by disk_cache_lock */
+static BYTE *ps_map = NULL;
+static UINT32 ps_map_size = 0;
+
+/*
+ * The fcntl lock only keeps other processes out of the PS file. Threads of this
+ * TCSD share system_ps_fd and its file offset, so get_file() also takes the
+ * (recursive) disk_cache_lock, which is held until the matching put_file().
+ */
 int
 get_file()
 {
 	int rc;
+
+	MUTEX_LOCK(disk_cache_lock);
+
 	/* check the global file handle first.  If it exists, lock it and return */
 	if (system_ps_fd != -1) {
 		int rc = 0;
@@ -65,6 +78,7 @@ get_file()
 		fl.l_type = F_WRLCK;
 		if ((rc = fcntl(system_ps_fd, F_SETLKW, &fl))) {
 			LogError("failed to get system PS lock: %s", strerror(errno));
+			MUTEX_UNLOCK(disk_cache_lock);
 			return -1;
 		}
 
@@ -76,6 +90,7 @@ get_file()
 	if (system_ps_fd < 0) {
 		LogError("system PS: open() of %s failed: %s",
 				tcsd_options.system_ps_file, strerror(errno));
+		MUTEX_UNLOCK(disk_cache_lock);
 		return -1;
 	}
 
@@ -83,6 +98,7 @@ get_file()
 	if ((rc = fcntl(system_ps_fd, F_SETLKW, &fl))) {
 		LogError("failed to get system PS lock of file %s: %s",
 			tcsd_options.system_ps_file, strerror(errno));
+		MUTEX_UNLOCK(disk_cache_lock);
 		return -1;
 	}
 
@@ -99,9 +115,11 @@ put_file(int fd)
 	if ((rc = fcntl(fd, F_SETLKW, &fl))) {
 		LogError("failed to unlock system PS file: %s",
 			strerror(errno));
-		return -1;
+		rc = -1;
 	}
 
+	MUTEX_UNLOCK(disk_cache_lock);
+
 	return rc;
 }
 
@@ -112,44 +130,286 @@ close_file(int fd)
 	system_ps_fd = -1;
 }
 
+void
+psfile_unmap()
+{
+	if (ps_map)
+		munmap(ps_map, ps_map_size);
+	ps_map = NULL;
+	ps_map_size = 0;
+}
+
+static void
+psfile_map(int fd)
+{
+	struct stat stat_buf;
+	void *map;
+
+	psfile_unmap();
+
+	if (fstat(fd, &stat_buf)) {
+		LogError("fstat: %s", strerror(errno));
+		return;
+	}
+
+	if (stat_buf.st_size == 0 || stat_buf.st_size > UINT_MAX)
+		return;
+
+	map = mmap(NULL, stat_buf.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		LogDebug("mmap of system PS file: %s", strerror(errno));
+		return;
+	}
+
+	ps_map = map;
+	ps_map_size = stat_buf.st_size;
+}
+
+/*
+ * read size bytes at offset from the PS file. Reads are served from a shared mapping
+ * of the file, which is re-established when the file has grown past it; if the file
+ * can't be mapped, fall back to pread. The caller must hold the file (see get_file()).
+ */
+TSS_RESULT
+psfile_read(int fd, UINT32 offset, void *data, UINT32 size)
+{
+	ssize_t rc;
+
+	if ((UINT64)offset + size > ps_map_size)
+		psfile_map(fd);
+
+	if (ps_map && (UINT64)offset + size <= ps_map_size) {
+		memcpy(data, &ps_map[offset], size);
+		return TSS_SUCCESS;
+	}
+
+	rc = pread(fd, data, size, offset);
+	if (rc == -1) {
+		LogError("read of %u bytes: %s", size, strerror(errno));
+		return TCSERR(TSS_E_INTERNAL_ERROR);
+	} else if ((UINT32)rc != size) {
+		LogError("read of %u bytes (only %zd read)", size, rc);
+		return TCSERR(TSS_E_INTERNAL_ERROR);
+	}
+
+	return TSS_SUCCESS;
+}
+
+/*
+ * write size bytes at offset in the PS file. The mapping is shared, so it sees the
+ * write without being remapped. The caller must hold the file (see get_file()).
+ */
+TSS_RESULT
+psfile_write(int fd, UINT32 offset, void *data, UINT32 size)
+{
+	ssize_t rc;
+
+	rc = pwrite(fd, data, size, offset);
+	if (rc == -1) {
+		LogError("write of %u bytes: %s", size, strerror(errno));
+		return TCSERR(TSS_E_INTERNAL_ERROR);
+	} else if ((UINT32)rc != size) {
+		LogError("write of %u bytes (only %zd written)", size, rc);
+		return TCSERR(TSS_E_INTERNAL_ERROR);
+	}
+
+	return TSS_SUCCESS;
+}
+
+/*
+ * put the PS file back onto fd (and lock it) after psfile_rewrite() moved its
+ * replacement there but could not install it under the PS file's name
+ */
+static void
+psfile_reopen(int fd)
+{
+	int old_fd;
+
+	old_fd = open(tcsd_options.system_ps_file, O_RDWR);
+	if (old_fd < 0) {
+		LogError("system PS: open() of %s failed: %s",
+			 tcsd_options.system_ps_file, strerror(errno));
+		return;
+	}
+
+	if (dup2(old_fd, fd) < 0) {
+		LogError("dup2: %s", strerror(errno));
+		close(old_fd);
+		return;
+	}
+	close(old_fd);
+
+	fl.l_type = F_WRLCK;
+	if (fcntl(fd, F_SETLKW, &fl))
+		LogError("failed to get system PS lock: %s", strerror(errno));
+}
+
+/* fsync the directory holding the PS file so that a rename into it survives a crash */
+static void
+psfile_sync_dir()
+{
+	char *dir, *slash;
+	int dir_fd;
+
+	if ((dir = strdup(tcsd_options.system_ps_file)) == NULL) {
+		LogError("malloc of %zd bytes failed.", strlen(tcsd_options.system_ps_file) + 1);
+		return;
+	}
+
+	if ((slash = strrchr(dir, '/')) == NULL)
+		strcpy(dir, ".");
+	else if (slash == dir)
+		slash[1] = '\0';
+	else
+		*slash = '\0';
+
+	if ((dir_fd = open(dir, O_RDONLY)) < 0) {
+		LogError("system PS: open() of %s failed: %s", dir, strerror(errno));
+	} else {
+		if (fsync(dir_fd))
+			LogError("fsync of %s: %s", dir, strerror(errno));
+		close(dir_fd);
+	}
+
+	free(dir);
+}
+
+/*
+ * write the valid keys in the PS file out to a new version 2 file with no free
+ * records in it, then atomically replace the PS file with it. This converts older
+ * files and reclaims the space left behind by unregistered keys. The caller must hold
+ * the file (see get_file()), which stays held on return.
+ */
+TSS_RESULT
+psfile_rewrite(int fd)
+{
+	struct key_disk_cache *tmp;
+	char *path = NULL;
+	BYTE version = TSSPS_SYSTEM_VERSION, *buf = NULL;
+	UINT32 num_keys = 0, i, offset, size, buf_size = 0, *offsets = NULL;
+	int new_fd = -1;
+	TSS_BOOL renamed = FALSE;
+	TSS_RESULT result = TCSERR(TSS_E_INTERNAL_ERROR);
+
+	for (tmp = key_disk_cache_head; tmp; tmp = tmp->next)
+		num_keys++;
+
+	if ((offsets = malloc((num_keys + 1) * sizeof(UINT32))) == NULL) {
+		LogError("malloc of %zd bytes failed.", (num_keys + 1) * sizeof(UINT32));
+		return TCSERR(TSS_E_OUTOFMEMORY);
+	}
+
+	if ((path = malloc(strlen(tcsd_options.system_ps_file) + 5)) == NULL) {
+		LogError("malloc of %zd bytes failed.", strlen(tcsd_options.system_ps_file) + 5);
+		free(offsets);
+		return TCSERR(TSS_E_OUTOFMEMORY);
+	}
+	sprintf(path, "%s.tmp", tcsd_options.system_ps_file);
+
+	new_fd = open(path, O_CREAT|O_TRUNC|O_RDWR, 0600);
+	if (new_fd < 0) {
+		LogError("system PS: open() of %s failed: %s", path, strerror(errno));
+		goto done;
+	}
+
+	i = LE_32(num_keys);
+	if (write_data(new_fd, &version, sizeof(BYTE)) ||
+	    write_data(new_fd, &i, sizeof(UINT32)))
+		goto done;
+
+	offset = TSSPS_KEYS_OFFSET;
+	for (i = 0, tmp = key_disk_cache_head; tmp; tmp = tmp->next, i++) {
+		size = TSSPS_RECORD_DATA_SIZE(tmp);
+		if (sizeof(UINT32) + size > buf_size) {
+			free(buf);
+			buf_size = sizeof(UINT32) + size;
+			if ((buf = malloc(buf_size)) == NULL) {
+				LogError("malloc of %u bytes failed.", buf_size);
+				result = TCSERR(TSS_E_OUTOFMEMORY);
+				goto done;
+			}
+		}
+
+		*(UINT32 *)buf = LE_32(size);
+		if (psfile_read(fd, TSSPS_UUID_OFFSET(tmp), &buf[sizeof(UINT32)], size) ||
+		    write_data(new_fd, buf, sizeof(UINT32) + size))
+			goto done;
+
+		offsets[i] = offset + sizeof(UINT32);
+		offset += sizeof(UINT32) + size;
+	}
+
+	if (fsync(new_fd)) {
+		LogError("fsync of %s: %s", path, strerror(errno));
+		goto done;
+	}
+
+	/* move the new file onto fd before it replaces the PS file, so that fd never
+	 * refers to an unlinked inode. Closing new_fd would drop this process' lock on
+	 * the new inode, so the lock is taken through fd only after that */
+	psfile_unmap();
+	if (dup2(new_fd, fd) < 0) {
+		LogError("dup2: %s", strerror(errno));
+		goto done;
+	}
+	close(new_fd);
+	new_fd = -1;
+
+	fl.l_type = F_WRLCK;
+	if (fcntl(fd, F_SETLKW, &fl)) {
+		LogError("failed to get system PS lock: %s", strerror(errno));
+		psfile_reopen(fd);
+		goto done;
+	}
+
+	if (rename(path, tcsd_options.system_ps_file)) {
+		LogError("rename of %s: %s", path, strerror(errno));
+		psfile_reopen(fd);
+		goto done;
+	}
+	renamed = TRUE;
+
+	/* make the rename itself durable; the new file is in place either way */
+	psfile_sync_dir();
+
+	for (i = 0, tmp = key_disk_cache_head; tmp; tmp = tmp->next, i++) {
+		tmp->offset = offsets[i];
+		tmp->record_size = TSSPS_RECORD_DATA_SIZE(tmp);
+	}
+	disk_cache_free_records();
+	ps_num_records = num_keys;
+	ps_file_end = offset;
+
+	LogDebug("system PS file rewritten: %u key(s), %u bytes", num_keys, offset);
+	result = TSS_SUCCESS;
+done:
+	if (new_fd >= 0)
+		close(new_fd);
+	if (!renamed)
+		unlink(path);
+	free(path);
+	free(buf);
+	free(offsets);
+	return result;
+}
+
 TSS_RESULT
 psfile_get_parent_uuid_by_uuid(int fd, TSS_UUID *uuid, TSS_UUID *ret_uuid)
 {
-        int rc;
-        UINT32 file_offset = 0;
-        struct key_disk_cache *tmp;
-
-        MUTEX_LOCK(disk_cache_lock);
-        tmp = key_disk_cache_head;
-
-        while (tmp) {
-                if (memcmp(uuid, &tmp->uuid, sizeof(TSS_UUID)) || !(tmp->flags & CACHE_FLAG_VALID)) {
-                        tmp = tmp->next;
-                        continue;
-                }
-
-                /* jump to the location of the parent uuid */
-                file_offset = TSSPS_PARENT_UUID_OFFSET(tmp);
-
-                rc = lseek(fd, file_offset, SEEK_SET);
-                if (rc == ((off_t) - 1)) {
-                        LogError("lseek: %s", strerror(errno));
-                        MUTEX_UNLOCK(disk_cache_lock);
-                        return -1;
-                }
-
-                if ((rc = read_data(fd, ret_uuid, sizeof(TSS_UUID)))) {
-			LogError("%s", __FUNCTION__);
-                        MUTEX_UNLOCK(disk_cache_lock);
-                        return rc;
-                }
-
-                MUTEX_UNLOCK(disk_cache_lock);
-                return TSS_SUCCESS;
-        }
-        MUTEX_UNLOCK(disk_cache_lock);
-        /* key not found */
-        return -2;
+	struct key_disk_cache *tmp;
+
+	MUTEX_LOCK(disk_cache_lock);
+
+	if ((tmp = disk_cache_find_by_uuid(uuid)) == NULL) {
+		MUTEX_UNLOCK(disk_cache_lock);
+		/* key not found */
+		return -2;
+	}
+
+	memcpy(ret_uuid, &tmp->parent_uuid, sizeof(TSS_UUID));
+
+	MUTEX_UNLOCK(disk_cache_lock);
+	return TSS_SUCCESS;
 }
 
 /*
@@ -158,49 +418,33 @@ psfile_get_parent_uuid_by_uuid(int fd, TSS_UUID *uuid, TSS_UUID *ret_uuid)
 TSS_RESULT
 psfile_get_key_by_uuid(int fd, TSS_UUID *uuid, BYTE *ret_buffer, UINT16 *ret_buffer_size)
 {
-        int rc;
-        UINT32 file_offset = 0;
-        struct key_disk_cache *tmp;
-
-        MUTEX_LOCK(disk_cache_lock);
-        tmp = key_disk_cache_head;
-
-        while (tmp) {
-                if (memcmp(uuid, &tmp->uuid, sizeof(TSS_UUID)) || !(tmp->flags & CACHE_FLAG_VALID)) {
-                        tmp = tmp->next;
-                        continue;
-                }
-
-                /* jump to the location of the key blob */
-                file_offset = TSSPS_BLOB_DATA_OFFSET(tmp);
-
-                rc = lseek(fd, file_offset, SEEK_SET);
-                if (rc == ((off_t) - 1)) {
-                        LogError("lseek: %s", strerror(errno));
-                        MUTEX_UNLOCK(disk_cache_lock);
-                        return TCSERR(TSS_E_INTERNAL_ERROR);
-                }
-
-                /* we found the key; file ptr is pointing at the blob */
-                if (*ret_buffer_size < tmp->blob_size) {
-                        /* not enough room */
-                        MUTEX_UNLOCK(disk_cache_lock);
-                        return TCSERR(TSS_E_FAIL);
-                }
-
-                if ((rc = read_data(fd, ret_buffer, tmp->blob_size))) {
-			LogError("%s", __FUNCTION__);
-                        MUTEX_UNLOCK(disk_cache_lock);
-                        return rc;
-                }
-		*ret_buffer_size = tmp->blob_size;
-		LogDebugUnrollKey(ret_buffer);
-                MUTEX_UNLOCK(disk_cache_lock);
-                return TSS_SUCCESS;
-        }
-        MUTEX_UNLOCK(disk_cache_lock);
-        /* key not found */
-        return TCSERR(TSS_E_FAIL);
+	TSS_RESULT rc;
+	struct key_disk_cache *tmp;
+
+	MUTEX_LOCK(disk_cache_lock);
+
+	if ((tmp = disk_cache_find_by_uuid(uuid)) == NULL) {
+		MUTEX_UNLOCK(disk_cache_lock);
+		/* key not found */
+		return TCSERR(TSS_E_FAIL);
+	}
+
+	if (*ret_buffer_size < tmp->blob_size) {
+		/* not enough room */
+		MUTEX_UNLOCK(disk_cache_lock);
+		return TCSERR(TSS_E_FAIL);
+	}
+
+	if ((rc = psfile_read(fd, TSSPS_BLOB_DATA_OFFSET(tmp), ret_buffer, tmp->blob_size))) {
+		LogError("%s", __FUNCTION__);
+		MUTEX_UNLOCK(disk_cache_lock);
+		return rc;
+	}
+	*ret_buffer_size = tmp->blob_size;
+	LogDebugUnrollKey(ret_buffer);
+
+	MUTEX_UNLOCK(disk_cache_lock);
+	return TSS_SUCCESS;
 }
 
 /*
@@ -211,19 +455,6 @@ TSS_RESULT
 psfile_get_key_by_cache_entry(int fd, struct key_disk_cache *c, BYTE *ret_buffer,
 			  UINT16 *ret_buffer_size)
 {
-        int rc;
-        UINT32 file_offset = 0;
-
-	/* jump to the location of the key blob */
-	file_offset = TSSPS_BLOB_DATA_OFFSET(c);
-
-	rc = lseek(fd, file_offset, SEEK_SET);
-	if (rc == ((off_t) - 1)) {
-		LogError("lseek: %s", strerror(errno));
-		return TCSERR(TSS_E_INTERNAL_ERROR);
-	}
-
-	/* we found the key; file ptr is pointing at the blob */
 	if (*ret_buffer_size < c->blob_size) {
 		/* not enough room */
 		LogError("%s: Buf size too small. Needed %d bytes, passed %d", __FUNCTION__,
@@ -231,7 +462,7 @@ psfile_get_key_by_cache_entry(int fd, struct key_disk_cache *c, BYTE *ret_buffer
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 	}
 
-	if ((rc = read_data(fd, ret_buffer, c->blob_size))) {
+	if (psfile_read(fd, TSSPS_BLOB_DATA_OFFSET(c), ret_buffer, c->blob_size)) {
 		LogError("%s: error reading %d bytes", __FUNCTION__, c->blob_size);
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 	}
@@ -247,24 +478,12 @@ psfile_get_key_by_cache_entry(int fd, struct key_disk_cache *c, BYTE *ret_buffer
 TSS_RESULT
 psfile_get_vendor_data(int fd, struct key_disk_cache *c, UINT32 *size, BYTE **data)
 {
-        int rc;
-        UINT32 file_offset;
-
-	/* jump to the location of the data */
-	file_offset = TSSPS_VENDOR_DATA_OFFSET(c);
-
-	rc = lseek(fd, file_offset, SEEK_SET);
-	if (rc == ((off_t) - 1)) {
-		LogError("lseek: %s", strerror(errno));
-		return TCSERR(TSS_E_INTERNAL_ERROR);
-	}
-
 	if ((*data = malloc(c->vendor_data_size)) == NULL) {
 		LogError("malloc of %u bytes failed", c->vendor_data_size);
 		return TCSERR(TSS_E_OUTOFMEMORY);
 	}
 
-	if ((rc = read_data(fd, *data, c->vendor_data_size))) {
+	if (psfile_read(fd, TSSPS_VENDOR_DATA_OFFSET(c), *data, c->vendor_data_size)) {
 		LogError("%s: error reading %u bytes", __FUNCTION__, c->vendor_data_size);
 		free(*data);
 		*data = NULL;
@@ -281,24 +500,13 @@ psfile_get_ps_type_by_uuid(int fd, TSS_UUID *uuid, UINT32 *ret_ps_type)
 	struct key_disk_cache *tmp;
 
 	MUTEX_LOCK(disk_cache_lock);
-	tmp = key_disk_cache_head;
-
-        while (tmp) {
-		if (memcmp(uuid, &tmp->uuid, sizeof(TSS_UUID)) ||
-		    !(tmp->flags & CACHE_FLAG_VALID)) {
-			tmp = tmp->next;
-			continue;
-                }
 
-		if (tmp->flags & CACHE_FLAG_PARENT_PS_SYSTEM) {
-			*ret_ps_type = TSS_PS_TYPE_SYSTEM;
-			goto done;
-		} else
-			break;
-        }
+	tmp = disk_cache_find_by_uuid(uuid);
+	if (tmp && (tmp->flags & CACHE_FLAG_PARENT_PS_SYSTEM))
+		*ret_ps_type = TSS_PS_TYPE_SYSTEM;
+	else
+		*ret_ps_type = TSS_PS_TYPE_USER;
 
-	*ret_ps_type = TSS_PS_TYPE_USER;
-done:
 	MUTEX_UNLOCK(disk_cache_lock);
 	return TSS_SUCCESS;
 }
@@ -306,257 +514,79 @@ done:
 TSS_RESULT
 psfile_is_pub_registered(int fd, TCPA_STORE_PUBKEY *pub, TSS_BOOL *is_reg)
 {
-        int rc;
-        UINT32 file_offset = 0;
-        struct key_disk_cache *tmp;
-	char tmp_buffer[2048];
-
-        MUTEX_LOCK(disk_cache_lock);
-        tmp = key_disk_cache_head;
-
-        while (tmp) {
-		/* if the key is of the wrong size or is invalid, try the next one */
-                if (pub->keyLength != tmp->pub_data_size || !(tmp->flags & CACHE_FLAG_VALID)) {
-                        tmp = tmp->next;
-                        continue;
-                }
-
-		/* we have a valid key with the same key size as the one we're looking for.
-		 * grab the pub key data off disk and compare it. */
-
-                /* jump to the location of the public key */
-                file_offset = TSSPS_PUB_DATA_OFFSET(tmp);
-
-                rc = lseek(fd, file_offset, SEEK_SET);
-                if (rc == ((off_t) - 1)) {
-                        LogError("lseek: %s", strerror(errno));
-                        MUTEX_UNLOCK(disk_cache_lock);
-                        return TCSERR(TSS_E_INTERNAL_ERROR);
-                }
-
-		DBG_ASSERT(tmp->pub_data_size < 2048);
-
-		/* read in the key */
-                if ((rc = read_data(fd, tmp_buffer, tmp->pub_data_size))) {
-			LogError("%s", __FUNCTION__);
-                        MUTEX_UNLOCK(disk_cache_lock);
-                        return rc;
-                }
-
-		/* do the compare */
-		if (memcmp(tmp_buffer, pub->key, tmp->pub_data_size)) {
-			tmp = tmp->next;
-			continue;
-		}
-
-		/* the key matches, copy the uuid out */
-		*is_reg = TRUE;
+	MUTEX_LOCK(disk_cache_lock);
+	*is_reg = disk_cache_find_by_pub(fd, pub) ? TRUE : FALSE;
+	MUTEX_UNLOCK(disk_cache_lock);
 
-                MUTEX_UNLOCK(disk_cache_lock);
-                return TSS_SUCCESS;
-        }
-        MUTEX_UNLOCK(disk_cache_lock);
-        /* key not found */
-	*is_reg = FALSE;
-        return TSS_SUCCESS;
+	return TSS_SUCCESS;
 }
 
 
 TSS_RESULT
 psfile_get_uuid_by_pub(int fd, TCPA_STORE_PUBKEY *pub, TSS_UUID **ret_uuid)
 {
-        int rc;
-        UINT32 file_offset = 0;
-        struct key_disk_cache *tmp;
-	char tmp_buffer[2048];
-
-        MUTEX_LOCK(disk_cache_lock);
-        tmp = key_disk_cache_head;
-
-        while (tmp) {
-		/* if the key is of the wrong size or is invalid, try the next one */
-                if (pub->keyLength != tmp->pub_data_size || !(tmp->flags & CACHE_FLAG_VALID)) {
-                        tmp = tmp->next;
-                        continue;
-                }
-
-		/* we have a valid key with the same key size as the one we're looking for.
-		 * grab the pub key data off disk and compare it. */
-
-                /* jump to the location of the public key */
-                file_offset = TSSPS_PUB_DATA_OFFSET(tmp);
-
-                rc = lseek(fd, file_offset, SEEK_SET);
-                if (rc == ((off_t) - 1)) {
-                        LogError("lseek: %s", strerror(errno));
-                        MUTEX_UNLOCK(disk_cache_lock);
-                        return TCSERR(TSS_E_INTERNAL_ERROR);
-                }
-
-		DBG_ASSERT(tmp->pub_data_size < 2048);
-
-		if (tmp->pub_data_size > sizeof(tmp_buffer)) {
-			LogError("Source buffer size too big! Size:  %d",
-				 tmp->pub_data_size);
-			MUTEX_UNLOCK(disk_cache_lock);
-			return TCSERR(TSS_E_INTERNAL_ERROR);
-		}
-		/* read in the key */
-                if ((rc = read_data(fd, tmp_buffer, tmp->pub_data_size))) {
-			LogError("%s", __FUNCTION__);
-                        MUTEX_UNLOCK(disk_cache_lock);
-                        return rc;
-                }
-
-		/* do the compare */
-		if (memcmp(tmp_buffer, pub->key, tmp->pub_data_size)) {
-			tmp = tmp->next;
-			continue;
-		}
+	struct key_disk_cache *tmp;
 
-		*ret_uuid = (TSS_UUID *)malloc(sizeof(TSS_UUID));
-		if (*ret_uuid == NULL) {
-			LogError("malloc of %zd bytes failed.", sizeof(TSS_UUID));
-                        MUTEX_UNLOCK(disk_cache_lock);
-			return TCSERR(TSS_E_OUTOFMEMORY);
-		}
+	MUTEX_LOCK(disk_cache_lock);
+
+	if ((tmp = disk_cache_find_by_pub(fd, pub)) == NULL) {
+		MUTEX_UNLOCK(disk_cache_lock);
+		/* key not found */
+		return TCSERR(TSS_E_PS_KEY_NOTFOUND);
+	}
+
+	*ret_uuid = (TSS_UUID *)malloc(sizeof(TSS_UUID));
+	if (*ret_uuid == NULL) {
+		LogError("malloc of %zd bytes failed.", sizeof(TSS_UUID));
+		MUTEX_UNLOCK(disk_cache_lock);
+		return TCSERR(TSS_E_OUTOFMEMORY);
+	}
 
-		/* the key matches, copy the uuid out */
-		memcpy(*ret_uuid, &tmp->uuid, sizeof(TSS_UUID));
+	/* the key matches, copy the uuid out */
+	memcpy(*ret_uuid, &tmp->uuid, sizeof(TSS_UUID));
 
-                MUTEX_UNLOCK(disk_cache_lock);
-                return TSS_SUCCESS;
-        }
-        MUTEX_UNLOCK(disk_cache_lock);
-        /* key not found */
-        return TCSERR(TSS_E_PS_KEY_NOTFOUND);
+	MUTEX_UNLOCK(disk_cache_lock);
+	return TSS_SUCCESS;
 }
 
 TSS_RESULT
 psfile_get_key_by_pub(int fd, TCPA_STORE_PUBKEY *pub, UINT32 *size, BYTE **ret_key)
 {
-        int rc;
-        UINT32 file_offset = 0;
-        struct key_disk_cache *tmp;
-	BYTE tmp_buffer[4096];
-
-        MUTEX_LOCK(disk_cache_lock);
-        tmp = key_disk_cache_head;
-
-        while (tmp) {
-		/* if the key is of the wrong size or is invalid, try the next one */
-                if (pub->keyLength != tmp->pub_data_size || !(tmp->flags & CACHE_FLAG_VALID)) {
-                        tmp = tmp->next;
-                        continue;
-                }
-
-		/* we have a valid key with the same key size as the one we're looking for.
-		 * grab the pub key data off disk and compare it. */
-
-                /* jump to the location of the public key */
-                file_offset = TSSPS_PUB_DATA_OFFSET(tmp);
-
-                rc = lseek(fd, file_offset, SEEK_SET);
-                if (rc == ((off_t) - 1)) {
-                        LogError("lseek: %s", strerror(errno));
-                        MUTEX_UNLOCK(disk_cache_lock);
-                        return TCSERR(TSS_E_INTERNAL_ERROR);
-                }
-
-		DBG_ASSERT(tmp->pub_data_size < 2048);
-		if (tmp->pub_data_size > sizeof(tmp_buffer)) {
-			LogError("Source buffer size too big! Size:  %d",
-				 tmp->pub_data_size);
-			MUTEX_UNLOCK(disk_cache_lock);
-			return TCSERR(TSS_E_INTERNAL_ERROR);
-		}
-
-		/* read in the key */
-                if ((rc = read_data(fd, tmp_buffer, tmp->pub_data_size))) {
-			LogError("%s", __FUNCTION__);
-                        MUTEX_UNLOCK(disk_cache_lock);
-                        return rc;
-                }
-
-		/* do the compare */
-		if (memcmp(tmp_buffer, pub->key, tmp->pub_data_size)) {
-			tmp = tmp->next;
-			continue;
-		}
-
-                /* jump to the location of the key blob */
-                file_offset = TSSPS_BLOB_DATA_OFFSET(tmp);
+	TSS_RESULT rc;
+	struct key_disk_cache *tmp;
 
-                rc = lseek(fd, file_offset, SEEK_SET);
-                if (rc == ((off_t) - 1)) {
-                        LogError("lseek: %s", strerror(errno));
-                        MUTEX_UNLOCK(disk_cache_lock);
-                        return TCSERR(TSS_E_INTERNAL_ERROR);
-                }
+	MUTEX_LOCK(disk_cache_lock);
 
-		DBG_ASSERT(tmp->blob_size < 4096);
-		if (tmp->blob_size > sizeof(tmp_buffer)) {
-			LogError("Blob size greater than 4096! Size:  %d",
-				 tmp->blob_size);
-			MUTEX_UNLOCK(disk_cache_lock);
-			return TCSERR(TSS_E_INTERNAL_ERROR);
-		}
+	if ((tmp = disk_cache_find_by_pub(fd, pub)) == NULL) {
+		MUTEX_UNLOCK(disk_cache_lock);
+		/* key not found */
+		return -2;
+	}
 
-		/* read in the key blob */
-                if ((rc = read_data(fd, tmp_buffer, tmp->blob_size))) {
-			LogError("%s", __FUNCTION__);
-                        MUTEX_UNLOCK(disk_cache_lock);
-                        return rc;
-                }
-
-		*ret_key = malloc(tmp->blob_size);
-		if (*ret_key == NULL) {
-			LogError("malloc of %d bytes failed.", tmp->blob_size);
-                        MUTEX_UNLOCK(disk_cache_lock);
-			return TCSERR(TSS_E_OUTOFMEMORY);
-		}
+	*ret_key = malloc(tmp->blob_size);
+	if (*ret_key == NULL) {
+		LogError("malloc of %d bytes failed.", tmp->blob_size);
+		MUTEX_UNLOCK(disk_cache_lock);
+		return TCSERR(TSS_E_OUTOFMEMORY);
+	}
 
-		memcpy(*ret_key, tmp_buffer, tmp->blob_size);
-		*size = tmp->blob_size;
+	/* read in the key blob */
+	if ((rc = psfile_read(fd, TSSPS_BLOB_DATA_OFFSET(tmp), *ret_key, tmp->blob_size))) {
+		LogError("%s", __FUNCTION__);
+		free(*ret_key);
+		*ret_key = NULL;
+		MUTEX_UNLOCK(disk_cache_lock);
+		return rc;
+	}
+	*size = tmp->blob_size;
 
-                MUTEX_UNLOCK(disk_cache_lock);
-                return rc;
-        }
-        MUTEX_UNLOCK(disk_cache_lock);
-        /* key not found */
-        return -2;
+	MUTEX_UNLOCK(disk_cache_lock);
+	return TSS_SUCCESS;
 }
 
 /*
- * disk store format:
- *
- * TrouSerS 0.2.0 and before:
- * Version 0:                  cached?
- * [UINT32   num_keys_on_disk]
- * [TSS_UUID uuid0           ] yes
- * [TSS_UUID uuid_parent0    ] yes
- * [UINT16   pub_data_size0  ] yes
- * [UINT16   blob_size0      ] yes
- * [UINT16   cache_flags0    ] yes
- * [BYTE[]   pub_data0       ]
- * [BYTE[]   blob0           ]
- * [...]
- *
- * TrouSerS 0.2.1+
- * Version 1:                  cached?
- * [BYTE     PS version = '\1']
- * [UINT32   num_keys_on_disk ]
- * [TSS_UUID uuid0            ] yes
- * [TSS_UUID uuid_parent0     ] yes
- * [UINT16   pub_data_size0   ] yes
- * [UINT16   blob_size0       ] yes
- * [UINT32   vendor_data_size0] yes
- * [UINT16   cache_flags0     ] yes
- * [BYTE[]   pub_data0        ]
- * [BYTE[]   blob0            ]
- * [BYTE[]   vendor_data0     ]
- * [...]
- *
+ * write a key to the system PS file, see init_disk_cache() for the format. The key
+ * goes into the smallest free record it fits in, or is appended to the file.
  */
 TSS_RESULT
 psfile_write_key(int fd,
@@ -569,8 +599,12 @@ psfile_write_key(int fd,
 		UINT16 key_blob_size)
 {
 	TSS_KEY key;
+	struct key_disk_cache c, *hole;
 	UINT16 pub_key_size, cache_flags = CACHE_FLAG_VALID;
+	UINT32 size, record_size, num_records, le32;
+	UINT16 le16;
 	UINT64 offset;
+	BYTE *buf = NULL, *ptr;
 	int rc = 0;
 
 	/* leaving the cache flag for parent ps type as 0 implies TSS_PS_TYPE_USER */
@@ -584,207 +618,117 @@ psfile_write_key(int fd,
 
 	pub_key_size = key.pubKey.keyLength;
 
-        if ((rc = write_key_init(fd, pub_key_size, key_blob_size, vendor_size)) < 0)
-                goto done;
-
-	/* offset now holds the number of bytes from the beginning of the file
-	 * the key will be stored at
-	 */
-	offset = rc;
+	c.pub_data_size = pub_key_size;
+	c.blob_size = key_blob_size;
+	c.vendor_data_size = vendor_size;
+	size = TSSPS_RECORD_DATA_SIZE(&c);
 
-#ifdef TSS_DEBUG
-	if (offset == 0)
-		LogDebug("ERROR: key being written with offset 0!!");
-#endif
+	MUTEX_LOCK(disk_cache_lock);
 
-	/* [TSS_UUID uuid0           ] yes */
-        if ((rc = write_data(fd, (void *)uuid, sizeof(TSS_UUID)))) {
-		LogError("%s", __FUNCTION__);
-                goto done;
+	if ((hole = disk_cache_find_free(size))) {
+		c.offset = hole->offset;
+		record_size = hole->record_size;
+	} else {
+		c.offset = ps_file_end + sizeof(UINT32);
+		record_size = size;
 	}
 
-	/* [TSS_UUID uuid_parent0    ] yes */
-        if ((rc = write_data(fd, (void *)parent_uuid, sizeof(TSS_UUID)))) {
-		LogError("%s", __FUNCTION__);
-                goto done;
+	/* build the whole record so that it goes to disk in one write */
+	if ((buf = malloc(sizeof(UINT32) + size)) == NULL) {
+		LogError("malloc of %zd bytes failed.", sizeof(UINT32) + size);
+		rc = TCSERR(TSS_E_OUTOFMEMORY);
+		goto done;
 	}
+	ptr = buf;
 
+	/* [UINT32   record_size0    ] yes */
+	le32 = LE_32(record_size);
+	memcpy(ptr, &le32, sizeof(UINT32));
+	ptr += sizeof(UINT32);
+	/* [TSS_UUID uuid0           ] yes */
+	memcpy(ptr, uuid, sizeof(TSS_UUID));
+	ptr += sizeof(TSS_UUID);
+	/* [TSS_UUID uuid_parent0    ] yes */
+	memcpy(ptr, parent_uuid, sizeof(TSS_UUID));
+	ptr += sizeof(TSS_UUID);
 	/* [UINT16   pub_data_size0  ] yes */
-	pub_key_size = LE_16(pub_key_size);
-        if ((rc = write_data(fd, &pub_key_size, sizeof(UINT16)))) {
-		LogError("%s", __FUNCTION__);
-                goto done;
-	}
-	/* Swap it back for later */
-	pub_key_size = LE_16(pub_key_size);
-
+	le16 = LE_16(pub_key_size);
+	memcpy(ptr, &le16, sizeof(UINT16));
+	ptr += sizeof(UINT16);
 	/* [UINT16   blob_size0      ] yes */
-	key_blob_size = LE_16(key_blob_size);
-        if ((rc = write_data(fd, &key_blob_size, sizeof(UINT16)))) {
-		LogError("%s", __FUNCTION__);
-                goto done;
-	}
-	/* Swap it back for later */
-	key_blob_size = LE_16(key_blob_size);
-
+	le16 = LE_16(key_blob_size);
+	memcpy(ptr, &le16, sizeof(UINT16));
+	ptr += sizeof(UINT16);
 	/* [UINT32   vendor_data_size0 ] yes */
-	vendor_size = LE_32(vendor_size);
-        if ((rc = write_data(fd, &vendor_size, sizeof(UINT32)))) {
-		LogError("%s", __FUNCTION__);
-                goto done;
-	}
-	/* Swap it back for later */
-	vendor_size = LE_32(vendor_size);
-
+	le32 = LE_32(vendor_size);
+	memcpy(ptr, &le32, sizeof(UINT32));
+	ptr += sizeof(UINT32);
 	/* [UINT16   cache_flags0    ] yes */
-	cache_flags = LE_16(cache_flags);
-        if ((rc = write_data(fd, &cache_flags, sizeof(UINT16)))) {
-		LogError("%s", __FUNCTION__);
-                goto done;
-	}
-	/* Swap it back for later */
-	cache_flags = LE_16(cache_flags);
-
+	le16 = LE_16(cache_flags);
+	memcpy(ptr, &le16, sizeof(UINT16));
+	ptr += sizeof(UINT16);
 	/* [BYTE[]   pub_data0       ] no */
-        if ((rc = write_data(fd, (void *)key.pubKey.key, pub_key_size))) {
-		LogError("%s", __FUNCTION__);
-                goto done;
-	}
-
+	memcpy(ptr, key.pubKey.key, pub_key_size);
+	ptr += pub_key_size;
 	/* [BYTE[]   blob0           ] no */
-        if ((rc = write_data(fd, (void *)key_blob, key_blob_size))) {
+	memcpy(ptr, key_blob, key_blob_size);
+	ptr += key_blob_size;
+	/* [BYTE[]   vendor_data0    ] no */
+	if (vendor_size > 0)
+		memcpy(ptr, vendor_data, vendor_size);
+
+	if ((rc = psfile_write(fd, TSSPS_RECORD_SIZE_OFFSET(&c), buf, sizeof(UINT32) + size))) {
 		LogError("%s", __FUNCTION__);
-                goto done;
+		goto done;
 	}
 
-	/* [BYTE[]   vendor_data0    ] no */
-	if (vendor_size > 0) {
-		if ((rc = write_data(fd, (void *)vendor_data, vendor_size))) {
+	if (hole == NULL) {
+		/* the record was appended, count it in the file's header */
+		num_records = LE_32(ps_num_records + 1);
+		if ((rc = psfile_write(fd, TSSPS_NUM_KEYS_OFFSET, &num_records, sizeof(UINT32)))) {
 			LogError("%s", __FUNCTION__);
 			goto done;
 		}
 	}
 
-	if ((rc = cache_key((UINT32)offset, cache_flags, uuid, parent_uuid, pub_key_size,
-					key_blob_size, vendor_size)))
-                goto done;
+	rc = cache_key(hole, c.offset, record_size, cache_flags, uuid, parent_uuid,
+		       pub_key_size, key_blob_size, vendor_size,
+		       disk_cache_hash(key.pubKey.key, pub_key_size));
 done:
+	MUTEX_UNLOCK(disk_cache_lock);
+	free(buf);
 	destroy_key_refs(&key);
 
-        return rc;
+	return rc;
 }
 
+/*
+ * unregister the key in c by marking its record free on disk. The disk cache entry
+ * moves to the free list, and the file is compacted if too much of it is free. The
+ * caller must hold the file (see get_file()).
+ */
 TSS_RESULT
 psfile_remove_key(int fd, struct key_disk_cache *c)
 {
-        TSS_RESULT result;
-        UINT32 head_offset = 0, tail_offset, num_keys;
-	BYTE buf[4096];
-	struct stat stat_buf;
-	int rc, size = 0;
-
-	if ((rc = fstat(fd, &stat_buf)) != 0) {
-		LogError("fstat: %s", strerror(errno));
-		return TSS_E_INTERNAL_ERROR;
-	}
-
-	/* head_offset is the offset the beginning of the key */
-	head_offset = TSSPS_UUID_OFFSET(c);
-
-	/* tail_offset is the offset the beginning of the next key */
-	tail_offset = TSSPS_VENDOR_DATA_OFFSET(c) + c->vendor_data_size;
-
-	rc = lseek(fd, tail_offset, SEEK_SET);
-	if (rc == ((off_t) - 1)) {
-		LogError("lseek: %s", strerror(errno));
-		return TCSERR(TSS_E_INTERNAL_ERROR);
-	}
+	TSS_RESULT result;
+	UINT16 cache_flags;
 
-	/* read in from tail, write out to head to fill the gap */
-	while ((rc = read(fd, buf, sizeof(buf))) > 0) {
-		size = rc;
-		tail_offset += size;
-
-		/* set the file pointer to where we want to write */
-		rc = lseek(fd, head_offset, SEEK_SET);
-		if (rc == ((off_t) - 1)) {
-			LogError("lseek: %s", strerror(errno));
-			return TCSERR(TSS_E_INTERNAL_ERROR);
-		}
-
-		/* write the data */
-		if ((result = write_data(fd, (void *)buf, size))) {
-			LogError("%s", __FUNCTION__);
-			return result;
-		}
-		head_offset += size;
-
-		/* set the file pointer to where we want to read in the next
-		 * loop */
-		rc = lseek(fd, tail_offset, SEEK_SET);
-		if (rc == ((off_t) - 1)) {
-			LogError("lseek: %s", strerror(errno));
-			return TCSERR(TSS_E_INTERNAL_ERROR);
-		}
-	}
-
-	if (rc < 0) {
-		LogError("read: %s", strerror(errno));
-		return TCSERR(TSS_E_INTERNAL_ERROR);
-	}
-
-	/* set the file pointer to where we want to write */
-	rc = lseek(fd, head_offset, SEEK_SET);
-	if (rc == ((off_t) - 1)) {
-		LogError("lseek: %s", strerror(errno));
-		return TCSERR(TSS_E_INTERNAL_ERROR);
-	}
-
-	/* head_offset now contains a pointer to where we want to truncate the
-	 * file. Zero out the old tail end of the file and truncate it. */
-
-	memset(buf, 0, sizeof(buf));
+	MUTEX_LOCK(disk_cache_lock);
 
-	/* Zero out the old tail end of the file */
-	if ((result = write_data(fd, (void *)buf, tail_offset - head_offset))) {
+	cache_flags = LE_16(c->flags & ~CACHE_FLAG_VALID);
+	if ((result = psfile_write(fd, TSSPS_CACHE_FLAGS_OFFSET(c), &cache_flags,
+				   sizeof(UINT16)))) {
 		LogError("%s", __FUNCTION__);
+		MUTEX_UNLOCK(disk_cache_lock);
 		return result;
 	}
 
-	if ((rc = ftruncate(fd, head_offset)) < 0) {
-		LogError("ftruncate: %s", strerror(errno));
-		return TCSERR(TSS_E_INTERNAL_ERROR);
-	}
-
-	/* we succeeded in removing a key from the disk. Decrement the number
-	 * of keys in the file */
-	rc = lseek(fd, TSSPS_NUM_KEYS_OFFSET, SEEK_SET);
-	if (rc == ((off_t) - 1)) {
-		LogError("lseek: %s", strerror(errno));
-		return TCSERR(TSS_E_INTERNAL_ERROR);
-	}
-
-	rc = read(fd, &num_keys, sizeof(UINT32));
-	num_keys = LE_32(num_keys);
-	if (rc != sizeof(UINT32)) {
-		LogError("read of %zd bytes: %s", sizeof(UINT32), strerror(errno));
-		return TCSERR(TSS_E_INTERNAL_ERROR);
-	}
+	disk_cache_release(c);
 
-	rc = lseek(fd, TSSPS_NUM_KEYS_OFFSET, SEEK_SET);
-	if (rc == ((off_t) - 1)) {
-		LogError("lseek: %s", strerror(errno));
-		return TCSERR(TSS_E_INTERNAL_ERROR);
-	}
-
-	/* decrement, then write back out to disk */
-	num_keys--;
-
-	num_keys = LE_32(num_keys);
-	if ((result = write_data(fd, (void *)&num_keys, sizeof(UINT32)))) {
-		LogError("%s", __FUNCTION__);
-		return result;
-	}
+	/* the key is gone either way, a failed compaction only wastes space */
+	if (disk_cache_needs_compaction() && psfile_rewrite(fd))
+		LogError("Compaction of the system PS file failed.");
 
+	MUTEX_UNLOCK(disk_cache_lock);
 	return TSS_SUCCESS;
 }
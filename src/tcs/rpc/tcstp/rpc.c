@@ -17,6 +17,8 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #endif
+#include <poll.h>
+#include <time.h>
 #include <errno.h>
 
 #include "trousers/tss.h"
@@ -29,10 +31,7 @@
 #include "tcsd_wrap.h"
 #include "tcsd.h"
 #include "rpc_tcstp_tcs.h"
-
-
-/* Lock is not static because we need to reference it in the auth manager */
-MUTEX_DECLARE_INIT(tcsp_lock);
+#include "req_mgr.h"
 
 
 void
@@ -52,12 +51,51 @@ UnloadBlob_Auth_Special(UINT64 *offset, BYTE *blob, TPM_AUTH *auth)
 	UnloadBlob(offset, TCPA_SHA1BASED_NONCE_LEN, blob, (BYTE *)&auth->HMAC);
 }
 
+/* wait until sock is ready for events or deadline passes, if there is one. Returns 0 when
+ * the socket is ready, -1 otherwise */
+static int
+wait_for_socket(int sock, short events, struct timespec *deadline)
+{
+	struct pollfd pfd;
+	struct timespec now;
+	long timeout;
+	int rc;
+
+	if (deadline == NULL)
+		return 0;
+
+	for (;;) {
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		timeout = (deadline->tv_sec - now.tv_sec) * 1000 +
+			  (deadline->tv_nsec - now.tv_nsec) / 1000000;
+		if (timeout <= 0) {
+			LogError("Timed out waiting on socket %d", sock);
+			return -1;
+		}
+
+		pfd.fd = sock;
+		pfd.events = events;
+		pfd.revents = 0;
+		if ((rc = poll(&pfd, 1, (int)timeout)) > 0)
+			return 0;
+		if (rc < 0 && errno != EINTR) {
+			LogError("poll on socket %d failed: %s", sock, strerror(errno));
+			return -1;
+		}
+	}
+}
+
+/* receive exactly size bytes. If deadline is non-NULL, all of them have to arrive before the
+ * CLOCK_MONOTONIC time it points to */
 int
-recv_from_socket(int sock, void *buffer, int size)
+recv_from_socket(int sock, void *buffer, int size, struct timespec *deadline)
 {
         int recv_size = 0, recv_total = 0;
 
 	while (recv_total < size) {
+		if (wait_for_socket(sock, POLLIN, deadline))
+			return -1;
+
 		errno = 0;
 		if ((recv_size = recv(sock, buffer+recv_total, size-recv_total, 0)) <= 0) {
 			if (recv_size < 0) {
@@ -76,13 +114,19 @@ recv_from_socket(int sock, void *buffer, int size)
 	return recv_total;
 }
 
+/* send all size bytes, before the time deadline points to if it is non-NULL */
 int
-send_to_socket(int sock, void *buffer, int size)
+send_to_socket(int sock, void *buffer, int size, struct timespec *deadline)
 {
 	int send_size = 0, send_total = 0;
 
 	while (send_total < size) {
+		if (wait_for_socket(sock, POLLOUT, deadline))
+			return -1;
+
 		if ((send_size = send(sock, buffer+send_total, size-send_total, 0)) < 0) {
+			if (errno == EINTR)
+				continue;
 			LogError("Socket send connection error: %s.", strerror(errno));
 			return -1;
 		}
@@ -370,6 +414,38 @@ getData(TCSD_PACKET_TYPE dataType,
 	return TSS_SUCCESS;
 }
 
+/*
+ * Like getData() for a TCSD_PACKET_TYPE_PBYTE parameter, but instead of copying the data
+ * out, point *theData at it in the receive buffer. The data must be treated as read-only
+ * and not freed, and it is only valid until the buffer is reused for the reply by
+ * initData() or setData().
+ */
+UINT32
+getDataView(unsigned int index, BYTE **theData, UINT32 theDataSize,
+	    struct tcsd_comm_data *comm)
+{
+	TCSD_PACKET_TYPE *type;
+
+	if ((comm->hdr.type_offset + index) > comm->buf_size)
+		return TSS_TCP_RPC_BAD_PACKET_TYPE;
+
+	type = (comm->buf + comm->hdr.type_offset) + index;
+
+	if ((UINT32)index >= comm->hdr.num_parms || *type != TCSD_PACKET_TYPE_PBYTE) {
+		LogDebug("Data type of TCS packet element %d doesn't match.", index);
+		return TSS_TCP_RPC_BAD_PACKET_TYPE;
+	}
+
+	if ((UINT64)comm->hdr.parm_offset + theDataSize > comm->hdr.packet_size)
+		return TCSERR(TSS_E_INTERNAL_ERROR);
+
+	*theData = theDataSize ? comm->buf + comm->hdr.parm_offset : NULL;
+	comm->hdr.parm_offset += theDataSize;
+	comm->hdr.parm_size -= theDataSize;
+
+	return TSS_SUCCESS;
+}
+
 TSS_RESULT
 tcs_wrap_Error(struct tcsd_thread_data *data)
 {
@@ -512,7 +588,9 @@ DispatchTable tcs_func_table[TCSD_MAX_NUM_ORDS] = {
 	{tcs_wrap_CMK_ConvertMigration,"CMK_ConvertMigration"},
 	{tcs_wrap_FlushSpecific,"FlushSpecific"}, /* 120 */
 	{tcs_wrap_KeyControlOwner, "KeyControlOwner"},
-	{tcs_wrap_DSAP, "DSAP"}
+	{tcs_wrap_DSAP, "DSAP"},
+	{tcs_wrap_Batch, "Batch"},
+	{tcs_wrap_GetPcrEventLogPage, "GetPcrEventLogPage"}
 };
 
 int
@@ -567,6 +645,31 @@ access_control(struct tcsd_thread_data *thread_data)
 	return 1;
 }
 
+/* the request manager priority class of the TPM commands sent for a TCSD command */
+static UINT32
+cmd_prio(UINT32 ordinal)
+{
+	switch (ordinal) {
+	case TCSD_ORD_QUOTE:
+	case TCSD_ORD_QUOTE2:
+	case TCSD_ORD_UNSEAL:
+	case TCSD_ORD_SIGN:
+	case TCSD_ORD_PCRREAD:
+	case TCSD_ORD_EXTEND:
+		return TSS_REQ_PRIO_HIGH;
+	case TCSD_ORD_GETRANDOM:
+	case TCSD_ORD_STIRRANDOM:
+	case TCSD_ORD_GETCAPABILITY:
+	case TCSD_ORD_TCSGETCAPABILITY:
+	case TCSD_ORD_SELFTESTFULL:
+	case TCSD_ORD_CONTINUESELFTEST:
+	case TCSD_ORD_GETTESTRESULT:
+		return TSS_REQ_PRIO_LOW;
+	default:
+		return TSS_REQ_PRIO_NORMAL;
+	}
+}
+
 TSS_RESULT
 dispatchCommand(struct tcsd_thread_data *data)
 {
@@ -582,8 +685,10 @@ dispatchCommand(struct tcsd_thread_data *data)
 	LogDebug("Dispatching ordinal %u (%s)", data->comm.hdr.u.ordinal,
 		 tcs_func_table[data->comm.hdr.u.ordinal].name);
 	/* We only need to check access_control if there are remote operations that are defined
-	 * in the config file, which means we allow remote connections */
-	if (tcsd_options.remote_ops[0] && access_control(data)) {
+	 * in the config file, which means we allow remote connections. A batch is checked
+	 * one sub-request at a time in tcs_wrap_Batch() */
+	if (data->comm.hdr.u.ordinal != TCSD_ORD_BATCH &&
+	    tcsd_options.remote_ops[0] && access_control(data)) {
 		LogWarn("Denied %s operation from %s",
 			tcs_func_table[data->comm.hdr.u.ordinal].name, data->hostname);
 
@@ -601,8 +706,17 @@ dispatchCommand(struct tcsd_thread_data *data)
 		return TSS_SUCCESS;
 	}
 
-	/* Now, dispatch */
-	if ((result = tcs_func_table[data->comm.hdr.u.ordinal].Func(data)) == TSS_SUCCESS) {
+	/* Now, dispatch. A batch isn't bracketed itself, each of its sub-requests comes back
+	 * through here and gets its own priority */
+	if (data->comm.hdr.u.ordinal == TCSD_ORD_BATCH)
+		result = tcs_func_table[TCSD_ORD_BATCH].Func(data);
+	else {
+		req_mgr_cmd_begin(data->context, cmd_prio(data->comm.hdr.u.ordinal));
+		result = tcs_func_table[data->comm.hdr.u.ordinal].Func(data);
+		req_mgr_cmd_end();
+	}
+
+	if (result == TSS_SUCCESS) {
 		/* set the comm buffer */
 		offset = 0;
 		LoadBlob_UINT32(&offset, data->comm.hdr.packet_size, data->comm.buf);
@@ -614,10 +728,135 @@ dispatchCommand(struct tcsd_thread_data *data)
 		LoadBlob_UINT32(&offset, data->comm.hdr.parm_offset, data->comm.buf);
 	}
 
+	/* the command has been completed by the TPM, so its keys and auth sessions may be
+	 * evicted again */
+	KEY_MGR_unpin_all();
+	auth_mgr_check_done();
+
 	return result;
 
 }
 
+/*
+ * A TCSD_ORD_BATCH request carries several complete TCSD request packets:
+ *
+ * [UINT32 count][UINT32 size0][PBYTE request0][UINT32 size1][PBYTE request1]...
+ *
+ * Each request is dispatched in turn as if it had arrived on its own, and the reply
+ * has the same layout with each request replaced by its complete reply packet. A
+ * failing request doesn't stop the ones after it; its reply just carries the error.
+ */
+TSS_RESULT
+tcs_wrap_Batch(struct tcsd_thread_data *data)
+{
+	struct tcsd_comm_data batch = data->comm;
+	UINT32 count, i, size, *reply_sizes = NULL, replies_size = 0;
+	BYTE *request, *replies = NULL, *tmp;
+	UINT64 offset;
+	TSS_RESULT result;
+
+	if (getData(TCSD_PACKET_TYPE_UINT32, 0, &count, 0, &batch))
+		return TCSERR(TSS_E_INTERNAL_ERROR);
+
+	if (count == 0 || count > TCSD_BATCH_MAX_REQS) {
+		LogError("Batch of %u TCSD requests refused", count);
+		initData(&data->comm, 0);
+		data->comm.hdr.u.result = TCSERR(TSS_E_BAD_PARAMETER);
+		return TSS_SUCCESS;
+	}
+
+	if ((reply_sizes = calloc(count, sizeof(UINT32))) == NULL) {
+		LogError("malloc of %zd bytes failed.", count * sizeof(UINT32));
+		return TCSERR(TSS_E_OUTOFMEMORY);
+	}
+
+	/* the sub-requests get a comm buffer of their own, since their handlers reuse it for
+	 * the reply */
+	data->comm.buf = NULL;
+	data->comm.buf_size = 0;
+
+	for (i = 0; i < count; i++) {
+		if (getData(TCSD_PACKET_TYPE_UINT32, 1 + (2 * i), &size, 0, &batch) ||
+		    size < sizeof(struct tcsd_packet_hdr) ||
+		    getDataView(2 + (2 * i), &request, size, &batch) ||
+		    Decode_UINT32(request) != size) {
+			result = TCSERR(TSS_E_INTERNAL_ERROR);
+			goto done;
+		}
+
+		if (size > data->comm.buf_size) {
+			if ((tmp = realloc(data->comm.buf, size)) == NULL) {
+				LogError("realloc of %u bytes failed.", size);
+				result = TCSERR(TSS_E_OUTOFMEMORY);
+				goto done;
+			}
+			data->comm.buf = tmp;
+			data->comm.buf_size = size;
+		}
+		memcpy(data->comm.buf, request, size);
+
+		data->comm.hdr.packet_size = Decode_UINT32(data->comm.buf);
+		data->comm.hdr.u.ordinal = Decode_UINT32(data->comm.buf + 4);
+		data->comm.hdr.num_parms = Decode_UINT32(data->comm.buf + 8);
+		data->comm.hdr.type_size = Decode_UINT32(data->comm.buf + 12);
+		data->comm.hdr.type_offset = Decode_UINT32(data->comm.buf + 16);
+		data->comm.hdr.parm_size = Decode_UINT32(data->comm.buf + 20);
+		data->comm.hdr.parm_offset = Decode_UINT32(data->comm.buf + 24);
+
+		if (data->comm.hdr.u.ordinal == TCSD_ORD_BATCH)
+			result = TCSERR(TSS_E_BAD_PARAMETER);
+		else
+			result = getTCSDPacket(data);
+
+		if (result) {
+			/* reply with just the error, as tcsd_conn_service() does */
+			memset(data->comm.buf, 0, sizeof(struct tcsd_packet_hdr));
+			offset = 0;
+			LoadBlob_UINT32(&offset, sizeof(struct tcsd_packet_hdr), data->comm.buf);
+			LoadBlob_UINT32(&offset, result, data->comm.buf);
+		}
+
+		reply_sizes[i] = Decode_UINT32(data->comm.buf);
+		if ((tmp = realloc(replies, replies_size + reply_sizes[i])) == NULL) {
+			LogError("realloc of %u bytes failed.", replies_size + reply_sizes[i]);
+			result = TCSERR(TSS_E_OUTOFMEMORY);
+			goto done;
+		}
+		replies = tmp;
+		memcpy(&replies[replies_size], data->comm.buf, reply_sizes[i]);
+		replies_size += reply_sizes[i];
+	}
+
+	/* put the batch's own buffer back and build the reply in it */
+	free(data->comm.buf);
+	data->comm = batch;
+
+	initData(&data->comm, 1 + (2 * count));
+	if (setData(TCSD_PACKET_TYPE_UINT32, 0, &count, 0, &data->comm)) {
+		result = TCSERR(TSS_E_INTERNAL_ERROR);
+		goto out;
+	}
+	for (i = 0, offset = 0; i < count; offset += reply_sizes[i], i++) {
+		if (setData(TCSD_PACKET_TYPE_UINT32, 1 + (2 * i), &reply_sizes[i], 0,
+			    &data->comm) ||
+		    setData(TCSD_PACKET_TYPE_PBYTE, 2 + (2 * i), &replies[offset], reply_sizes[i],
+			    &data->comm)) {
+			result = TCSERR(TSS_E_INTERNAL_ERROR);
+			goto out;
+		}
+	}
+	data->comm.hdr.u.result = TSS_SUCCESS;
+	result = TSS_SUCCESS;
+	goto out;
+done:
+	free(data->comm.buf);
+	data->comm = batch;
+out:
+	free(reply_sizes);
+	free(replies);
+	return result;
+}
+
 TSS_RESULT
 getTCSDPacket(struct tcsd_thread_data *data)
 {
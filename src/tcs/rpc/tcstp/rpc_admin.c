@@ -45,11 +45,7 @@ tcs_wrap_PhysicalSetDeactivated(struct tcsd_thread_data *data)
 	if (getData(TCSD_PACKET_TYPE_BOOL, 1, &state, 0, &data->comm))
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_PhysicalSetDeactivated_Internal(hContext, state);
-
-	MUTEX_UNLOCK(tcsp_lock);
 done:
 	initData(&data->comm, 0);
 	data->comm.hdr.u.result = result;
@@ -75,12 +71,8 @@ tcs_wrap_DisableOwnerClear(struct tcsd_thread_data *data)
 	if (getData(TCSD_PACKET_TYPE_AUTH, 1, &auth, 0, &data->comm))
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_DisableOwnerClear_Internal(hContext, &auth);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
 	if (result == TSS_SUCCESS) {
 		initData(&data->comm, 1);
 		if (setData(TCSD_PACKET_TYPE_AUTH, 0, &auth, 0, &data->comm)) {
@@ -104,12 +96,8 @@ tcs_wrap_ForceClear(struct tcsd_thread_data *data)
 
 	LogDebugFn("thread %ld context %x", THREAD_ID, hContext);
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_ForceClear_Internal(hContext);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
 	initData(&data->comm, 0);
 	data->comm.hdr.u.result = result;
 
@@ -127,12 +115,8 @@ tcs_wrap_DisableForceClear(struct tcsd_thread_data *data)
 
 	LogDebugFn("thread %ld context %x", THREAD_ID, hContext);
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_DisableForceClear_Internal(hContext);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
 	initData(&data->comm, 0);
 	data->comm.hdr.u.result = result;
 
@@ -150,12 +134,8 @@ tcs_wrap_PhysicalEnable(struct tcsd_thread_data *data)
 
 	LogDebugFn("thread %ld context %x", THREAD_ID, hContext);
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_PhysicalEnable_Internal(hContext);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
 	initData(&data->comm, 0);
 	data->comm.hdr.u.result = result;
 
@@ -180,11 +160,7 @@ tcs_wrap_SetOwnerInstall(struct tcsd_thread_data *data)
 	if (getData(TCSD_PACKET_TYPE_BOOL, 1, &state, 0, &data->comm))
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_SetOwnerInstall_Internal(hContext, state);
-
-	MUTEX_UNLOCK(tcsp_lock);
 done:
 	initData(&data->comm, 0);
 	data->comm.hdr.u.result = result;
@@ -214,12 +190,8 @@ tcs_wrap_OwnerSetDisable(struct tcsd_thread_data *data)
 	if (getData(TCSD_PACKET_TYPE_AUTH, 2, &ownerAuth, 0, &data->comm))
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_OwnerSetDisable_Internal(hContext, disableState, &ownerAuth);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
 	if (result == TSS_SUCCESS) {
 		initData(&data->comm, 1);
 		if (setData(TCSD_PACKET_TYPE_AUTH, 0, &ownerAuth, 0, &data->comm)) {
@@ -243,12 +215,8 @@ tcs_wrap_PhysicalDisable(struct tcsd_thread_data *data)
 
 	LogDebugFn("thread %ld context %x", THREAD_ID, hContext);
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_PhysicalDisable_Internal(hContext);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
 	initData(&data->comm, 0);
 	data->comm.hdr.u.result = result;
 
@@ -273,11 +241,7 @@ tcs_wrap_PhysicalPresence(struct tcsd_thread_data *data)
 	if (getData(TCSD_PACKET_TYPE_UINT16, 1, &phyPresFlags, 0, &data->comm))
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_PhysicalPresence_Internal(hContext, phyPresFlags);
-
-	MUTEX_UNLOCK(tcsp_lock);
 done:
 	initData(&data->comm, 0);
 	data->comm.hdr.u.result = result;
@@ -296,12 +260,8 @@ tcs_wrap_SetTempDeactivated(struct tcsd_thread_data *data)
 
 	LogDebugFn("thread %ld context %x", THREAD_ID, hContext);
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_SetTempDeactivated_Internal(hContext);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
 	initData(&data->comm, 0);
 	data->comm.hdr.u.result = result;
 
@@ -335,12 +295,8 @@ tcs_wrap_SetTempDeactivated2(struct tcsd_thread_data *data)
 	else
 		pAuth = NULL;
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_SetTempDeactivated2_Internal(hContext, pAuth);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
 	if (result == TSS_SUCCESS) {
 		initData(&data->comm, 1);
 		if (pAuth) {
@@ -374,12 +330,8 @@ tcs_wrap_ResetLockValue(struct tcsd_thread_data *data)
 	if (getData(TCSD_PACKET_TYPE_AUTH, 1, &ownerAuth, 0, &data->comm))
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_ResetLockValue_Internal(hContext, &ownerAuth);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
 	if (result == TSS_SUCCESS) {
 		initData(&data->comm, 1);
 		if (setData(TCSD_PACKET_TYPE_AUTH, 0, &ownerAuth, 0, &data->comm)) {
@@ -414,11 +366,7 @@ tcs_wrap_FlushSpecific(struct tcsd_thread_data *data)
 	if (getData(TCSD_PACKET_TYPE_UINT32, 2, &resourceType, 0, &data->comm))
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_FlushSpecific_Internal(hContext, hResHandle, resourceType);
-
-	MUTEX_UNLOCK(tcsp_lock);
 done:
 	initData(&data->comm, 0);
 	data->comm.hdr.u.result = result;
@@ -94,16 +94,12 @@ tcs_wrap_MakeIdentity(struct tcsd_thread_data *data)
 		pSRKAuth = &auth1;
 	}
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_MakeIdentity_Internal(hContext, identityAuth, privCAHash,
 				       idKeyInfoSize, idKeyInfo, pSRKAuth,
 				       pOwnerAuth, &idKeySize, &idKey,
 				       &pcIDBindSize, &prgbIDBind, &pcECSize,
 				       &prgbEC, &pcPlatCredSize, &prgbPlatCred,
 				       &pcConfCredSize, &prgbConfCred);
-
-	MUTEX_UNLOCK(tcsp_lock);
 	free(idKeyInfo);
 
 	if (result == TSS_SUCCESS) {
@@ -205,14 +201,10 @@ tcs_wrap_ActivateIdentity(struct tcsd_thread_data *data)
 		pOwnerAuth = &auth2;
 	}
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_ActivateTPMIdentity_Internal(hContext, idKeyHandle, blobSize,
 						   blob, pIdKeyAuth, pOwnerAuth,
 						   &SymmetricKeySize,
 						   &SymmetricKey);
-
-	MUTEX_UNLOCK(tcsp_lock);
 	free(blob);
 
 	if (result == TSS_SUCCESS) {
@@ -53,12 +53,8 @@ tcs_wrap_SetOrdinalAuditStatus(struct tcsd_thread_data *data)
 	if (getData(TCSD_PACKET_TYPE_AUTH, 3, &ownerAuth, 0, &data->comm))
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_SetOrdinalAuditStatus_Internal(hContext, &ownerAuth, ulOrdinal, bAuditState);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
 	if (result == TSS_SUCCESS) {
 		initData(&data->comm, 1);
 		if (setData(TCSD_PACKET_TYPE_AUTH, 0, &ownerAuth, 0, &data->comm))
@@ -95,13 +91,9 @@ tcs_wrap_GetAuditDigest(struct tcsd_thread_data *data)
 	if (getData(TCSD_PACKET_TYPE_UINT32, 1, &startOrdinal, 0, &data->comm))
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_GetAuditDigest_Internal(hContext, startOrdinal, &auditDigest, &counterValueSize, &counterValue,
 						&more, &ordSize, &ordList);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
 	if (result == TSS_SUCCESS) {
 		initData(&data->comm, 6);
 		if (setData(TCSD_PACKET_TYPE_DIGEST, 0, &auditDigest, 0, &data->comm)) {
@@ -183,15 +175,11 @@ tcs_wrap_GetAuditDigestSigned(struct tcsd_thread_data *data)
 	else
 		pAuth = NULL;
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_GetAuditDigestSigned_Internal(hContext, keyHandle, closeAudit, antiReplay,
 							pAuth, &counterValueSize, &counterValue,
 							&auditDigest, &ordinalDigest,
 							&sigSize, &sig);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
 	if (result == TSS_SUCCESS) {
 		i = 0;
 		initData(&data->comm, 7);
@@ -43,12 +43,8 @@ tcs_wrap_OIAP(struct tcsd_thread_data *data)
 
 	LogDebugFn("thread %ld context %x", THREAD_ID, hContext);
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = auth_mgr_oiap(hContext, &authHandle, &n0);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
 	if (result == TSS_SUCCESS) {
 		initData(&data->comm, 2);
 		if (setData(TCSD_PACKET_TYPE_UINT32, 0, &authHandle, 0, &data->comm)) {
@@ -92,13 +88,9 @@ tcs_wrap_OSAP(struct tcsd_thread_data *data)
 	if (getData(TCSD_PACKET_TYPE_NONCE, 3, &nonceOddOSAP, 0, &data->comm))
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = auth_mgr_osap(hContext, entityType, entityValue, nonceOddOSAP,
 			       &authHandle, &nonceEven, &nonceEvenOSAP);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
 	if (result == TSS_SUCCESS) {
 		initData(&data->comm, 3);
 		if (setData(TCSD_PACKET_TYPE_UINT32, 0, &authHandle, 0, &data->comm)) {
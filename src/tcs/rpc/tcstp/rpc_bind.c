@@ -57,33 +57,21 @@ tcs_wrap_UnBind(struct tcsd_thread_data *data)
 	if (getData(TCSD_PACKET_TYPE_UINT32, 2, &inDataSize, 0, &data->comm))
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 
-	inData = calloc(1, inDataSize);
-	if (inData == NULL) {
-		LogError("malloc of %u bytes failed.", inDataSize);
-		return TCSERR(TSS_E_OUTOFMEMORY);
-	}
-	if (getData(TCSD_PACKET_TYPE_PBYTE, 3, inData, inDataSize, &data->comm)) {
-		free(inData);
+	/* inData points into the receive buffer, see getDataView() */
+	if (getDataView(3, &inData, inDataSize, &data->comm))
 		return TCSERR(TSS_E_INTERNAL_ERROR);
-	}
 
 	result = getData(TCSD_PACKET_TYPE_AUTH, 4, &privAuth, 0, &data->comm);
 	if (result == TSS_TCP_RPC_BAD_PACKET_TYPE)
 		pPrivAuth = NULL;
-	else if (result) {
-		free(inData);
+	else if (result)
 		return result;
-	} else
+	else
 		pPrivAuth = &privAuth;
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_UnBind_Internal(hContext, keyHandle, inDataSize, inData,
 				 pPrivAuth, &outDataSize, &outData);
 
-	MUTEX_UNLOCK(tcsp_lock);
-	free(inData);
-
 	if (result == TSS_SUCCESS) {
 		i = 0;
 		initData(&data->comm, 3);
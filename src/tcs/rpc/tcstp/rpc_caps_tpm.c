@@ -65,12 +65,8 @@ tcs_wrap_GetCapability(struct tcsd_thread_data *data)
 		}
 	}
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_GetCapability_Internal(hContext, capArea, subCapSize, subCap, &respSize,
 					     &resp);
-
-	MUTEX_UNLOCK(tcsp_lock);
 	free(subCap);
 
 	if (result == TSS_SUCCESS) {
@@ -112,12 +108,8 @@ tcs_wrap_GetCapabilityOwner(struct tcsd_thread_data *data)
 	if (getData(TCSD_PACKET_TYPE_AUTH, 1, &ownerAuth, 0, &data->comm))
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_GetCapabilityOwner_Internal(hContext, &ownerAuth, &version, &nonVol, &vol);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
 	if (result == TSS_SUCCESS) {
 		initData(&data->comm, 4);
 		if (setData(TCSD_PACKET_TYPE_VERSION, 0, &version, 0, &data->comm)) {
@@ -205,12 +197,8 @@ tcs_wrap_SetCapability(struct tcsd_thread_data *data)
 		pOwnerAuth = &ownerAuth;
 
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_SetCapability_Internal(hContext, capArea, subCapSize, subCap, valueSize,
 					     value, pOwnerAuth);
-
-	MUTEX_UNLOCK(tcsp_lock);
 	free(subCap);
 	free(value);
 
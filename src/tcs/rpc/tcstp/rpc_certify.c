@@ -69,14 +69,10 @@ tcs_wrap_CertifyKey(struct tcsd_thread_data *data)
 	if (memcmp(&nullAuth, &keyAuth, sizeof(TPM_AUTH)))
 		pKeyAuth = &keyAuth;
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_CertifyKey_Internal(hContext, certHandle, keyHandle, antiReplay, pCertAuth,
 					  pKeyAuth, &CertifyInfoSize, &CertifyInfo, &outDataSize,
 					  &outData);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
 	if (result == TSS_SUCCESS) {
 		i = 0;
 		initData(&data->comm, 6);
@@ -81,13 +81,9 @@ tcs_wrap_ChangeAuth(struct tcsd_thread_data *data)
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 	}
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_ChangeAuth_Internal(hContext, parentHandle, protocolID, newAuth, entityType,
 					  encDataSize, encData, &ownerAuth, &entityAuth,
 					  &outDataSize, &outData);
-
-	MUTEX_UNLOCK(tcsp_lock);
 	free(encData);
 	if (result == TSS_SUCCESS) {
 		initData(&data->comm, 4);
@@ -144,13 +140,9 @@ tcs_wrap_ChangeAuthOwner(struct tcsd_thread_data *data)
 	if (getData(TCSD_PACKET_TYPE_AUTH, 4, &ownerAuth, 0, &data->comm))
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_ChangeAuthOwner_Internal(hContext, protocolID, newAuth, entityType,
 					       &ownerAuth);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
 	if (result == TSS_SUCCESS) {
 		initData(&data->comm, 1);
 		if (setData(TCSD_PACKET_TYPE_AUTH, 0, &ownerAuth, 0, &data->comm)) {
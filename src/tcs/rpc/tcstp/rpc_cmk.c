@@ -49,12 +49,8 @@ tcs_wrap_CMK_SetRestrictions(struct tcsd_thread_data *data)
 	if (getData(TCSD_PACKET_TYPE_AUTH, 2, &ownerAuth, 0, &data->comm))
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_CMK_SetRestrictions_Internal(hContext, restriction, &ownerAuth);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
 	if (result == TSS_SUCCESS) {
 		initData(&data->comm, 1);
 		if (setData(TCSD_PACKET_TYPE_AUTH, 0, &ownerAuth, 0, &data->comm))
@@ -90,13 +86,9 @@ tcs_wrap_CMK_ApproveMA(struct tcsd_thread_data *data)
 	if (getData(TCSD_PACKET_TYPE_AUTH, 2, &ownerAuth, 0, &data->comm))
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_CMK_ApproveMA_Internal(hContext, migAuthorityDigest, &ownerAuth,
 			&migAuthorityApproval);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
 	if (result == TSS_SUCCESS) {
 		initData(&data->comm, 2);
 		if (setData(TCSD_PACKET_TYPE_AUTH, 0, &ownerAuth, 0, &data->comm))
@@ -171,13 +163,9 @@ tcs_wrap_CMK_CreateKey(struct tcsd_thread_data *data)
 	else
 		pAuth = NULL;
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_CMK_CreateKey_Internal(hContext, hKey, keyUsageAuth, migAuthorityApproval,
 			migAuthorityDigest, &keyDataSize, &keyData, pAuth);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
 	if (result == TSS_SUCCESS) {
 		initData(&data->comm, 3);
 		if (setData(TCSD_PACKET_TYPE_UINT32, 0, &keyDataSize, 0, &data->comm)) {
@@ -265,12 +253,8 @@ tcs_wrap_CMK_CreateTicket(struct tcsd_thread_data *data)
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 	}
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_CMK_CreateTicket_Internal(hContext, publicVerifyKeySize, publicVerifyKey,
 			signedData, sigValueSize, sigValue, &ownerAuth, &sigTicket);
-
-	MUTEX_UNLOCK(tcsp_lock);
 	free(publicVerifyKey);
 	free(sigValue);
 
@@ -441,14 +425,10 @@ tcs_wrap_CMK_CreateBlob(struct tcsd_thread_data *data)
 	else
 		pAuth = NULL;
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_CMK_CreateBlob_Internal(hContext, hKey, migrationType, migKeyAuthSize,
 			migKeyAuth, pubSourceKeyDigest, msaListSize, msaList, restrictTicketSize,
 			restrictTicket, sigTicketSize, sigTicket, encDataSize, encData, pAuth,
 			&randomSize, &random, &outDataSize, &outData);
-
-	MUTEX_UNLOCK(tcsp_lock);
 	free(migKeyAuth);
 	free(msaList);
 	free(restrictTicket);
@@ -594,13 +574,9 @@ tcs_wrap_CMK_ConvertMigration(struct tcsd_thread_data *data)
 	else
 		pAuth = NULL;
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_CMK_ConvertMigration_Internal(hContext, hKey, restrictTicket, sigTicket,
 			keyDataSize, keyData, msaListSize, msaList, randomSize, random,
 			pAuth, &outDataSize, &outData);
-
-	MUTEX_UNLOCK(tcsp_lock);
 	free(keyData);
 	free(msaList);
 	free(random);
@@ -46,12 +46,8 @@ tcs_wrap_ReadCounter(struct tcsd_thread_data *data)
 	if (getData(TCSD_PACKET_TYPE_UINT32, 1, &idCounter, 0, &data->comm))
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_ReadCounter_Internal(hContext, idCounter, &counterValue);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
 	if (result == TSS_SUCCESS) {
 		initData(&data->comm, 1);
 		if (setData(TCSD_PACKET_TYPE_COUNTER_VALUE, 0, &counterValue, 0, &data->comm))
@@ -104,13 +100,9 @@ tcs_wrap_CreateCounter(struct tcsd_thread_data *data)
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 	}
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_CreateCounter_Internal(hContext, LabelSize, pLabel, encauth, &auth,
 					     &idCounter, &counterValue);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
 	free(pLabel);
 
 	if (result == TSS_SUCCESS) {
@@ -150,12 +142,8 @@ tcs_wrap_IncrementCounter(struct tcsd_thread_data *data)
 	if (getData(TCSD_PACKET_TYPE_AUTH, 2, &auth, 0, &data->comm))
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_IncrementCounter_Internal(hContext, idCounter, &auth, &counterValue);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
 	if (result == TSS_SUCCESS) {
 		initData(&data->comm, 2);
 		if (setData(TCSD_PACKET_TYPE_AUTH, 0, &auth, 0, &data->comm))
@@ -190,12 +178,8 @@ tcs_wrap_ReleaseCounter(struct tcsd_thread_data *data)
 	if (getData(TCSD_PACKET_TYPE_AUTH, 2, &auth, 0, &data->comm))
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_ReleaseCounter_Internal(hContext, idCounter, &auth);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
 	if (result == TSS_SUCCESS) {
 		initData(&data->comm, 1);
 		if (setData(TCSD_PACKET_TYPE_AUTH, 0, &auth, 0, &data->comm))
@@ -228,12 +212,8 @@ tcs_wrap_ReleaseCounterOwner(struct tcsd_thread_data *data)
 	if (getData(TCSD_PACKET_TYPE_AUTH, 2, &auth, 0, &data->comm))
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_ReleaseCounterOwner_Internal(hContext, idCounter, &auth);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
 	if (result == TSS_SUCCESS) {
 		initData(&data->comm, 1);
 		if (setData(TCSD_PACKET_TYPE_AUTH, 0, &auth, 0, &data->comm))
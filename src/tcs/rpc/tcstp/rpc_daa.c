@@ -98,13 +98,9 @@ tcs_wrap_DaaJoin(struct tcsd_thread_data *data)
 		pOwnerAuth = &ownerAuth;
 	}
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_DaaJoin_internal(hContext, hDAA, stage, inputSize0, inputData0, inputSize1,
 				       inputData1, pOwnerAuth, &outputSize, &outputData);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
 	free(inputData0);
 	if( inputData1 != NULL) free(inputData1);
 
@@ -206,13 +202,9 @@ tcs_wrap_DaaSign(struct tcsd_thread_data *data)
 
 	LogDebugFn("-> TCSP_DaaSign_internal");
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_DaaSign_internal(hContext, hDAA, stage, inputSize0, inputData0, inputSize1,
 				       inputData1, pOwnerAuth, &outputSize, &outputData);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
 	LogDebugFn("<- TCSP_DaaSign_internal");
 
 	free(inputData0);
@@ -81,12 +81,8 @@ tcs_wrap_Delegate_Manage(struct tcsd_thread_data *data)
 	else
 		pAuth = NULL;
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_Delegate_Manage_Internal(hContext, familyId, opFlag,
 			opDataSize, opData, pAuth, &retDataSize, &retData);
-
-	MUTEX_UNLOCK(tcsp_lock);
 	free(opData);
 
 	if (result == TSS_SUCCESS) {
@@ -172,12 +168,8 @@ tcs_wrap_Delegate_CreateKeyDelegation(struct tcsd_thread_data *data)
 	else
 		pAuth = NULL;
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_Delegate_CreateKeyDelegation_Internal(hContext, hKey,
 			publicInfoSize, publicInfo, &encDelAuth, pAuth, &blobSize, &blob);
-
-	MUTEX_UNLOCK(tcsp_lock);
 	free(publicInfo);
 
 	if (result == TSS_SUCCESS) {
@@ -263,12 +255,8 @@ tcs_wrap_Delegate_CreateOwnerDelegation(struct tcsd_thread_data *data)
 	else
 		pAuth = NULL;
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_Delegate_CreateOwnerDelegation_Internal(hContext, increment,
 			publicInfoSize, publicInfo, &encDelAuth, pAuth, &blobSize, &blob);
-
-	MUTEX_UNLOCK(tcsp_lock);
 	free(publicInfo);
 
 	if (result == TSS_SUCCESS) {
@@ -345,12 +333,8 @@ tcs_wrap_Delegate_LoadOwnerDelegation(struct tcsd_thread_data *data)
 	else
 		pAuth = NULL;
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_Delegate_LoadOwnerDelegation_Internal(hContext, index, blobSize, blob,
 			pAuth);
-
-	MUTEX_UNLOCK(tcsp_lock);
 	free(blob);
 
 	if (result == TSS_SUCCESS) {
@@ -386,13 +370,9 @@ tcs_wrap_Delegate_ReadTable(struct tcsd_thread_data *data)
 
 	LogDebugFn("thread %ld context %x", THREAD_ID, hContext);
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_Delegate_ReadTable_Internal(hContext, &familyTableSize, &familyTable,
 			&delegateTableSize, &delegateTable);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
 	if (result == TSS_SUCCESS) {
 		initData(&data->comm, 4);
 		if (setData(TCSD_PACKET_TYPE_UINT32, 0, &familyTableSize, 0, &data->comm)) {
@@ -470,12 +450,8 @@ tcs_wrap_Delegate_UpdateVerificationCount(struct tcsd_thread_data *data)
 	else
 		pAuth = NULL;
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_Delegate_UpdateVerificationCount_Internal(hContext, inputSize, input,
 			pAuth, &outputSize, &output);
-
-	MUTEX_UNLOCK(tcsp_lock);
 	free(input);
 
 	if (result == TSS_SUCCESS) {
@@ -534,11 +510,7 @@ tcs_wrap_Delegate_VerifyDelegation(struct tcsd_thread_data *data)
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 	}
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_Delegate_VerifyDelegation_Internal(hContext, delegateSize, delegate);
-
-	MUTEX_UNLOCK(tcsp_lock);
 	free(delegate);
 done:
 	initData(&data->comm, 0);
@@ -587,12 +559,8 @@ tcs_wrap_DSAP(struct tcsd_thread_data *data)
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 	}
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_DSAP_Internal(hContext, entityType, keyHandle, &nonceOddDSAP, entityValueSize,
 				    entityValue, &authHandle, &nonceEven, &nonceEvenDSAP);
-
-	MUTEX_UNLOCK(tcsp_lock);
 	free(entityValue);
 
 	if (result == TSS_SUCCESS) {
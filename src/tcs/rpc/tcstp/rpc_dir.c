@@ -51,12 +51,8 @@ tcs_wrap_DirWriteAuth(struct tcsd_thread_data *data)
 	if (getData(TCSD_PACKET_TYPE_AUTH, 3, &auth, 0, &data->comm))
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_DirWriteAuth_Internal(hContext, dirIndex, dirDigest, &auth);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
 	if (result == TSS_SUCCESS) {
 		initData(&data->comm, 1);
 		if (setData(TCSD_PACKET_TYPE_AUTH, 0, &auth, 0, &data->comm)) {
@@ -89,12 +85,8 @@ tcs_wrap_DirRead(struct tcsd_thread_data *data)
 	if (getData(TCSD_PACKET_TYPE_UINT32, 1, &dirIndex, 0, &data->comm))
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_DirRead_Internal(hContext, dirIndex, &dirValue);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
 	if (result == TSS_SUCCESS) {
 		initData(&data->comm, 1);
 		if (setData(TCSD_PACKET_TYPE_DIGEST, 0, &dirValue, 0, &data->comm)) {
@@ -63,13 +63,9 @@ tcs_wrap_CreateEndorsementKeyPair(struct tcsd_thread_data *data)
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 	}
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_CreateEndorsementKeyPair_Internal(hContext, antiReplay, eKPtrSize, eKPtr,
 							&eKSize, &eK, &checksum);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
 	free(eKPtr);
 
 	if (result == TSS_SUCCESS) {
@@ -114,12 +110,8 @@ tcs_wrap_ReadPubek(struct tcsd_thread_data *data)
 	if (getData(TCSD_PACKET_TYPE_NONCE, 1, &antiReplay, 0, &data->comm))
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_ReadPubek_Internal(hContext, antiReplay, &pubEKSize, &pubEK, &checksum);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
 	if (result == TSS_SUCCESS) {
 		initData(&data->comm, 3);
 		if (setData(TCSD_PACKET_TYPE_UINT32, 0, &pubEKSize, 0, &data->comm)) {
@@ -161,12 +153,8 @@ tcs_wrap_OwnerReadPubek(struct tcsd_thread_data *data)
 	if (getData(TCSD_PACKET_TYPE_AUTH, 1, &auth, 0, &data->comm))
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_OwnerReadPubek_Internal(hContext, &auth, &pubEKSize, &pubEK);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
 	if (result == TSS_SUCCESS) {
 		initData(&data->comm, 3);
 		if (setData(TCSD_PACKET_TYPE_AUTH, 0, &auth, 0, &data->comm)) {
@@ -204,12 +192,8 @@ tcs_wrap_DisablePubekRead(struct tcsd_thread_data *data)
 	if (getData(TCSD_PACKET_TYPE_AUTH, 1, &auth, 0, &data->comm))
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_DisablePubekRead_Internal(hContext, &auth);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
 	if (result == TSS_SUCCESS) {
 		initData(&data->comm, 1);
 		if (setData(TCSD_PACKET_TYPE_AUTH, 0, &auth, 0, &data->comm)) {
@@ -271,13 +255,9 @@ tcs_wrap_CreateRevocableEndorsementKeyPair(struct tcsd_thread_data *data)
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 	}
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_CreateRevocableEndorsementKeyPair_Internal(hContext, antiReplay,
 			eKPtrSize, eKPtr, genResetAuth, &eKResetAuth, &eKSize, &eK, &checksum);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
 	free(eKPtr);
 
 	if (result == TSS_SUCCESS) {
@@ -324,11 +304,7 @@ tcs_wrap_RevokeEndorsementKeyPair(struct tcsd_thread_data *data)
 	if (getData(TCSD_PACKET_TYPE_DIGEST, 1, &eKResetAuth, 0, &data->comm))
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_RevokeEndorsementKeyPair_Internal(hContext, eKResetAuth);
-
-	MUTEX_UNLOCK(tcsp_lock);
 done:
 	initData(&data->comm, 0);
 
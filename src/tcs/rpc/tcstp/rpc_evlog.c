@@ -188,6 +188,60 @@ tcs_wrap_GetPcrEventLog(struct tcsd_thread_data *data)
 	return TSS_SUCCESS;
 }
 
+TSS_RESULT
+tcs_wrap_GetPcrEventLogPage(struct tcsd_thread_data *data)
+{
+	TCS_CONTEXT_HANDLE hContext;
+	TSS_PCR_EVENT *ppEvents;
+	TSS_RESULT result;
+	UINT32 pcrIndex, eventIndex, maxBytes, eventCount, i, j;
+
+	if (getData(TCSD_PACKET_TYPE_UINT32, 0, &hContext, 0, &data->comm))
+		return TCSERR(TSS_E_INTERNAL_ERROR);
+
+	LogDebugFn("thread %ld context %x", THREAD_ID, hContext);
+
+	if (getData(TCSD_PACKET_TYPE_UINT32, 1, &pcrIndex, 0, &data->comm))
+		return TCSERR(TSS_E_INTERNAL_ERROR);
+	if (getData(TCSD_PACKET_TYPE_UINT32, 2, &eventIndex, 0, &data->comm))
+		return TCSERR(TSS_E_INTERNAL_ERROR);
+	if (getData(TCSD_PACKET_TYPE_UINT32, 3, &maxBytes, 0, &data->comm))
+		return TCSERR(TSS_E_INTERNAL_ERROR);
+	if (getData(TCSD_PACKET_TYPE_UINT32, 4, &eventCount, 0, &data->comm))
+		return TCSERR(TSS_E_INTERNAL_ERROR);
+
+	result = TCS_GetPcrEventLogPage_Internal(hContext, &pcrIndex, &eventIndex, maxBytes,
+						 &eventCount, &ppEvents);
+
+	if (result == TSS_SUCCESS) {
+		initData(&data->comm, eventCount + 3);
+		if (setData(TCSD_PACKET_TYPE_UINT32, 0, &pcrIndex, 0, &data->comm) ||
+		    setData(TCSD_PACKET_TYPE_UINT32, 1, &eventIndex, 0, &data->comm) ||
+		    setData(TCSD_PACKET_TYPE_UINT32, 2, &eventCount, 0, &data->comm)) {
+			free_external_events(eventCount, ppEvents);
+			free(ppEvents);
+			return TCSERR(TSS_E_INTERNAL_ERROR);
+		}
+
+		i = 3;
+		for (j = 0; j < eventCount; j++) {
+			if (setData(TCSD_PACKET_TYPE_PCR_EVENT, i++, &(ppEvents[j]), 0, &data->comm)) {
+				free_external_events(eventCount, ppEvents);
+				free(ppEvents);
+				return TCSERR(TSS_E_INTERNAL_ERROR);
+			}
+		}
+
+		free_external_events(eventCount, ppEvents);
+		free(ppEvents);
+	} else
+		initData(&data->comm, 0);
+
+	data->comm.hdr.u.result = result;
+
+	return TSS_SUCCESS;
+}
+
 TSS_RESULT
 tcs_wrap_LogPcrEvent(struct tcsd_thread_data *data)
 {
@@ -45,11 +45,7 @@ tcs_wrap_EvictKey(struct tcsd_thread_data *data)
 	if (getData(TCSD_PACKET_TYPE_UINT32, 1, &hKey, 0, &data->comm))
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = key_mgr_evict(hContext, hKey);
-
-	MUTEX_UNLOCK(tcsp_lock);
 done:
 	initData(&data->comm, 0);
 	data->comm.hdr.u.result = result;
@@ -88,12 +84,8 @@ tcs_wrap_GetPubkey(struct tcsd_thread_data *data)
 	else
 		pAuth = &auth;
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_GetPubKey_Internal(hContext, hKey, pAuth, &pubKeySize, &pubKey);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
 	if (result == TSS_SUCCESS) {
 		i = 0;
 		initData(&data->comm, 3);
@@ -133,12 +125,8 @@ tcs_wrap_TerminateHandle(struct tcsd_thread_data *data)
 	if (getData(TCSD_PACKET_TYPE_UINT32, 1, &authHandle, 0, &data->comm))
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_TerminateHandle_Internal(hContext, authHandle);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
 	initData(&data->comm, 0);
 	data->comm.hdr.u.result = result;
 
@@ -175,36 +163,24 @@ tcs_wrap_LoadKeyByBlob(struct tcsd_thread_data *data)
 	if (getData(TCSD_PACKET_TYPE_UINT32, 2, &cWrappedKeyBlob, 0, &data->comm))
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 
-	rgbWrappedKeyBlob = calloc(1, cWrappedKeyBlob);
-	if (rgbWrappedKeyBlob == NULL) {
-		LogError("malloc of %d bytes failed.", cWrappedKeyBlob);
-		return TCSERR(TSS_E_OUTOFMEMORY);
-	}
-	if (getData(TCSD_PACKET_TYPE_PBYTE, 3, rgbWrappedKeyBlob, cWrappedKeyBlob, &data->comm)) {
-		free(rgbWrappedKeyBlob);
+	/* rgbWrappedKeyBlob points into the receive buffer, see getDataView() */
+	if (getDataView(3, &rgbWrappedKeyBlob, cWrappedKeyBlob, &data->comm))
 		return TCSERR(TSS_E_INTERNAL_ERROR);
-	}
+
 	result = getData(TCSD_PACKET_TYPE_AUTH, 4, &auth, 0, &data->comm);
 	if (result == TSS_TCP_RPC_BAD_PACKET_TYPE)
 		pAuth = NULL;
-	else if (result) {
-		free(rgbWrappedKeyBlob);
+	else if (result)
 		return result;
-	} else
+	else
 		pAuth = &auth;
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = key_mgr_load_by_blob(hContext, hUnwrappingKey, cWrappedKeyBlob, rgbWrappedKeyBlob,
 				      pAuth, &phKeyTCSI, &phKeyHMAC);
 
 	if (!result)
 		result = ctx_mark_key_loaded(hContext, phKeyTCSI);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
-	free(rgbWrappedKeyBlob);
-
 	if (result == TSS_SUCCESS) {
 		i = 0;
 		initData(&data->comm, 3);
@@ -251,36 +227,24 @@ tcs_wrap_LoadKey2ByBlob(struct tcsd_thread_data *data)
 	if (getData(TCSD_PACKET_TYPE_UINT32, 2, &cWrappedKeyBlob, 0, &data->comm))
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 
-	rgbWrappedKeyBlob = calloc(1, cWrappedKeyBlob);
-	if (rgbWrappedKeyBlob == NULL) {
-		LogError("malloc of %d bytes failed.", cWrappedKeyBlob);
-		return TCSERR(TSS_E_OUTOFMEMORY);
-	}
-	if (getData(TCSD_PACKET_TYPE_PBYTE, 3, rgbWrappedKeyBlob, cWrappedKeyBlob, &data->comm)) {
-		free(rgbWrappedKeyBlob);
+	/* rgbWrappedKeyBlob points into the receive buffer, see getDataView() */
+	if (getDataView(3, &rgbWrappedKeyBlob, cWrappedKeyBlob, &data->comm))
 		return TCSERR(TSS_E_INTERNAL_ERROR);
-	}
+
 	result = getData(TCSD_PACKET_TYPE_AUTH, 4, &auth, 0, &data->comm);
 	if (result == TSS_TCP_RPC_BAD_PACKET_TYPE)
 		pAuth = NULL;
-	else if (result) {
-		free(rgbWrappedKeyBlob);
+	else if (result)
 		return result;
-	} else
+	else
 		pAuth = &auth;
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = key_mgr_load_by_blob(hContext, hUnwrappingKey, cWrappedKeyBlob, rgbWrappedKeyBlob,
 				      pAuth, &phKeyTCSI, NULL);
 
 	if (!result)
 		result = ctx_mark_key_loaded(hContext, phKeyTCSI);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
-	free(rgbWrappedKeyBlob);
-
 	if (result == TSS_SUCCESS) {
 		i = 0;
 		initData(&data->comm, 2);
@@ -348,13 +312,9 @@ tcs_wrap_CreateWrapKey(struct tcsd_thread_data *data)
 	else
 		pAuth = &auth;
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_CreateWrapKey_Internal(hContext, hWrappingKey, KeyUsageAuth, KeyMigrationAuth,
 					     keyInfoSize, keyInfo, &keyDataSize, &keyData, pAuth);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
 	free(keyInfo);
 	if (result == TSS_SUCCESS) {
 		initData(&data->comm, 3);
@@ -403,12 +363,8 @@ tcs_wrap_OwnerReadInternalPub(struct tcsd_thread_data *data)
 	if (getData(TCSD_PACKET_TYPE_AUTH, 2, &ownerAuth, 0, &data->comm))
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_OwnerReadInternalPub_Internal(hContext, hKey, &ownerAuth, &pubKeySize, &pubKeyData);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
 	if (result == TSS_SUCCESS) {
 		initData(&data->comm, 3);
 		if (setData(TCSD_PACKET_TYPE_AUTH, 0, &ownerAuth, 0, &data->comm))
@@ -472,13 +428,9 @@ tcs_wrap_KeyControlOwner(struct tcsd_thread_data *data)
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 	}
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_KeyControlOwner_Internal(hContext, hKey, ulPublicKeyLength, rgbPublicKey,
 					       attribName, attribValue, &ownerAuth, &uuidData);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
 	if (result == TSS_SUCCESS) {
 		initData(&data->comm, 2);
 		if (setData(TCSD_PACKET_TYPE_AUTH, 0, &ownerAuth, 0, &data->comm)) {
@@ -45,12 +45,8 @@ tcs_wrap_KillMaintenanceFeature(struct tcsd_thread_data *data)
 	if (getData(TCSD_PACKET_TYPE_AUTH, 1, &ownerAuth, 0, &data->comm))
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_KillMaintenanceFeature_Internal(hContext, &ownerAuth);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
 	if (result == TSS_SUCCESS) {
 		initData(&data->comm, 1);
 		if (setData(TCSD_PACKET_TYPE_AUTH, 0, &ownerAuth, 0, &data->comm)) {
@@ -88,14 +84,10 @@ tcs_wrap_CreateMaintenanceArchive(struct tcsd_thread_data *data)
 	if (getData(TCSD_PACKET_TYPE_AUTH, 2, &ownerAuth, 0, &data->comm))
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_CreateMaintenanceArchive_Internal(hContext, generateRandom, &ownerAuth,
 							&randomSize, &random, &archiveSize,
 							&archive);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
 	if (result == TSS_SUCCESS) {
 		initData(&data->comm, 5);
 		if (setData(TCSD_PACKET_TYPE_AUTH, 0, &ownerAuth, 0, &data->comm)) {
@@ -171,12 +163,8 @@ tcs_wrap_LoadMaintenanceArchive(struct tcsd_thread_data *data)
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 	}
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_LoadMaintenanceArchive_Internal(hContext, dataInSize, dataIn, &ownerAuth,
 							&dataOutSize, &dataOut);
-
-	MUTEX_UNLOCK(tcsp_lock);
 	free(dataIn);
 
 	if (result == TSS_SUCCESS) {
@@ -238,12 +226,8 @@ tcs_wrap_LoadManuMaintPub(struct tcsd_thread_data *data)
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 	}
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_LoadManuMaintPub_Internal(hContext, antiReplay, pubKeySize, pubKey,
 						&checksum);
-
-	MUTEX_UNLOCK(tcsp_lock);
 	free(pubKey);
 
 	if (result == TSS_SUCCESS) {
@@ -278,12 +262,8 @@ tcs_wrap_ReadManuMaintPub(struct tcsd_thread_data *data)
 	if (getData(TCSD_PACKET_TYPE_NONCE, 1, &antiReplay, 0, &data->comm))
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_ReadManuMaintPub_Internal(hContext, antiReplay, &checksum);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
 	if (result == TSS_SUCCESS) {
 		initData(&data->comm, 1);
 		if (setData(TCSD_PACKET_TYPE_DIGEST, 0, &checksum, 0, &data->comm)) {
@@ -98,15 +98,11 @@ tcs_wrap_CreateMigrationBlob(struct tcsd_thread_data *data)
 		pEntityAuth = &auth2;
 	}
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_CreateMigrationBlob_Internal(hContext, parentHandle, migrationType,
 						   MigrationKeyAuthSize, MigrationKeyAuth,
 						   encDataSize, encData, pParentAuth, pEntityAuth,
 						   &randomSize, &random, &outDataSize, &outData);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
 	free(MigrationKeyAuth);
 	free(encData);
 	if (result == TSS_SUCCESS) {
@@ -218,14 +214,10 @@ tcs_wrap_ConvertMigrationBlob(struct tcsd_thread_data *data)
 		pParentAuth = &parentAuth;
 
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_ConvertMigrationBlob_Internal(hContext, parentHandle, inDataSize, inData,
 						    randomSize, random, pParentAuth, &outDataSize,
 						    &outData);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
 	free(inData);
 	free(random);
 	if (result == TSS_SUCCESS) {
@@ -295,14 +287,10 @@ tcs_wrap_AuthorizeMigrationKey(struct tcsd_thread_data *data)
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 	}
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_AuthorizeMigrationKey_Internal(hContext, migrateScheme, MigrationKeySize,
 						     MigrationKey, &ownerAuth,
 						     &MigrationKeyAuthSize, &MigrationKeyAuth);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
 	free(MigrationKey);
 	if (result == TSS_SUCCESS) {
 		initData(&data->comm, 3);
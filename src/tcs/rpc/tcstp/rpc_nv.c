@@ -67,13 +67,9 @@ tcs_wrap_NV_DefineOrReleaseSpace(struct tcsd_thread_data *data)
 	else
 		pAuth = &Auth;
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_NV_DefineOrReleaseSpace_Internal(hContext,
 						       cPubInfoSize, pubInfo, encAuth, pAuth);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
 	free(pubInfo);
 
 	if (result == TSS_SUCCESS) {
@@ -115,31 +111,18 @@ tcs_wrap_NV_WriteValue(struct tcsd_thread_data *data)
 	if (getData(TCSD_PACKET_TYPE_UINT32, 3, &ulDataLength, 0, &data->comm))
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 
-	rgbDataToWrite = calloc(1, ulDataLength);
-	if (rgbDataToWrite == NULL) {
-		LogError("malloc of %u bytes failed.", ulDataLength);
-		return TCSERR(TSS_E_OUTOFMEMORY);
-	}
-
-	if (getData(TCSD_PACKET_TYPE_PBYTE, 4, rgbDataToWrite, ulDataLength, &data->comm)) {
-		free(rgbDataToWrite);
+	/* rgbDataToWrite points into the receive buffer, see getDataView() */
+	if (getDataView(4, &rgbDataToWrite, ulDataLength, &data->comm))
 		return TCSERR(TSS_E_INTERNAL_ERROR);
-	}
 
 	if (getData(TCSD_PACKET_TYPE_AUTH, 5, &Auth, 0, &data->comm))
 		pAuth = NULL;
 	else
 		pAuth = &Auth;
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_NV_WriteValue_Internal(hContext, hNVStore,
 					     offset, ulDataLength, rgbDataToWrite, pAuth);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
-	free(rgbDataToWrite);
-
 	if (result == TSS_SUCCESS) {
 		initData(&data->comm, 1);
 		if (pAuth) {
@@ -179,31 +162,17 @@ tcs_wrap_NV_WriteValueAuth(struct tcsd_thread_data *data)
 	if (getData(TCSD_PACKET_TYPE_UINT32, 3, &ulDataLength, 0, &data->comm))
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 
-	rgbDataToWrite = calloc(1, ulDataLength);
-	if (rgbDataToWrite == NULL) {
-		LogError("malloc of %u bytes failed.", ulDataLength);
-		return TCSERR(TSS_E_OUTOFMEMORY);
-	}
-
-	if (getData(TCSD_PACKET_TYPE_PBYTE, 4, rgbDataToWrite, ulDataLength, &data->comm)) {
-		free(rgbDataToWrite);
+	/* rgbDataToWrite points into the receive buffer, see getDataView() */
+	if (getDataView(4, &rgbDataToWrite, ulDataLength, &data->comm))
 		return TCSERR(TSS_E_INTERNAL_ERROR);
-	}
-	if (getData(TCSD_PACKET_TYPE_AUTH, 5, &Auth, 0, &data->comm)) {
-		free(rgbDataToWrite);
+	if (getData(TCSD_PACKET_TYPE_AUTH, 5, &Auth, 0, &data->comm))
 		return TCSERR(TSS_E_INTERNAL_ERROR);
-	} else
+	else
 		pAuth = &Auth;
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_NV_WriteValueAuth_Internal(hContext, hNVStore,
 						 offset, ulDataLength, rgbDataToWrite, pAuth);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
-	free(rgbDataToWrite);
-
 	if (result == TSS_SUCCESS) {
 		initData(&data->comm, 1);
 		if ( pAuth) {
@@ -248,13 +217,9 @@ tcs_wrap_NV_ReadValue(struct tcsd_thread_data *data)
 	else
 		pAuth = &Auth;
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_NV_ReadValue_Internal(hContext, hNVStore,
 					    offset, &ulDataLength, pAuth, &rgbDataRead);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
 	if (result == TSS_SUCCESS) {
 		i = 0;
 		initData(&data->comm, 3);
@@ -311,13 +276,9 @@ tcs_wrap_NV_ReadValueAuth(struct tcsd_thread_data *data)
 		pNVAuth = &NVAuth;
 	}
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_NV_ReadValueAuth_Internal(hContext, hNVStore,
 						offset, &ulDataLength, pNVAuth, &rgbDataRead);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
 	if (result == TSS_SUCCESS) {
 		i = 0;
 		initData(&data->comm, 3);
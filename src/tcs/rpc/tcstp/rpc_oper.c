@@ -45,11 +45,7 @@ tcs_wrap_SetOperatorAuth(struct tcsd_thread_data *data)
 	if (getData(TCSD_PACKET_TYPE_SECRET, 1, &operatorAuth, 0, &data->comm))
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_SetOperatorAuth_Internal(hContext, &operatorAuth);
-
-	MUTEX_UNLOCK(tcsp_lock);
 done:
 	initData(&data->comm, 0);
 
@@ -106,13 +106,9 @@ tcs_wrap_TakeOwnership(struct tcsd_thread_data *data)
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 	}
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_TakeOwnership_Internal(hContext, protocolID, encOwnerAuthSize, encOwnerAuth,
 					     encSrkAuthSize, encSrkAuth, srkInfoSize, srkInfo,
 					     &ownerAuth, &srkKeySize, &srkKey);
-
-	MUTEX_UNLOCK(tcsp_lock);
 	free(encOwnerAuth);
 	free(encSrkAuth);
 	free(srkInfo);
@@ -157,12 +153,8 @@ tcs_wrap_OwnerClear(struct tcsd_thread_data *data)
 	if (getData(TCSD_PACKET_TYPE_AUTH, 1, &auth, 0, &data->comm))
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_OwnerClear_Internal(hContext, &auth);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
 	if (result == TSS_SUCCESS) {
 		initData(&data->comm, 1);
 		if (setData(TCSD_PACKET_TYPE_AUTH, 0, &auth, 0, &data->comm)) {
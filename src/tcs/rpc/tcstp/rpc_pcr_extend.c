@@ -49,12 +49,8 @@ tcs_wrap_Extend(struct tcsd_thread_data *data)
 	if (getData(TCSD_PACKET_TYPE_DIGEST, 2, &inDigest, 0, &data->comm))
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_Extend_Internal(hContext, pcrIndex, inDigest, &outDigest);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
 	if (result == TSS_SUCCESS) {
 		initData(&data->comm, 1);
 		if (setData(TCSD_PACKET_TYPE_DIGEST, 0, &outDigest, 0, &data->comm)) {
@@ -86,12 +82,8 @@ tcs_wrap_PcrRead(struct tcsd_thread_data *data)
 	if (getData(TCSD_PACKET_TYPE_UINT32, 1, &pcrIndex, 0, &data->comm))
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_PcrRead_Internal(hContext, pcrIndex, &digest);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
 	if (result == TSS_SUCCESS) {
 		initData(&data->comm, 1);
 		if (setData(TCSD_PACKET_TYPE_DIGEST, 0, &digest, 0, &data->comm)) {
@@ -133,11 +125,7 @@ tcs_wrap_PcrReset(struct tcsd_thread_data *data)
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 	}
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_PcrReset_Internal(hContext, pcrDataSizeIn, pcrDataIn);
-
-	MUTEX_UNLOCK(tcsp_lock);
 	free(pcrDataIn);
 done:
 	initData(&data->comm, 0);
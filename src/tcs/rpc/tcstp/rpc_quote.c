@@ -80,12 +80,8 @@ tcs_wrap_Quote(struct tcsd_thread_data *data)
 	} else
 		pPrivAuth = &privAuth;
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_Quote_Internal(hContext, hKey, antiReplay, pcrDataSizeIn, pcrDataIn,
 				     pPrivAuth, &pcrDataSizeOut, &pcrDataOut, &sigSize, &sig);
-
-	MUTEX_UNLOCK(tcsp_lock);
 	free(pcrDataIn);
 
 	if (result == TSS_SUCCESS) {
@@ -88,13 +88,9 @@ tcs_wrap_Quote2(struct tcsd_thread_data *data)
 	} else
 		pPrivAuth = &privAuth;
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_Quote2_Internal(hContext, hKey, antiReplay, pcrDataSizeIn, pcrDataIn,
 				     addVersion,pPrivAuth, &pcrDataSizeOut, &pcrDataOut, &versionInfoSize, 
 				     &versionInfo,&sigSize, &sig);
-
-	MUTEX_UNLOCK(tcsp_lock);
 	free(pcrDataIn);
 
 	if (result == TSS_SUCCESS) {
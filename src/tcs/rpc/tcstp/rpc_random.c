@@ -46,12 +46,8 @@ tcs_wrap_GetRandom(struct tcsd_thread_data *data)
 	if (getData(TCSD_PACKET_TYPE_UINT32, 1, &bytesRequested, 0, &data->comm))
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_GetRandom_Internal(hContext, &bytesRequested, &randomBytes);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
 	if (result == TSS_SUCCESS) {
 		initData(&data->comm, 2);
 		if (setData(TCSD_PACKET_TYPE_UINT32, 0, &bytesRequested, 0, &data->comm)) {
@@ -99,11 +95,7 @@ tcs_wrap_StirRandom(struct tcsd_thread_data *data)
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 	}
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_StirRandom_Internal(hContext, inDataSize, inData);
-
-	MUTEX_UNLOCK(tcsp_lock);
 	free(inData);
 done:
 	initData(&data->comm, 0);
@@ -61,58 +61,31 @@ tcs_common_Seal(UINT32 sealOrdinal,
 	if (getData(TCSD_PACKET_TYPE_UINT32, i++, &PCRInfoSize, 0, &data->comm))
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 
+	/* PCRInfo and inData point into the receive buffer, see getDataView() */
 	if (PCRInfoSize > 0) {
-		PCRInfo = calloc(1, PCRInfoSize);
-		if (PCRInfo == NULL) {
-			LogError("malloc of %u bytes failed.", PCRInfoSize);
-			return TCSERR(TSS_E_OUTOFMEMORY);
-		}
-
-		if (getData(TCSD_PACKET_TYPE_PBYTE, i++, PCRInfo, PCRInfoSize, &data->comm)) {
-			free(PCRInfo);
+		if (getDataView(i++, &PCRInfo, PCRInfoSize, &data->comm))
 			return TCSERR(TSS_E_INTERNAL_ERROR);
-		}
 	}
 
-	if (getData(TCSD_PACKET_TYPE_UINT32, i++, &inDataSize, 0, &data->comm)) {
-		free(PCRInfo);
+	if (getData(TCSD_PACKET_TYPE_UINT32, i++, &inDataSize, 0, &data->comm))
 		return TCSERR(TSS_E_INTERNAL_ERROR);
-	}
 
 	if (inDataSize > 0) {
-		inData = calloc(1, inDataSize);
-		if (inData == NULL) {
-			LogError("malloc of %u bytes failed.", inDataSize);
-			free(PCRInfo);
-			return TCSERR(TSS_E_OUTOFMEMORY);
-		}
-
-		if (getData(TCSD_PACKET_TYPE_PBYTE, i++, inData, inDataSize, &data->comm)) {
-			free(inData);
-			free(PCRInfo);
+		if (getDataView(i++, &inData, inDataSize, &data->comm))
 			return TCSERR(TSS_E_INTERNAL_ERROR);
-		}
 	}
 
 	result = getData(TCSD_PACKET_TYPE_AUTH, i++, &pubAuth, 0, &data->comm);
 	if (result == TSS_TCP_RPC_BAD_PACKET_TYPE)
 		pAuth = NULL;
-	else if (result) {
-		free(inData);
-		free(PCRInfo);
+	else if (result)
 		return result;
-	} else
+	else
 		pAuth = &pubAuth;
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_Seal_Internal(sealOrdinal, hContext, keyHandle, KeyUsageAuth, PCRInfoSize,
 				    PCRInfo, inDataSize, inData, pAuth, &outDataSize, &outData);
 
-	MUTEX_UNLOCK(tcsp_lock);
-	free(inData);
-	free(PCRInfo);
-
 	if (result == TSS_SUCCESS) {
 		initData(&data->comm, 3);
 		if (pAuth != NULL) {
@@ -183,44 +156,30 @@ tcs_wrap_UnSeal(struct tcsd_thread_data *data)
 	if (getData(TCSD_PACKET_TYPE_UINT32, 2, &inDataSize, 0, &data->comm))
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 
-	inData = calloc(1, inDataSize);
-	if (inData == NULL) {
-		LogError("malloc of %d bytes failed.", inDataSize);
-		return TCSERR(TSS_E_OUTOFMEMORY);
-	}
-
-	if (getData(TCSD_PACKET_TYPE_PBYTE, 3, inData, inDataSize, &data->comm)) {
-		free(inData);
+	/* inData points into the receive buffer, see getDataView() */
+	if (getDataView(3, &inData, inDataSize, &data->comm))
 		return TCSERR(TSS_E_INTERNAL_ERROR);
-	}
 
 	result = getData(TCSD_PACKET_TYPE_AUTH, 4, &parentAuth, 0, &data->comm);
 	if (result == TSS_TCP_RPC_BAD_PACKET_TYPE)
 		pParentAuth = NULL;
-	else if (result) {
-		free(inData);
+	else if (result)
 		return result;
-	} else
+	else
 		pParentAuth = &parentAuth;
 
 	result = getData(TCSD_PACKET_TYPE_AUTH, 5, &dataAuth, 0, &data->comm);
 	if (result == TSS_TCP_RPC_BAD_PACKET_TYPE) {
 		pDataAuth = pParentAuth;
 		pParentAuth = NULL;
-	} else if (result) {
-		free(inData);
+	} else if (result)
 		return result;
-	} else
+	else
 		pDataAuth = &dataAuth;
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_Unseal_Internal(hContext, parentHandle, inDataSize, inData, pParentAuth,
 				      pDataAuth, &outDataSize, &outData);
 
-	MUTEX_UNLOCK(tcsp_lock);
-	free(inData);
-
 	if (result == TSS_SUCCESS) {
 		initData(&data->comm, 4);
 		if (pParentAuth != NULL) {
@@ -38,12 +38,8 @@ tcs_wrap_SelfTestFull(struct tcsd_thread_data *data)
 
 	LogDebugFn("thread %ld context %x", THREAD_ID, hContext);
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_SelfTestFull_Internal(hContext);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
 	initData(&data->comm, 0);
 	data->comm.hdr.u.result = result;
 
@@ -84,13 +80,9 @@ tcs_wrap_CertifySelfTest(struct tcsd_thread_data *data)
         else
                 pPrivAuth = &privAuth;
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_CertifySelfTest_Internal(hContext, hKey, antiReplay, pPrivAuth, &sigSize,
 					       &sigData);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
 	i = 0;
 	if (result == TSS_SUCCESS) {
 		initData(&data->comm, 3);
@@ -131,12 +123,8 @@ tcs_wrap_GetTestResult(struct tcsd_thread_data *data)
 
 	LogDebugFn("thread %ld context %x", THREAD_ID, hContext);
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_GetTestResult_Internal(hContext, &resultDataSize, &resultData);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
 	if (result == TSS_SUCCESS) {
 		initData(&data->comm, 2);
 		if (setData(TCSD_PACKET_TYPE_UINT32, 0, &resultDataSize, 0, &data->comm)) {
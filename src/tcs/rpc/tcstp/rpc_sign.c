@@ -57,32 +57,21 @@ tcs_wrap_Sign(struct tcsd_thread_data *data)
 	if (getData(TCSD_PACKET_TYPE_UINT32, 2, &areaToSignSize, 0, &data->comm))
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 
-	areaToSign = calloc(1, areaToSignSize);
-	if (areaToSign == NULL) {
-		LogError("malloc of %d bytes failed.", areaToSignSize);
-		return TCSERR(TSS_E_OUTOFMEMORY);
-	}
-	if (getData(TCSD_PACKET_TYPE_PBYTE, 3, areaToSign, areaToSignSize, &data->comm)) {
-		free(areaToSign);
+	/* areaToSign points into the receive buffer, see getDataView() */
+	if (getDataView(3, &areaToSign, areaToSignSize, &data->comm))
 		return TCSERR(TSS_E_INTERNAL_ERROR);
-	}
+
 	result = getData(TCSD_PACKET_TYPE_AUTH, 4, &auth, 0, &data->comm);
 	if (result == TSS_TCP_RPC_BAD_PACKET_TYPE)
 		pAuth = NULL;
-	else if (result) {
-		free(areaToSign);
+	else if (result)
 		return result;
-	} else
+	else
 		pAuth = &auth;
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_Sign_Internal(hContext, hKey, areaToSignSize, areaToSign, pAuth, &sigSize,
 				    &sig);
 
-	MUTEX_UNLOCK(tcsp_lock);
-	free(areaToSign);
-
 	if (result == TSS_SUCCESS) {
 		i = 0;
 		initData(&data->comm, 3);
@@ -40,12 +40,8 @@ tcs_wrap_ReadCurrentTicks(struct tcsd_thread_data *data)
 
 	LogDebugFn("thread %ld context %x", THREAD_ID, hContext);
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_ReadCurrentTicks_Internal(hContext, &pulCurrentTime, &prgbCurrentTime);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
 	if (result == TSS_SUCCESS) {
 		initData(&data->comm, 2);
 		if (setData(TCSD_PACKET_TYPE_UINT32, 0, &pulCurrentTime, 0, &data->comm)) {
@@ -96,13 +92,9 @@ tcs_wrap_TickStampBlob(struct tcsd_thread_data *data)
 	else
 		pAuth = &auth;
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_TickStampBlob_Internal(hContext, hKey, &nonce, &digest, pAuth, &sigSize, &sig,
 					     &tcSize, &tc);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
 	if (result == TSS_SUCCESS) {
 		initData(&data->comm, 5);
 		i = 0;
@@ -86,16 +86,12 @@ tcs_wrap_EstablishTransport(struct tcsd_thread_data *data)
 	else
 		pAuth = &pEncKeyAuth;
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_EstablishTransport_Internal(hContext, ulTransControlFlags, hEncKey,
 						  ulTransSessionInfoSize, rgbTransSessionInfo,
 						  ulSecretSize, rgbSecret, pAuth, &pbLocality,
 						  &hTransSession, &ulCurrentTicks,
 						  &prgbCurrentTicks, &pTransNonce);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
 	free(rgbSecret);
 	free(rgbTransSessionInfo);
 
@@ -217,8 +213,6 @@ tcs_wrap_ExecuteTransport(struct tcsd_thread_data *data)
 	else
 		pAuth2 = &pWrappedCmdAuth2;
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_ExecuteTransport_Internal(hContext, unWrappedCommandOrdinal,
 						ulWrappedCmdDataInSize, rgbWrappedCmdDataIn,
 						&pulHandleListSize, &rghHandles, pAuth1, pAuth2,
@@ -226,8 +220,6 @@ tcs_wrap_ExecuteTransport(struct tcsd_thread_data *data)
 						&pulWrappedCmdReturnCode, &ulWrappedCmdDataOutSize,
 						&rgbWrappedCmdDataOut);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
 	free(rgbWrappedCmdDataIn);
 
 	if (result == TSS_SUCCESS) {
@@ -342,15 +334,11 @@ tcs_wrap_ReleaseTransportSigned(struct tcsd_thread_data *data)
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 
 
-	MUTEX_LOCK(tcsp_lock);
-
 	result = TCSP_ReleaseTransportSigned_Internal(hContext, hSignatureKey, &AntiReplayNonce,
 						      pAuth, &pTransAuth, &pbLocality,
 						      &pulCurrentTicks, &prgbCurrentTicks,
 						      &pulSignatureSize, &prgbSignature);
 
-	MUTEX_UNLOCK(tcsp_lock);
-
 	if (result == TSS_SUCCESS) {
 		initData(&data->comm, 7);
 		if (pAuth) {
@@ -12,6 +12,8 @@
 #include <string.h>
 #include <stdlib.h>
 #include <limits.h>
+#include <errno.h>
+#include <time.h>
 
 #include "trousers/tss.h"
 #include "trousers_types.h"
@@ -25,12 +27,29 @@
 #include "auth_mgr.h"
 #include "req_mgr.h"
 
-
-MUTEX_DECLARE_EXTERN(tcsp_lock);
-
 /* Note: The after taking the auth_mgr_lock in any of the functions below, the
  * mem_cache_lock cannot be taken without risking a deadlock. So, the auth_mgr
- * functions must be "self-contained" wrt locking */
+ * functions must be "self-contained" wrt locking. The exported auth_mgr_*
+ * functions take auth_mgr_lock, the static functions below expect it to be held
+ * by the caller. */
+
+/*
+ * The sessions auth_mgr_check() has marked in_use for the command this thread is processing.
+ * A command that fails before it gets to auth_mgr_release_auth() would otherwise leave them
+ * in_use, and so never swappable, for good. auth_mgr_check_done() clears whatever is left
+ * once the command returns.
+ */
+#define TSS_MAX_CHECKED_AUTHS	4
+static THREAD_LOCAL struct {
+	TCS_CONTEXT_HANDLE tcs_ctx;
+	TPM_AUTHHANDLE tpm_handle;
+} checked_auths[TSS_MAX_CHECKED_AUTHS];
+static THREAD_LOCAL UINT32 num_checked_auths = 0;
+
+/* whether auth_swap_in() handed this thread one of auth_mgr.reserved_slots. It is used up once
+ * the thread's session is in the TPM, or passed on by auth_mgr_check_done() if the command
+ * fails before that. */
+static THREAD_LOCAL TSS_BOOL holds_reserved_slot = FALSE;
 
 /* no locking done in init since its called by only a single thread */
 TSS_RESULT
@@ -39,22 +58,7 @@ auth_mgr_init()
 	memset(&auth_mgr, 0, sizeof(struct _auth_mgr));
 
 	auth_mgr.max_auth_sessions = tpm_metrics.num_auths;
-
-	auth_mgr.overflow = calloc(TSS_DEFAULT_OVERFLOW_AUTHS, sizeof(COND_VAR *));
-	if (auth_mgr.overflow == NULL) {
-		LogError("malloc of %zd bytes failed",
-			 (TSS_DEFAULT_OVERFLOW_AUTHS * sizeof(COND_VAR *)));
-		return TCSERR(TSS_E_OUTOFMEMORY);
-	}
-	auth_mgr.overflow_size = TSS_DEFAULT_OVERFLOW_AUTHS;
-
-	auth_mgr.auth_mapper = calloc(TSS_DEFAULT_AUTH_TABLE_SIZE, sizeof(struct auth_map));
-	if (auth_mgr.auth_mapper == NULL) {
-		LogError("malloc of %zd bytes failed",
-			 (TSS_DEFAULT_AUTH_TABLE_SIZE * sizeof(struct auth_map)));
-		return TCSERR(TSS_E_OUTOFMEMORY);
-	}
-	auth_mgr.auth_mapper_size = TSS_DEFAULT_AUTH_TABLE_SIZE;
+	auth_mgr.lru.lru_prev = auth_mgr.lru.lru_next = &auth_mgr.lru;
 
 	return TSS_SUCCESS;
 }
@@ -62,180 +66,407 @@ auth_mgr_init()
 TSS_RESULT
 auth_mgr_final()
 {
+	struct auth_map *a;
+	struct auth_ctx_map *c;
+	struct auth_waiter *w;
 	UINT32 i;
 
 	/* wake up any sleeping threads, so they can be joined */
-	for (i = 0; i < auth_mgr.overflow_size; i++) {
-		if (auth_mgr.overflow[i] != NULL)
-			COND_SIGNAL(auth_mgr.overflow[i]);
+	MUTEX_LOCK(auth_mgr_lock);
+	while ((w = auth_mgr.wait_head)) {
+		auth_mgr.wait_head = w->next;
+		auth_mgr.sleeping_threads--;
+		auth_mgr.reserved_slots++;
+		w->signaled = TRUE;
+		COND_SIGNAL(&w->cond);
 	}
+	auth_mgr.wait_tail = NULL;
+	MUTEX_UNLOCK(auth_mgr_lock);
+
+	for (i = 0; i < TSS_AUTH_MGR_HASH_SIZE; i++) {
+		while ((a = auth_mgr.auth_mapper[i])) {
+			auth_mgr.auth_mapper[i] = a->hash_next;
+			free(a->swap);
+			free(a);
+		}
 
-	free(auth_mgr.overflow);
-	free(auth_mgr.auth_mapper);
+		while ((c = auth_mgr.ctx_mapper[i])) {
+			auth_mgr.ctx_mapper[i] = c->next;
+			free(c);
+		}
+	}
 
 	return TSS_SUCCESS;
 }
 
-TSS_RESULT
-auth_mgr_save_ctx(TCS_CONTEXT_HANDLE hContext)
+/* the LRU list is circular around auth_mgr.lru. An entry that isn't on it points at itself, so
+ * taking an entry off the list twice is harmless. */
+static void
+auth_lru_remove(struct auth_map *a)
 {
-       TSS_RESULT result = TSS_SUCCESS;
-	UINT32 i;
+	a->lru_prev->lru_next = a->lru_next;
+	a->lru_next->lru_prev = a->lru_prev;
+	a->lru_prev = a->lru_next = a;
+}
 
-	for (i = 0; i < auth_mgr.auth_mapper_size; i++) {
-		if (auth_mgr.auth_mapper[i].full == TRUE &&
-		    auth_mgr.auth_mapper[i].swap == NULL &&
-		    auth_mgr.auth_mapper[i].tcs_ctx != hContext) {
-			LogDebug("Calling TPM_SaveAuthContext for TCS CTX %x. Swapping out: TCS %x "
-				 "TPM %x", hContext, auth_mgr.auth_mapper[i].tcs_ctx,
-				 auth_mgr.auth_mapper[i].tpm_handle);
-
-			if ((result = TPM_SaveAuthContext(auth_mgr.auth_mapper[i].tpm_handle,
-							  &auth_mgr.auth_mapper[i].swap_size,
-							  &auth_mgr.auth_mapper[i].swap))) {
-				LogDebug("TPM_SaveAuthContext failed: 0x%x", result);
-				return result;
-			}
-                       break;
+/* a session that is loaded in the TPM and not in use by a command becomes the most recently
+ * used swap out candidate */
+static void
+auth_lru_touch(struct auth_map *a)
+{
+	auth_lru_remove(a);
+
+	if (a->swap != NULL || a->in_use == TRUE)
+		return;
+
+	a->lru_prev = auth_mgr.lru.lru_prev;
+	a->lru_next = &auth_mgr.lru;
+	auth_mgr.lru.lru_prev->lru_next = a;
+	auth_mgr.lru.lru_prev = a;
+}
+
+static struct auth_ctx_map *
+auth_ctx_find(TCS_CONTEXT_HANDLE tcsContext)
+{
+	struct auth_ctx_map *c;
+
+	for (c = auth_mgr.ctx_mapper[TSS_AUTH_MGR_HASH(tcsContext)]; c; c = c->next) {
+		if (c->tcs_ctx == tcsContext)
+			break;
+	}
+
+	return c;
+}
+
+/* drop the record of a TCS context once its last session is gone */
+static void
+auth_ctx_put(struct auth_ctx_map *c)
+{
+	struct auth_ctx_map **prev;
+
+	if (c->opened)
+		return;
+
+	for (prev = &auth_mgr.ctx_mapper[TSS_AUTH_MGR_HASH(c->tcs_ctx)]; *prev;
+	     prev = &(*prev)->next) {
+		if (*prev == c) {
+			*prev = c->next;
+			break;
+		}
+	}
+
+	free(c);
+}
+
+static struct auth_map *
+auth_find(TCS_CONTEXT_HANDLE tcsContext, TPM_AUTHHANDLE tpm_auth_handle)
+{
+	struct auth_map *a;
+
+	for (a = auth_mgr.auth_mapper[TSS_AUTH_MGR_HASH(tpm_auth_handle)]; a; a = a->hash_next) {
+		if (a->tpm_handle == tpm_auth_handle && a->tcs_ctx == tcsContext)
+			break;
+	}
+
+	return a;
+}
+
+static void
+auth_hash_remove(struct auth_map *a)
+{
+	struct auth_map **prev;
+
+	for (prev = &auth_mgr.auth_mapper[TSS_AUTH_MGR_HASH(a->tpm_handle)]; *prev;
+	     prev = &(*prev)->hash_next) {
+		if (*prev == a) {
+			*prev = a->hash_next;
+			break;
+		}
+	}
+}
+
+static void
+auth_hash_insert(struct auth_map *a)
+{
+	UINT32 bucket = TSS_AUTH_MGR_HASH(a->tpm_handle);
+
+	a->hash_next = auth_mgr.auth_mapper[bucket];
+	auth_mgr.auth_mapper[bucket] = a;
+}
+
+/* forget about a session entirely. The caller is responsible for the session's state in the
+ * TPM and for calling auth_ctx_put() on a->ctx afterwards. */
+static void
+auth_remove(struct auth_map *a)
+{
+	struct auth_map **prev;
+
+	auth_hash_remove(a);
+	auth_lru_remove(a);
+
+	for (prev = &a->ctx->sessions; *prev; prev = &(*prev)->ctx_next) {
+		if (*prev == a) {
+			*prev = a->ctx_next;
+			break;
 		}
 	}
+	a->ctx->opened--;
+	auth_mgr.open_auth_sessions--;
+
+	free(a->swap);
+	free(a);
+}
+
+/* swap out the least recently used session owned by another context, skipping any that another
+ * thread is currently using in a command. If only hContext's own idle sessions are loaded (a TSP
+ * keeping continued sessions around for reuse), swap out the least recently used of those. */
+static TSS_RESULT
+auth_save_ctx(TCS_CONTEXT_HANDLE hContext)
+{
+	TSS_RESULT result = TSS_SUCCESS;
+	struct auth_map *a, *own = NULL;
+
+	for (a = auth_mgr.lru.lru_next; a != &auth_mgr.lru; a = a->lru_next) {
+		if (a->tcs_ctx != hContext)
+			break;
+
+		if (own == NULL)
+			own = a;
+	}
+
+	if (a == &auth_mgr.lru && (a = own) == NULL)
+		return result;
 
-       return result;
+	LogDebug("Calling TPM_SaveAuthContext for TCS CTX %x. Swapping out: TCS %x TPM %x",
+		 hContext, a->tcs_ctx, a->tpm_handle);
+
+	if ((result = TPM_SaveAuthContext(a->tpm_handle, &a->swap_size, &a->swap))) {
+		LogDebug("TPM_SaveAuthContext failed: 0x%x", result);
+		return result;
+	}
+
+	auth_lru_remove(a);
+
+	return result;
 }
 
 /* if there's a TCS context waiting to get auth, wake it up or swap it in */
-void
-auth_mgr_swap_in()
-{
-	if (auth_mgr.overflow[auth_mgr.of_tail] != NULL) {
-		LogDebug("waking up thread %lddd, auth slot has opened", THREAD_ID);
-		/* wake up the next sleeping thread in order and increment tail */
-		COND_SIGNAL(auth_mgr.overflow[auth_mgr.of_tail]);
-		auth_mgr.overflow[auth_mgr.of_tail] = NULL;
-		auth_mgr.of_tail = (auth_mgr.of_tail + 1) % auth_mgr.overflow_size;
+static void
+auth_swap_in()
+{
+	struct auth_waiter *w;
+
+	if ((w = auth_mgr.wait_head) != NULL) {
+		LogDebug("waking up the longest waiting thread, auth slot has opened");
+		/* hand the slot to the first waiter in line. Taking it off the queue here means
+		 * a waiter that times out at the same moment can't be woken twice */
+		auth_mgr.wait_head = w->next;
+		if (auth_mgr.wait_head == NULL)
+			auth_mgr.wait_tail = NULL;
+		auth_mgr.sleeping_threads--;
+
+		/* the slot stays reserved for the waiter until it has opened its session, so a
+		 * thread that gets auth_mgr_lock before the waiter wakes up can't take it */
+		auth_mgr.reserved_slots++;
+		w->signaled = TRUE;
+		COND_SIGNAL(&w->cond);
 	} else {
 		/* else nobody needs to be swapped in, so continue */
 		LogDebug("no threads need to be signaled.");
 	}
 }
 
-/* we need to swap out an auth context or add a waiting context to the overflow queue */
-TSS_RESULT
-auth_mgr_swap_out(TCS_CONTEXT_HANDLE hContext)
+/* this thread's session is now in the TPM, so its reserved slot (if any) has been used */
+static void
+auth_slot_claimed()
+{
+	if (holds_reserved_slot == FALSE)
+		return;
+
+	holds_reserved_slot = FALSE;
+	auth_mgr.reserved_slots--;
+}
+
+/* give a reserved slot this thread didn't use to the next waiter in line */
+static void
+auth_slot_release()
 {
-	COND_VAR *cond;
+	if (holds_reserved_slot == FALSE)
+		return;
+
+	auth_slot_claimed();
+	auth_swap_in();
+}
+
+/* we need to swap out an auth context or wait in line for an auth slot to open */
+static TSS_RESULT
+auth_swap_out(TCS_CONTEXT_HANDLE hContext)
+{
+	struct auth_waiter w, **prev;
+	struct timespec start, end, deadline;
+	TSS_RESULT result = TSS_SUCCESS;
+	UINT32 wait_ms;
+
+	/* a slot handed to us earlier wasn't enough after all, let the next waiter have it */
+	auth_slot_release();
 
 	/* If the TPM can do swapping and it succeeds, return, else cond wait below */
-	if (tpm_metrics.authctx_swap && !auth_mgr_save_ctx(hContext))
+	if (tpm_metrics.authctx_swap && !auth_save_ctx(hContext))
 		return TSS_SUCCESS;
 
-	if ((cond = ctx_get_cond_var(hContext)) == NULL) {
-		LogError("Auth swap variable not found for TCS context 0x%x", hContext);
-		return TCSERR(TSS_E_INTERNAL_ERROR);
-	}
-
 	/* Test whether we are the last awake thread.  If we are, we can't go to sleep
 	 * since then there'd be no worker thread to wake the others up. This situation
 	 * can arise when we're on a busy system who's TPM doesn't support auth ctx
-	 * swapping.
+	 * swapping. A waiter stays on its worker thread until it's done, but one that's
+	 * already been handed a slot is off the queue and will run again without any
+	 * help, so only threads still in line count as asleep here.
 	 */
-	if (auth_mgr.sleeping_threads == (tcsd_options.num_threads - 1)) {
+	if (auth_mgr.sleeping_threads >= (tcsd_options.num_threads - 1)) {
 		LogError("auth mgr failing: too many threads already waiting");
 		LogTPMERR(TCPA_E_RESOURCES, __FILE__, __LINE__);
 		return TCPA_E_RESOURCES;
 	}
 
-	if (auth_mgr.overflow[auth_mgr.of_head] == NULL) {
-		auth_mgr.overflow[auth_mgr.of_head] = cond;
-		auth_mgr.of_head = (auth_mgr.of_head + 1) % auth_mgr.overflow_size;
-		/* go to sleep */
-		LogDebug("thread %lddd going to sleep until auth slot opens", THREAD_ID);
-		auth_mgr.sleeping_threads++;
-		COND_WAIT(cond, &tcsp_lock);
-		auth_mgr.sleeping_threads--;
-	} else if (auth_mgr.overflow_size + TSS_DEFAULT_OVERFLOW_AUTHS < UINT_MAX) {
-		COND_VAR **tmp = auth_mgr.overflow;
-
-		LogDebugFn("Table of sleeping threads is full (%hu), growing to %hu entries",
-			   auth_mgr.sleeping_threads,
-			   auth_mgr.overflow_size + TSS_DEFAULT_OVERFLOW_AUTHS);
-
-		auth_mgr.overflow = calloc(auth_mgr.overflow_size + TSS_DEFAULT_OVERFLOW_AUTHS,
-					   sizeof(COND_VAR *));
-		if (auth_mgr.overflow == NULL) {
-			LogDebugFn("malloc of %zd bytes failed",
-				   (auth_mgr.overflow_size + TSS_DEFAULT_OVERFLOW_AUTHS) *
-				   sizeof(COND_VAR *));
-			auth_mgr.overflow = tmp;
-			return TCSERR(TSS_E_OUTOFMEMORY);
+	COND_INIT(w.cond);
+	w.signaled = FALSE;
+	w.next = NULL;
+
+	if (auth_mgr.wait_tail)
+		auth_mgr.wait_tail->next = &w;
+	else
+		auth_mgr.wait_head = &w;
+	auth_mgr.wait_tail = &w;
+
+	auth_mgr.sleeping_threads++;
+	if (auth_mgr.sleeping_threads > auth_mgr.max_sleeping_threads)
+		auth_mgr.max_sleeping_threads = auth_mgr.sleeping_threads;
+
+	/* the deadline has to be on the condition variable's clock, but the wait is timed on the
+	 * monotonic clock so that a step in the wall clock can't skew the statistics */
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	deadline.tv_sec += TSS_AUTH_WAIT_TIMEOUT;
+
+	/* go to sleep */
+	LogDebug("thread %ld going to sleep until auth slot opens (%u waiting)", THREAD_ID,
+		 auth_mgr.sleeping_threads);
+	while (w.signaled == FALSE) {
+		if (COND_TIMEDWAIT(&w.cond, &auth_mgr_lock, &deadline) == ETIMEDOUT)
+			break;
+	}
+
+	if (w.signaled == FALSE) {
+		/* still in line, take ourselves out */
+		for (prev = &auth_mgr.wait_head; *prev; prev = &(*prev)->next) {
+			if (*prev == &w) {
+				*prev = w.next;
+				break;
+			}
+		}
+		if (auth_mgr.wait_tail == &w) {
+			struct auth_waiter *t;
+
+			for (t = auth_mgr.wait_head; t && t->next; t = t->next)
+				;
+			auth_mgr.wait_tail = t;
 		}
-		auth_mgr.overflow_size += TSS_DEFAULT_OVERFLOW_AUTHS;
-
-		LogDebugFn("Success.");
-		memcpy(auth_mgr.overflow, tmp, auth_mgr.sleeping_threads * sizeof(COND_VAR *));
-		free(tmp);
-
-		/* XXX This could temporarily wake threads up out of order */
-		auth_mgr.of_head = auth_mgr.sleeping_threads;
-		auth_mgr.of_tail = 0;
-		auth_mgr.overflow[auth_mgr.of_head] = cond;
-		auth_mgr.of_head = (auth_mgr.of_head + 1) % auth_mgr.overflow_size;
-		LogDebug("thread %lddd going to sleep until auth slot opens", THREAD_ID);
-		auth_mgr.sleeping_threads++;
-		COND_WAIT(cond, &tcsp_lock);
 		auth_mgr.sleeping_threads--;
+
+		auth_mgr.wait_timeouts++;
+		LogError("Timed out after %d seconds waiting for an auth slot for TCS context %x",
+			 TSS_AUTH_WAIT_TIMEOUT, hContext);
+		LogTPMERR(TCPA_E_RESOURCES, __FILE__, __LINE__);
+		result = TCPA_E_RESOURCES;
 	} else {
-		LogError("Auth table overflow is full (%u entries), some will fail.",
-			 auth_mgr.overflow_size);
-		return TCSERR(TSS_E_INTERNAL_ERROR);
+		holds_reserved_slot = TRUE;
+
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		wait_ms = (end.tv_sec - start.tv_sec) * 1000 +
+			  (end.tv_nsec - start.tv_nsec) / 1000000;
+		auth_mgr.waits++;
+		auth_mgr.wait_ms_total += wait_ms;
+		if (wait_ms > auth_mgr.wait_ms_max)
+			auth_mgr.wait_ms_max = wait_ms;
 	}
 
-	return TSS_SUCCESS;
+	COND_DESTROY(w.cond);
+
+	return result;
+}
+
+/* log the state of the auth slot wait queue. tcsd does this on SIGHUP, which is the only place
+ * these numbers are reported. */
+void
+auth_mgr_report()
+{
+	MUTEX_LOCK(auth_mgr_lock);
+	LogInfo("auth sessions: %hd of %hd open, wait queue depth %u (peak %u), %u wait timeouts",
+		auth_mgr.open_auth_sessions, auth_mgr.max_auth_sessions,
+		auth_mgr.sleeping_threads, auth_mgr.max_sleeping_threads, auth_mgr.wait_timeouts);
+	LogInfo("auth slot waits: %u, average %u ms, longest %u ms", auth_mgr.waits,
+		auth_mgr.waits ? (UINT32)(auth_mgr.wait_ms_total / auth_mgr.waits) : 0,
+		auth_mgr.wait_ms_max);
+	MUTEX_UNLOCK(auth_mgr_lock);
+}
+
+TSS_RESULT
+auth_mgr_swap_out(TCS_CONTEXT_HANDLE hContext)
+{
+	TSS_RESULT result;
+
+	MUTEX_LOCK(auth_mgr_lock);
+	result = auth_swap_out(hContext);
+	MUTEX_UNLOCK(auth_mgr_lock);
+
+	return result;
+}
+
+/* flush a session that is loaded in the TPM */
+static void
+auth_flush(struct auth_map *a)
+{
+	TSS_RESULT result;
+
+	result = TCSP_FlushSpecific_Common(a->tpm_handle, TPM_RT_AUTH);
+
+	/* Ok, probably dealing with a 1.1 TPM */
+	if (result == TPM_E_BAD_ORDINAL)
+		result = internal_TerminateHandle(a->tpm_handle);
+
+	if (result == TCPA_E_INVALID_AUTHHANDLE) {
+		LogDebug("Tried to close an invalid auth handle: %x", a->tpm_handle);
+	} else if (result != TCPA_SUCCESS) {
+		LogDebug("TPM_TerminateHandle returned %d", result);
+	}
 }
 
 /* close all auth contexts associated with this TCS_CONTEXT_HANDLE */
 TSS_RESULT
 auth_mgr_close_context(TCS_CONTEXT_HANDLE tcs_handle)
 {
-	UINT32 i;
-	TSS_RESULT result;
+	struct auth_ctx_map *c;
+	struct auth_map *a;
 
-	for (i = 0; i < auth_mgr.auth_mapper_size; i++) {
-		if (auth_mgr.auth_mapper[i].full == TRUE &&
-		    auth_mgr.auth_mapper[i].tcs_ctx == tcs_handle) {
-			if (auth_mgr.auth_mapper[i].swap) {
-				/* This context is swapped out of the TPM, so we can just free the
-				 * blob */
-				free(auth_mgr.auth_mapper[i].swap);
-				auth_mgr.auth_mapper[i].swap = NULL;
-				auth_mgr.auth_mapper[i].swap_size = 0;
-			} else {
-				result = TCSP_FlushSpecific_Common(auth_mgr.auth_mapper[i].tpm_handle,
-								   TPM_RT_AUTH);
-
-				/* Ok, probably dealing with a 1.1 TPM */
-				if (result == TPM_E_BAD_ORDINAL)
-                                       result = internal_TerminateHandle(
-                                           auth_mgr.auth_mapper[i].tpm_handle);
-
-				if (result == TCPA_E_INVALID_AUTHHANDLE) {
-					LogDebug("Tried to close an invalid auth handle: %x",
-						 auth_mgr.auth_mapper[i].tpm_handle);
-				} else if (result != TCPA_SUCCESS) {
-					LogDebug("TPM_TerminateHandle returned %d", result);
-				}
-			}
-                       /* clear the slot */
-			auth_mgr.open_auth_sessions--;
-			auth_mgr.auth_mapper[i].full = FALSE;
-                       auth_mgr.auth_mapper[i].tpm_handle = 0;
-                       auth_mgr.auth_mapper[i].tcs_ctx = 0;
-			LogDebug("released auth for TCS %x TPM %x", tcs_handle,
-                               auth_mgr.auth_mapper[i].tpm_handle);
-
-			auth_mgr_swap_in();
-		}
+	MUTEX_LOCK(auth_mgr_lock);
+
+	if ((c = auth_ctx_find(tcs_handle)) == NULL) {
+		MUTEX_UNLOCK(auth_mgr_lock);
+		return TSS_SUCCESS;
+	}
+
+	while ((a = c->sessions)) {
+		/* A context that is swapped out of the TPM only needs its blob freed */
+		if (a->swap == NULL)
+			auth_flush(a);
+
+		LogDebug("released auth for TCS %x TPM %x", tcs_handle, a->tpm_handle);
+		auth_remove(a);
+
+		auth_swap_in();
 	}
+	auth_ctx_put(c);
+
+	MUTEX_UNLOCK(auth_mgr_lock);
 
 	return TSS_SUCCESS;
 }
@@ -257,181 +488,245 @@ TSS_RESULT
 auth_mgr_release_auth_handle(TCS_AUTHHANDLE tpm_auth_handle, TCS_CONTEXT_HANDLE tcs_handle,
 			     TSS_BOOL cont)
 {
-	UINT32 i;
+	struct auth_map *a;
+	struct auth_ctx_map *c;
 	TSS_RESULT result = TSS_SUCCESS;
 
-	for (i = 0; i < auth_mgr.auth_mapper_size; i++) {
-		if (auth_mgr.auth_mapper[i].full == TRUE &&
-		    auth_mgr.auth_mapper[i].tpm_handle == tpm_auth_handle &&
-		    auth_mgr.auth_mapper[i].tcs_ctx == tcs_handle) {
-			if (!cont) {
-                               /*
-                                * This function should not be necessary, but
-                                * if the main operation resulted in an error,
-                                * the TPM may still hold the auth handle
-                                * and it must be freed.  Most of the time
-                                * this call will result in TPM_E_INVALID_AUTHHANDLE
-                                * error which can be ignored.
-                                */
-                               result = TCSP_FlushSpecific_Common(
-                                   auth_mgr.auth_mapper[i].tpm_handle,
-                                   TPM_RT_AUTH);
-
-				/* Ok, probably dealing with a 1.1 TPM */
-				if (result == TPM_E_BAD_ORDINAL)
-                                       result = internal_TerminateHandle(
-                                           auth_mgr.auth_mapper[i].tpm_handle);
-
-				if (result == TCPA_E_INVALID_AUTHHANDLE) {
-					LogDebug("Tried to close an invalid auth handle: %x",
-						 auth_mgr.auth_mapper[i].tpm_handle);
-				} else if (result != TCPA_SUCCESS) {
-					LogDebug("TPM_TerminateHandle returned %d", result);
-				}
-
-                               if (result == TPM_SUCCESS) {
-                                       LogDebug("released auth for TCS %x TPM %x",
-                                                auth_mgr.auth_mapper[i].tcs_ctx, tpm_auth_handle);
-                               }
-                               /*
-                                * Mark it as released, the "cont" flag indicates
-                                * that it is no longer needed.
-                                */
-                               auth_mgr.open_auth_sessions--;
-                               auth_mgr.auth_mapper[i].full = FALSE;
-                               auth_mgr.auth_mapper[i].tpm_handle = 0;
-                               auth_mgr.auth_mapper[i].tcs_ctx = 0;
-                               auth_mgr_swap_in();
-			}
-                       /* If the cont flag is TRUE, we have to keep the handle */
-		}
+	MUTEX_LOCK(auth_mgr_lock);
+
+	if ((a = auth_find(tcs_handle, tpm_auth_handle)) == NULL) {
+		MUTEX_UNLOCK(auth_mgr_lock);
+		return result;
 	}
 
+	/* the command is done with the session, it may be swapped out again */
+	a->in_use = FALSE;
+
+	if (!cont) {
+		/*
+		 * This function should not be necessary, but
+		 * if the main operation resulted in an error,
+		 * the TPM may still hold the auth handle
+		 * and it must be freed.  Most of the time
+		 * this call will result in TPM_E_INVALID_AUTHHANDLE
+		 * error which can be ignored.
+		 */
+		if (a->swap == NULL)
+			auth_flush(a);
+
+		LogDebug("released auth for TCS %x TPM %x", tcs_handle, tpm_auth_handle);
+
+		/*
+		 * Mark it as released, the "cont" flag indicates
+		 * that it is no longer needed.
+		 */
+		c = a->ctx;
+		auth_remove(a);
+		auth_ctx_put(c);
+		auth_swap_in();
+	} else {
+		/* If the cont flag is TRUE, we have to keep the handle */
+		auth_lru_touch(a);
+	}
+
+	MUTEX_UNLOCK(auth_mgr_lock);
+
 	return result;
 }
 
 TSS_RESULT
 auth_mgr_check(TCS_CONTEXT_HANDLE tcsContext, TPM_AUTHHANDLE *tpm_auth_handle)
 {
-	UINT32 i;
+	struct auth_map *a;
 	TSS_RESULT result = TSS_SUCCESS;
 
-	for (i = 0; i < auth_mgr.auth_mapper_size; i++) {
-		if (auth_mgr.auth_mapper[i].full == TRUE &&
-		    auth_mgr.auth_mapper[i].tpm_handle == *tpm_auth_handle &&
-		    auth_mgr.auth_mapper[i].tcs_ctx == tcsContext) {
-			/* We have a record of this session, now swap it into the TPM if need be. */
-			if (auth_mgr.auth_mapper[i].swap) {
-				LogDebugFn("TPM_LoadAuthContext for TCS %x TPM %x", tcsContext,
-					   auth_mgr.auth_mapper[i].tpm_handle);
-
-				result = TPM_LoadAuthContext(auth_mgr.auth_mapper[i].swap_size,
-							     auth_mgr.auth_mapper[i].swap,
-							     tpm_auth_handle);
-				if (result == TSS_SUCCESS) {
-					free(auth_mgr.auth_mapper[i].swap);
-					auth_mgr.auth_mapper[i].swap = NULL;
-					auth_mgr.auth_mapper[i].swap_size = 0;
-
-					LogDebugFn("TPM_LoadAuthContext succeeded. Old TPM: %x, New"
-						   " TPM: %x", auth_mgr.auth_mapper[i].tpm_handle,
-						   *tpm_auth_handle);
-
-					auth_mgr.auth_mapper[i].tpm_handle = *tpm_auth_handle;
-				} else if (result == TPM_E_RESOURCES) {
-					if ((result = auth_mgr_swap_out(tcsContext))) {
-						LogDebugFn("TPM_LoadAuthContext failed with TPM_E_R"
-							   "ESOURCES and swapping out failed, retur"
-							   "ning error");
-						return result;
-					}
-
-					LogDebugFn("Retrying TPM_LoadAuthContext after swap"
-						   " out...");
-					result =
-					      TPM_LoadAuthContext(auth_mgr.auth_mapper[i].swap_size,
-								  auth_mgr.auth_mapper[i].swap,
-								  tpm_auth_handle);
-					free(auth_mgr.auth_mapper[i].swap);
-					auth_mgr.auth_mapper[i].swap = NULL;
-					auth_mgr.auth_mapper[i].swap_size = 0;
-				} else {
-					LogDebug("TPM_LoadAuthContext failed: 0x%x.", result);
-				}
+	MUTEX_LOCK(auth_mgr_lock);
+
+	if ((a = auth_find(tcsContext, *tpm_auth_handle)) == NULL) {
+		MUTEX_UNLOCK(auth_mgr_lock);
+
+		LogDebugFn("Can't find auth for TCS handle %x, should be %x", tcsContext,
+			   *tpm_auth_handle);
+		return TCPA_E_INVALID_AUTHHANDLE;
+	}
+
+	/* We have a record of this session, now swap it into the TPM if need be. */
+	if (a->swap) {
+		LogDebugFn("TPM_LoadAuthContext for TCS %x TPM %x", tcsContext, a->tpm_handle);
+
+		result = TPM_LoadAuthContext(a->swap_size, a->swap, tpm_auth_handle);
+		if (result == TPM_E_RESOURCES) {
+			if ((result = auth_swap_out(tcsContext))) {
+				LogDebugFn("TPM_LoadAuthContext failed with TPM_E_RESOURCES and "
+					   "swapping out failed, returning error");
+				MUTEX_UNLOCK(auth_mgr_lock);
+				return result;
 			}
 
-			return result;
+			LogDebugFn("Retrying TPM_LoadAuthContext after swap out...");
+			result = TPM_LoadAuthContext(a->swap_size, a->swap, tpm_auth_handle);
+		}
+
+		if (result == TSS_SUCCESS) {
+			auth_slot_claimed();
+			free(a->swap);
+			a->swap = NULL;
+			a->swap_size = 0;
+
+			LogDebugFn("TPM_LoadAuthContext succeeded. Old TPM: %x, New TPM: %x",
+				   a->tpm_handle, *tpm_auth_handle);
+
+			/* the TPM may hand the session back under a new handle */
+			auth_hash_remove(a);
+			a->tpm_handle = *tpm_auth_handle;
+			auth_hash_insert(a);
+		} else {
+			LogDebug("TPM_LoadAuthContext failed: 0x%x.", result);
+		}
+	}
+
+	/* keep the session in the TPM until the command releases it */
+	if (result == TSS_SUCCESS && a->in_use == FALSE) {
+		if (num_checked_auths == TSS_MAX_CHECKED_AUTHS) {
+			LogError("Too many auth sessions checked by one command, not holding 0x%x",
+				 a->tpm_handle);
+		} else {
+			checked_auths[num_checked_auths].tcs_ctx = a->tcs_ctx;
+			checked_auths[num_checked_auths++].tpm_handle = a->tpm_handle;
+			a->in_use = TRUE;
+			auth_lru_remove(a);
 		}
 	}
 
-	LogDebugFn("Can't find auth for TCS handle %x, should be %x", tcsContext, *tpm_auth_handle);
-	return TCSERR(TSS_E_INTERNAL_ERROR);
+	MUTEX_UNLOCK(auth_mgr_lock);
+	return result;
 }
 
-TSS_RESULT
-auth_mgr_add(TCS_CONTEXT_HANDLE tcsContext, TCS_AUTHHANDLE tpm_auth_handle)
+/* let the sessions this thread's command checked be swapped out again, called once per TCSD
+ * request by the dispatcher */
+void
+auth_mgr_check_done()
 {
-	struct auth_map *tmp = auth_mgr.auth_mapper;
+	struct auth_map *a;
 	UINT32 i;
 
-	for (i = 0; i < auth_mgr.auth_mapper_size; i++) {
-		if (auth_mgr.auth_mapper[i].full == FALSE) {
-			auth_mgr.auth_mapper[i].tpm_handle = tpm_auth_handle;
-			auth_mgr.auth_mapper[i].tcs_ctx = tcsContext;
-			auth_mgr.auth_mapper[i].full = TRUE;
-			auth_mgr.open_auth_sessions++;
-			LogDebug("added auth for TCS %x TPM %x", tcsContext, tpm_auth_handle);
+	if (num_checked_auths == 0 && holds_reserved_slot == FALSE)
+		return;
+
+	MUTEX_LOCK(auth_mgr_lock);
+
+	/* the command failed before opening a session in the slot it was handed */
+	auth_slot_release();
 
-			return TSS_SUCCESS;
+	/* the command may have released and freed a session already */
+	for (i = 0; i < num_checked_auths; i++) {
+		a = auth_find(checked_auths[i].tcs_ctx, checked_auths[i].tpm_handle);
+		if (a && a->in_use == TRUE) {
+			a->in_use = FALSE;
+			auth_lru_touch(a);
 		}
 	}
+	num_checked_auths = 0;
 
+	MUTEX_UNLOCK(auth_mgr_lock);
+}
 
-	LogDebugFn("Thread %ld growing the auth table to %u entries", THREAD_ID,
-		   auth_mgr.auth_mapper_size + TSS_DEFAULT_AUTH_TABLE_SIZE);
+static TSS_RESULT
+auth_add(TCS_CONTEXT_HANDLE tcsContext, TCS_AUTHHANDLE tpm_auth_handle)
+{
+	struct auth_map *a;
+	struct auth_ctx_map *c;
+	UINT32 bucket;
 
-	auth_mgr.auth_mapper = calloc(auth_mgr.auth_mapper_size +
-				      TSS_DEFAULT_AUTH_TABLE_SIZE, sizeof(struct auth_map));
-	if (auth_mgr.auth_mapper == NULL) {
-		auth_mgr.auth_mapper = tmp;
+	if ((c = auth_ctx_find(tcsContext)) == NULL) {
+		if ((c = calloc(1, sizeof(struct auth_ctx_map))) == NULL) {
+			LogError("malloc of %zd bytes failed", sizeof(struct auth_ctx_map));
+			return TCSERR(TSS_E_OUTOFMEMORY);
+		}
+
+		c->tcs_ctx = tcsContext;
+		bucket = TSS_AUTH_MGR_HASH(tcsContext);
+		c->next = auth_mgr.ctx_mapper[bucket];
+		auth_mgr.ctx_mapper[bucket] = c;
+	}
+
+	if ((a = calloc(1, sizeof(struct auth_map))) == NULL) {
+		LogError("malloc of %zd bytes failed", sizeof(struct auth_map));
+		auth_ctx_put(c);
 		return TCSERR(TSS_E_OUTOFMEMORY);
-	} else {
-		memcpy(auth_mgr.auth_mapper, tmp,
-				auth_mgr.auth_mapper_size * sizeof(struct auth_map));
-		auth_mgr.auth_mapper_size += TSS_DEFAULT_AUTH_TABLE_SIZE;
-		LogDebugFn("Success.");
-		return TSS_SUCCESS;
 	}
+
+	a->tpm_handle = tpm_auth_handle;
+	a->tcs_ctx = tcsContext;
+	a->ctx = c;
+	a->lru_prev = a->lru_next = a;
+	auth_hash_insert(a);
+
+	a->ctx_next = c->sessions;
+	c->sessions = a;
+	c->opened++;
+
+	auth_lru_touch(a);
+	auth_mgr.open_auth_sessions++;
+	auth_slot_claimed();
+	LogDebug("added auth for TCS %x TPM %x", tcsContext, tpm_auth_handle);
+
+	return TSS_SUCCESS;
+}
+
+TSS_RESULT
+auth_mgr_add(TCS_CONTEXT_HANDLE tcsContext, TCS_AUTHHANDLE tpm_auth_handle)
+{
+	TSS_RESULT result;
+
+	MUTEX_LOCK(auth_mgr_lock);
+	result = auth_add(tcsContext, tpm_auth_handle);
+	MUTEX_UNLOCK(auth_mgr_lock);
+
+	return result;
 }
 
 /* A thread wants a new OIAP or OSAP session with the TPM. Returning TRUE indicates that we should
  * allow it to open the session, FALSE to indicate that the request should be queued or have
  * another thread's session swapped out to make room for it.
  */
-TSS_BOOL
-auth_mgr_req_new(TCS_CONTEXT_HANDLE hContext)
+static TSS_BOOL
+auth_req_new(TCS_CONTEXT_HANDLE hContext)
 {
-	UINT32 i, opened = 0;
+	struct auth_ctx_map *c;
+	UINT32 opened = 0;
+	int free_slots;
 
-	for (i = 0; i < auth_mgr.auth_mapper_size; i++) {
-		if (auth_mgr.auth_mapper[i].full == TRUE &&
-		    auth_mgr.auth_mapper[i].tcs_ctx  == hContext) {
-			opened++;
-		}
+	/* auth_swap_in() already gave this thread a slot */
+	if (holds_reserved_slot == TRUE)
+		return TRUE;
+
+	/* while other threads are waiting for a slot, wait in line behind them */
+	if (auth_mgr.wait_head != NULL) {
+		LogDebug("Request for new auth handle queued behind %u waiting",
+			 auth_mgr.sleeping_threads);
+		return FALSE;
 	}
 
+	if ((c = auth_ctx_find(hContext)) != NULL)
+		opened = c->opened;
+
 	/* If this TSP has already opened its max open auth handles, deny another open */
 	if (opened >= MAX(2, (UINT32)auth_mgr.max_auth_sessions/2)) {
 		LogDebug("Max opened auth handles already opened.");
 		return FALSE;
 	}
 
+	/* slots reserved for woken waiters aren't available */
+	free_slots = auth_mgr.max_auth_sessions - auth_mgr.open_auth_sessions -
+		     (int)auth_mgr.reserved_slots;
+
 	/* if we have one opened already and there's a slot available, ok */
-	if (opened && ((auth_mgr.max_auth_sessions - auth_mgr.open_auth_sessions) >= 1))
+	if (opened && free_slots >= 1)
 		return TRUE;
 
 	/* we don't already have one open and there are at least 2 slots left */
-	if ((auth_mgr.max_auth_sessions - auth_mgr.open_auth_sessions) >= 2)
+	if (free_slots >= 2)
 		return TRUE;
 
 	LogDebug("Request for new auth handle denied by TCS. (%d opened sessions)", opened);
@@ -439,6 +734,18 @@ auth_mgr_req_new(TCS_CONTEXT_HANDLE hContext)
 	return FALSE;
 }
 
+TSS_BOOL
+auth_mgr_req_new(TCS_CONTEXT_HANDLE hContext)
+{
+	TSS_BOOL ret;
+
+	MUTEX_LOCK(auth_mgr_lock);
+	ret = auth_req_new(hContext);
+	MUTEX_UNLOCK(auth_mgr_lock);
+
+	return ret;
+}
+
 TSS_RESULT
 auth_mgr_oiap(TCS_CONTEXT_HANDLE hContext,	/* in */
 	      TCS_AUTHHANDLE *authHandle,	/* out */
@@ -446,9 +753,13 @@ auth_mgr_oiap(TCS_CONTEXT_HANDLE hContext,	/* in */
 {
 	TSS_RESULT result;
 
+	/* hold the lock from the slot check until the new session is in the table, so that
+	 * two threads can't both take the last free slot */
+	MUTEX_LOCK(auth_mgr_lock);
+
 	/* are the maximum number of auth sessions open? */
-	if (auth_mgr_req_new(hContext) == FALSE) {
-		if ((result = auth_mgr_swap_out(hContext)))
+	if (auth_req_new(hContext) == FALSE) {
+		if ((result = auth_swap_out(hContext)))
 			goto done;
 	}
 
@@ -456,8 +767,9 @@ auth_mgr_oiap(TCS_CONTEXT_HANDLE hContext,	/* in */
 		goto done;
 
 	/* success, add an entry to the table */
-	result = auth_mgr_add(hContext, *authHandle);
+	result = auth_add(hContext, *authHandle);
 done:
+	MUTEX_UNLOCK(auth_mgr_lock);
 	return result;
 }
 
@@ -481,9 +793,11 @@ auth_mgr_osap(TCS_CONTEXT_HANDLE hContext,	/* in */
 		newEntValue = entityValue;
 	}
 
+	MUTEX_LOCK(auth_mgr_lock);
+
 	/* are the maximum number of auth sessions open? */
-	if (auth_mgr_req_new(hContext) == FALSE) {
-		if ((result = auth_mgr_swap_out(hContext)))
+	if (auth_req_new(hContext) == FALSE) {
+		if ((result = auth_swap_out(hContext)))
 			goto done;
 	}
 
@@ -492,8 +806,9 @@ auth_mgr_osap(TCS_CONTEXT_HANDLE hContext,	/* in */
 		goto done;
 
 	/* success, add an entry to the table */
-	result = auth_mgr_add(hContext, *authHandle);
+	result = auth_add(hContext, *authHandle);
 done:
+	MUTEX_UNLOCK(auth_mgr_lock);
 	return result;
 }
 
@@ -26,42 +26,44 @@
 #include "tcsd.h"
 
 
-unsigned long nextContextHandle = 0xA0000000;
-struct tcs_context *tcs_context_table = NULL;
+UINT32 nextContextHandle = 0xA0000000;
+struct tcs_context *tcs_context_table[TCS_CTX_HASH_SIZE];
+/* number of contexts holding TSS_CONTEXT_FLAG_TRANSPORT_EXCLUSIVE, protected by tcs_ctx_lock */
+static UINT32 exclusive_transport_contexts = 0;
 
 MUTEX_DECLARE_INIT(tcs_ctx_lock);
 
 TCS_CONTEXT_HANDLE getNextHandle();
 struct tcs_context *create_tcs_context();
 struct tcs_context *get_context(TCS_CONTEXT_HANDLE);
-struct tcs_context *get_previous_context(TCS_CONTEXT_HANDLE);
 
 TSS_BOOL initContextHandle = 1;
 
+/* Context handles are handed out in sequence from a start point chosen at random the first
+ * time through. Since a handle isn't issued again until the 32 bit counter wraps, the counter
+ * acts as a generation number: a handle kept by a client after its context was closed will
+ * never reach a context opened later. Called with tcs_ctx_lock held. */
 TCS_CONTEXT_HANDLE
 getNextHandle()
 {
 	UINT32 tempRand;
-	time_t currentTime;
+	TCS_CONTEXT_HANDLE handle;
 
 	if (initContextHandle) {
-		currentTime = time(NULL);
-		srand(currentTime);
+		srand(time(NULL));
 		tempRand = rand();
-		tempRand = tempRand << 16;
-		tempRand &= 0x00FF0000;
+		tempRand = tempRand << 8;
+		tempRand &= 0x00FFFF00;
 		nextContextHandle |= tempRand;
 		initContextHandle = 0;
 	}
-	currentTime = time(NULL);
-	srand(currentTime + 1);
-	tempRand = rand();
-	tempRand = tempRand << 8;
-	tempRand &= 0x0000FF00;
-	if (nextContextHandle == 0)
-		return getNextHandle();
-	else
-		return ((nextContextHandle++) | tempRand);
+
+	/* skip the NULL handle and, after a wrap, any handle that is still open */
+	do {
+		handle = nextContextHandle++;
+	} while (handle == NULL_TCS_HANDLE || get_context(handle) != NULL);
+
+	return handle;
 }
 
 struct tcs_context *
@@ -71,7 +73,6 @@ create_tcs_context()
 
 	if (ret != NULL) {
 		ret->handle = getNextHandle();
-		COND_INIT(ret->cond);
 	}
 	return ret;
 }
@@ -80,61 +81,43 @@ struct tcs_context *
 get_context(TCS_CONTEXT_HANDLE handle)
 {
 	struct tcs_context *index;
-	index = tcs_context_table;
-	while (index) {
+
+	for (index = tcs_context_table[TCS_CTX_HASH(handle)]; index; index = index->next) {
 		if (index->handle == handle)
 			break;
-		index = index->next;
 	}
 
 	return index;
 }
 
-struct tcs_context *
-get_previous_context(TCS_CONTEXT_HANDLE handle)
-{
-	struct tcs_context *index;
-	index = tcs_context_table;
-	while (index) {
-		if (index->next) {
-			if (index->next->handle == handle)
-				return index;
-		}
-		index = index->next;
-	}
-
-	return 0;
-}
-
 void
 destroy_context(TCS_CONTEXT_HANDLE handle)
 {
-	struct tcs_context *toKill;
-	struct tcs_context *previous;
+	struct tcs_context *toKill, **prev;
 
 	MUTEX_LOCK(tcs_ctx_lock);
 
-	toKill = get_context(handle);
-	previous = get_previous_context(handle);
+	for (prev = &tcs_context_table[TCS_CTX_HASH(handle)]; *prev; prev = &(*prev)->next) {
+		if ((*prev)->handle == handle)
+			break;
+	}
 
-	if (!previous && tcs_context_table->handle == handle) {
-		/* this means that toKill is the first one */
-		tcs_context_table = tcs_context_table->next;
-	} else if (previous && toKill) {
-		/* both are found */
-		previous->next = toKill->next;
-	} else {
+	if ((toKill = *prev) == NULL) {
 		MUTEX_UNLOCK(tcs_ctx_lock);
 		return;
 	}
 
+	*prev = toKill->next;
+	if (toKill->flags & TSS_CONTEXT_FLAG_TRANSPORT_EXCLUSIVE)
+		exclusive_transport_contexts--;
+
 	MUTEX_UNLOCK(tcs_ctx_lock);
 
 	CTX_ref_count_keys(toKill);
 
 #ifdef TSS_BUILD_TRANSPORT
 	/* Free existing transport session if necessary */
-	if (toKill != NULL && toKill->transHandle)
+	if (toKill->transHandle)
 		TCSP_FlushSpecific_Common(toKill->transHandle, TPM_RT_TRANS);
 #endif
 
@@ -145,32 +128,20 @@ TCS_CONTEXT_HANDLE
 make_context()
 {
 	struct tcs_context *index;
+	UINT32 bucket;
 
 	MUTEX_LOCK(tcs_ctx_lock);
 
-	index = tcs_context_table;
-
-	if (!index) {
-		tcs_context_table = create_tcs_context();
-		if (tcs_context_table == NULL) {
-			LogError("Malloc Failure.");
-			MUTEX_UNLOCK(tcs_ctx_lock);
-			return 0;
-		}
-		index = tcs_context_table;
-	} else {
-		while (index->next) {
-			index = index->next;
-		}
-		index->next = create_tcs_context();
-		if (index->next == NULL) {
-			LogError("Malloc Failure.");
-			MUTEX_UNLOCK(tcs_ctx_lock);
-			return 0;
-		}
-		index = index->next;
+	if ((index = create_tcs_context()) == NULL) {
+		LogError("Malloc Failure.");
+		MUTEX_UNLOCK(tcs_ctx_lock);
+		return 0;
 	}
 
+	bucket = TCS_CTX_HASH(index->handle);
+	index->next = tcs_context_table[bucket];
+	tcs_context_table[bucket] = index;
+
 	MUTEX_UNLOCK(tcs_ctx_lock);
 
 	return index->handle;
@@ -197,24 +168,6 @@ ctx_verify_context(TCS_CONTEXT_HANDLE tcsContext)
 }
 
 
-COND_VAR *
-ctx_get_cond_var(TCS_CONTEXT_HANDLE tcs_handle)
-{
-	struct tcs_context *c;
-	COND_VAR *ret = NULL;
-
-	MUTEX_LOCK(tcs_ctx_lock);
-
-	c = get_context(tcs_handle);
-
-	if (c != NULL)
-		ret = &c->cond;
-
-	MUTEX_UNLOCK(tcs_ctx_lock);
-
-	return ret;
-}
-
 /* the only transport flag at the TCS level is whether the session is exclusive or not. If the app
  * is requesting an exclusive transport session, check that no other exclusive sessions exist and
  * if not, flag this context as being the one. If so, return internal error. */
@@ -222,7 +175,7 @@ TSS_RESULT
 ctx_req_exclusive_transport(TCS_CONTEXT_HANDLE tcsContext)
 {
 	TSS_RESULT result = TSS_SUCCESS;
-	struct tcs_context *tmp, *self = NULL;
+	struct tcs_context *self;
 
 	/* If the daemon is configured to ignore apps that want an exclusive transport, just
 	 * return */
@@ -231,22 +184,15 @@ ctx_req_exclusive_transport(TCS_CONTEXT_HANDLE tcsContext)
 
 	MUTEX_LOCK(tcs_ctx_lock);
 
-	tmp = tcs_context_table;
-	while (tmp) {
-		if (tmp->flags & TSS_CONTEXT_FLAG_TRANSPORT_EXCLUSIVE) {
-			result = TCSERR(TSS_E_INTERNAL_ERROR);
-			goto done;
-		}
-
-		if (tmp->handle == tcsContext)
-			self = tmp;
-
-		tmp = tmp->next;
+	if (exclusive_transport_contexts) {
+		result = TCSERR(TSS_E_INTERNAL_ERROR);
+		goto done;
 	}
 
-	if (self)
+	if ((self = get_context(tcsContext)) != NULL) {
 		self->flags |= TSS_CONTEXT_FLAG_TRANSPORT_EXCLUSIVE;
-	else
+		exclusive_transport_contexts++;
+	} else
 		result = TCSERR(TCS_E_INVALID_CONTEXTHANDLE);
 done:
 	MUTEX_UNLOCK(tcs_ctx_lock);
@@ -258,21 +204,11 @@ TSS_RESULT
 ctx_set_transport_enabled(TCS_CONTEXT_HANDLE tcsContext, UINT32 hTransHandle)
 {
 	TSS_RESULT result = TSS_SUCCESS;
-	struct tcs_context *tmp, *self = NULL;
+	struct tcs_context *self;
 
 	MUTEX_LOCK(tcs_ctx_lock);
 
-	tmp = tcs_context_table;
-	while (tmp) {
-		if (tmp->handle == tcsContext) {
-			self = tmp;
-			break;
-		}
-
-		tmp = tmp->next;
-	}
-
-	if (self) {
+	if ((self = get_context(tcsContext)) != NULL) {
 		self->flags |= TSS_CONTEXT_FLAG_TRANSPORT_ENABLED;
 		self->transHandle = hTransHandle;
 	} else
@@ -287,21 +223,11 @@ TSS_RESULT
 ctx_set_transport_disabled(TCS_CONTEXT_HANDLE tcsContext, TCS_HANDLE *transHandle)
 {
 	TSS_RESULT result = TSS_SUCCESS;
-	struct tcs_context *tmp, *self = NULL;
+	struct tcs_context *self;
 
 	MUTEX_LOCK(tcs_ctx_lock);
 
-	tmp = tcs_context_table;
-	while (tmp) {
-		if (tmp->handle == tcsContext) {
-			self = tmp;
-			break;
-		}
-
-		tmp = tmp->next;
-	}
-
-	if (self) {
+	if ((self = get_context(tcsContext)) != NULL) {
 		if (!transHandle || *transHandle == self->transHandle) {
 			self->transHandle = 0;
 			self->flags &= ~TSS_CONTEXT_FLAG_TRANSPORT_ENABLED;
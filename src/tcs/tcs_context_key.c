@@ -25,60 +25,68 @@
 
 MUTEX_DECLARE_EXTERN(tcs_ctx_lock);
 
-/* runs through the list of all keys loaded by context c and decrements
+/* runs through the set of all keys loaded by context c and decrements
  * their ref count by 1, then free's their structures.
  */
 void
 ctx_ref_count_keys(struct tcs_context *c)
 {
 	struct keys_loaded *cur, *prev;
+	UINT32 i;
 
 	if (c == NULL)
 		return;
 
-	cur = prev = c->keys;
+	for (i = 0; i < TCS_CTX_KEYS_HASH_SIZE; i++) {
+		cur = prev = c->keys[i];
 
-	while (cur != NULL) {
-		key_mgr_dec_ref_count(cur->key_handle);
-		cur = cur->next;
-		free(prev);
-		prev = cur;
+		while (cur != NULL) {
+			key_mgr_dec_ref_count(cur->key_handle);
+			cur = cur->next;
+			free(prev);
+			prev = cur;
+		}
+		c->keys[i] = NULL;
 	}
 }
-/* Traverse loaded keys list and if matching key handle is found return TRUE else return FALSE
+
+/* look key_handle up in the loaded keys set of context c. Called with tcs_ctx_lock held. */
+static struct keys_loaded *
+ctx_find_key_loaded(struct tcs_context *c, TCS_KEY_HANDLE key_handle)
+{
+	struct keys_loaded *k;
+
+	for (k = c->keys[TCS_CTX_KEYS_HASH(key_handle)]; k; k = k->next) {
+		if (k->key_handle == key_handle)
+			break;
+	}
+
+	return k;
+}
+
+/* If matching key handle is found in the loaded keys set return TRUE else return FALSE
  */
 TSS_BOOL
 ctx_has_key_loaded(TCS_CONTEXT_HANDLE ctx_handle, TCS_KEY_HANDLE key_handle)
 {
 	struct tcs_context *c;
-	struct keys_loaded *k = NULL;
+	TSS_BOOL ret = FALSE;
 
 	MUTEX_LOCK(tcs_ctx_lock);
 
-	c = get_context(ctx_handle);
-	if (c == NULL) {
-		MUTEX_UNLOCK(tcs_ctx_lock);
-		return FALSE;
-	}
-	k = c->keys;
-	while (k != NULL) {
-		if (k->key_handle == key_handle) {
-			MUTEX_UNLOCK(tcs_ctx_lock);
-			return TRUE;
-		}
-		k = k->next;
-	}
+	if ((c = get_context(ctx_handle)) != NULL && ctx_find_key_loaded(c, key_handle) != NULL)
+		ret = TRUE;
 
 	MUTEX_UNLOCK(tcs_ctx_lock);
-	return FALSE;
+	return ret;
 }
 
-/* Traverse loaded keys list and if matching key handle is found remove it */
+/* If matching key handle is found in the loaded keys set remove it */
 TSS_RESULT
 ctx_remove_key_loaded(TCS_CONTEXT_HANDLE ctx_handle, TCS_KEY_HANDLE key_handle)
 {
 	struct tcs_context *c;
-	struct keys_loaded *cur, *prev;
+	struct keys_loaded *cur, **prev;
 
 	MUTEX_LOCK(tcs_ctx_lock);
 
@@ -88,12 +96,9 @@ ctx_remove_key_loaded(TCS_CONTEXT_HANDLE ctx_handle, TCS_KEY_HANDLE key_handle)
 		return TCSERR(TCS_E_INVALID_CONTEXTHANDLE);
 	}
 
-	for (prev = cur = c->keys; cur; prev = cur, cur = cur->next) {
+	for (prev = &c->keys[TCS_CTX_KEYS_HASH(key_handle)]; (cur = *prev); prev = &cur->next) {
 		if (cur->key_handle == key_handle) {
-			if (cur == c->keys)
-				c->keys = cur->next;
-			else
-				prev->next = cur->next;
+			*prev = cur->next;
 
 			free(cur);
 			MUTEX_UNLOCK(tcs_ctx_lock);
@@ -105,58 +110,56 @@ ctx_remove_key_loaded(TCS_CONTEXT_HANDLE ctx_handle, TCS_KEY_HANDLE key_handle)
 	return TCSERR(TCS_E_INVALID_KEY);
 }
 
-/* make a new entry in the per-context list of loaded keys. If the list already
+/* make a new entry in the per-context set of loaded keys. If the set already
  * contains a pointer to the key in memory, just return success.
  */
 TSS_RESULT
 ctx_mark_key_loaded(TCS_CONTEXT_HANDLE ctx_handle, TCS_KEY_HANDLE key_handle)
 {
 	struct tcs_context *c;
-	struct keys_loaded *k = NULL, *new;
+	struct keys_loaded *new;
 	TSS_RESULT result;
 
+	/* mem_cache_lock is taken before tcs_ctx_lock, and both are held so that the record and
+	 * the ref count it stands for appear together to a context close or key evict */
+	MUTEX_LOCK(mem_cache_lock);
 	MUTEX_LOCK(tcs_ctx_lock);
 
 	c = get_context(ctx_handle);
+	if (c == NULL) {
+		result = TCSERR(TSS_E_FAIL);
+		goto done;
+	}
 
-	if (c != NULL) {
-		k = c->keys;
-		while (k != NULL) {
-			if (k->key_handle == key_handle) {
-				/* we've previously created a pointer to key_handle in the global
-				 * list of loaded keys and incremented that key's reference count,
-				 * so there's no need to do anything.
-				 */
-				result = TSS_SUCCESS;
-				break;
-			}
-
-			k = k->next;
-		}
-	} else {
-		MUTEX_UNLOCK(tcs_ctx_lock);
-		return TCSERR(TSS_E_FAIL);
+	/* if the key is found, we've previously created a pointer to key_handle in the global
+	 * list of loaded keys and incremented that key's reference count, so there's no
+	 * need to do anything.
+	 */
+	if (ctx_find_key_loaded(c, key_handle) != NULL) {
+		result = TSS_SUCCESS;
+		goto done;
 	}
 
 	/* if we have no record of this key being loaded by this context, create a new
 	 * entry and increment the key's reference count in the global list.
 	 */
-	if (k == NULL) {
-		new = calloc(1, sizeof(struct keys_loaded));
-		if (new == NULL) {
-			LogError("malloc of %zd bytes failed.", sizeof(struct keys_loaded));
-			MUTEX_UNLOCK(tcs_ctx_lock);
-			return TCSERR(TSS_E_OUTOFMEMORY);
-		}
-
-		new->key_handle = key_handle;
-		new->next = c->keys;
-		c->keys = new;
-		result = key_mgr_inc_ref_count(new->key_handle);
+	if ((result = key_mgr_inc_ref_count(key_handle)))
+		goto done;
+
+	new = calloc(1, sizeof(struct keys_loaded));
+	if (new == NULL) {
+		LogError("malloc of %zd bytes failed.", sizeof(struct keys_loaded));
+		key_mgr_dec_ref_count(key_handle);
+		result = TCSERR(TSS_E_OUTOFMEMORY);
+		goto done;
 	}
 
+	new->key_handle = key_handle;
+	new->next = c->keys[TCS_CTX_KEYS_HASH(key_handle)];
+	c->keys[TCS_CTX_KEYS_HASH(key_handle)] = new;
+done:
 	MUTEX_UNLOCK(tcs_ctx_lock);
+	MUTEX_UNLOCK(mem_cache_lock);
 
 	return result;
 }
-
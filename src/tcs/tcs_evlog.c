@@ -13,6 +13,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <limits.h>
+#include <errno.h>
 
 #include "trousers/tss.h"
 #include "trousers_types.h"
@@ -43,10 +44,10 @@ event_log_init()
 	MUTEX_INIT(tcs_event_log->lock);
 
 	/* allocate as many event lists as there are PCR's */
-	tcs_event_log->lists = calloc(tpm_metrics.num_pcrs, sizeof(struct event_wrapper *));
+	tcs_event_log->lists = calloc(tpm_metrics.num_pcrs, sizeof(struct event_list));
 	if (tcs_event_log->lists == NULL) {
 		LogError("malloc of %zd bytes failed.",
-				tpm_metrics.num_pcrs * sizeof(struct event_wrapper *));
+				tpm_metrics.num_pcrs * sizeof(struct event_list));
 		free(tcs_event_log);
 		return TCSERR(TSS_E_OUTOFMEMORY);
 	}
@@ -62,22 +63,25 @@ event_log_init()
 TSS_RESULT
 event_log_final()
 {
-	struct event_wrapper *cur, *next;
-	UINT32 i;
+	struct event_list *list;
+	UINT32 i, j;
 
 	MUTEX_LOCK(tcs_event_log->lock);
 
 	for (i = 0; i < tpm_metrics.num_pcrs; i++) {
-		cur = tcs_event_log->lists[i];
-		while (cur != NULL) {
-			next = cur->next;
-			free(cur->event.rgbPcrValue);
-			free(cur->event.rgbEvent);
-			free(cur);
-			cur = next;
+		list = &tcs_event_log->lists[i];
+		for (j = 0; j < list->num; j++) {
+			free(list->events[j].rgbPcrValue);
+			free(list->events[j].rgbEvent);
 		}
+		free(list->events);
 	}
 
+	if (tcs_event_log->firmware_source && tcs_event_log->firmware_source->index)
+		ext_log_index_free(tcs_event_log->firmware_source->index);
+	if (tcs_event_log->kernel_source && tcs_event_log->kernel_source->index)
+		ext_log_index_free(tcs_event_log->kernel_source->index);
+
 	MUTEX_UNLOCK(tcs_event_log->lock);
 
 	free(tcs_event_log->lists);
@@ -96,97 +100,54 @@ copy_pcr_event(TSS_PCR_EVENT *dest, TSS_PCR_EVENT *source)
 TSS_RESULT
 event_log_add(TSS_PCR_EVENT *event, UINT32 *pNumber)
 {
-	struct event_wrapper *new, *tmp;
+	struct event_list *list;
+	TSS_PCR_EVENT *tmp;
 	TSS_RESULT result;
-	UINT32 i;
+	UINT32 size;
 
 	MUTEX_LOCK(tcs_event_log->lock);
 
-	new = calloc(1, sizeof(struct event_wrapper));
-	if (new == NULL) {
-		LogError("malloc of %zd bytes failed.", sizeof(struct event_wrapper));
-		MUTEX_UNLOCK(tcs_event_log->lock);
-		return TCSERR(TSS_E_OUTOFMEMORY);
+	list = &tcs_event_log->lists[event->ulPcrIndex];
+
+	/* grow the list by doubling, so that appending stays cheap however long it gets */
+	if (list->num == list->size) {
+		size = list->size ? list->size * 2 : EVLOG_LIST_INIT_SIZE;
+		if ((tmp = realloc(list->events, size * sizeof(TSS_PCR_EVENT))) == NULL) {
+			LogError("malloc of %zd bytes failed.", size * sizeof(TSS_PCR_EVENT));
+			MUTEX_UNLOCK(tcs_event_log->lock);
+			return TCSERR(TSS_E_OUTOFMEMORY);
+		}
+		list->events = tmp;
+		list->size = size;
 	}
 
-	if ((result = copy_pcr_event(&(new->event), event))) {
-		free(new);
+	if ((result = copy_pcr_event(&list->events[list->num], event))) {
 		MUTEX_UNLOCK(tcs_event_log->lock);
 		return result;
 	}
 
-	/* go to the end of the list to add the element, so that they're in order */
-	i = 0;
-	if (tcs_event_log->lists[event->ulPcrIndex] == NULL) {
-		tcs_event_log->lists[event->ulPcrIndex] = new;
-	} else {
-		i++;
-		tmp = tcs_event_log->lists[event->ulPcrIndex];
-		while (tmp->next != NULL) {
-			i++;
-			tmp = tmp->next;
-		}
-		tmp->next = new;
-	}
-
-	*pNumber = ++i;
+	*pNumber = ++list->num;
 
 	MUTEX_UNLOCK(tcs_event_log->lock);
 
 	return TSS_SUCCESS;
 }
 
+/* the lock should be held before calling this function. The event returned is only valid
+ * while the lock is held, since logging more events can move the list. */
 TSS_PCR_EVENT *
 get_pcr_event(UINT32 pcrIndex, UINT32 eventNumber)
 {
-	struct event_wrapper *tmp;
-	UINT32 counter = 0;
-
-	MUTEX_LOCK(tcs_event_log->lock);
-
-	tmp = tcs_event_log->lists[pcrIndex];
-	for (; tmp; tmp = tmp->next) {
-		if (counter == eventNumber) {
-			break;
-		}
-		counter++;
-	}
-
-	MUTEX_UNLOCK(tcs_event_log->lock);
+	struct event_list *list = &tcs_event_log->lists[pcrIndex];
 
-	return (tmp ? &(tmp->event) : NULL);
+	return (eventNumber < list->num ? &list->events[eventNumber] : NULL);
 }
 
 /* the lock should be held before calling this function */
 UINT32
 get_num_events(UINT32 pcrIndex)
 {
-	struct event_wrapper *tmp;
-	UINT32 counter = 0;
-
-	tmp = tcs_event_log->lists[pcrIndex];
-	for (; tmp; tmp = tmp->next) {
-		counter++;
-	}
-
-	return counter;
-}
-
-TSS_PCR_EVENT *
-concat_pcr_events(TSS_PCR_EVENT **list_so_far, UINT32 list_size, TSS_PCR_EVENT *addition,
-		  UINT32 addition_size)
-{
-	TSS_PCR_EVENT *ret;
-
-	ret = realloc(*list_so_far, (list_size + addition_size) * sizeof(TSS_PCR_EVENT));
-	if (ret == NULL) {
-		LogError("malloc of %zd bytes failed",
-			 (list_size + addition_size) * sizeof(TSS_PCR_EVENT));
-		return ret;
-	}
-
-	memcpy(&ret[list_size], addition, addition_size * sizeof(TSS_PCR_EVENT));
-	return ret;
+	return tcs_event_log->lists[pcrIndex].num;
 }
 
 /* XXX make this a macro */
@@ -213,11 +174,218 @@ free_external_events(UINT32 eventCount, TSS_PCR_EVENT *ppEvents)
 		 * maintained by the TCSD don't need to have this data free'd, since that
 		 * will happen at shutdown time only. So, for each PCR index that's
 		 * read from securityfs, we need to free its pointers after that data has
-		 * been set in the packet to send back to the TSP. */
+		 * been set in the packet to send back to the TSP. rgbEvent lives in the same
+		 * block as rgbPcrValue, see ext_log_event_alloc(). */
 		if ((tcsd_options.kernel_pcrs & (1 << ppEvents[j].ulPcrIndex)) ||
-		    (tcsd_options.firmware_pcrs & (1 << ppEvents[j].ulPcrIndex))) {
+		    (tcsd_options.firmware_pcrs & (1 << ppEvents[j].ulPcrIndex)))
 			free(ppEvents[j].rgbPcrValue);
-			free(ppEvents[j].rgbEvent);
+	}
+}
+
+/* start (or keep) indexing the external log at path. If the configured log file has changed,
+ * the offsets collected so far are useless. Called with the event log lock held. */
+TSS_RESULT
+ext_log_index_open(struct ext_log_index *idx, char *path)
+{
+	if (idx->path && !strcmp(idx->path, path))
+		return TSS_SUCCESS;
+
+	ext_log_index_free(idx);
+
+	if ((idx->path = strdup(path)) == NULL) {
+		LogError("malloc of %zd bytes failed.", strlen(path) + 1);
+		return TCSERR(TSS_E_OUTOFMEMORY);
+	}
+
+	return TSS_SUCCESS;
+}
+
+void
+ext_log_index_free(struct ext_log_index *idx)
+{
+	UINT32 i;
+
+	free(idx->path);
+	for (i = 0; i < EVLOG_MAX_PCRS; i++)
+		free(idx->offsets[i]);
+
+	memset(idx, 0, sizeof(struct ext_log_index));
+}
+
+TSS_RESULT
+ext_log_index_add(struct ext_log_index *idx, UINT32 pcr, long offset)
+{
+	long *tmp;
+	UINT32 size;
+
+	if (pcr >= EVLOG_MAX_PCRS) {
+		LogDebug("Skipping external event for PCR %u", pcr);
+		return TSS_SUCCESS;
+	}
+
+	if (idx->num[pcr] == idx->size[pcr]) {
+		size = idx->size[pcr] ? idx->size[pcr] * 2 : EVLOG_INDEX_INIT_SIZE;
+		if ((tmp = realloc(idx->offsets[pcr], size * sizeof(long))) == NULL) {
+			LogError("malloc of %zd bytes failed.", size * sizeof(long));
+			return TCSERR(TSS_E_OUTOFMEMORY);
+		}
+		idx->offsets[pcr] = tmp;
+		idx->size[pcr] = size;
+	}
+
+	idx->offsets[pcr][idx->num[pcr]++] = offset;
+
+	return TSS_SUCCESS;
+}
+
+/* read past len bytes of the log. Reading is used instead of fseek() since seeking past the
+ * end of a regular file succeeds, and seeking in securityfs walks the log from the start. */
+int
+ext_log_skip(FILE *fp, UINT32 len)
+{
+	BYTE buf[512];
+	size_t n;
+
+	while (len) {
+		n = MIN(len, sizeof(buf));
+		if (fread(buf, 1, n, fp) != n)
+			return -1;
+		len -= n;
+	}
+
+	return 0;
+}
+
+/* position fp at offset, unless reading the previous entry already left it there */
+static int
+ext_log_seek(FILE *fp, long offset)
+{
+	if (ftell(fp) == offset)
+		return 0;
+
+	return fseek(fp, offset, SEEK_SET);
+}
+
+/* the digest and the data of an external event are allocated as one block, starting at
+ * rgbPcrValue. A NUL byte is kept after the data for the text based logs. */
+TSS_RESULT
+ext_log_event_alloc(TSS_PCR_EVENT *e, UINT32 event_len)
+{
+	BYTE *block;
+	size_t size = (size_t)TPM_SHA1_160_HASH_LEN + event_len + 1;
+
+	if (size < event_len || (block = calloc(1, size)) == NULL) {
+		LogError("malloc of %zd bytes failed.", size);
+		return TCSERR(TSS_E_OUTOFMEMORY);
+	}
+
+	e->ulPcrValueLength = TPM_SHA1_160_HASH_LEN;
+	e->rgbPcrValue = block;
+	e->ulEventLength = event_len;
+	e->rgbEvent = event_len ? block + TPM_SHA1_160_HASH_LEN : NULL;
+
+	return TSS_SUCCESS;
+}
+
+static void
+ext_log_free_events(UINT32 count, TSS_PCR_EVENT *events)
+{
+	UINT32 i;
+
+	for (i = 0; i < count; i++)
+		free(events[i].rgbPcrValue);
+	free(events);
+}
+
+TSS_RESULT
+ext_log_get_entries_by_pcr(struct ext_log_source *src, FILE *fp, UINT32 pcr_index, UINT32 first,
+			   UINT32 *count, TSS_PCR_EVENT **events)
+{
+	struct ext_log_index *idx = src->index;
+	TSS_PCR_EVENT *e;
+	UINT32 i, n;
+	TSS_RESULT result;
+
+	if (*count == 0)
+		return TSS_SUCCESS;
+
+	if ((result = src->index_entries(fp, idx)))
+		return result;
+
+	if (pcr_index >= EVLOG_MAX_PCRS || first >= idx->num[pcr_index]) {
+		*count = 0;
+		*events = NULL;
+		return TSS_SUCCESS;
+	}
+
+	n = MIN(*count, idx->num[pcr_index] - first);
+	if ((e = calloc(n, sizeof(TSS_PCR_EVENT))) == NULL) {
+		LogError("malloc of %zd bytes failed.", n * sizeof(TSS_PCR_EVENT));
+		return TCSERR(TSS_E_OUTOFMEMORY);
+	}
+
+	for (i = 0; i < n; i++) {
+		if (ext_log_seek(fp, idx->offsets[pcr_index][first + i])) {
+			LogError("seek in event source failed: %s", strerror(errno));
+			ext_log_free_events(i, e);
+			return TCSERR(TSS_E_INTERNAL_ERROR);
+		}
+
+		if ((result = src->read_entry(fp, &e[i]))) {
+			ext_log_free_events(i, e);
+			return result;
 		}
 	}
+
+	*count = n;
+	*events = e;
+
+	return TSS_SUCCESS;
+}
+
+/* if ppEvent is NULL, return the number of events logged for pcr_index in *num, else
+ * return event number *num */
+TSS_RESULT
+ext_log_get_entry(struct ext_log_source *src, FILE *fp, UINT32 pcr_index, UINT32 *num,
+		  TSS_PCR_EVENT **ppEvent)
+{
+	struct ext_log_index *idx = src->index;
+	TSS_PCR_EVENT *e;
+	UINT32 n;
+	TSS_RESULT result;
+
+	if ((result = src->index_entries(fp, idx)))
+		return result;
+
+	n = pcr_index < EVLOG_MAX_PCRS ? idx->num[pcr_index] : 0;
+
+	if (ppEvent == NULL) {
+		*num = n;
+		return TSS_SUCCESS;
+	}
+
+	if (*num >= n) {
+		LogDebug("Event %u of PCR %u not found", *num, pcr_index);
+		return TCSERR(TSS_E_BAD_PARAMETER);
+	}
+
+	if ((e = calloc(1, sizeof(TSS_PCR_EVENT))) == NULL) {
+		LogError("malloc of %zd bytes failed.", sizeof(TSS_PCR_EVENT));
+		return TCSERR(TSS_E_OUTOFMEMORY);
+	}
+
+	if (ext_log_seek(fp, idx->offsets[pcr_index][*num])) {
+		LogError("seek in event source failed: %s", strerror(errno));
+		free(e);
+		return TCSERR(TSS_E_INTERNAL_ERROR);
+	}
+
+	if ((result = src->read_entry(fp, e))) {
+		free(e);
+		return result;
+	}
+
+	*ppEvent = e;
+
+	return TSS_SUCCESS;
 }
@@ -52,11 +52,19 @@
 
 #define EVLOG_FILENAME_MAXSIZE 255
 
+static TSS_RESULT ima_index_entries(FILE *, struct ext_log_index *);
+static TSS_RESULT ima_read_entry(FILE *, TSS_PCR_EVENT *);
+
+static struct ext_log_index ima_index;
+
 struct ext_log_source ima_source = {
 	ima_open,
 	ima_get_entries_by_pcr,
 	ima_get_entry,
-	ima_close
+	ima_close,
+	ima_index_entries,
+	ima_read_entry,
+	&ima_index
 };
 
 int
@@ -70,282 +78,134 @@ ima_open(void *source, FILE **handle)
 		return -1;
 	}
 
+	if (ext_log_index_open(&ima_index, (char *)source)) {
+		fclose(fd);
+		return -1;
+	}
+
 	*handle =  fd;
 	return 0;
 }
 
-TSS_RESULT
-ima_get_entries_by_pcr(FILE *handle, UINT32 pcr_index, UINT32 first,
-			UINT32 *count, TSS_PCR_EVENT **events)
+/*  4 bytes binary         [PCR index]
+ * 20 bytes binary         [template SHA1]
+ *  4 bytes binary         [template name length]
+ *  n bytes of ascii       [template name]
+ * 20 bytes binary         [file digest]
+ *  4 bytes binary         [event length]
+ *  n bytes                [event]
+ *
+ * Read an entry up to its event data, returning its PCR index, template SHA1 and event length.
+ * Returns 1 at a clean end of the log. */
+static int
+ima_read_header(FILE *fp, UINT32 *pcr_value, BYTE *digest, UINT32 *event_len)
 {
-	int pcr_value;
-	char page[IMA_READ_SIZE];
-	int error_path = 1, ptr = 0;
-	UINT32 copied_events = 0, i;
-	struct event_wrapper *list, *cur;
-	TSS_RESULT result = TCSERR(TSS_E_INTERNAL_ERROR);
-	FILE *fp = (FILE *) handle;
-	uint len;
-	char name[EVLOG_FILENAME_MAXSIZE];
-
-	if (!fp) {
-		LogError("File handle is NULL!\n");
+	UINT32 len;
+
+	if (fread(pcr_value, sizeof(UINT32), 1, fp) != 1)
 		return 1;
-	}
 
-	if (*count == 0)
-		return TSS_SUCCESS;
+	/* Get the template SHA1, template name size, template name and file digest */
+	if (fread(digest, 20, 1, fp) != 1 ||
+	    fread(&len, sizeof(len), 1, fp) != 1) {
+		LogDebug("Short read of event log file");
+		return -1;
+	}
+	if (len > EVLOG_FILENAME_MAXSIZE) {
+		LogError("Event log file name too big! Max size is %d", EVLOG_FILENAME_MAXSIZE);
+		return -1;
+	}
+	if (ext_log_skip(fp, len + 20)) {
+		LogDebug("Short read of event log file");
+		return -1;
+	}
 
-	list = calloc(1, sizeof(struct event_wrapper));
-	if (list == NULL) {
-		LogError("malloc of %zd bytes failed.", sizeof(struct event_wrapper));
-		return TCSERR(TSS_E_OUTOFMEMORY);
+	/* Get the template data length */
+	if (fread(event_len, sizeof(UINT32), 1, fp) != 1) {
+		LogDebug("Short read of event log file");
+		return -1;
 	}
-	cur = list;
-
-	rewind(fp);
-
-        while (fread(page, 24, 1, fp)) {
-		/* copy the initial 4 bytes (PCR index) XXX endianess ignored */
-		ptr = 0;
-		memcpy(&pcr_value, &page[ptr], sizeof(int));
-		cur->event.ulPcrIndex = pcr_value;
-		ptr += sizeof(int);
-
-		/* grab this entry */
-		cur->event.ulPcrValueLength = 20;
-		cur->event.rgbPcrValue = malloc(cur->event.ulPcrValueLength);
-		if (cur->event.rgbPcrValue == NULL) {
-			LogError("malloc of %d bytes failed.", 20);
-			result = TCSERR(TSS_E_OUTOFMEMORY);
-			goto free_list;
-		}
 
-		/* copy the template SHA1 XXX endianess ignored */
-		memcpy(cur->event.rgbPcrValue, &page[ptr],
-		       cur->event.ulPcrValueLength);
+	return 0;
+}
 
-/* Get the template name size, template name */
+/* add the entries appended to the log since the last call to the index */
+static TSS_RESULT
+ima_index_entries(FILE *fp, struct ext_log_index *idx)
 {
-		char digest[20];
+	UINT32 pcr_value, event_len;
+	BYTE digest[20];
+	long next;
+	TSS_RESULT result;
+
+	if (fseek(fp, idx->parsed, SEEK_SET)) {
+		LogError("seek in event source failed: %s", strerror(errno));
+		return TCSERR(TSS_E_INTERNAL_ERROR);
+	}
 
-		if (fread(&len, 1, sizeof(len), fp) != (sizeof(len))) {
-			LogError("Failed to read event log file");
-			result = TCSERR(TSS_E_INTERNAL_ERROR);
-			goto free_list;
-		}
-		if (len > EVLOG_FILENAME_MAXSIZE) {
-			LogError("Event log file name too big! Max size is %d", EVLOG_FILENAME_MAXSIZE);
-			result = TCSERR(TSS_E_INTERNAL_ERROR);
-			goto free_list;
-		}
-		memset(name, 0, EVLOG_FILENAME_MAXSIZE);
-		if (fread(name, 1, len, fp) != len) {
-			LogError("Failed to read event log file");
-			result = TCSERR(TSS_E_INTERNAL_ERROR);
-			goto free_list;
-		}
-		if (fread(digest, 1, sizeof digest, fp) != (sizeof(digest))) {
-			LogError("Failed to read event log file");
-			result = TCSERR(TSS_E_INTERNAL_ERROR);
-			goto free_list;
-		}
-}
-		/* Get the template data namelen and data */
-		if (fread(&cur->event.ulEventLength, 1, sizeof(int), fp) != sizeof(int)) {
-			LogError("Failed to read event log file");
-			result = TCSERR(TSS_E_INTERNAL_ERROR);
-			goto free_list;
-		}
-		cur->event.rgbEvent = malloc(cur->event.ulEventLength + 1);
-		if (cur->event.rgbEvent == NULL) {
-			free(cur->event.rgbPcrValue);
-			LogError("malloc of %u bytes failed.",
-				 cur->event.ulEventLength);
-			result = TCSERR(TSS_E_OUTOFMEMORY);
-			goto free_list;
-		}
-		memset(cur->event.rgbEvent, 0, cur->event.ulEventLength);
-		if (fread(cur->event.rgbEvent, 1, cur->event.ulEventLength, fp) != cur->event.ulEventLength) {
-			free(cur->event.rgbPcrValue);
-			LogError("Failed to read event log file");
-			result = TCSERR(TSS_E_INTERNAL_ERROR);
-			goto free_list;
-		}
+	/* a short read means the end of the log, or an entry that's still being written */
+	while (ima_read_header(fp, &pcr_value, digest, &event_len) == 0) {
+		if (ext_log_skip(fp, event_len))
+			break;
 
-		copied_events++;
+		if ((next = ftell(fp)) < 0) {
+			LogError("ftell on event source failed: %s", strerror(errno));
+			return TCSERR(TSS_E_INTERNAL_ERROR);
+		}
 
-		if (copied_events == *count)
-			goto copy_events;
+		if ((result = ext_log_index_add(idx, pcr_value, idx->parsed)))
+			return result;
 
-		cur->next = calloc(1, sizeof(struct event_wrapper));
-		if (cur->next == NULL) {
-			LogError("malloc of %zd bytes failed.",
-				 sizeof(struct event_wrapper));
-			result = TCSERR(TSS_E_OUTOFMEMORY);
-			goto free_list;
-		}
-		cur = cur->next;
+		idx->parsed = next;
 	}
 
-copy_events:
-	/* we've copied all the events we need to from this PCR, now
-	 * copy them all into one contiguous memory block
-	 */
-	*events = calloc(copied_events, sizeof(TSS_PCR_EVENT));
-	if (*events == NULL) {
-		LogError("malloc of %zd bytes failed.", copied_events * sizeof(TSS_PCR_EVENT));
-		result = TCSERR(TSS_E_OUTOFMEMORY);
-		goto free_list;
-	}
+	return TSS_SUCCESS;
+}
+
+static TSS_RESULT
+ima_read_entry(FILE *fp, TSS_PCR_EVENT *e)
+{
+	UINT32 pcr_value, event_len;
+	BYTE digest[20];
+	TSS_RESULT result;
 
-	cur = list;
-	for (i = 0; i < copied_events; i++) {
-		memcpy(&((*events)[i]), &(cur->event), sizeof(TSS_PCR_EVENT));
-		cur = cur->next;
+	if (ima_read_header(fp, &pcr_value, digest, &event_len)) {
+		LogError("Failed to read event log file");
+		return TCSERR(TSS_E_INTERNAL_ERROR);
 	}
 
-	*count = copied_events;
-	/* assume we're in an error path until we get here */
-	error_path = 0;
-	result = TSS_SUCCESS;
-
-free_list:
-	cur = list->next;
-	while (cur != NULL) {
-		if (error_path) {
-			free(cur->event.rgbEvent);
-			free(cur->event.rgbPcrValue);
-		}
-		free(list);
-		list = cur;
-		cur = list->next;
+	if ((result = ext_log_event_alloc(e, event_len)))
+		return result;
+
+	/* XXX endianess ignored */
+	e->ulPcrIndex = pcr_value;
+	memcpy(e->rgbPcrValue, digest, 20);
+
+	if (event_len > 0 && fread(e->rgbEvent, event_len, 1, fp) != 1) {
+		LogError("Failed to read event log file");
+		free(e->rgbPcrValue);
+		return TCSERR(TSS_E_INTERNAL_ERROR);
 	}
-	free(list);
-	return result;
+
+	return TSS_SUCCESS;
 }
 
 TSS_RESULT
-ima_get_entry(FILE *handle, UINT32 pcr_index, UINT32 *num, TSS_PCR_EVENT **ppEvent)
+ima_get_entries_by_pcr(FILE *handle, UINT32 pcr_index, UINT32 first,
+			UINT32 *count, TSS_PCR_EVENT **events)
 {
-	int pcr_value, ptr = 0;
-	uint len;
-	char page[IMA_READ_SIZE];
-	UINT32 seen_indices = 0;
-	TSS_RESULT result = TCSERR(TSS_E_INTERNAL_ERROR);
-	TSS_PCR_EVENT *event = NULL;
-	FILE *fp = (FILE *) handle;
-	char name[EVLOG_FILENAME_MAXSIZE];
-
-	rewind(fp);
-	while (fread(page, 24, 1, fp)) {
-		/* copy the initial 4 bytes (PCR index) XXX endianess ignored */
-		ptr = 0;
-		memcpy(&pcr_value, &page[ptr], sizeof(int));
-
-		if (pcr_index == (UINT32)pcr_value) {
-			ptr += sizeof(int);
-			/* This is the case where we're looking for a specific event number in a
-			 * specific PCR index. When we've reached the correct event, malloc
-			 * space for it, copy it in, then break out of the while loop */
-			if (ppEvent && seen_indices == *num) {
-				/* grab this entry */
-				event = calloc(1, sizeof(TSS_PCR_EVENT));
-				event->ulPcrIndex = pcr_value;
-				event->rgbPcrValue = NULL;
-				event->rgbEvent = NULL;
-				event->ulPcrValueLength = 20;
-				event->rgbPcrValue = malloc(event->ulPcrValueLength);
-				if (event->rgbPcrValue == NULL) {
-					LogError("malloc of %d bytes failed.", 20);
-					free(event);
-					result = TCSERR(TSS_E_OUTOFMEMORY);
-					goto done;
-				}
-
-				/* copy the template SHA1 XXX endianess ignored */
-				memcpy(event->rgbPcrValue, &page[ptr],
-						event->ulPcrValueLength);
-
-				/* Get the template name size, template name */
-				{
-					char digest[20];
-
-					if (fread(&len, 1, sizeof(len), fp) != sizeof(len)) {
-						LogError("Failed to read event log file");
-						result = TCSERR(TSS_E_INTERNAL_ERROR);
-						goto done;
-					}
-					if (len > EVLOG_FILENAME_MAXSIZE) {
-						LogError("Event log file name too big! Max size is %d", EVLOG_FILENAME_MAXSIZE);
-						result = TCSERR(TSS_E_INTERNAL_ERROR);
-						goto done;
-					}
-					memset(name, 0, EVLOG_FILENAME_MAXSIZE);
-					if (fread(name, 1, len, fp) != len) {
-						LogError("Failed to read event log file");
-						result = TCSERR(TSS_E_INTERNAL_ERROR);
-						goto done;
-					}
-					if (fread(digest, 1, sizeof(digest), fp) != sizeof(digest)) {
-						LogError("Failed to read event log file");
-						result = TCSERR(TSS_E_INTERNAL_ERROR);
-						goto done;
-					}
-				}
-				/* Get the template data namelen and data */
-				if (fread(&event->ulEventLength, 1, sizeof(int), fp) != sizeof(int)) {
-					LogError("Failed to read event log file");
-					result = TCSERR(TSS_E_INTERNAL_ERROR);
-					goto done;
-				}
-				event->rgbEvent = malloc(event->ulEventLength + 1);
-				if (event->rgbEvent == NULL) {
-					LogError("malloc of %u bytes failed.",
-							event->ulEventLength);
-					result = TCSERR(TSS_E_OUTOFMEMORY);
-					goto done;
-				}
-				memset(event->rgbEvent, 0, event->ulEventLength + 1);
-				if (fread(event->rgbEvent, 1, event->ulEventLength, fp) != event->ulEventLength ) {
-					LogError("Failed to read event log file");
-					result = TCSERR(TSS_E_INTERNAL_ERROR);
-					goto done;
-				}
-				
-				*ppEvent = event;
-				result = TSS_SUCCESS;
-				break;
-			}
-		}
-		if (fread(&len, 1, sizeof(len), fp) != sizeof(len)) {
-			LogError("Failed to read event log file");
-			result = TCSERR(TSS_E_INTERNAL_ERROR);
-			goto done;
-		}
-		fseek(fp, len + 20, SEEK_CUR);
-		if (fread(&len, 1, sizeof(len), fp) != sizeof(len)) {
-			LogError("Failed to read event log file");
-			result = TCSERR(TSS_E_INTERNAL_ERROR);
-			goto done;
-		}
-		fseek(fp, len, SEEK_CUR);
-		seen_indices++;
-	}
-done:
-	if (result != TSS_SUCCESS) {
-		if (event != NULL) {
-			free(event->rgbPcrValue);
-			free(event->rgbEvent);
-		}
-		free(event);
-		event = NULL;
+	if (!handle) {
+		LogError("File handle is NULL!\n");
+		return TCSERR(TSS_E_INTERNAL_ERROR);
 	}
 
-	if (ppEvent == NULL)
-		*num = seen_indices;
+	return ext_log_get_entries_by_pcr(&ima_source, handle, pcr_index, first, count, events);
+}
 
-	return result;
+TSS_RESULT
+ima_get_entry(FILE *handle, UINT32 pcr_index, UINT32 *num, TSS_PCR_EVENT **ppEvent)
+{
+	return ext_log_get_entry(&ima_source, handle, pcr_index, num, ppEvent);
 }
 
 int
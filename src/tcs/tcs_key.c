@@ -85,7 +85,7 @@ TSS_RESULT
 get_slot_lite(TCS_CONTEXT_HANDLE hContext, TCS_KEY_HANDLE hKey, TPM_KEY_HANDLE *out)
 {
 	if (ctx_has_key_loaded(hContext, hKey)) {
-		if ((*out = mc_get_slot_by_handle(hKey)) == NULL_TPM_HANDLE)
+		if ((*out = mc_get_slot_by_handle_lock(hKey)) == NULL_TPM_HANDLE)
 			return TCSERR(TCS_E_INVALID_KEY);
 
 		return TSS_SUCCESS;
@@ -106,19 +106,27 @@ get_slot(TCS_CONTEXT_HANDLE hContext, TCS_KEY_HANDLE hKey, TPM_KEY_HANDLE *out)
 	TPM_STORE_PUBKEY *pub = NULL;
 	TPM_KEY_HANDLE slot;
 
+	MUTEX_LOCK(mem_cache_lock);
+
         LogDebugFn("calling mc_get_slot_by_handle");
         if ((slot = mc_get_slot_by_handle(hKey)) == NULL_TPM_HANDLE) {
-                LogDebugFn("calling mc_get_pub_by_slot");
-                if ((pub = mc_get_pub_by_slot(hKey)) == NULL)
+                LogDebugFn("calling mc_get_pub_by_handle");
+                if ((pub = mc_get_pub_by_handle(hKey)) == NULL) {
+			MUTEX_UNLOCK(mem_cache_lock);
                         return TCSERR(TCS_E_KM_LOADFAILED);
+		}
 
                 LogDebugFn("calling LoadKeyShim");
                 /* Otherwise, try to load it using the shim */
                 result = LoadKeyShim(hContext, pub, NULL, &slot);
         }
 
-	if (!result)
+	if (!result) {
+		mc_pin_key_by_handle(hKey);
 		*out = slot;
+	}
+
+	MUTEX_UNLOCK(mem_cache_lock);
 
 	return result;
 }
@@ -171,7 +179,8 @@ load_key_init(TPM_COMMAND_CODE   ord,
 			LogDebugFn("tcs key handle exists");
 
 			tpm_slot = mc_get_slot_by_handle(tcs_handle);
-			if (tpm_slot && (isKeyLoaded(tpm_slot) == TRUE)) {
+			if ((tpm_slot && (isKeyLoaded(tpm_slot) == TRUE)) ||
+			    key_mgr_swap_in(tcs_handle, &tpm_slot) == TSS_SUCCESS) {
 				LogDebugFn("Don't need to reload this key.");
 				*handle = tcs_handle;
 				*slot = tpm_slot;
@@ -215,6 +224,85 @@ load_key_final(TCS_CONTEXT_HANDLE hContext,
 		return mc_set_slot_by_handle(*tcs_handle, slot);
 }
 
+/*
+ * Cache of the TPM's TPM_CAP_CHECK_LOADED answers. Whether a key can be loaded depends only on
+ * its TCPA_KEY_PARMS and on how full the TPM is, so for each set of key parms seen we keep
+ * the most keys the TPM had loaded when it said yes and the fewest it had loaded when it said
+ * no. With the number of loaded keys known from the request manager's key slot shadow, a
+ * count at or below the first or at or above the second is answered without asking the TPM.
+ * The cache is emptied when the TPM may have been reset (the shadow's epoch moved on) and
+ * when a key load runs out of room. key_parms_lock is a leaf lock.
+ */
+#define TCS_KEY_PARMS_CACHE_SIZE	16
+
+struct key_parms_entry {
+	TCPA_DIGEST digest;	/* of the key parms as sent to the TPM */
+	int yes_max;		/* -1 if the TPM hasn't said yes yet */
+	int no_min;		/* TCS_KEY_PARMS_NEVER if the TPM hasn't said no yet */
+};
+#define TCS_KEY_PARMS_NEVER	(TSS_REQ_MGR_MAX_KEY_SLOTS + 1)
+
+static MUTEX_DECLARE_INIT(key_parms_lock);
+static struct key_parms_entry key_parms_cache[TCS_KEY_PARMS_CACHE_SIZE];
+static UINT32 key_parms_num = 0, key_parms_next = 0, key_parms_epoch = 0;
+
+/* caller must hold key_parms_lock */
+static struct key_parms_entry *
+key_parms_find(TCPA_DIGEST *digest, UINT32 epoch)
+{
+	UINT32 i;
+
+	if (epoch != key_parms_epoch) {
+		key_parms_num = key_parms_next = 0;
+		key_parms_epoch = epoch;
+		return NULL;
+	}
+
+	for (i = 0; i < key_parms_num; i++) {
+		if (!memcmp(&key_parms_cache[i].digest, digest, sizeof(TCPA_DIGEST)))
+			return &key_parms_cache[i];
+	}
+
+	return NULL;
+}
+
+/* record the TPM's answer for a key with these parms, given when it had @loaded keys loaded */
+static void
+key_parms_add(TCPA_DIGEST *digest, UINT32 epoch, UINT32 loaded, TSS_BOOL can_load)
+{
+	struct key_parms_entry *entry;
+
+	MUTEX_LOCK(key_parms_lock);
+
+	if ((entry = key_parms_find(digest, epoch)) == NULL) {
+		/* replace the entries round robin once the cache is full */
+		entry = &key_parms_cache[key_parms_next];
+		key_parms_next = (key_parms_next + 1) % TCS_KEY_PARMS_CACHE_SIZE;
+		if (key_parms_num < TCS_KEY_PARMS_CACHE_SIZE)
+			key_parms_num++;
+
+		memcpy(&entry->digest, digest, sizeof(TCPA_DIGEST));
+		entry->yes_max = -1;
+		entry->no_min = TCS_KEY_PARMS_NEVER;
+	}
+
+	if (can_load && (int)loaded > entry->yes_max)
+		entry->yes_max = loaded;
+	else if (!can_load && (int)loaded < entry->no_min)
+		entry->no_min = loaded;
+
+	MUTEX_UNLOCK(key_parms_lock);
+}
+
+/* forget every cached answer, since one of them has turned out to be wrong */
+void
+key_parms_cache_flush()
+{
+	MUTEX_LOCK(key_parms_lock);
+	key_parms_num = key_parms_next = 0;
+	MUTEX_UNLOCK(key_parms_lock);
+}
+
 TSS_RESULT
 canILoadThisKey(TCPA_KEY_PARMS *parms, TSS_BOOL *b)
 {
@@ -224,11 +312,30 @@ canILoadThisKey(TCPA_KEY_PARMS *parms, TSS_BOOL *b)
 	TCPA_RESULT result;
 	UINT32 respDataLength;
 	BYTE *respData;
+	TCPA_DIGEST digest;
+	struct key_parms_entry *entry;
+	UINT32 loaded, epoch, loaded_after, epoch_after;
+	TSS_BOOL cacheable;
 
 	offset = 0;
 	LoadBlob_KEY_PARMS(&offset, subCap, parms);
 	subCapLength = offset;
 
+	cacheable = (req_mgr_key_slots_used(&loaded, &epoch) == TSS_SUCCESS &&
+		     Hash(TSS_HASH_SHA1, subCapLength, subCap, digest.digest) == TSS_SUCCESS);
+	if (cacheable) {
+		MUTEX_LOCK(key_parms_lock);
+		if ((entry = key_parms_find(&digest, epoch))) {
+			if ((int)loaded <= entry->yes_max || (int)loaded >= entry->no_min) {
+				*b = ((int)loaded <= entry->yes_max) ? TRUE : FALSE;
+				MUTEX_UNLOCK(key_parms_lock);
+				LogDebugFn("%s (cached, %u keys loaded)", *b ? "YES" : "NO", loaded);
+				return TSS_SUCCESS;
+			}
+		}
+		MUTEX_UNLOCK(key_parms_lock);
+	}
+
 	if ((result = TCSP_GetCapability_Internal(InternalContext, TCPA_CAP_CHECK_LOADED,
 						  subCapLength, subCap, &respDataLength,
 						  &respData))) {
@@ -241,6 +348,11 @@ canILoadThisKey(TCPA_KEY_PARMS *parms, TSS_BOOL *b)
 	free(respData);
 	LogDebugFn("%s", *b ? "YES" : "NO");
 
+	/* only keep the answer if no other thread loaded or evicted a key meanwhile */
+	if (cacheable && req_mgr_key_slots_used(&loaded_after, &epoch_after) == TSS_SUCCESS &&
+	    loaded_after == loaded && epoch_after == epoch)
+		key_parms_add(&digest, epoch, loaded, *b);
+
 	return TSS_SUCCESS;
 }
 
@@ -285,8 +397,9 @@ clearUnknownKeys(TCS_CONTEXT_HANDLE hContext, UINT32 *cleared)
 	UINT32 respDataSize = 0, count = 0;
 	TCPA_CAPABILITY_AREA capArea = -1;
 	UINT64 offset = 0;
-	TSS_BOOL found = FALSE;
+#ifdef TSS_DEBUG
 	struct key_mem_cache *tmp;
+#endif
 
 	capArea = TCPA_CAP_KEY_HANDLE;
 
@@ -314,15 +427,7 @@ clearUnknownKeys(TCS_CONTEXT_HANDLE hContext, UINT32 *cleared)
 	for (i = 0; i < keyList.loaded; i++) {
 		/* as long as we're only called from evictFirstKey(), we don't
 		 * need to lock here */
-		for (tmp = key_mem_cache_head; tmp; tmp = tmp->next) {
-			if (tmp->tpm_handle == keyList.handle[i]) {
-				found = TRUE;
-				break;
-			}
-		}
-		if (found)
-			found = FALSE;
-		else {
+		if (mc_get_handle_by_slot(keyList.handle[i]) == NULL_TCS_HANDLE) {
 			if ((result = internal_EvictByKeySlot(keyList.handle[i])))
 				goto done;
 			else
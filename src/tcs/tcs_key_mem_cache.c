@@ -30,9 +30,11 @@
 
 /*
  * mem_cache_lock will be responsible for protecting the key_mem_cache_head list. This is a
- * TCSD global linked list of all keys which have been loaded into the TPM at some time.
+ * TCSD global linked list of all keys which have been loaded into the TPM at some time. It
+ * is also held across every load and evict of a key, so that the list and the TPM's key
+ * slots stay in sync. It's recursive because the load paths call back into each other.
  */
-MUTEX_DECLARE_INIT(mem_cache_lock);
+MUTEX_DECLARE(mem_cache_lock);
 
 /*
  * tcs_keyhandle_lock is only used to make TCS keyhandle generation atomic for all TCSD
@@ -46,6 +48,324 @@ static MUTEX_DECLARE_INIT(tcs_keyhandle_lock);
  */
 static MUTEX_DECLARE_INIT(timestamp_lock);
 
+/*
+ * The keys whose TPM slots have been handed to the command this thread is processing. Each
+ * of them has its pin_cnt raised, which keeps it from being chosen for eviction until the
+ * command is done with the TPM and key_mgr_unpin_all() is called.
+ */
+#define TSS_MAX_PINNED_KEYS	8
+static THREAD_LOCAL TCS_KEY_HANDLE pinned_keys[TSS_MAX_PINNED_KEYS];
+static THREAD_LOCAL UINT32 num_pinned_keys = 0;
+
+/*
+ * Hash indexes over key_mem_cache_head, protected by mem_cache_lock. Every entry is in the
+ * TCS handle index. Entries are only in the TPM handle index while they hold a key slot,
+ * only in the UUID index once they have a non-NULL UUID and only in the pubkey index if they
+ * carry a key blob. The list itself is kept for the walks that have to visit every key.
+ */
+#define KEY_MGR_HASH_BITS	8
+#define KEY_MGR_HASH_SIZE	(1 << KEY_MGR_HASH_BITS)
+
+static struct key_mem_cache *tcs_handle_index[KEY_MGR_HASH_SIZE];
+static struct key_mem_cache *tpm_handle_index[KEY_MGR_HASH_SIZE];
+static struct key_mem_cache *uuid_index[KEY_MGR_HASH_SIZE];
+static struct key_mem_cache *pub_index[KEY_MGR_HASH_SIZE];
+
+#define MC_HASH_LINK(bucket, entry, field) \
+	do { \
+		(entry)->field = *(bucket); \
+		*(bucket) = (entry); \
+	} while (0)
+
+#define MC_HASH_UNLINK(bucket, entry, field) \
+	do { \
+		struct key_mem_cache **_pp; \
+		for (_pp = (bucket); *_pp; _pp = &(*_pp)->field) { \
+			if (*_pp == (entry)) { \
+				*_pp = (entry)->field; \
+				break; \
+			} \
+		} \
+		(entry)->field = NULL; \
+	} while (0)
+
+static UINT32
+mc_hash_handle(UINT32 handle)
+{
+	/* TPM handles aren't sequential, so mix the bits before taking the top of them */
+	return (handle * 0x9e3779b1U) >> (32 - KEY_MGR_HASH_BITS);
+}
+
+/* FNV-1a, used for the UUID index and as the pubkey digest */
+static UINT32
+mc_hash_bytes(BYTE *data, UINT32 size)
+{
+	UINT32 hash = 2166136261U, i;
+
+	for (i = 0; i < size; i++) {
+		hash ^= data[i];
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
+
+static TSS_BOOL
+mc_uuid_is_null(TSS_UUID *uuid)
+{
+	return memcmp(uuid, &NULL_UUID, sizeof(TSS_UUID)) ? FALSE : TRUE;
+}
+
+/*
+ * Keys holding a TPM slot, other than the SRK, in least recently used first order. A key is
+ * moved to the tail whenever a command uses it, so evictFirstKey() can take its victim from
+ * the head instead of searching the cache for the oldest time stamp.
+ */
+static struct key_mem_cache *lru_head = NULL, *lru_tail = NULL;
+
+static TSS_BOOL
+mc_lru_tracked(struct key_mem_cache *entry)
+{
+	return (entry->tpm_handle != NULL_TPM_HANDLE &&
+		entry->tpm_handle != SRK_TPM_HANDLE) ? TRUE : FALSE;
+}
+
+/* caller must lock the mem cache before calling! */
+static void
+mc_lru_remove(struct key_mem_cache *entry)
+{
+	if (entry->lru_prev)
+		entry->lru_prev->lru_next = entry->lru_next;
+	else
+		lru_head = entry->lru_next;
+
+	if (entry->lru_next)
+		entry->lru_next->lru_prev = entry->lru_prev;
+	else
+		lru_tail = entry->lru_prev;
+
+	entry->lru_next = entry->lru_prev = NULL;
+}
+
+/* caller must lock the mem cache before calling! */
+static void
+mc_lru_append(struct key_mem_cache *entry)
+{
+	entry->lru_next = NULL;
+	entry->lru_prev = lru_tail;
+	if (lru_tail)
+		lru_tail->lru_next = entry;
+	else
+		lru_head = entry;
+	lru_tail = entry;
+}
+
+/* caller must lock the mem cache before calling! */
+static void
+mc_lru_touch(struct key_mem_cache *entry)
+{
+	entry->time_stamp = getNextTimeStamp();
+
+	if (!mc_lru_tracked(entry) || entry == lru_tail)
+		return;
+
+	mc_lru_remove(entry);
+	mc_lru_append(entry);
+}
+
+#define MC_TCS_BUCKET(h)	(&tcs_handle_index[mc_hash_handle(h)])
+#define MC_TPM_BUCKET(h)	(&tpm_handle_index[mc_hash_handle(h)])
+#define MC_UUID_BUCKET(u)	(&uuid_index[mc_hash_bytes((BYTE *)(u), sizeof(TSS_UUID)) & \
+					     (KEY_MGR_HASH_SIZE - 1)])
+#define MC_PUB_BUCKET(d)	(&pub_index[(d) & (KEY_MGR_HASH_SIZE - 1)])
+
+/* caller must lock the mem cache before calling! */
+static void
+mc_set_tpm_handle(struct key_mem_cache *entry, TCPA_KEY_HANDLE tpm_handle)
+{
+	if (mc_lru_tracked(entry))
+		mc_lru_remove(entry);
+	if (entry->tpm_handle != NULL_TPM_HANDLE)
+		MC_HASH_UNLINK(MC_TPM_BUCKET(entry->tpm_handle), entry, tpm_hnext);
+
+	entry->tpm_handle = tpm_handle;
+	if (tpm_handle == NULL_TPM_HANDLE) {
+		entry->time_stamp = 0;
+	} else {
+		entry->time_stamp = getNextTimeStamp();
+		MC_HASH_LINK(MC_TPM_BUCKET(tpm_handle), entry, tpm_hnext);
+	}
+	if (mc_lru_tracked(entry))
+		mc_lru_append(entry);
+}
+
+/* caller must lock the mem cache before calling! */
+static void
+mc_link_entry(struct key_mem_cache *entry)
+{
+	entry->next = key_mem_cache_head;
+	entry->prev = NULL;
+	if (key_mem_cache_head)
+		key_mem_cache_head->prev = entry;
+	key_mem_cache_head = entry;
+
+	MC_HASH_LINK(MC_TCS_BUCKET(entry->tcs_handle), entry, tcs_hnext);
+	if (entry->tpm_handle != NULL_TPM_HANDLE)
+		MC_HASH_LINK(MC_TPM_BUCKET(entry->tpm_handle), entry, tpm_hnext);
+	if (mc_lru_tracked(entry))
+		mc_lru_append(entry);
+	if (!mc_uuid_is_null(&entry->uuid))
+		MC_HASH_LINK(MC_UUID_BUCKET(&entry->uuid), entry, uuid_hnext);
+	if (entry->blob) {
+		entry->pub_digest = mc_hash_bytes(entry->blob->pubKey.key,
+						  entry->blob->pubKey.keyLength);
+		MC_HASH_LINK(MC_PUB_BUCKET(entry->pub_digest), entry, pub_hnext);
+	}
+}
+
+/* caller must lock the mem cache before calling! */
+static void
+mc_free_entry(struct key_mem_cache *entry)
+{
+	if (entry->prev != NULL)
+		entry->prev->next = entry->next;
+	if (entry->next != NULL)
+		entry->next->prev = entry->prev;
+	if (entry == key_mem_cache_head)
+		key_mem_cache_head = entry->next;
+
+	MC_HASH_UNLINK(MC_TCS_BUCKET(entry->tcs_handle), entry, tcs_hnext);
+	if (entry->tpm_handle != NULL_TPM_HANDLE)
+		MC_HASH_UNLINK(MC_TPM_BUCKET(entry->tpm_handle), entry, tpm_hnext);
+	if (mc_lru_tracked(entry))
+		mc_lru_remove(entry);
+	if (!mc_uuid_is_null(&entry->uuid))
+		MC_HASH_UNLINK(MC_UUID_BUCKET(&entry->uuid), entry, uuid_hnext);
+	if (entry->blob) {
+		MC_HASH_UNLINK(MC_PUB_BUCKET(entry->pub_digest), entry, pub_hnext);
+		destroy_key_refs(entry->blob);
+		free(entry->blob);
+	}
+
+	free(entry->swap);
+	free(entry);
+}
+
+/* caller must lock the mem cache before calling! */
+static struct key_mem_cache *
+mc_find_by_handle(TCS_KEY_HANDLE tcs_handle)
+{
+	struct key_mem_cache *tmp;
+
+	for (tmp = *MC_TCS_BUCKET(tcs_handle); tmp; tmp = tmp->tcs_hnext) {
+		if (tmp->tcs_handle == tcs_handle)
+			return tmp;
+	}
+
+	return NULL;
+}
+
+/* caller must lock the mem cache before calling! */
+static struct key_mem_cache *
+mc_find_by_slot(TCPA_KEY_HANDLE tpm_handle)
+{
+	struct key_mem_cache *tmp;
+
+	if (tpm_handle == NULL_TPM_HANDLE)
+		return NULL;
+
+	for (tmp = *MC_TPM_BUCKET(tpm_handle); tmp; tmp = tmp->tpm_hnext) {
+		if (tmp->tpm_handle == tpm_handle)
+			return tmp;
+	}
+
+	return NULL;
+}
+
+static TSS_BOOL
+mc_pub_matches(struct key_mem_cache *tmp, TCPA_STORE_PUBKEY *pub, UINT32 digest)
+{
+	return (tmp->pub_digest == digest &&
+		tmp->blob->pubKey.keyLength == pub->keyLength &&
+		!memcmp(tmp->blob->pubKey.key, pub->key, pub->keyLength)) ? TRUE : FALSE;
+}
+
+/* caller must lock the mem cache before calling! Returns the newest entry for pub */
+static struct key_mem_cache *
+mc_find_by_pub(TCPA_STORE_PUBKEY *pub)
+{
+	struct key_mem_cache *tmp;
+	UINT32 digest = mc_hash_bytes(pub->key, pub->keyLength);
+
+	for (tmp = *MC_PUB_BUCKET(digest); tmp; tmp = tmp->pub_hnext) {
+		if (mc_pub_matches(tmp, pub, digest))
+			return tmp;
+	}
+
+	return NULL;
+}
+
+/* no locking done in init since its called by only a single thread */
+TSS_RESULT
+key_mgr_init()
+{
+	MUTEX_INIT_RECURSIVE(mem_cache_lock);
+
+	return TSS_SUCCESS;
+}
+
+/* caller must lock the mem cache before calling! */
+static void
+mc_pin_key(struct key_mem_cache *entry)
+{
+	UINT32 i;
+
+	for (i = 0; i < num_pinned_keys; i++) {
+		if (pinned_keys[i] == entry->tcs_handle)
+			return;
+	}
+
+	if (num_pinned_keys == TSS_MAX_PINNED_KEYS) {
+		LogError("Too many keys referenced by one command, not pinning 0x%x",
+			 entry->tcs_handle);
+		return;
+	}
+
+	pinned_keys[num_pinned_keys++] = entry->tcs_handle;
+	entry->pin_cnt++;
+}
+
+/* caller must lock the mem cache before calling! */
+void
+mc_pin_key_by_handle(TCS_KEY_HANDLE tcs_handle)
+{
+	struct key_mem_cache *tmp;
+
+	if ((tmp = mc_find_by_handle(tcs_handle)))
+		mc_pin_key(tmp);
+}
+
+/* drop the pins taken by this thread, called once per TCSD request by the dispatcher */
+void
+key_mgr_unpin_all()
+{
+	struct key_mem_cache *tmp;
+	UINT32 i;
+
+	if (num_pinned_keys == 0)
+		return;
+
+	MUTEX_LOCK(mem_cache_lock);
+
+	for (i = 0; i < num_pinned_keys; i++) {
+		if ((tmp = mc_find_by_handle(pinned_keys[i])))
+			tmp->pin_cnt--;
+	}
+	num_pinned_keys = 0;
+
+	MUTEX_UNLOCK(mem_cache_lock);
+}
+
 TCS_KEY_HANDLE
 getNextTcsKeyHandle()
 {
@@ -83,16 +403,9 @@ mc_get_pub_by_slot(TCPA_KEY_HANDLE tpm_handle)
 	struct key_mem_cache *tmp;
 	TCPA_STORE_PUBKEY *ret;
 
-	if (tpm_handle == NULL_TPM_HANDLE)
-		return NULL;
-
-	for (tmp = key_mem_cache_head; tmp; tmp = tmp->next) {
-		LogDebugFn("TCSD mem_cached handle: 0x%x",
-			   tmp->tcs_handle);
-		if (tmp->tpm_handle == tpm_handle) {
-			ret = tmp->blob ? &tmp->blob->pubKey : NULL;
-			return ret;
-		}
+	if ((tmp = mc_find_by_slot(tpm_handle))) {
+		ret = tmp->blob ? &tmp->blob->pubKey : NULL;
+		return ret;
 	}
 	LogDebugFn("returning NULL TCPA_STORE_PUBKEY");
 	return NULL;
@@ -107,13 +420,9 @@ mc_get_pub_by_handle(TCS_KEY_HANDLE tcs_handle)
 
 	LogDebugFn("looking for 0x%x", tcs_handle);
 
-	for (tmp = key_mem_cache_head; tmp; tmp = tmp->next) {
-		LogDebugFn("TCSD mem_cached handle: 0x%x",
-			 tmp->tcs_handle);
-		if (tmp->tcs_handle == tcs_handle) {
-			ret = tmp->blob ? &tmp->blob->pubKey : NULL;
-			return ret;
-		}
+	if ((tmp = mc_find_by_handle(tcs_handle))) {
+		ret = tmp->blob ? &tmp->blob->pubKey : NULL;
+		return ret;
 	}
 
 	LogDebugFn("returning NULL TCPA_STORE_PUBKEY");
@@ -127,27 +436,15 @@ mc_set_parent_by_handle(TCS_KEY_HANDLE tcs_handle, TCS_KEY_HANDLE p_tcs_handle)
 	struct key_mem_cache *tmp, *parent;
 
 	/* find parent */
-	for (tmp = key_mem_cache_head; tmp; tmp = tmp->next) {
-		LogDebug("TCSD mem_cached handle: 0x%x", tmp->tcs_handle);
-		if (tmp->tcs_handle == p_tcs_handle) {
-			parent = tmp;
-			break;
-		}
-	}
-
-	/* didn't find parent */
-	if (tmp == NULL)
-		goto done;
+	if ((parent = mc_find_by_handle(p_tcs_handle)) == NULL)
+		return TCSERR(TSS_E_FAIL);
 
 	/* set parent blob in child */
-	for (tmp = key_mem_cache_head; tmp; tmp = tmp->next) {
-		if (tmp->tcs_handle == tcs_handle) {
-			tmp->parent = parent;
-			return TSS_SUCCESS;
-		}
-	}
-done:
-	return TCSERR(TSS_E_FAIL);
+	if ((tmp = mc_find_by_handle(tcs_handle)) == NULL)
+		return TCSERR(TSS_E_FAIL);
+
+	tmp->parent = parent;
+	return TSS_SUCCESS;
 }
 
 TCPA_RESULT
@@ -186,6 +483,7 @@ ensureKeyIsLoaded(TCS_CONTEXT_HANDLE hContext, TCS_KEY_HANDLE keyHandle, TCPA_KE
 		}
 	}
 	mc_update_time_stamp(*keySlot);
+	mc_pin_key_by_handle(keyHandle);
 
 done:
 	MUTEX_UNLOCK(mem_cache_lock);
@@ -198,18 +496,10 @@ done:
 TSS_UUID *
 mc_get_uuid_by_pub(TCPA_STORE_PUBKEY *pub)
 {
-	TSS_UUID *ret;
 	struct key_mem_cache *tmp;
 
-	for (tmp = key_mem_cache_head; tmp; tmp = tmp->next) {
-		LogDebugFn("TCSD mem_cached handle: 0x%x", tmp->tcs_handle);
-		if (tmp->blob &&
-		    tmp->blob->pubKey.keyLength == pub->keyLength &&
-		    !memcmp(tmp->blob->pubKey.key, pub->key, pub->keyLength)) {
-			ret = &tmp->uuid;
-			return ret;
-		}
-	}
+	if ((tmp = mc_find_by_pub(pub)))
+		return &tmp->uuid;
 
 	return NULL;
 }
@@ -219,15 +509,26 @@ mc_get_handles_by_uuid(TSS_UUID *uuid, TCS_KEY_HANDLE *tcsHandle, TCPA_KEY_HANDL
 {
 	struct key_mem_cache *tmp;
 
-	for (tmp = key_mem_cache_head; tmp; tmp = tmp->next) {
-		if (!memcmp(&tmp->uuid, uuid, sizeof(TSS_UUID))) {
-			*tcsHandle = tmp->tcs_handle;
-			*slot = tmp->tpm_handle;
-			return TSS_SUCCESS;
-		}
+	if ((tmp = mc_get_entry_by_uuid(uuid)) == NULL)
+		return TCSERR(TSS_E_FAIL);
+
+	*tcsHandle = tmp->tcs_handle;
+	*slot = tmp->tpm_handle;
+	return TSS_SUCCESS;
+}
+
+/* caller must lock the mem cache before calling! Unregistered keys are never found */
+struct key_mem_cache *
+mc_get_entry_by_uuid(TSS_UUID *uuid)
+{
+	struct key_mem_cache *tmp;
+
+	for (tmp = *MC_UUID_BUCKET(uuid); tmp; tmp = tmp->uuid_hnext) {
+		if (!memcmp(&tmp->uuid, uuid, sizeof(TSS_UUID)))
+			return tmp;
 	}
 
-	return TCSERR(TSS_E_FAIL);
+	return NULL;
 }
 
 TCS_KEY_HANDLE
@@ -293,15 +594,11 @@ mc_add_entry(TCS_KEY_HANDLE tcs_handle,
 	     TCPA_KEY_HANDLE tpm_handle,
 	     TSS_KEY *key_blob)
 {
-	struct key_mem_cache *entry, *tmp;
+	struct key_mem_cache *entry;
 
 	/* Make sure the cache doesn't already have an entry for this key */
-	for (tmp = key_mem_cache_head; tmp; tmp = tmp->next) {
-		LogDebugFn("TCSD mem_cached handle: 0x%x", tmp->tcs_handle);
-		if (tcs_handle == tmp->tcs_handle) {
-			return TSS_SUCCESS;
-		}
-	}
+	if (mc_find_by_handle(tcs_handle))
+		return TSS_SUCCESS;
 
 	/* Not found - we need to create a new entry */
 	entry = (struct key_mem_cache *)calloc(1, sizeof(struct key_mem_cache));
@@ -387,22 +684,19 @@ mc_add_entry(TCS_KEY_HANDLE tcs_handle,
 	}
 	entry->blob->encSize = key_blob->encSize;
 add:
-	/* add to the front of the list */
-	entry->next = key_mem_cache_head;
 	if (key_mem_cache_head) {
 		/* set the reference count to 0 initially for all keys not being the SRK. Up
 		 * the call chain, a reference to this mem cache entry will be set in the
 		 * context object of the calling context and this reference count will be
 		 * incremented there. */
 		entry->ref_cnt = 0;
-
-		key_mem_cache_head->prev = entry;
 	} else {
 		/* if we are the SRK, initially set the reference count to 1, so that it is
 		 * always seen as loaded in the TPM. */
 		entry->ref_cnt = 1;
 	}
-	key_mem_cache_head = entry;
+	/* add to the front of the list and to the indexes */
+	mc_link_entry(entry);
 
 	return TSS_SUCCESS;
 }
@@ -413,27 +707,12 @@ mc_remove_entry(TCS_KEY_HANDLE tcs_handle)
 {
 	struct key_mem_cache *cur;
 
-	for (cur = key_mem_cache_head; cur; cur = cur->next) {
-		if (cur->tcs_handle == tcs_handle) {
-			if (cur->blob) {
-				destroy_key_refs(cur->blob);
-				free(cur->blob);
-			}
-
-			if (cur->prev != NULL)
-				cur->prev->next = cur->next;
-			if (cur->next != NULL)
-				cur->next->prev = cur->prev;
+	if ((cur = mc_find_by_handle(tcs_handle)) == NULL)
+		return TCSERR(TSS_E_FAIL);
 
-			if (cur == key_mem_cache_head)
-				key_mem_cache_head = cur->next;
-			free(cur);
+	mc_free_entry(cur);
 
-			return TSS_SUCCESS;
-		}
-	}
-
-	return TCSERR(TSS_E_FAIL);
+	return TSS_SUCCESS;
 }
 
 TSS_RESULT
@@ -442,15 +721,12 @@ mc_add_entry_init(TCS_KEY_HANDLE tcs_handle,
 		  TSS_KEY *key_blob,
 		  TSS_UUID *uuid)
 {
-	struct key_mem_cache *entry, *tmp;
+	struct key_mem_cache *entry;
 
 	/* Make sure the cache doesn't already have an entry for this key */
 	MUTEX_LOCK(mem_cache_lock);
-	for (tmp = key_mem_cache_head; tmp; tmp = tmp->next) {
-		if (tcs_handle == tmp->tcs_handle) {
-			mc_remove_entry(tcs_handle);
-		}
-	}
+	while (mc_remove_entry(tcs_handle) == TSS_SUCCESS)
+		;
 	MUTEX_UNLOCK(mem_cache_lock);
 
 	/* Not found - we need to create a new entry */
@@ -521,12 +797,8 @@ mc_add_entry_init(TCS_KEY_HANDLE tcs_handle,
 
 	MUTEX_LOCK(mem_cache_lock);
 
-	entry->next = key_mem_cache_head;
-	if (key_mem_cache_head)
-		key_mem_cache_head->prev = entry;
-
 	entry->ref_cnt = 1;
-	key_mem_cache_head = entry;
+	mc_link_entry(entry);
 	MUTEX_UNLOCK(mem_cache_lock);
 
 	return TSS_SUCCESS;
@@ -538,21 +810,13 @@ mc_set_slot_by_slot(TCPA_KEY_HANDLE old_handle, TCPA_KEY_HANDLE new_handle)
 {
 	struct key_mem_cache *tmp;
 
-	for (tmp = key_mem_cache_head; tmp; tmp = tmp->next) {
-		if (tmp->tpm_handle == old_handle) {
-			LogDebugFn("Set TCS key 0x%x, old TPM handle: 0x%x "
-				   "new TPM handle: 0x%x", tmp->tcs_handle,
-				   old_handle, new_handle);
-			if (new_handle == NULL_TPM_HANDLE)
-				tmp->time_stamp = 0;
-			else
-				tmp->time_stamp = getNextTimeStamp();
-			tmp->tpm_handle = new_handle;
-			return TSS_SUCCESS;
-		}
-	}
+	if ((tmp = mc_find_by_slot(old_handle)) == NULL)
+		return TCSERR(TSS_E_FAIL);
 
-	return TCSERR(TSS_E_FAIL);
+	LogDebugFn("Set TCS key 0x%x, old TPM handle: 0x%x new TPM handle: 0x%x",
+		   tmp->tcs_handle, old_handle, new_handle);
+	mc_set_tpm_handle(tmp, new_handle);
+	return TSS_SUCCESS;
 }
 
 /* only called from load key paths, so no locking */
@@ -561,19 +825,11 @@ mc_set_slot_by_handle(TCS_KEY_HANDLE tcs_handle, TCPA_KEY_HANDLE tpm_handle)
 {
 	struct key_mem_cache *tmp;
 
-	for (tmp = key_mem_cache_head; tmp; tmp = tmp->next) {
-		LogDebug("TCSD mem_cached handle: 0x%x", tmp->tcs_handle);
-		if (tmp->tcs_handle == tcs_handle) {
-			if (tpm_handle == NULL_TPM_HANDLE)
-				tmp->time_stamp = 0;
-			else
-				tmp->time_stamp = getNextTimeStamp();
-			tmp->tpm_handle = tpm_handle;
-			return TSS_SUCCESS;
-		}
-	}
+	if ((tmp = mc_find_by_handle(tcs_handle)) == NULL)
+		return TCSERR(TSS_E_FAIL);
 
-	return TCSERR(TSS_E_FAIL);
+	mc_set_tpm_handle(tmp, tpm_handle);
+	return TSS_SUCCESS;
 }
 
 /* the beginnings of a key manager start here ;-) */
@@ -625,22 +881,23 @@ key_mgr_load_by_blob(TCS_CONTEXT_HANDLE hContext, TCS_KEY_HANDLE hUnwrappingKey,
 	return result;
 }
 
-/* create a reference to one key. This is called from the key_mgr_load_*
- * functions only, so no locking is done.
+/* create a reference to one key. This is called by the context routines, so
+ * locking is necessary.
  */
 TSS_RESULT
 key_mgr_inc_ref_count(TCS_KEY_HANDLE key_handle)
 {
 	struct key_mem_cache *cur;
 
-	for (cur = key_mem_cache_head; cur; cur = cur->next) {
-		LogDebugFn("TCSD mem_cached handle: 0x%x", cur->tcs_handle);
-		if (cur->tcs_handle == key_handle) {
-			cur->ref_cnt++;
-			return TSS_SUCCESS;
-		}
+	MUTEX_LOCK(mem_cache_lock);
+
+	if ((cur = mc_find_by_handle(key_handle))) {
+		cur->ref_cnt++;
+		MUTEX_UNLOCK(mem_cache_lock);
+		return TSS_SUCCESS;
 	}
 
+	MUTEX_UNLOCK(mem_cache_lock);
 	return TCSERR(TSS_E_FAIL);
 }
 
@@ -654,14 +911,11 @@ key_mgr_dec_ref_count(TCS_KEY_HANDLE key_handle)
 
 	MUTEX_LOCK(mem_cache_lock);
 
-	for (cur = key_mem_cache_head; cur; cur = cur->next) {
-		if (cur->tcs_handle == key_handle) {
-			cur->ref_cnt--;
-			LogDebugFn("decrementing ref cnt for key 0x%x",
-				   key_handle);
-			MUTEX_UNLOCK(mem_cache_lock);
-			return TSS_SUCCESS;
-		}
+	if ((cur = mc_find_by_handle(key_handle))) {
+		cur->ref_cnt--;
+		LogDebugFn("decrementing ref cnt for key 0x%x", key_handle);
+		MUTEX_UNLOCK(mem_cache_lock);
+		return TSS_SUCCESS;
 	}
 
 	MUTEX_UNLOCK(mem_cache_lock);
@@ -677,26 +931,17 @@ key_mgr_ref_count()
 	MUTEX_LOCK(mem_cache_lock);
 
 	for (cur = key_mem_cache_head; cur;) {
-		if (cur->ref_cnt == 0) {
+		/* a pinned key is still in use by another thread's command; it will be freed
+		 * by the next pass after that command completes */
+		if (cur->ref_cnt == 0 && cur->pin_cnt == 0) {
 			if (cur->tpm_handle != NULL_TPM_HANDLE) {
 				LogDebugFn("Key 0x%x being freed from TPM", cur->tpm_handle);
 				internal_EvictByKeySlot(cur->tpm_handle);
 			}
 			LogDebugFn("Key 0x%x being freed", cur->tcs_handle);
-			if (cur->blob) {
-				destroy_key_refs(cur->blob);
-				free(cur->blob);
-			}
-			if (cur->prev != NULL)
-				cur->prev->next = cur->next;
-			if (cur->next != NULL)
-				cur->next->prev = cur->prev;
-
 			tmp = cur;
-			if (cur == key_mem_cache_head)
-				key_mem_cache_head = cur->next;
 			cur = cur->next;
-			free(tmp);
+			mc_free_entry(tmp);
 		} else {
 			cur = cur->next;
 		}
@@ -710,15 +955,9 @@ TCPA_KEY_HANDLE
 mc_get_slot_by_handle(TCS_KEY_HANDLE tcs_handle)
 {
 	struct key_mem_cache *tmp;
-	TCS_KEY_HANDLE ret;
 
-	for (tmp = key_mem_cache_head; tmp; tmp = tmp->next) {
-		LogDebugFn("TCSD mem_cached handle: 0x%x", tmp->tcs_handle);
-		if (tmp->tcs_handle == tcs_handle) {
-			ret = tmp->tpm_handle;
-			return ret;
-		}
-	}
+	if ((tmp = mc_find_by_handle(tcs_handle)))
+		return tmp->tpm_handle;
 
 	LogDebugFn("returning NULL_TPM_HANDLE");
 	return NULL_TPM_HANDLE;
@@ -733,13 +972,14 @@ mc_get_slot_by_handle_lock(TCS_KEY_HANDLE tcs_handle)
 
 	MUTEX_LOCK(mem_cache_lock);
 
-	for (tmp = key_mem_cache_head; tmp; tmp = tmp->next) {
-		LogDebugFn("TCSD mem_cached handle: 0x%x", tmp->tcs_handle);
-		if (tmp->tcs_handle == tcs_handle) {
-			ret = tmp->tpm_handle;
-			MUTEX_UNLOCK(mem_cache_lock);
-			return ret;
+	if ((tmp = mc_find_by_handle(tcs_handle))) {
+		ret = tmp->tpm_handle;
+		if (ret != NULL_TPM_HANDLE) {
+			mc_pin_key(tmp);
+			mc_lru_touch(tmp);
 		}
+		MUTEX_UNLOCK(mem_cache_lock);
+		return ret;
 	}
 
 	MUTEX_UNLOCK(mem_cache_lock);
@@ -752,16 +992,9 @@ TCPA_KEY_HANDLE
 mc_get_slot_by_pub(TCPA_STORE_PUBKEY *pub)
 {
 	struct key_mem_cache *tmp;
-	TCPA_KEY_HANDLE ret;
 
-	for (tmp = key_mem_cache_head; tmp; tmp = tmp->next) {
-		LogDebugFn("TCSD mem_cached handle: 0x%x", tmp->tcs_handle);
-		if (tmp->blob &&
-		    !memcmp(tmp->blob->pubKey.key, pub->key, pub->keyLength)) {
-			ret = tmp->tpm_handle;
-			return ret;
-		}
-	}
+	if ((tmp = mc_find_by_pub(pub)))
+		return tmp->tpm_handle;
 
 	LogDebugFn("returning NULL_TPM_HANDLE");
 	return NULL_TPM_HANDLE;
@@ -775,12 +1008,11 @@ TCS_KEY_HANDLE
 mc_get_handle_by_pub(TCPA_STORE_PUBKEY *pub, TCS_KEY_HANDLE parent)
 {
 	struct key_mem_cache *tmp;
+	UINT32 digest = mc_hash_bytes(pub->key, pub->keyLength);
 
-	for (tmp = key_mem_cache_head; tmp; tmp = tmp->next) {
+	for (tmp = *MC_PUB_BUCKET(digest); tmp; tmp = tmp->pub_hnext) {
 		LogDebugFn("TCSD mem_cached handle: 0x%x", tmp->tcs_handle);
-		if (tmp->blob &&
-		    pub->keyLength == tmp->blob->pubKey.keyLength &&
-		    !memcmp(tmp->blob->pubKey.key, pub->key, pub->keyLength)) {
+		if (mc_pub_matches(tmp, pub, digest)) {
 			if (parent) {
 				if (!tmp->parent)
 					continue;
@@ -801,15 +1033,15 @@ mc_get_parent_pub_by_pub(TCPA_STORE_PUBKEY *pub)
 {
 	struct key_mem_cache *tmp;
 	TCPA_STORE_PUBKEY *ret = NULL;
+	UINT32 digest = mc_hash_bytes(pub->key, pub->keyLength);
 
-	for (tmp = key_mem_cache_head; tmp; tmp = tmp->next) {
+	for (tmp = *MC_PUB_BUCKET(digest); tmp; tmp = tmp->pub_hnext) {
 		LogDebugFn("TCSD mem_cached handle: 0x%x", tmp->tcs_handle);
 		if (tmp->tcs_handle == TPM_KEYHND_SRK) {
 			LogDebugFn("skipping the SRK");
 			continue;
 		}
-		if (tmp->blob &&
-		    !memcmp(tmp->blob->pubKey.key, pub->key, pub->keyLength)) {
+		if (mc_pub_matches(tmp, pub, digest)) {
 			if (tmp->parent && tmp->parent->blob) {
 				ret = &tmp->parent->blob->pubKey;
 				LogDebugFn("Success");
@@ -831,13 +1063,9 @@ mc_get_blob_by_pub(TCPA_STORE_PUBKEY *pub, TSS_KEY **ret_key)
 {
 	struct key_mem_cache *tmp;
 
-	for (tmp = key_mem_cache_head; tmp; tmp = tmp->next) {
-		LogDebugFn("TCSD mem_cached handle: 0x%x", tmp->tcs_handle);
-		if (tmp->blob &&
-		    !memcmp(tmp->blob->pubKey.key, pub->key, pub->keyLength)) {
-			*ret_key = tmp->blob;
-			return TSS_SUCCESS;
-		}
+	if ((tmp = mc_find_by_pub(pub))) {
+		*ret_key = tmp->blob;
+		return TSS_SUCCESS;
 	}
 
 	LogDebugFn("returning TSS_E_FAIL");
@@ -849,15 +1077,9 @@ TCS_KEY_HANDLE
 mc_get_handle_by_slot(TCPA_KEY_HANDLE tpm_handle)
 {
 	struct key_mem_cache *tmp;
-	TCS_KEY_HANDLE ret;
 
-	for (tmp = key_mem_cache_head; tmp; tmp = tmp->next) {
-		LogDebugFn("TCSD mem_cached handle: 0x%x", tmp->tcs_handle);
-		if (tmp->tpm_handle == tpm_handle) {
-			ret = tmp->tcs_handle;
-			return ret;
-		}
-	}
+	if ((tmp = mc_find_by_slot(tpm_handle)))
+		return tmp->tcs_handle;
 
 	return NULL_TCS_HANDLE;
 }
@@ -868,55 +1090,175 @@ mc_update_time_stamp(TCPA_KEY_HANDLE tpm_handle)
 {
 	struct key_mem_cache *tmp;
 
-	for (tmp = key_mem_cache_head; tmp; tmp = tmp->next) {
-		LogDebugFn("TCSD mem_cached handle: 0x%x", tmp->tcs_handle);
-		if (tmp->tpm_handle == tpm_handle) {
-			tmp->time_stamp = getNextTimeStamp();
-			return TSS_SUCCESS;
+	if ((tmp = mc_find_by_slot(tpm_handle)) == NULL)
+		return TCSERR(TSS_E_FAIL);
+
+	mc_lru_touch(tmp);
+	return TSS_SUCCESS;
+}
+
+/*
+ * Take the key out of its TPM slot. If the TPM supports TPM_SaveKeyContext, a context of the
+ * key is saved first, so that key_mgr_swap_in() can put it back without unwrapping its blob
+ * under the parent again. caller must lock the mem cache before calling!
+ */
+static TSS_RESULT
+mc_swap_out(struct key_mem_cache *entry)
+{
+	TCPA_KEY_HANDLE slot = entry->tpm_handle;
+	TSS_RESULT result;
+
+	if (tpm_metrics.keyctx_swap && entry->swap == NULL) {
+		if ((result = TPM_SaveKeyContext(slot, &entry->swap_size, &entry->swap))) {
+			LogDebugFn("TPM_SaveKeyContext failed: 0x%x, key will be reloaded by blob",
+				   result);
+			entry->swap_size = 0;
 		}
 	}
 
-	return TCSERR(TSS_E_FAIL);
+	if ((result = internal_EvictByKeySlot(slot))) {
+		free(entry->swap);
+		entry->swap = NULL;
+		entry->swap_size = 0;
+		return result;
+	}
+
+	LogDebugFn("%s key w/ TPM handle 0x%x", entry->swap ? "Swapped out" : "Evicted", slot);
+	mc_set_tpm_handle(entry, NULL_TPM_HANDLE);
+
+	return TSS_SUCCESS;
 }
 
-/* Right now this evicts the LRU key assuming it's not the parent */
+/* Evicts the least recently used key that isn't the parent or in use by another command */
 TSS_RESULT
 evictFirstKey(TCS_KEY_HANDLE parent_tcs_handle)
 {
 	struct key_mem_cache *tmp;
-	TCS_KEY_HANDLE tpm_handle_to_evict = NULL_TPM_HANDLE;
-	UINT32 smallestTimeStamp = ~(0U);	/* largest */
 	TSS_RESULT result;
 	UINT32 count;
 
+	MUTEX_LOCK(mem_cache_lock);
+
 	/* First, see if there are any known keys worth evicting */
 	if ((result = clearUnknownKeys(InternalContext, &count)))
-		return result;
+		goto done;
 
 	if (count > 0) {
 		LogDebugFn("Evicted %u unknown keys", count);
-		return TSS_SUCCESS;
+		goto done;
 	}
 
-	for (tmp = key_mem_cache_head; tmp; tmp = tmp->next) {
-		if (tmp->tpm_handle != NULL_TPM_HANDLE &&	/* not already evicted */
-		    tmp->tpm_handle != SRK_TPM_HANDLE &&	/* not the srk */
-		    tmp->tcs_handle != parent_tcs_handle &&	/* not my parent */
-		    tmp->time_stamp < smallestTimeStamp) {	/* is the smallest time
-								   stamp so far */
-			tpm_handle_to_evict = tmp->tpm_handle;
-			smallestTimeStamp = tmp->time_stamp;
+	for (tmp = lru_head; tmp; tmp = tmp->lru_next) {
+		if (tmp->tcs_handle != parent_tcs_handle &&	/* not my parent */
+		    tmp->pin_cnt == 0)				/* not in use */
+			break;
+	}
+
+	if (tmp != NULL)
+		result = mc_swap_out(tmp);
+done:
+	MUTEX_UNLOCK(mem_cache_lock);
+	return result;
+}
+
+/*
+ * Load the context saved when tcs_handle's key was swapped out back into the TPM. Returns
+ * TSS_E_FAIL if there is no saved context, in which case the caller has to load the key by its
+ * blob. caller must lock the mem cache before calling!
+ */
+TSS_RESULT
+key_mgr_swap_in(TCS_KEY_HANDLE tcs_handle, TCPA_KEY_HANDLE *slot)
+{
+	struct key_mem_cache *entry;
+	TSS_RESULT result;
+
+	if ((entry = mc_find_by_handle(tcs_handle)) == NULL || entry->swap == NULL)
+		return TCSERR(TSS_E_FAIL);
+
+	LogDebugFn("TPM_LoadKeyContext for TCS key 0x%x", tcs_handle);
+	result = TPM_LoadKeyContext(entry->swap_size, entry->swap, slot);
+	if (result == TPM_E_RESOURCES || result == TPM_E_NOSPACE) {
+		if ((result = evictFirstKey(tcs_handle)) == TSS_SUCCESS)
+			result = TPM_LoadKeyContext(entry->swap_size, entry->swap, slot);
+	}
+
+	/* either the key is back in the TPM, or the context can't be loaded (the TPM may have
+	 * been restarted since it was saved), so the blob is of no further use */
+	free(entry->swap);
+	entry->swap = NULL;
+	entry->swap_size = 0;
+
+	if (result) {
+		LogDebugFn("TPM_LoadKeyContext failed: 0x%x", result);
+		return result;
+	}
+
+	mc_set_tpm_handle(entry, *slot);
+
+	return TSS_SUCCESS;
+}
+
+TSS_RESULT
+TPM_SaveKeyContext(TCPA_KEY_HANDLE handle, UINT32 *size, BYTE **blob)
+{
+	UINT64 offset;
+	UINT32 trash, bsize;
+	TSS_RESULT result;
+	BYTE txBlob[TSS_TPM_TXBLOB_SIZE];
+
+	offset = 10;
+	LoadBlob_UINT32(&offset, handle, txBlob);
+	LoadBlob_Header(TPM_TAG_RQU_COMMAND, offset, TPM_ORD_SaveKeyContext, txBlob);
+
+	if ((result = req_mgr_submit_req(txBlob)))
+		return result;
+
+	result = UnloadBlob_Header(txBlob, &trash);
+
+	if (!result) {
+		offset = 10;
+		UnloadBlob_UINT32(&offset, &bsize, txBlob);
+		if (bsize > TSS_TPM_TXBLOB_SIZE - offset) {
+			LogError("TPM returned a %u byte key context", bsize);
+			return TCSERR(TSS_E_INTERNAL_ERROR);
 		}
+
+		*blob = malloc(bsize);
+		if (*blob == NULL) {
+			LogError("malloc of %u bytes failed.", bsize);
+			return TCSERR(TSS_E_OUTOFMEMORY);
+		}
+		UnloadBlob(&offset, bsize, txBlob, *blob);
+		*size = bsize;
 	}
 
-	if (tpm_handle_to_evict != NULL_TCS_HANDLE) {
-		if ((result = internal_EvictByKeySlot(tpm_handle_to_evict)))
-			return result;
+	return result;
+}
 
-		LogDebugFn("Evicted key w/ TPM handle 0x%x", tpm_handle_to_evict);
-		result = mc_set_slot_by_slot(tpm_handle_to_evict, NULL_TPM_HANDLE);
-	} else
-		return TSS_SUCCESS;
+TSS_RESULT
+TPM_LoadKeyContext(UINT32 size, BYTE *blob, TCPA_KEY_HANDLE *handle)
+{
+	UINT64 offset;
+	UINT32 trash;
+	TSS_RESULT result;
+	BYTE txBlob[TSS_TPM_TXBLOB_SIZE];
+
+	LogDebugFn("Loading %u byte key context back into TPM", size);
+
+	offset = 10;
+	LoadBlob_UINT32(&offset, size, txBlob);
+	LoadBlob(&offset, size, txBlob, blob);
+	LoadBlob_Header(TPM_TAG_RQU_COMMAND, offset, TPM_ORD_LoadKeyContext, txBlob);
+
+	if ((result = req_mgr_submit_req(txBlob)))
+		return result;
+
+	result = UnloadBlob_Header(txBlob, &trash);
+
+	if (!result) {
+		offset = 10;
+		UnloadBlob_UINT32(&offset, handle, txBlob);
+	}
 
 	return result;
 }
@@ -930,11 +1272,20 @@ isKeyLoaded(TCPA_KEY_HANDLE keySlot)
 	UINT32 respSize;
 	BYTE *resp;
 	TSS_RESULT result;
+	TSS_BOOL loaded;
 
 	if (keySlot == SRK_TPM_HANDLE) {
 		return TRUE;
 	}
 
+	/* the request manager follows every key load and evict, so the TPM only has to be
+	 * asked when that record has been invalidated */
+	if (req_mgr_key_slot_is_loaded(keySlot, &loaded) == TSS_SUCCESS) {
+		if (loaded)
+			return TRUE;
+		goto not_loaded;
+	}
+
 	if ((result = TCSP_GetCapability_Internal(InternalContext, TCPA_CAP_KEY_HANDLE, 0, NULL,
 						  &respSize, &resp)))
 		goto not_loaded;
@@ -972,6 +1323,7 @@ LoadKeyShim(TCS_CONTEXT_HANDLE hContext, TCPA_STORE_PUBKEY *pubKey,
 	TSS_KEY *myKey;
 	UINT64 offset;
 	TCS_KEY_HANDLE parentHandle;
+	struct key_mem_cache *entry;
 	BYTE keyBlob[1024];
 
 	LogDebugFn("calling mc_get_slot_by_pub");
@@ -983,6 +1335,11 @@ LoadKeyShim(TCS_CONTEXT_HANDLE hContext, TCPA_STORE_PUBKEY *pubKey,
 		return TSS_SUCCESS;
 	}
 
+	/* If I was swapped out, loading my saved context is much cheaper than unwrapping me */
+	if ((entry = mc_find_by_pub(pubKey)) &&
+	    key_mgr_swap_in(entry->tcs_handle, slotOut) == TSS_SUCCESS)
+		return TSS_SUCCESS;
+
 	/*
 	 * Before proceeding, the parent must be loaded.
 	 * If the parent is registered, then it can be loaded by UUID.
@@ -1163,14 +1520,14 @@ mc_set_uuid(TCS_KEY_HANDLE tcs_handle, TSS_UUID *uuid)
 
 	LogDebugFn("looking for 0x%x", tcs_handle);
 
-	for (tmp = key_mem_cache_head; tmp; tmp = tmp->next) {
-		LogDebugFn("TCSD mem_cached handle: 0x%x", tmp->tcs_handle);
-		if (tmp->tcs_handle == tcs_handle) {
-			LogDebugFn("Handle found, re-setting UUID");
-			memcpy(&tmp->uuid, uuid, sizeof(TSS_UUID));
-			result = TSS_SUCCESS;
-			break;
-		}
+	if ((tmp = mc_find_by_handle(tcs_handle))) {
+		LogDebugFn("Handle found, re-setting UUID");
+		if (!mc_uuid_is_null(&tmp->uuid))
+			MC_HASH_UNLINK(MC_UUID_BUCKET(&tmp->uuid), tmp, uuid_hnext);
+		memcpy(&tmp->uuid, uuid, sizeof(TSS_UUID));
+		if (!mc_uuid_is_null(&tmp->uuid))
+			MC_HASH_LINK(MC_UUID_BUCKET(&tmp->uuid), tmp, uuid_hnext);
+		result = TSS_SUCCESS;
 	}
 	MUTEX_UNLOCK(mem_cache_lock);
 
@@ -33,21 +33,15 @@ ps_init_disk_cache(void)
 	int fd;
 	TSS_RESULT rc;
 
-	MUTEX_INIT(disk_cache_lock);
+	MUTEX_INIT_RECURSIVE(disk_cache_lock);
 
 	if ((fd = get_file()) < 0)
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 
-	if ((rc = init_disk_cache(fd)))
-		return rc;
-
-	/* this is temporary, to clear out a PS file from trousers
-	 * versions before 0.2.1 */
-	if ((rc = clean_disk_cache(fd)))
-		return rc;
+	rc = init_disk_cache(fd);
 
 	put_file(fd);
-	return TSS_SUCCESS;
+	return rc;
 }
 
 void
@@ -98,13 +92,10 @@ getParentUUIDByUUID(TSS_UUID *uuid, TSS_UUID *ret_uuid)
 	/* check the registered key disk cache */
 	MUTEX_LOCK(disk_cache_lock);
 
-	for (disk_tmp = key_disk_cache_head; disk_tmp; disk_tmp = disk_tmp->next) {
-		if ((disk_tmp->flags & CACHE_FLAG_VALID) &&
-		    !memcmp(&disk_tmp->uuid, uuid, sizeof(TSS_UUID))) {
-			memcpy(ret_uuid, &disk_tmp->parent_uuid, sizeof(TSS_UUID));
-			MUTEX_UNLOCK(disk_cache_lock);
-			return TSS_SUCCESS;
-		}
+	if ((disk_tmp = disk_cache_find_by_uuid(uuid))) {
+		memcpy(ret_uuid, &disk_tmp->parent_uuid, sizeof(TSS_UUID));
+		MUTEX_UNLOCK(disk_cache_lock);
+		return TSS_SUCCESS;
 	}
 	MUTEX_UNLOCK(disk_cache_lock);
 
@@ -114,135 +105,41 @@ getParentUUIDByUUID(TSS_UUID *uuid, TSS_UUID *ret_uuid)
 TSS_RESULT
 isUUIDRegistered(TSS_UUID *uuid, TSS_BOOL *is_reg)
 {
-	struct key_disk_cache *disk_tmp;
-
 	/* check the registered key disk cache */
 	MUTEX_LOCK(disk_cache_lock);
-
-	for (disk_tmp = key_disk_cache_head; disk_tmp; disk_tmp = disk_tmp->next) {
-		if ((disk_tmp->flags & CACHE_FLAG_VALID) &&
-		    !memcmp(&disk_tmp->uuid, uuid, sizeof(TSS_UUID))) {
-			*is_reg = TRUE;
-			MUTEX_UNLOCK(disk_cache_lock);
-			return TSS_SUCCESS;
-		}
-	}
+	*is_reg = disk_cache_find_by_uuid(uuid) ? TRUE : FALSE;
 	MUTEX_UNLOCK(disk_cache_lock);
-	*is_reg = FALSE;
 
 	return TSS_SUCCESS;
 }
 
-void
-disk_cache_shift(struct key_disk_cache *c)
-{
-	UINT32 key_size, offset;
-	struct key_disk_cache *tmp = key_disk_cache_head;
-
-	/* offset is the end of the key location in the file */
-	offset = TSSPS_VENDOR_DATA_OFFSET(c) + c->vendor_data_size;
-	/* key_size is the size of the key entry on disk */
-	key_size = offset - TSSPS_UUID_OFFSET(c);
-
-	/* for each disk cache entry, if the data for that entry is at an
-	 * offset greater than the key beign removed, then the entry needs to
-	 * be decremented by the size of key's disk footprint (the key_size
-	 * variable) */
-	while (tmp) {
-		if (tmp->offset >= offset) {
-			tmp->offset -= key_size;
-		}
-
-		tmp = tmp->next;
-	}
-}
-
 TSS_RESULT
 ps_remove_key(TSS_UUID *uuid)
 {
-	struct key_disk_cache *tmp, *prev = NULL;
+	struct key_disk_cache *tmp;
 	TSS_RESULT rc;
         int fd = -1;
 
 	MUTEX_LOCK(disk_cache_lock);
-	tmp = key_disk_cache_head;
 
-	for (; tmp; prev = tmp, tmp = tmp->next) {
-		if ((tmp->flags & CACHE_FLAG_VALID) &&
-		    !memcmp(uuid, &tmp->uuid, sizeof(TSS_UUID))) {
-			if ((fd = get_file()) < 0) {
-				rc = TCSERR(TSS_E_INTERNAL_ERROR);
-				break;
-			}
-
-			rc = psfile_remove_key(fd, tmp);
-
-			put_file(fd);
-
-			/* if moving the file contents around succeeded, then
-			 * change the offsets of the keys in the cache in
-			 * mem_cache_shift() and remove the key from the
-			 * cache. */
-			if (!rc) {
-				disk_cache_shift(tmp);
-				if (prev) {
-					prev->next = tmp->next;
-				} else {
-					key_disk_cache_head = tmp->next;
-				}
-				free(tmp);
-			} else {
-				LogError("Error removing registered key.");
-			}
-
-			MUTEX_UNLOCK(disk_cache_lock);
-			return rc;
-		}
+	if ((tmp = disk_cache_find_by_uuid(uuid)) == NULL) {
+		MUTEX_UNLOCK(disk_cache_lock);
+		return TCSERR(TSS_E_PS_KEY_NOTFOUND);
 	}
 
-	MUTEX_UNLOCK(disk_cache_lock);
-
-	return TCSERR(TCSERR(TSS_E_PS_KEY_NOTFOUND));
-}
+	if ((fd = get_file()) < 0) {
+		MUTEX_UNLOCK(disk_cache_lock);
+		return TCSERR(TSS_E_INTERNAL_ERROR);
+	}
 
-/*
- * temporary function to clean out blanked keys from a PS file from
- * trousers 0.2.0 and before
- */
-TSS_RESULT
-clean_disk_cache(int fd)
-{
-	struct key_disk_cache *tmp, *prev = NULL;
-	TSS_RESULT rc;
+	/* on success, tmp has been moved to the free list */
+	if ((rc = psfile_remove_key(fd, tmp)))
+		LogError("Error removing registered key.");
 
-	MUTEX_LOCK(disk_cache_lock);
-	tmp = key_disk_cache_head;
-
-	for (; tmp; prev = tmp, tmp = tmp->next) {
-		if (!(tmp->flags & CACHE_FLAG_VALID)) {
-			rc = psfile_remove_key(fd, tmp);
-
-			/* if moving the file contents around succeeded, then
-			 * change the offsets of the keys in the cache in
-			 * mem_cache_shift() and remove the key from the
-			 * cache. */
-			if (!rc) {
-				disk_cache_shift(tmp);
-				if (prev) {
-					prev->next = tmp->next;
-				}
-				free(tmp);
-			} else {
-				LogError("Error removing blank key.");
-			}
-
-			MUTEX_UNLOCK(disk_cache_lock);
-			return rc;
-		}
-	}
+	put_file(fd);
 
 	MUTEX_UNLOCK(disk_cache_lock);
-	return TSS_SUCCESS;
+	return rc;
 }
 
 TSS_RESULT
@@ -355,8 +252,10 @@ ps_write_key(TSS_UUID *uuid, TSS_UUID *parent_uuid, BYTE *vendor_data,
 	if (!memcmp(parent_uuid, &NULL_UUID, sizeof(TSS_UUID))) {
 		parent_ps = TSS_PS_TYPE_SYSTEM;
 	} else {
-		if ((rc = psfile_get_ps_type_by_uuid(fd, parent_uuid, &parent_ps)))
+		if ((rc = psfile_get_ps_type_by_uuid(fd, parent_uuid, &parent_ps))) {
+			put_file(fd);
 			return rc;
+		}
 	}
 
         rc = psfile_write_key(fd, uuid, parent_uuid, &parent_ps, vendor_data,
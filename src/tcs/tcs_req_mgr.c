@@ -20,25 +20,238 @@
 #include "trousers/tss.h"
 #include "tcs_tsp.h"
 #include "tcs_utils.h"
+#include "tcs_int_literals.h"
 #include "tddl.h"
 #include "req_mgr.h"
+#include "tcsd_wrap.h"
+#include "tcsd.h"
 #include "tcslog.h"
 
 static struct tpm_req_mgr *trm;
 
+/* the class and context of the TCSD command being executed by this thread. Every TPM command
+ * sent on its behalf, including key loads and auth swaps done by the TCS, gets its class */
+static THREAD_LOCAL int cmd_prio = -1;
+static THREAD_LOCAL TCS_CONTEXT_HANDLE cmd_ctx = NULL_TCS_HANDLE;
+
+/*
+ * Shadow of the key handles loaded in the TPM. Every command passes through
+ * req_mgr_transmit() one at a time, so the shadow is kept in step with the TPM by watching
+ * for the commands that load and evict keys. It's rebuilt from any TPM_CAP_KEY_HANDLE reply,
+ * and thrown away whenever its contents can't be known: after a TPM_E_INVALID_KEYHANDLE
+ * error, a failure talking to the device, or a command that may change the loaded keys out
+ * of sight, such as one wrapped in a transport session. key_slots_epoch counts the times the
+ * TPM may have been reset under us, so that callers can tell when what they learned about it
+ * has gone stale. key_slots_lock is a leaf lock.
+ */
+static MUTEX_DECLARE_INIT(key_slots_lock);
+static TCPA_KEY_HANDLE key_slots[TSS_REQ_MGR_MAX_KEY_SLOTS];
+static UINT32 num_key_slots = 0;
+static TSS_BOOL key_slots_valid = FALSE;
+static UINT32 key_slots_epoch = 0;
+
 #ifdef TSS_DEBUG
 #define TSS_TPM_DEBUG
 #endif
 
+/* the class of a TPM command sent outside of any TCSD command */
+static UINT32
+req_mgr_ord_prio(TPM_COMMAND_CODE ord)
+{
+	switch (ord) {
+	case TPM_ORD_Quote:
+	case TPM_ORD_Quote2:
+	case TPM_ORD_Unseal:
+	case TPM_ORD_Sign:
+	case TPM_ORD_PcrRead:
+	case TPM_ORD_Extend:
+		return TSS_REQ_PRIO_HIGH;
+	case TPM_ORD_GetRandom:
+	case TPM_ORD_StirRandom:
+	case TPM_ORD_GetCapability:
+	case TPM_ORD_SelfTestFull:
+	case TPM_ORD_ContinueSelfTest:
+	case TPM_ORD_GetTestResult:
+		return TSS_REQ_PRIO_LOW;
+	default:
+		return TSS_REQ_PRIO_NORMAL;
+	}
+}
+
+/* caller must hold key_slots_lock */
+static void
+key_slots_add(TCPA_KEY_HANDLE handle)
+{
+	UINT32 i;
+
+	for (i = 0; i < num_key_slots; i++) {
+		if (key_slots[i] == handle)
+			return;
+	}
+
+	if (num_key_slots == TSS_REQ_MGR_MAX_KEY_SLOTS) {
+		key_slots_valid = FALSE;
+		return;
+	}
+
+	key_slots[num_key_slots++] = handle;
+}
+
+/* caller must hold key_slots_lock */
+static void
+key_slots_remove(TCPA_KEY_HANDLE handle)
+{
+	UINT32 i;
+
+	for (i = 0; i < num_key_slots; i++) {
+		if (key_slots[i] == handle) {
+			key_slots[i] = key_slots[--num_key_slots];
+			return;
+		}
+	}
+}
+
+/* caller must hold key_slots_lock */
+static void
+key_slots_set(BYTE *rsp)
+{
+	UINT32 i, size;
+	UINT16 loaded;
+
+	size = Decode_UINT32(&rsp[10]);
+	loaded = Decode_UINT16(&rsp[14]);
+	if (size < sizeof(UINT16) + loaded * sizeof(UINT32) ||
+	    loaded > TSS_REQ_MGR_MAX_KEY_SLOTS) {
+		key_slots_valid = FALSE;
+		return;
+	}
+
+	for (i = 0; i < loaded; i++)
+		key_slots[i] = Decode_UINT32(&rsp[16 + i * sizeof(UINT32)]);
+	num_key_slots = loaded;
+	key_slots_valid = TRUE;
+}
+
+/* Update the key slot shadow with the effect of one TPM command. req holds the bytes of the
+ * request that matter here, since the reply is written over the request blob. */
+static void
+key_slots_track(BYTE *req, TSS_RESULT result, BYTE *rsp)
+{
+	TPM_COMMAND_CODE ord = Decode_UINT32(&req[6]);
+	TSS_RESULT rc;
+
+	MUTEX_LOCK(key_slots_lock);
+
+	if (result) {
+		key_slots_valid = FALSE;
+		key_slots_epoch++;
+		goto done;
+	}
+
+	rc = Decode_UINT32(&rsp[6]);
+	if (rc == TPM_E_INVALID_KEYHANDLE) {
+		key_slots_valid = FALSE;
+		goto done;
+	} else if (rc != TPM_SUCCESS) {
+		goto done;
+	}
+
+	switch (ord) {
+	case TPM_ORD_LoadKey:
+	case TPM_ORD_LoadKey2:
+	case TPM_ORD_LoadKeyContext:
+		key_slots_add(Decode_UINT32(&rsp[10]));
+		break;
+	case TPM_ORD_LoadContext:
+		/* the resource type of the TPM_CONTEXT_BLOB that follows the handle, keepHandle
+		 * and contextSize parameters */
+		if (Decode_UINT32(&req[21]) == TPM_RT_KEY)
+			key_slots_add(Decode_UINT32(&rsp[10]));
+		break;
+	case TPM_ORD_EvictKey:
+		key_slots_remove(Decode_UINT32(&req[10]));
+		break;
+	case TPM_ORD_FlushSpecific:
+		if (Decode_UINT32(&req[14]) == TPM_RT_KEY)
+			key_slots_remove(Decode_UINT32(&req[10]));
+		break;
+	case TPM_ORD_GetCapability:
+		if (Decode_UINT32(&req[10]) == TPM_CAP_KEY_HANDLE)
+			key_slots_set(rsp);
+		break;
+	case TPM_ORD_OwnerClear:
+	case TPM_ORD_ForceClear:
+	case TPM_ORD_Startup:
+		key_slots_epoch++;
+		/* fall through */
+	case TPM_ORD_ExecuteTransport:
+	case TPM_ORD_ReleaseTransportSigned:
+		key_slots_valid = FALSE;
+		break;
+	default:
+		break;
+	}
+done:
+	MUTEX_UNLOCK(key_slots_lock);
+}
+
+/* Look handle up in the key slot shadow. Returns TSS_E_FAIL if the shadow isn't valid, in
+ * which case the caller has to ask the TPM for TPM_CAP_KEY_HANDLE, which resyncs it */
 TSS_RESULT
-req_mgr_submit_req(BYTE *blob)
+req_mgr_key_slot_is_loaded(TCPA_KEY_HANDLE handle, TSS_BOOL *loaded)
+{
+	TSS_RESULT result = TCSERR(TSS_E_FAIL);
+	UINT32 i;
+
+	MUTEX_LOCK(key_slots_lock);
+
+	if (key_slots_valid) {
+		*loaded = FALSE;
+		for (i = 0; i < num_key_slots; i++) {
+			if (key_slots[i] == handle) {
+				*loaded = TRUE;
+				break;
+			}
+		}
+		result = TSS_SUCCESS;
+	}
+
+	MUTEX_UNLOCK(key_slots_lock);
+
+	return result;
+}
+
+/* Return the number of keys loaded in the TPM according to the key slot shadow, and the
+ * current epoch. Returns TSS_E_FAIL if the shadow isn't valid. */
+TSS_RESULT
+req_mgr_key_slots_used(UINT32 *used, UINT32 *epoch)
+{
+	TSS_RESULT result = TCSERR(TSS_E_FAIL);
+
+	MUTEX_LOCK(key_slots_lock);
+
+	*epoch = key_slots_epoch;
+	if (key_slots_valid) {
+		*used = num_key_slots;
+		result = TSS_SUCCESS;
+	}
+
+	MUTEX_UNLOCK(key_slots_lock);
+
+	return result;
+}
+
+/* caller must hold trm->queue_lock if the dispatcher may be running */
+static TSS_RESULT
+req_mgr_transmit(BYTE *blob)
 {
 	TSS_RESULT result;
 	BYTE loc_buf[TSS_TPM_TXBLOB_SIZE];
 	UINT32 size = TSS_TPM_TXBLOB_SIZE;
 	UINT32 retry = TSS_REQ_MGR_MAX_RETRIES;
+	BYTE req[TSS_REQ_MGR_TRACK_SIZE];
 
-	MUTEX_LOCK(trm->queue_lock);
+	memcpy(req, blob, sizeof(req));
 
 #ifdef TSS_TPM_DEBUG
 	LogBlobData("To TPM:", Decode_UINT32(&blob[2]), blob);
@@ -51,13 +264,162 @@ req_mgr_submit_req(BYTE *blob)
 	if (!result)
 		memcpy(blob, loc_buf, Decode_UINT32(&loc_buf[2]));
 
+	key_slots_track(req, result, loc_buf);
+
 #ifdef TSS_TPM_DEBUG
 	LogBlobData("From TPM:", size, loc_buf);
 #endif
 
+	return result;
+}
+
+/* caller must hold trm->queue_lock */
+static struct tpm_req *
+req_mgr_dequeue(struct tpm_req_queue *q, struct tpm_req *req)
+{
+	struct tpm_req *prev = NULL, *tmp;
+
+	for (tmp = q->head; tmp != req; prev = tmp, tmp = tmp->next)
+		;
+
+	if (prev)
+		prev->next = req->next;
+	else
+		q->head = req->next;
+	if (q->tail == req)
+		q->tail = prev;
+
+	q->last_ctx = req->context;
+	req->next = NULL;
+
+	return req;
+}
+
+/* Pick the next request to send to the TPM. The highest class that has work goes first. Within
+ * a class, requests are taken in order, except that a context that was just served yields to
+ * any other context waiting in the same class. Caller must hold trm->queue_lock. */
+static struct tpm_req *
+req_mgr_next_req()
+{
+	struct tpm_req_queue *q;
+	struct tpm_req *req;
+	int i;
+
+	/* anything that has been passed over too often goes first */
+	for (i = TSS_REQ_PRIO_NUM - 1; i > TSS_REQ_PRIO_HIGH; i--) {
+		q = &trm->queue[i];
+		if (q->head &&
+		    trm->num_dispatched - q->head->enqueued_at > TSS_REQ_MGR_MAX_BYPASS) {
+			LogDebugFn("Dispatching starved class %d request", i);
+			return req_mgr_dequeue(q, q->head);
+		}
+	}
+
+	for (i = 0; i < TSS_REQ_PRIO_NUM; i++) {
+		q = &trm->queue[i];
+		if (q->head == NULL)
+			continue;
+
+		for (req = q->head; req; req = req->next) {
+			if (req->context != q->last_ctx)
+				return req_mgr_dequeue(q, req);
+		}
+
+		return req_mgr_dequeue(q, q->head);
+	}
+
+	return NULL;
+}
+
+/* The dispatcher thread owns the TPM device. It sends queued requests one at a time and
+ * wakes up each submitter when its reply has been copied back into its blob. */
+static void *
+req_mgr_dispatch(void *v)
+{
+	struct tpm_req *req;
+
+	thread_signal_init();
+
+	MUTEX_LOCK(trm->queue_lock);
+
+	for (;;) {
+		if ((req = req_mgr_next_req()) == NULL) {
+			if (trm->shutdown)
+				break;
+
+			COND_WAIT(&trm->dispatch_cond, &trm->queue_lock);
+			continue;
+		}
+
+		trm->num_dispatched++;
+
+		/* only the dispatcher touches the device, so it can be used unlocked */
+		MUTEX_UNLOCK(trm->queue_lock);
+		req->result = req_mgr_transmit(req->blob);
+		MUTEX_LOCK(trm->queue_lock);
+
+		req->done = 1;
+		COND_SIGNAL(&req->cond);
+	}
+
 	MUTEX_UNLOCK(trm->queue_lock);
 
-	return result;
+	return NULL;
+}
+
+TSS_RESULT
+req_mgr_submit_req(BYTE *blob)
+{
+	struct tpm_req req, **tail;
+	TSS_RESULT result;
+	UINT32 prio;
+
+	MUTEX_LOCK(trm->queue_lock);
+
+	/* before the dispatcher is started, the TCSD is single threaded */
+	if (!trm->running) {
+		result = req_mgr_transmit(blob);
+		MUTEX_UNLOCK(trm->queue_lock);
+		return result;
+	}
+
+	prio = (cmd_prio >= 0) ? (UINT32)cmd_prio : req_mgr_ord_prio(Decode_UINT32(&blob[6]));
+
+	memset(&req, 0, sizeof(struct tpm_req));
+	req.blob = blob;
+	req.context = cmd_ctx;
+	req.enqueued_at = trm->num_dispatched;
+	COND_INIT(req.cond);
+
+	tail = trm->queue[prio].tail ? &trm->queue[prio].tail->next : &trm->queue[prio].head;
+	*tail = &req;
+	trm->queue[prio].tail = &req;
+
+	COND_SIGNAL(&trm->dispatch_cond);
+
+	while (!req.done)
+		COND_WAIT(&req.cond, &trm->queue_lock);
+
+	MUTEX_UNLOCK(trm->queue_lock);
+
+	COND_DESTROY(req.cond);
+
+	return req.result;
+}
+
+/* called by the TCSD dispatcher around the execution of each TCSD command */
+void
+req_mgr_cmd_begin(TCS_CONTEXT_HANDLE hContext, UINT32 prio)
+{
+	cmd_ctx = hContext;
+	cmd_prio = (int)prio;
+}
+
+void
+req_mgr_cmd_end()
+{
+	cmd_ctx = NULL_TCS_HANDLE;
+	cmd_prio = -1;
 }
 
 TSS_RESULT
@@ -69,13 +431,45 @@ req_mgr_init()
 	}
 
 	MUTEX_INIT(trm->queue_lock);
+	COND_INIT(trm->dispatch_cond);
 
 	return Tddli_Open();
 }
 
+/* start the dispatcher thread. This must be done after the TCSD has daemonized */
+TSS_RESULT
+req_mgr_start()
+{
+	int rc;
+
+	if ((rc = THREAD_CREATE(&trm->dispatcher, NULL, req_mgr_dispatch, NULL))) {
+		LogError("Thread create failed: %d", rc);
+		return TCSERR(TSS_E_INTERNAL_ERROR);
+	}
+
+	MUTEX_LOCK(trm->queue_lock);
+	trm->running = 1;
+	MUTEX_UNLOCK(trm->queue_lock);
+
+	return TSS_SUCCESS;
+}
+
 TSS_RESULT
 req_mgr_final()
 {
+	int rc;
+
+	MUTEX_LOCK(trm->queue_lock);
+	trm->shutdown = 1;
+	COND_SIGNAL(&trm->dispatch_cond);
+	MUTEX_UNLOCK(trm->queue_lock);
+
+	/* the dispatcher drains the queue before exiting */
+	if (trm->running) {
+		if ((rc = THREAD_JOIN(trm->dispatcher, NULL)))
+			LogError("Thread join failed: error: %d", rc);
+	}
+
 	free(trm);
 
 	return Tddli_Close();
@@ -154,13 +154,20 @@ TCS_GetPcrEvent_Internal(TCS_CONTEXT_HANDLE hContext,	/* in */
 			return TCSERR(TSS_E_OUTOFMEMORY);
 		}
 
+		MUTEX_LOCK(tcs_event_log->lock);
+
 		event = get_pcr_event(PcrIndex, *pNumber);
 		if (event == NULL) {
+			MUTEX_UNLOCK(tcs_event_log->lock);
 			free(*ppEvent);
 			return TCSERR(TSS_E_BAD_PARAMETER);
 		}
 
-		if ((result = copy_pcr_event(*ppEvent, event))) {
+		result = copy_pcr_event(*ppEvent, event);
+
+		MUTEX_UNLOCK(tcs_event_log->lock);
+
+		if (result) {
 			free(*ppEvent);
 			return result;
 		}
@@ -238,9 +245,8 @@ TCS_GetPcrEventsByPcr_Internal(TCS_CONTEXT_HANDLE hContext,	/* in */
 				UINT32 *pEventCount,		/* in, out */
 				TSS_PCR_EVENT **ppEvents)	/* out */
 {
-	UINT32 lastEventNumber, i, eventIndex;
+	UINT32 lastEventNumber;
 	TSS_RESULT result;
-	struct event_wrapper *tmp;
 
 	if ((result = ctx_verify_context(hContext)))
 		return result;
@@ -268,8 +274,6 @@ TCS_GetPcrEventsByPcr_Internal(TCS_CONTEXT_HANDLE hContext,	/* in */
 
 	lastEventNumber = get_num_events(PcrIndex);
 
-	MUTEX_UNLOCK(tcs_event_log->lock);
-
 	/* if pEventCount is larger than the number of events to return, just return less.
 	 * *pEventCount will be set to the number returned below. First, check for overflow.
 	 */
@@ -277,10 +281,13 @@ TCS_GetPcrEventsByPcr_Internal(TCS_CONTEXT_HANDLE hContext,	/* in */
 	    (FirstEvent + *pEventCount) >= *pEventCount)
 		lastEventNumber = MIN(lastEventNumber, FirstEvent + *pEventCount);
 
-	if (FirstEvent > lastEventNumber)
+	if (FirstEvent > lastEventNumber) {
+		MUTEX_UNLOCK(tcs_event_log->lock);
 		return TCSERR(TSS_E_BAD_PARAMETER);
+	}
 
-	if (lastEventNumber == 0) {
+	if (lastEventNumber == FirstEvent) {
+		MUTEX_UNLOCK(tcs_event_log->lock);
 		*pEventCount = 0;
 		*ppEvents = NULL;
 		return TSS_SUCCESS;
@@ -291,28 +298,19 @@ TCS_GetPcrEventsByPcr_Internal(TCS_CONTEXT_HANDLE hContext,	/* in */
 	 */
 	*ppEvents = calloc((lastEventNumber - FirstEvent), sizeof(TSS_PCR_EVENT));
 	if (*ppEvents == NULL) {
+		MUTEX_UNLOCK(tcs_event_log->lock);
 		LogError("malloc of %zd bytes failed.",
 			 sizeof(TSS_PCR_EVENT) * (lastEventNumber - FirstEvent));
 		return TCSERR(TSS_E_OUTOFMEMORY);
 	}
 
-	MUTEX_LOCK(tcs_event_log->lock);
-
-	tmp = tcs_event_log->lists[PcrIndex];
-
-	/* move through the list until we get to the first event requested */
-	for (i = 0; i < FirstEvent; i++)
-		tmp = tmp->next;
-
 	/* copy events from the first requested to the last requested */
-	for (eventIndex = 0; i < lastEventNumber; eventIndex++, i++) {
-		copy_pcr_event(&((*ppEvents)[eventIndex]), &(tmp->event));
-		tmp = tmp->next;
-	}
+	memcpy(*ppEvents, get_pcr_event(PcrIndex, FirstEvent),
+	       (lastEventNumber - FirstEvent) * sizeof(TSS_PCR_EVENT));
 
 	MUTEX_UNLOCK(tcs_event_log->lock);
 
-	*pEventCount = eventIndex;
+	*pEventCount = lastEventNumber - FirstEvent;
 
 	return TSS_SUCCESS;
 }
@@ -323,65 +321,69 @@ TCS_GetPcrEventLog_Internal(TCS_CONTEXT_HANDLE hContext,/* in  */
 			    TSS_PCR_EVENT **ppEvents)	/* out */
 {
 	TSS_RESULT result;
-	UINT32 i, j, event_count, aggregate_count = 0;
-	struct event_wrapper *tmp;
-	TSS_PCR_EVENT *event_list = NULL, *aggregate_list = NULL;
+	UINT32 i, event_count, aggregate_count = 0;
+	TSS_PCR_EVENT **ext_lists = NULL, *aggregate_list = NULL;
+	UINT32 *ext_counts = NULL;
 
 	if ((result = ctx_verify_context(hContext)))
 		return result;
 
+	ext_lists = calloc(tpm_metrics.num_pcrs, sizeof(TSS_PCR_EVENT *));
+	ext_counts = calloc(tpm_metrics.num_pcrs, sizeof(UINT32));
+	if (ext_lists == NULL || ext_counts == NULL) {
+		LogError("malloc of %zd bytes failed",
+			 tpm_metrics.num_pcrs * (sizeof(TSS_PCR_EVENT *) + sizeof(UINT32)));
+		free(ext_lists);
+		free(ext_counts);
+		return TCSERR(TSS_E_OUTOFMEMORY);
+	}
+
 	MUTEX_LOCK(tcs_event_log->lock);
 
-	/* for each PCR index, if its externally controlled, get the total number of events
-	 * externally, else copy the events from the TCSD list. Then tack that list onto a
-	 * master list to returned. */
+	/* for each PCR index, if its externally controlled, get its events from the external
+	 * source, else count the events in the TCSD list. Then size the master list to be
+	 * returned once and fill it in PCR order. */
 	for (i = 0; i < tpm_metrics.num_pcrs; i++) {
 		if ((tcsd_options.kernel_pcrs & (1 << i)) ||
 		    (tcsd_options.firmware_pcrs & (1 << i))) {
 			/* A kernel or firmware controlled PCR event list */
 			event_count = UINT_MAX;
 			if ((result = TCS_GetExternalPcrEventsByPcr(i, 0, &event_count,
-								    &event_list))) {
+								    &ext_lists[i]))) {
 				LogDebug("Getting External event list for PCR %u failed", i);
-				free(aggregate_list);
 				goto error;
 			}
+			ext_counts[i] = event_count;
 			LogDebug("Retrieved %u events from PCR %u (external)", event_count, i);
 		} else {
 			/* A TCSD controlled PCR event list */
 			event_count = get_num_events(i);
+		}
 
-			if (event_count == 0)
-				continue;
+		aggregate_count += event_count;
+	}
 
-			if ((event_list = calloc(event_count, sizeof(TSS_PCR_EVENT))) == NULL) {
-				LogError("malloc of %zd bytes failed",
-					 event_count * sizeof(TSS_PCR_EVENT));
-				result = TCSERR(TSS_E_OUTOFMEMORY);
-				free(aggregate_list);
-				goto error;
-			}
+	if (aggregate_count &&
+	    (aggregate_list = calloc(aggregate_count, sizeof(TSS_PCR_EVENT))) == NULL) {
+		LogError("malloc of %zd bytes failed", aggregate_count * sizeof(TSS_PCR_EVENT));
+		result = TCSERR(TSS_E_OUTOFMEMORY);
+		goto error;
+	}
 
-			tmp = tcs_event_log->lists[i];
-			for (j = 0; j < event_count; j++) {
-				copy_pcr_event(&event_list[j], &(tmp->event));
-				tmp = tmp->next;
-			}
+	for (aggregate_count = 0, i = 0; i < tpm_metrics.num_pcrs; i++) {
+		if (ext_lists[i]) {
+			memcpy(&aggregate_list[aggregate_count], ext_lists[i],
+			       ext_counts[i] * sizeof(TSS_PCR_EVENT));
+			aggregate_count += ext_counts[i];
+			continue;
 		}
 
-		if (event_count == 0)
+		if ((event_count = get_num_events(i)) == 0)
 			continue;
 
-		/* Tack the list onto the aggregate_list */
-		aggregate_list = concat_pcr_events(&aggregate_list, aggregate_count, event_list,
-						   event_count);
-		if (aggregate_list == NULL) {
-			free(event_list);
-			result = TCSERR(TSS_E_OUTOFMEMORY);
-			goto error;
-		}
+		memcpy(&aggregate_list[aggregate_count], get_pcr_event(i, 0),
+		       event_count * sizeof(TSS_PCR_EVENT));
 		aggregate_count += event_count;
-		free(event_list);
 	}
 
 	*ppEvents = aggregate_list;
@@ -390,6 +392,128 @@ TCS_GetPcrEventLog_Internal(TCS_CONTEXT_HANDLE hContext,/* in  */
 error:
 	MUTEX_UNLOCK(tcs_event_log->lock);
 
+	for (i = 0; i < tpm_metrics.num_pcrs; i++) {
+		/* on success the aggregate list owns the external events' data */
+		if (result)
+			free_external_events(ext_counts[i], ext_lists[i]);
+		free(ext_lists[i]);
+	}
+	free(ext_lists);
+	free(ext_counts);
+
 	return result;
 }
 
+/* Return up to *pEventCount events of the PCR event log, starting at event *pEventIndex of
+ * PCR *pPcrIndex and going on through the higher PCRs in the order TCS_GetPcrEventLog_Internal
+ * returns them, carrying no more than MaxBytes of event data. On return, *pPcrIndex and
+ * *pEventIndex say where the next page starts. Events only ever get appended to a PCR's list,
+ * so this cursor stays valid while the log grows. A page always holds at least one event if
+ * any are left, so a caller walking the log always makes progress, and knows it has reached
+ * the end when a page comes back empty. */
+TSS_RESULT
+TCS_GetPcrEventLogPage_Internal(TCS_CONTEXT_HANDLE hContext,	/* in */
+				UINT32 *pPcrIndex,		/* in, out */
+				UINT32 *pEventIndex,		/* in, out */
+				UINT32 MaxBytes,		/* in */
+				UINT32 *pEventCount,		/* in, out */
+				TSS_PCR_EVENT **ppEvents)	/* out */
+{
+	TSS_RESULT result;
+	TSS_PCR_EVENT *page, *ext_list, *event;
+	UINT32 pcr, index, j, max_events, num, event_count, want, size, bytes = 0;
+	TSS_BOOL external;
+
+	if ((result = ctx_verify_context(hContext)))
+		return result;
+
+	if (MaxBytes == 0 || MaxBytes > TCSD_EVLOG_PAGE_MAX_BYTES)
+		MaxBytes = TCSD_EVLOG_PAGE_MAX_BYTES;
+
+	/* every event costs at least its TSS_PCR_EVENT, which bounds the size of the page */
+	max_events = MIN(*pEventCount, MAX(1, MaxBytes / sizeof(TSS_PCR_EVENT)));
+	*pEventCount = 0;
+	*ppEvents = NULL;
+
+	if (max_events == 0)
+		return TSS_SUCCESS;
+
+	if ((page = calloc(max_events, sizeof(TSS_PCR_EVENT))) == NULL) {
+		LogError("malloc of %zd bytes failed", max_events * sizeof(TSS_PCR_EVENT));
+		return TCSERR(TSS_E_OUTOFMEMORY);
+	}
+
+	MUTEX_LOCK(tcs_event_log->lock);
+
+	/* the loop moves on to the next PCR only once the page holds all of this one's events */
+	for (pcr = *pPcrIndex, index = *pEventIndex, num = 0;
+	     pcr < tpm_metrics.num_pcrs && num < max_events; pcr++, index = 0) {
+		external = (tcsd_options.kernel_pcrs & (1 << pcr)) ||
+			   (tcsd_options.firmware_pcrs & (1 << pcr));
+
+		if (external) {
+			if ((result = TCS_GetExternalPcrEvent(pcr, &event_count, NULL)))
+				goto error;
+		} else
+			event_count = get_num_events(pcr);
+
+		if (index >= event_count)
+			continue;
+
+		want = MIN(event_count - index, max_events - num);
+
+		if (external) {
+			if ((result = TCS_GetExternalPcrEventsByPcr(pcr, index, &want,
+								    &ext_list)))
+				goto error;
+
+			for (j = 0; j < want; j++) {
+				size = get_pcr_event_size(&ext_list[j]);
+				if (num && bytes + size > MaxBytes) {
+					/* these didn't fit, drop the data read for them */
+					free_external_events(want - j, &ext_list[j]);
+					break;
+				}
+				memcpy(&page[num++], &ext_list[j], sizeof(TSS_PCR_EVENT));
+				bytes += size;
+				index++;
+			}
+			free(ext_list);
+		} else {
+			for (j = 0; j < want; j++) {
+				event = get_pcr_event(pcr, index);
+				size = get_pcr_event_size(event);
+				if (num && bytes + size > MaxBytes)
+					break;
+				if ((result = copy_pcr_event(&page[num], event)))
+					goto error;
+				num++;
+				bytes += size;
+				index++;
+			}
+		}
+
+		if (index < event_count)
+			break;
+	}
+
+	MUTEX_UNLOCK(tcs_event_log->lock);
+
+	LogDebugFn("returning %u events, %u bytes", num, bytes);
+
+	if (num == 0)
+		free(page);
+	else
+		*ppEvents = page;
+	*pEventCount = num;
+	*pPcrIndex = pcr;
+	*pEventIndex = index;
+
+	return TSS_SUCCESS;
+error:
+	MUTEX_UNLOCK(tcs_event_log->lock);
+	free_external_events(num, page);
+	free(page);
+
+	return result;
+}
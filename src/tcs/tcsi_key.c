@@ -91,7 +91,8 @@ LoadKeyByBlob_Internal(UINT32 ord,	/* The ordinal to use, LoadKey or LoadKey2 */
 			LogDebugFn("tcs key handle exists");
 
 			newSlot = mc_get_slot_by_handle(newHandle);
-			if (newSlot && (isKeyLoaded(newSlot) == TRUE)) {
+			if ((newSlot && (isKeyLoaded(newSlot) == TRUE)) ||
+			    key_mgr_swap_in(newHandle, &newSlot) == TSS_SUCCESS) {
 				LogDebugFn("Don't need to reload this key.");
 				*phKeyTCSI = newHandle;
 				if (phKeyHMAC)
@@ -123,6 +124,9 @@ LoadKeyByBlob_Internal(UINT32 ord,	/* The ordinal to use, LoadKey or LoadKey2 */
 
 	if ((result = UnloadBlob_Header(txBlob, &paramSize))) {
 		LogDebugFn("UnloadBlob_Header failed: rc=0x%x", result);
+		/* canILoadThisKey() may have answered from a cache that is out of date */
+		if (result == TPM_E_NOSPACE || result == TPM_E_RESOURCES)
+			key_parms_cache_flush();
 		goto error;
 	}
 
@@ -154,14 +158,18 @@ TCSP_EvictKey_Internal(TCS_CONTEXT_HANDLE hContext,	/* in */
 	if ((result = ctx_verify_context(hContext)))
 		return result;
 
+	MUTEX_LOCK(mem_cache_lock);
+
 	tpm_handle = mc_get_slot_by_handle(hKey);
-	if (tpm_handle == NULL_TPM_HANDLE)
+	if (tpm_handle == NULL_TPM_HANDLE) {
+		MUTEX_UNLOCK(mem_cache_lock);
 		return TSS_SUCCESS;	/*let's call this success if the key is already evicted */
+	}
 
-	if ((result = internal_EvictByKeySlot(tpm_handle)))
-		return result;
+	if ((result = internal_EvictByKeySlot(tpm_handle)) == TSS_SUCCESS)
+		result = mc_set_slot_by_slot(tpm_handle, NULL_TPM_HANDLE);
 
-	result = mc_set_slot_by_slot(tpm_handle, NULL_TPM_HANDLE);
+	MUTEX_UNLOCK(mem_cache_lock);
 
 	return result;
 }
@@ -108,8 +108,8 @@ TCS_EnumRegisteredKeys_Internal(TCS_CONTEXT_HANDLE hContext,		/* in */
 
 	/* this entire operation needs to be atomic wrt registered keys. We must
 	 * lock the mem cache as well to test if a given key is loaded. */
-	MUTEX_LOCK(disk_cache_lock);
 	MUTEX_LOCK(mem_cache_lock);
+	MUTEX_LOCK(disk_cache_lock);
 
 	/* return an array of all registered keys if pKeyUUID == NULL */
 	if (pKeyUUID == NULL) {
@@ -137,27 +137,14 @@ TCS_EnumRegisteredKeys_Internal(TCS_CONTEXT_HANDLE hContext,		/* in */
 		i = 0;
 		for (disk_ptr = key_disk_cache_head; disk_ptr; disk_ptr = disk_ptr->next) {
 			if (disk_ptr->flags & CACHE_FLAG_VALID) {
-				/* look for a mem cache entry to check if its loaded */
-				for (mem_ptr = key_mem_cache_head; mem_ptr; mem_ptr = mem_ptr->next) {
-					if (!memcmp(&mem_ptr->uuid, &disk_ptr->uuid, sizeof(TSS_UUID))) {
-						if ((result = fill_key_info(disk_ptr, mem_ptr, &ret[i]))) {
-							free(ret);
-							ret = NULL;
-							count = 0;
-							goto done;
-						}
-						break;
-					}
-				}
-				/* if there is no mem cache entry for this key, go ahead and call
-				 * fill_key_info(), it will pull everything from disk */
-				if (mem_ptr == NULL) {
-					if ((result = fill_key_info(disk_ptr, NULL, &ret[i]))) {
-						free(ret);
-						ret = NULL;
-						count = 0;
-						goto done;
-					}
+				/* look for a mem cache entry to check if its loaded. If there is none,
+				 * fill_key_info() will pull everything from disk */
+				mem_ptr = mc_get_entry_by_uuid(&disk_ptr->uuid);
+				if ((result = fill_key_info(disk_ptr, mem_ptr, &ret[i]))) {
+					free(ret);
+					ret = NULL;
+					count = 0;
+					goto done;
 				}
 				i++;
 			}
@@ -166,25 +153,18 @@ TCS_EnumRegisteredKeys_Internal(TCS_CONTEXT_HANDLE hContext,		/* in */
 		/* return a chain of a key and its parents up to the SRK */
 		/*  determine the number of keys in the chain */
 		memcpy(&tmp_uuid, pKeyUUID, sizeof(TSS_UUID));
-		disk_ptr = key_disk_cache_head;
-		while (disk_ptr != NULL && count < MAX_KEY_CHILDREN)
+		while (count < MAX_KEY_CHILDREN &&
+		       (disk_ptr = disk_cache_find_by_uuid(&tmp_uuid)) != NULL)
 		{
-			if (disk_ptr->flags & CACHE_FLAG_VALID &&
-				!memcmp(&disk_ptr->uuid, &tmp_uuid, sizeof(TSS_UUID)))
-			{
-				/* increment count, then search for the parent */
-				count++;
-				/* save a pointer to this cache entry */
-				tmp_ptrs[count - 1] = disk_ptr;
-				/* if the parent of this key is NULL, we're at the root of the tree */
-				if (!memcmp(&disk_ptr->parent_uuid, &NULL_UUID, sizeof(TSS_UUID)))
-					break;
-				/* overwrite tmp_uuid with the parent, which we will now search for */
-				memcpy(&tmp_uuid, &disk_ptr->parent_uuid, sizeof(TSS_UUID));
-				disk_ptr = key_disk_cache_head;
-				continue;
-			}
-			disk_ptr = disk_ptr->next;
+			/* increment count, then search for the parent */
+			count++;
+			/* save a pointer to this cache entry */
+			tmp_ptrs[count - 1] = disk_ptr;
+			/* if the parent of this key is NULL, we're at the root of the tree */
+			if (!memcmp(&disk_ptr->parent_uuid, &NULL_UUID, sizeof(TSS_UUID)))
+				break;
+			/* overwrite tmp_uuid with the parent, which we will now search for */
+			memcpy(&tmp_uuid, &disk_ptr->parent_uuid, sizeof(TSS_UUID));
 		}
 		/* when we reach this point, we have an array of TSS_UUID's that leads from the
 		 * requested key up to the SRK*/
@@ -204,27 +184,14 @@ TCS_EnumRegisteredKeys_Internal(TCS_CONTEXT_HANDLE hContext,		/* in */
 		}
 
 		for (i = 0; i < count; i++) {
-			/* look for a mem cache entry to check if its loaded */
-			for (mem_ptr = key_mem_cache_head; mem_ptr; mem_ptr = mem_ptr->next) {
-				if (!memcmp(&mem_ptr->uuid, &tmp_ptrs[i]->uuid, sizeof(TSS_UUID))) {
-					if ((result = fill_key_info(tmp_ptrs[i], mem_ptr, &ret[i]))) {
-						free(ret);
-						ret = NULL;
-						count = 0;
-						goto done;
-					}
-					break;
-				}
-			}
-			/* if there is no mem cache entry for this key, go ahead and call
-			 * fill_key_info(), it will pull everything from disk */
-			if (mem_ptr == NULL) {
-				if ((result = fill_key_info(tmp_ptrs[i], NULL, &ret[i]))) {
-					free(ret);
-					ret = NULL;
-					count = 0;
-					goto done;
-				}
+			/* look for a mem cache entry to check if its loaded. If there is none,
+			 * fill_key_info() will pull everything from disk */
+			mem_ptr = mc_get_entry_by_uuid(&tmp_ptrs[i]->uuid);
+			if ((result = fill_key_info(tmp_ptrs[i], mem_ptr, &ret[i]))) {
+				free(ret);
+				ret = NULL;
+				count = 0;
+				goto done;
 			}
 		}
 	}
@@ -275,8 +242,8 @@ TCS_EnumRegisteredKeys_Internal2(TCS_CONTEXT_HANDLE hContext,		/* in */
 
 	/* this entire operation needs to be atomic wrt registered keys. We must
 	 * lock the mem cache as well to test if a given key is loaded. */
-	MUTEX_LOCK(disk_cache_lock);
 	MUTEX_LOCK(mem_cache_lock);
+	MUTEX_LOCK(disk_cache_lock);
 
 	/* return an array of all registered keys if pKeyUUID == NULL */
 	if (pKeyUUID == NULL) {
@@ -304,27 +271,14 @@ TCS_EnumRegisteredKeys_Internal2(TCS_CONTEXT_HANDLE hContext,		/* in */
 		i = 0;
 		for (disk_ptr = key_disk_cache_head; disk_ptr; disk_ptr = disk_ptr->next) {
 			if (disk_ptr->flags & CACHE_FLAG_VALID) {
-				/* look for a mem cache entry to check if its loaded */
-				for (mem_ptr = key_mem_cache_head; mem_ptr; mem_ptr = mem_ptr->next) {
-					if (!memcmp(&mem_ptr->uuid, &disk_ptr->uuid, sizeof(TSS_UUID))) {
-						if ((result = fill_key_info2(disk_ptr, mem_ptr, &ret[i]))) {
-							free(ret);
-							ret = NULL;
-							count = 0;
-							goto done;
-						}
-						break;
-					}
-				}
-				/* if there is no mem cache entry for this key, go ahead and call
-				 * fill_key_info2(), it will pull everything from disk */
-				if (mem_ptr == NULL) {
-					if ((result = fill_key_info2(disk_ptr, NULL, &ret[i]))) {
-						free(ret);
-						ret = NULL;
-						count = 0;
-						goto done;
-					}
+				/* look for a mem cache entry to check if its loaded. If there is none,
+				 * fill_key_info2() will pull everything from disk */
+				mem_ptr = mc_get_entry_by_uuid(&disk_ptr->uuid);
+				if ((result = fill_key_info2(disk_ptr, mem_ptr, &ret[i]))) {
+					free(ret);
+					ret = NULL;
+					count = 0;
+					goto done;
 				}
 				i++;
 			}
@@ -333,25 +287,18 @@ TCS_EnumRegisteredKeys_Internal2(TCS_CONTEXT_HANDLE hContext,		/* in */
 		/* return a chain of a key and its parents up to the SRK */
 		/*  determine the number of keys in the chain */
 		memcpy(&tmp_uuid, pKeyUUID, sizeof(TSS_UUID));
-		disk_ptr = key_disk_cache_head;
-		while (disk_ptr != NULL && count < MAX_KEY_CHILDREN)
+		while (count < MAX_KEY_CHILDREN &&
+		       (disk_ptr = disk_cache_find_by_uuid(&tmp_uuid)) != NULL)
 		{
-			if (disk_ptr->flags & CACHE_FLAG_VALID &&
-				!memcmp(&disk_ptr->uuid, &tmp_uuid, sizeof(TSS_UUID)))
-			{
-				/* increment count, then search for the parent */
-				count++;
-				/* save a pointer to this cache entry */
-				tmp_ptrs[count - 1] = disk_ptr;
-				/* if the parent of this key is NULL, we're at the root of the tree */
-				if (!memcmp(&disk_ptr->parent_uuid, &NULL_UUID, sizeof(TSS_UUID)))
-					break;
-				/* overwrite tmp_uuid with the parent, which we will now search for */
-				memcpy(&tmp_uuid, &disk_ptr->parent_uuid, sizeof(TSS_UUID));
-				disk_ptr = key_disk_cache_head;
-				continue;
-			}
-			disk_ptr = disk_ptr->next;
+			/* increment count, then search for the parent */
+			count++;
+			/* save a pointer to this cache entry */
+			tmp_ptrs[count - 1] = disk_ptr;
+			/* if the parent of this key is NULL, we're at the root of the tree */
+			if (!memcmp(&disk_ptr->parent_uuid, &NULL_UUID, sizeof(TSS_UUID)))
+				break;
+			/* overwrite tmp_uuid with the parent, which we will now search for */
+			memcpy(&tmp_uuid, &disk_ptr->parent_uuid, sizeof(TSS_UUID));
 		}
 		/* when we reach this point, we have an array of TSS_UUID's that leads from the
 		 * requested key up to the SRK*/
@@ -371,27 +318,14 @@ TCS_EnumRegisteredKeys_Internal2(TCS_CONTEXT_HANDLE hContext,		/* in */
 		}
 
 		for (i = 0; i < count; i++) {
-			/* look for a mem cache entry to check if its loaded */
-			for (mem_ptr = key_mem_cache_head; mem_ptr; mem_ptr = mem_ptr->next) {
-				if (!memcmp(&mem_ptr->uuid, &tmp_ptrs[i]->uuid, sizeof(TSS_UUID))) {
-					if ((result = fill_key_info2(tmp_ptrs[i], mem_ptr, &ret[i]))) {
-						free(ret);
-						ret = NULL;
-						count = 0;
-						goto done;
-					}
-					break;
-				}
-			}
-			/* if there is no mem cache entry for this key, go ahead and call
-			 * fill_key_info(), it will pull everything from disk */
-			if (mem_ptr == NULL) {
-				if ((result = fill_key_info2(tmp_ptrs[i], NULL, &ret[i]))) {
-					free(ret);
-					ret = NULL;
-					count = 0;
-					goto done;
-				}
+			/* look for a mem cache entry to check if its loaded. If there is none,
+			 * fill_key_info2() will pull everything from disk */
+			mem_ptr = mc_get_entry_by_uuid(&tmp_ptrs[i]->uuid);
+			if ((result = fill_key_info2(tmp_ptrs[i], mem_ptr, &ret[i]))) {
+				free(ret);
+				ret = NULL;
+				count = 0;
+				goto done;
 			}
 		}
 	}
@@ -132,6 +132,7 @@ TCSP_ExecuteTransport_Internal(TCS_CONTEXT_HANDLE      hContext,
 	TCS_HANDLE handle1 = 0, handle2 = 0;
 	UINT64 offset, wrappedOffset = 0;
 	BYTE txBlob[TSS_TPM_TXBLOB_SIZE];
+	TSS_BOOL mc_locked = FALSE;
 
 
 	if (*pulHandleListSize > 2) {
@@ -326,6 +327,14 @@ build_command:
 		LoadBlob_Header(TPM_TAG_RQU_COMMAND, offset, TPM_ORD_ExecuteTransport, txBlob);
 	}
 
+	/* A key loaded by a wrapped LoadKey2 isn't in the mem cache until load_key_final() adds
+	 * it, and in the meantime it would look like an unknown key to evictFirstKey(). Hold
+	 * the mem cache across the TPM command to close that window. */
+	if (unWrappedCommandOrdinal == TPM_ORD_LoadKey2) {
+		MUTEX_LOCK(mem_cache_lock);
+		mc_locked = TRUE;
+	}
+
 	if ((result = req_mgr_submit_req(txBlob)))
 		goto done;
 
@@ -371,6 +380,8 @@ build_command:
 		*ulWrappedCmdParamOutSize = 0;
 		*rgbWrappedCmdParamOut = NULL;
 		auth_mgr_release_auth(pWrappedCmdAuth1, pWrappedCmdAuth2, hContext);
+		if (mc_locked)
+			MUTEX_UNLOCK(mem_cache_lock);
 
 		return TSS_SUCCESS;
 	}
@@ -420,6 +431,8 @@ build_command:
 
 done:
 	auth_mgr_release_auth(pWrappedCmdAuth1, pWrappedCmdAuth2, hContext);
+	if (mc_locked)
+		MUTEX_UNLOCK(mem_cache_lock);
 	return result;
 }
 
@@ -27,7 +27,7 @@
 #include <arpa/inet.h>
 #include <errno.h>
 #include <getopt.h>
-#include <sys/select.h>
+#include <sys/epoll.h>
 #include "trousers/tss.h"
 #include "trousers_types.h"
 #include "tcs_tsp.h"
@@ -52,6 +52,7 @@ struct srv_sock_info {
 	socklen_t addr_len;
 };
 #define MAX_IP_PROTO 2
+#define MAX_EPOLL_EVENTS 64
 #define INVALID_ADDR_STR "<Invalid client address>"
 
 static void close_server_socks(struct srv_sock_info *socks_info)
@@ -169,6 +170,13 @@ tcsd_startup(void)
 		return result;
 	}
 
+	/* must happen before PS_init_disk_cache(), which adds keys to the mem cache */
+	if ((result = key_mgr_init())) {
+		conf_file_final(&tcsd_options);
+		(void)req_mgr_final();
+		return result;
+	}
+
 	result = PS_init_disk_cache();
 	if (result != TSS_SUCCESS) {
 		conf_file_final(&tcsd_options);
@@ -381,31 +389,38 @@ char *fetch_hostname(struct sockaddr_storage *client_addr, socklen_t socklen)
 	if (getnameinfo((struct sockaddr *)client_addr, socklen, buf,
 						sizeof(buf), NULL, 0, 0) != 0) {
 		LogWarn("Could not retrieve client address info");
-		return NULL;
+		return strdup(INVALID_ADDR_STR);
 	} else {
 		return strdup(buf);
 	}
 }
 
-void prepare_for_select(struct srv_sock_info *socks_info, int *num_fds,
-						fd_set *rdfd_set, int *nfds)
+/* Add the server sockets to the epoll set that also watches all client connections. Their
+ * srv_sock_info is the event data, which is how the poll loop tells them apart from clients. */
+int prepare_for_poll(struct srv_sock_info *socks_info, int *num_fds)
 {
+	struct epoll_event ev;
 	int i;
 
-	FD_ZERO(rdfd_set);
 	*num_fds = 0;
-	*nfds = 0;
 	// Filter out socket descriptors in the queue that
 	// has the -1 value.
 	for (i=0; i < MAX_IP_PROTO; i++) {
 		if (socks_info[i].sd == -1)
 			break;
 
-		FD_SET(socks_info[i].sd, rdfd_set);
+		memset(&ev, 0, sizeof(ev));
+		ev.events = EPOLLIN;
+		ev.data.ptr = &socks_info[i];
+		if (epoll_ctl(tm->epoll_fd, EPOLL_CTL_ADD, socks_info[i].sd, &ev) == -1) {
+			LogError("Error monitoring server socket descriptor: %s",
+				 strerror(errno));
+			return -1;
+		}
 		(*num_fds)++;
-		if (*nfds < socks_info[i].sd) // grab highest sd for select call
-			*nfds = socks_info[i].sd;
 	}
+
+	return 0;
 }
 
 int
@@ -413,12 +428,12 @@ main(int argc, char **argv)
 {
 	TSS_RESULT result;
 	int newsd, c, rv, option_index = 0;
-	int i;
+	int i, j;
 	socklen_t client_len;
 	char *hostname = NULL;
-	fd_set rdfd_set;
+	struct epoll_event events[MAX_EPOLL_EVENTS];
+	struct srv_sock_info *ssi;
 	int num_fds = 0;
-	int nfds = 0;
 	int stor_errno;
 	sigset_t sigmask, termmask, oldsigmask;
 	struct sockaddr_storage client_addr;
@@ -490,6 +505,24 @@ main(int argc, char **argv)
 		}
 	}
 
+	if (req_mgr_start()) {
+		LogError("Could not start the TPM request dispatcher. Aborting...");
+		tcsd_shutdown(socks_info);
+		return -1;
+	}
+
+	if (tcsd_threads_start()) {
+		LogError("Could not start the worker threads. Aborting...");
+		tcsd_shutdown(socks_info);
+		return -1;
+	}
+
+	if (prepare_for_poll(socks_info, &num_fds) == -1 || num_fds == 0) {
+		LogError("No server sockets available to listen connections. Aborting...");
+		tcsd_shutdown(socks_info);
+		return -1;
+	}
+
 	LogInfo("%s: TCSD up and running.", PACKAGE_STRING);
 
 	sigemptyset(&sigmask);
@@ -500,13 +533,6 @@ main(int argc, char **argv)
 	sigaddset(&termmask, SIGTERM);
 
 	do {
-		prepare_for_select(socks_info, &num_fds, &rdfd_set, &nfds);
-		// Sanity check
-		if (num_fds == 0) {
-			LogError("No server sockets available to listen connections. Aborting...");
-			return -1;
-		}
-
 		// Block TERM and HUP signals to prevent race condition
 		if (sigprocmask(SIG_BLOCK, &sigmask, &oldsigmask) == -1) {
 			LogError("Error setting interrupt mask before accept");
@@ -520,6 +546,7 @@ main(int argc, char **argv)
 			}
 			if (reload_config() != TSS_SUCCESS)
 				LogError("Failed reloading config");
+			auth_mgr_report();
 			if (sigprocmask(SIG_BLOCK, &termmask, NULL) == -1) {
 				LogError("Error blocking SIGTERM after config reload");
 			}
@@ -527,9 +554,9 @@ main(int argc, char **argv)
 		if (term)
 			break;
 
-		// Select IPv4 and IPv6 socket descriptors with appropriate sigmask.
-		LogDebug("Waiting for connections");
-		rv = pselect(nfds+1, &rdfd_set, NULL, NULL, NULL, &oldsigmask);
+		// Wait on the server and client sockets with appropriate sigmask.
+		LogDebug("Waiting for connections and requests");
+		rv = epoll_pwait(tm->epoll_fd, events, MAX_EPOLL_EVENTS, -1, &oldsigmask);
 		stor_errno = errno; // original mask must be set ASAP, so store errno.
 		if (sigprocmask(SIG_SETMASK, &oldsigmask, NULL) == -1) {
 			LogError("Error reseting signal mask to the original configuration.");
@@ -542,12 +569,22 @@ main(int argc, char **argv)
 			continue;
 		}
 
-		for (i=0; i < num_fds; i++) { // accept connections from all IP versions (with valid sd)
-			if (!FD_ISSET(socks_info[i].sd, &rdfd_set)) {
+		for (i=0; i < rv; i++) {
+			ssi = NULL;
+			for (j=0; j < num_fds; j++) {
+				if (events[i].data.ptr == &socks_info[j])
+					ssi = &socks_info[j];
+			}
+
+			// A request has started to arrive from an already connected client
+			if (ssi == NULL) {
+				tcsd_conn_ready(events[i].data.ptr);
 				continue;
 			}
-			client_len = socks_info[i].addr_len;
-			newsd = accept(socks_info[i].sd, (struct sockaddr *) &client_addr, &client_len);
+
+			// accept connections from all IP versions (with valid sd)
+			client_len = ssi->addr_len;
+			newsd = accept(ssi->sd, (struct sockaddr *) &client_addr, &client_len);
 			if (newsd < 0) {
 				if (errno != EINTR)
 					LogError("Failed accept: %s", strerror(errno));
@@ -556,12 +593,10 @@ main(int argc, char **argv)
 			LogDebug("accepted socket %i", newsd);
 
 			hostname = fetch_hostname(&client_addr, client_len);
-			if (hostname == NULL)
-				hostname=INVALID_ADDR_STR;
 
-			tcsd_thread_create(newsd, hostname);
+			tcsd_conn_create(newsd, hostname);
 			hostname = NULL;
-		} // for (i=0; i < MAX_IP_PROTO; i++)
+		} // for (i=0; i < rv; i++)
 	} while (term ==0);
 
 	/* To close correctly, we must receive a SIGTERM */
@@ -17,6 +17,9 @@
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/time.h>
+#include <time.h>
+#include <sys/epoll.h>
 
 #include "trousers/tss.h"
 #include "trousers_types.h"
@@ -30,28 +33,41 @@
 
 struct tcsd_thread_mgr *tm = NULL;
 
+static void tcsd_conn_close(struct tcsd_thread_data *);
+
 TSS_RESULT
 tcsd_threads_final()
 {
+#ifndef TCSD_SINGLE_THREAD_DEBUG
 	int rc;
 	UINT32 i;
+#endif
 
 	MUTEX_LOCK(tm->lock);
 
 	tm->shutdown = 1;
+	COND_BROADCAST(&tm->ready_cond);
 
 	MUTEX_UNLOCK(tm->lock);
 
-	/* wait for all currently running threads to exit */
+#ifndef TCSD_SINGLE_THREAD_DEBUG
+	/* wait for the workers to finish their current request and exit */
 	for (i = 0; i < tm->max_threads; i++) {
-		if (tm->thread_data[i].thread_id != THREAD_NULL) {
-			if ((rc = THREAD_JOIN(*(tm->thread_data[i].thread_id), NULL))) {
-				LogError("Thread join failed: error: %d", rc);
-			}
+		if (tm->threads[i] == (THREAD_TYPE)0)
+			continue;
+
+		if ((rc = THREAD_JOIN(tm->threads[i], NULL))) {
+			LogError("Thread join failed: error: %d", rc);
 		}
 	}
+#endif
+
+	/* free the TCS resources of any clients still connected */
+	while (tm->conns)
+		tcsd_conn_close(tm->conns);
 
-	free(tm->thread_data);
+	close(tm->epoll_fd);
+	free(tm->threads);
 	free(tm);
 
 	return TSS_SUCCESS;
@@ -68,110 +84,318 @@ tcsd_threads_init(void)
 	}
 	/* initialize mutex */
 	MUTEX_INIT(tm->lock);
+	COND_INIT(tm->ready_cond);
 
 	/* set the max threads variable from config */
 	tm->max_threads = tcsd_options.num_threads;
 
-	/* allocate each thread's data structure */
-	tm->thread_data = calloc(tcsd_options.num_threads, sizeof(struct tcsd_thread_data));
-	if (tm->thread_data == NULL) {
+	/* allocate the worker pool */
+	tm->threads = calloc(tcsd_options.num_threads, sizeof(THREAD_TYPE));
+	if (tm->threads == NULL) {
 		LogError("malloc of %zu bytes failed.",
-			 tcsd_options.num_threads * sizeof(struct tcsd_thread_data));
+			 tcsd_options.num_threads * sizeof(THREAD_TYPE));
 		free(tm);
 		return TCSERR(TSS_E_OUTOFMEMORY);
 	}
 
+	/* all client sockets are watched from a single epoll set. The worker that services
+	 * a request re-arms its socket once the reply has been sent. */
+	if ((tm->epoll_fd = epoll_create(TCSD_MAX_SOCKETS_QUEUED)) < 0) {
+		LogError("epoll_create failed: %s", strerror(errno));
+		free(tm->threads);
+		free(tm);
+		return TCSERR(TSS_E_INTERNAL_ERROR);
+	}
+
 	return TSS_SUCCESS;
 }
 
-
+/* start the worker pool. This must be done after the TCSD has daemonized */
 TSS_RESULT
-tcsd_thread_create(int socket, char *hostname)
+tcsd_threads_start(void)
 {
-	UINT32 thread_num = -1;
-	int rc = TCS_SUCCESS;
 #ifndef TCSD_SINGLE_THREAD_DEBUG
+	UINT32 i;
+	int rc;
 	THREAD_ATTR_DECLARE(tcsd_thread_attr);
 
 	/* init the thread attribute */
 	if ((rc = THREAD_ATTR_INIT(tcsd_thread_attr))) {
 		LogError("Initializing thread attribute failed: error=%d: %s", rc, strerror(rc));
-		rc = TCSERR(TSS_E_INTERNAL_ERROR);
-		goto out;
+		return TCSERR(TSS_E_INTERNAL_ERROR);
 	}
 	/* make all threads joinable */
 	if ((rc = THREAD_ATTR_SETJOINABLE(tcsd_thread_attr))) {
 		LogError("Making thread attribute joinable failed: error=%d: %s", rc, strerror(rc));
-		rc = TCSERR(TSS_E_INTERNAL_ERROR);
-		goto out;
+		return TCSERR(TSS_E_INTERNAL_ERROR);
 	}
 
-	MUTEX_LOCK(tm->lock);
-#endif
-	if (tm->num_active_threads == tm->max_threads) {
-		if (hostname != NULL) {
-			LogError("max number of connections reached (%d), new connection"
-				 " from %s refused.", tm->max_threads, hostname);
-		} else {
-			LogError("max number of connections reached (%d), new connection"
-				 " refused.", tm->max_threads);
+	for (i = 0; i < tm->max_threads; i++) {
+		if ((rc = THREAD_CREATE(&tm->threads[i], &tcsd_thread_attr, tcsd_thread_run,
+					NULL))) {
+			LogError("Thread create failed: %d", rc);
+			return TCSERR(TSS_E_INTERNAL_ERROR);
 		}
-		rc = TCSERR(TSS_E_CONNECTION_FAILED);
-#ifndef TCSD_SINGLE_THREAD_DEBUG
-		goto out_unlock;
-#else
-		goto out;
+	}
 #endif
+	return TSS_SUCCESS;
+}
+
+/* wait for the next request on this connection */
+static void
+tcsd_conn_rearm(struct tcsd_thread_data *data)
+{
+	struct epoll_event ev;
+
+	memset(&ev, 0, sizeof(struct epoll_event));
+	ev.events = EPOLLIN | EPOLLONESHOT;
+	ev.data.ptr = data;
+
+	if (epoll_ctl(tm->epoll_fd, EPOLL_CTL_MOD, data->sock, &ev)) {
+		LogError("epoll_ctl on socket %d failed: %s", data->sock, strerror(errno));
+		tcsd_conn_close(data);
 	}
+}
+
+static void
+tcsd_conn_close(struct tcsd_thread_data *data)
+{
+	LogDebug("Closing connection on socket %d", data->sock);
 
-	/* search for an open slot to store the thread data in */
-	for (thread_num = 0; thread_num < tm->max_threads; thread_num++) {
-		if (tm->thread_data[thread_num].thread_id == THREAD_NULL)
-			break;
+	/* Closing connection to TSP. This also removes it from the epoll set */
+	close(data->sock);
+	data->sock = -1;
+	free(data->comm.buf);
+	data->comm.buf = NULL;
+	data->comm.buf_size = -1;
+	/* If the connection was not shut down cleanly, free TCS resources here */
+	if (data->context != NULL_TCS_HANDLE) {
+		TCS_CloseContext_Internal(data->context);
+		data->context = NULL_TCS_HANDLE;
+	}
+	if(data->hostname != NULL) {
+		free(data->hostname);
+		data->hostname = NULL;
 	}
 
-	DBG_ASSERT(thread_num != tm->max_threads);
+	MUTEX_LOCK(tm->lock);
+	if (data->prev)
+		data->prev->next = data->next;
+	else
+		tm->conns = data->next;
+	if (data->next)
+		data->next->prev = data->prev;
+	tm->num_conns--;
+	MUTEX_UNLOCK(tm->lock);
 
-	tm->thread_data[thread_num].sock = socket;
-	tm->thread_data[thread_num].context = NULL_TCS_HANDLE;
-	if (hostname != NULL)
-		tm->thread_data[thread_num].hostname = hostname;
+	free(data);
+}
 
-#ifdef TCSD_SINGLE_THREAD_DEBUG
-	(void)tcsd_thread_run((void *)(&(tm->thread_data[thread_num])));
-#else
-	tm->thread_data[thread_num].thread_id = calloc(1, sizeof(THREAD_TYPE));
-	if (tm->thread_data[thread_num].thread_id == NULL) {
-		rc = TCSERR(TSS_E_OUTOFMEMORY);
-		LogError("malloc of %zd bytes failed.", sizeof(THREAD_TYPE));
-		goto out_unlock;
+TSS_RESULT
+tcsd_conn_create(int socket, char *hostname)
+{
+	struct tcsd_thread_data *data;
+	struct epoll_event ev;
+	struct timeval tv;
+
+	if ((data = calloc(1, sizeof(struct tcsd_thread_data))) == NULL) {
+		LogError("malloc of %zd bytes failed.", sizeof(struct tcsd_thread_data));
+		goto error;
 	}
 
-	if ((rc = THREAD_CREATE(tm->thread_data[thread_num].thread_id,
-				 &tcsd_thread_attr,
-				 tcsd_thread_run,
-				 (void *)(&(tm->thread_data[thread_num]))))) {
-		LogError("Thread create failed: %d", rc);
-		rc = TCSERR(TSS_E_INTERNAL_ERROR);
-		goto out_unlock;
+	data->comm.buf_size = TCSD_INIT_TXBUF_SIZE;
+	if ((data->comm.buf = calloc(1, data->comm.buf_size)) == NULL) {
+		LogError("malloc of %u bytes failed.", data->comm.buf_size);
+		free(data);
+		goto error;
 	}
 
-	tm->num_active_threads++;
+	data->sock = socket;
+	data->context = NULL_TCS_HANDLE;
+	data->hostname = hostname;
+
+	/* Sockets are only read once they're readable, so an idle client costs nothing. Bound
+	 * how long a client that stalls mid-request can hold on to a worker though. Each
+	 * request also has to arrive, and its reply be taken, within an overall deadline, see
+	 * tcsd_conn_service(). */
+	tv.tv_sec = TCSD_CONN_RECV_TIMEOUT;
+	tv.tv_usec = 0;
+	if (setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)))
+		LogWarn("Could not set receive timeout on socket %d: %s", socket,
+			strerror(errno));
+	tv.tv_sec = TCSD_CONN_SEND_TIMEOUT;
+	if (setsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv)))
+		LogWarn("Could not set send timeout on socket %d: %s", socket,
+			strerror(errno));
 
-out_unlock:
+	MUTEX_LOCK(tm->lock);
+	data->next = tm->conns;
+	if (tm->conns)
+		tm->conns->prev = data;
+	tm->conns = data;
+	tm->num_conns++;
 	MUTEX_UNLOCK(tm->lock);
-#endif
-out:
-	/* cleanup in case of error */
-	if (rc != TCS_SUCCESS) {
-		if (hostname != NULL) {
-			if (thread_num != -1)
-				tm->thread_data[thread_num].hostname = NULL;
-			free(hostname);
+
+	memset(&ev, 0, sizeof(struct epoll_event));
+	ev.events = EPOLLIN | EPOLLONESHOT;
+	ev.data.ptr = data;
+
+	if (epoll_ctl(tm->epoll_fd, EPOLL_CTL_ADD, socket, &ev)) {
+		LogError("epoll_ctl on socket %d failed: %s", socket, strerror(errno));
+		tcsd_conn_close(data);
+		return TCSERR(TSS_E_CONNECTION_FAILED);
+	}
+
+	LogDebug("%u connections open", tm->num_conns);
+
+	return TSS_SUCCESS;
+error:
+	free(hostname);
+	close(socket);
+	return TCSERR(TSS_E_OUTOFMEMORY);
+}
+
+/* receive one request from the connection, execute it and send the reply. Returns non-zero if
+ * the connection should be closed */
+static int
+tcsd_conn_service(struct tcsd_thread_data *data)
+{
+	BYTE *buffer;
+	int recd_so_far, total_recv_size, recv_chunk_size, send_size;
+	TSS_RESULT result;
+	UINT64 offset;
+	struct timespec deadline;
+
+	/* the whole request has to arrive by the deadline, not just each piece of it */
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	deadline.tv_sec += TCSD_CONN_RECV_TIMEOUT;
+
+	/* get the packet header to get the size of the incoming packet */
+	if (recv_from_socket(data->sock, data->comm.buf, sizeof(struct tcsd_packet_hdr),
+			     &deadline) < 0)
+		return -1;
+
+	recd_so_far = sizeof(struct tcsd_packet_hdr);
+
+	/* check the packet size */
+	total_recv_size = Decode_UINT32(data->comm.buf);
+	if (total_recv_size < (int)sizeof(struct tcsd_packet_hdr)) {
+		LogError("Packet to receive from socket %d is too small (%d bytes)",
+			 data->sock, total_recv_size);
+		return -1;
+	}
+
+	LogDebug("total_recv_size %d, buf_size %u, recd_so_far %d", total_recv_size,
+		 data->comm.buf_size, recd_so_far);
+
+	/* instead of blindly allocating recv_size bytes off the bat, stage the realloc
+	 * and wait for the data to come in over the socket. This protects against
+	 * trivially asking tcsd to alloc 2GB. The buffer at least doubles at each stage
+	 * so that a large packet costs a handful of reallocs, and it is kept for the
+	 * following requests on this connection */
+	while (total_recv_size > (int) data->comm.buf_size) {
+		BYTE *new_buffer;
+		int new_bufsize, incr;
+
+		incr = MAX((int)data->comm.buf_size, TCSD_INCR_TXBUF_SIZE);
+		if ((int)data->comm.buf_size + incr < total_recv_size)
+			new_bufsize = data->comm.buf_size + incr;
+		else
+			new_bufsize = total_recv_size;
+		recv_chunk_size = new_bufsize - recd_so_far;
+
+		LogDebug("Increasing communication buffer to %d bytes.", new_bufsize);
+		new_buffer = realloc(data->comm.buf, new_bufsize);
+		if (new_buffer == NULL) {
+			LogError("realloc of %d bytes failed.", new_bufsize);
+			return -1;
+		}
+
+		data->comm.buf_size = new_bufsize;
+		data->comm.buf = new_buffer;
+		buffer = data->comm.buf + recd_so_far;
+
+		LogDebug("recv_chunk_size %d recd_so_far %d", recv_chunk_size, recd_so_far);
+		if (recv_from_socket(data->sock, buffer, recv_chunk_size, &deadline) < 0) {
+			result = TCSERR(TSS_E_INTERNAL_ERROR);
+			goto error;
+		}
+
+		recd_so_far += recv_chunk_size;
+	}
+
+	if (recd_so_far < total_recv_size) {
+		buffer = data->comm.buf + recd_so_far;
+		recv_chunk_size = total_recv_size - recd_so_far;
+
+		LogDebug("recv_chunk_size %d recd_so_far %d", recv_chunk_size, recd_so_far);
+
+		if (recv_from_socket(data->sock, buffer, recv_chunk_size, &deadline) < 0) {
+			result = TCSERR(TSS_E_INTERNAL_ERROR);
+			goto error;
 		}
-		close(socket);
 	}
-	return rc;
+	LogDebug("Rx'd packet");
+
+	/* create a platform version of the tcsd header */
+	offset = 0;
+	UnloadBlob_UINT32(&offset, &data->comm.hdr.packet_size, data->comm.buf);
+	UnloadBlob_UINT32(&offset, &data->comm.hdr.u.result, data->comm.buf);
+	UnloadBlob_UINT32(&offset, &data->comm.hdr.num_parms, data->comm.buf);
+	UnloadBlob_UINT32(&offset, &data->comm.hdr.type_size, data->comm.buf);
+	UnloadBlob_UINT32(&offset, &data->comm.hdr.type_offset, data->comm.buf);
+	UnloadBlob_UINT32(&offset, &data->comm.hdr.parm_size, data->comm.buf);
+	UnloadBlob_UINT32(&offset, &data->comm.hdr.parm_offset, data->comm.buf);
+
+	result = getTCSDPacket(data);
+error:
+	if (result) {
+		/* something internal to the TCSD went wrong in preparing the packet
+		 * to return to the TSP.  Use our already allocated buffer to return a
+		 * TSS_E_INTERNAL_ERROR return code to the TSP. In the non-error path,
+		 * these LoadBlob's are done in getTCSDPacket().
+		 */
+		/* set everything to zero, fill in what is non-zero */
+		memset(data->comm.buf, 0, data->comm.buf_size);
+		offset = 0;
+		/* load packet size */
+		LoadBlob_UINT32(&offset, sizeof(struct tcsd_packet_hdr), data->comm.buf);
+		/* load result */
+		LoadBlob_UINT32(&offset, result, data->comm.buf);
+	}
+	send_size = Decode_UINT32(data->comm.buf);
+	LogDebug("Sending 0x%X bytes back", send_size);
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	deadline.tv_sec += TCSD_CONN_SEND_TIMEOUT;
+	if (send_to_socket(data->sock, data->comm.buf, send_size, &deadline) < 0)
+		return -1;
+
+	return 0;
+}
+
+/* called by the poll loop when a request has started to arrive on a connection */
+void
+tcsd_conn_ready(struct tcsd_thread_data *data)
+{
+#ifdef TCSD_SINGLE_THREAD_DEBUG
+	if (tcsd_conn_service(data))
+		tcsd_conn_close(data);
+	else
+		tcsd_conn_rearm(data);
+#else
+	MUTEX_LOCK(tm->lock);
+
+	data->next_ready = NULL;
+	if (tm->ready_tail)
+		tm->ready_tail->next_ready = data;
+	else
+		tm->ready_head = data;
+	tm->ready_tail = data;
+
+	COND_SIGNAL(&tm->ready_cond);
+
+	MUTEX_UNLOCK(tm->lock);
+#endif
 }
 
 /* Since we don't want any of the worker threads to catch any signals, we must mask off any
@@ -197,165 +421,41 @@ thread_signal_init()
 	}
 }
 
+/* worker thread: service requests from the ready queue until shutdown */
 void *
 tcsd_thread_run(void *v)
 {
-	struct tcsd_thread_data *data = (struct tcsd_thread_data *)v;
-	BYTE *buffer;
-	int recd_so_far, empty_space, total_recv_size, recv_chunk_size, send_size;
-	TSS_RESULT result;
-	UINT64 offset;
-#ifndef TCSD_SINGLE_THREAD_DEBUG
-	int rc;
+	struct tcsd_thread_data *data;
 
 	thread_signal_init();
-#endif
 
-	data->comm.buf_size = TCSD_INIT_TXBUF_SIZE;
-	data->comm.buf = calloc(1, data->comm.buf_size);
-	while (data->comm.buf) {
-		/* get the packet header to get the size of the incoming packet */
-		if (recv_from_socket(data->sock, data->comm.buf,
-				     sizeof(struct tcsd_packet_hdr)) < 0)
-			break;
-
-		recd_so_far = sizeof(struct tcsd_packet_hdr);
-
-		/* check the packet size */
-		total_recv_size = Decode_UINT32(data->comm.buf);
-		if (total_recv_size < (int)sizeof(struct tcsd_packet_hdr)) {
-			LogError("Packet to receive from socket %d is too small (%d bytes)",
-				 data->sock, total_recv_size);
-			break;
-		}
+	MUTEX_LOCK(tm->lock);
+	tm->num_active_threads++;
 
-		LogDebug("total_recv_size %d, buf_size %u, recd_so_far %d", total_recv_size,
-			 data->comm.buf_size, recd_so_far);
-
-		empty_space = data->comm.buf_size - recd_so_far;
-
-		/* instead of blindly allocating recv_size bytes off the bat, stage the realloc
-		 * and wait for the data to come in over the socket. This protects against
-		 * trivially asking tcsd to alloc 2GB */
-		while (total_recv_size > (int) data->comm.buf_size) {
-			BYTE *new_buffer;
-			int new_bufsize;
-
-			if ((int)data->comm.buf_size + TCSD_INCR_TXBUF_SIZE < total_recv_size) {
-				new_bufsize = data->comm.buf_size + TCSD_INCR_TXBUF_SIZE;
-				recv_chunk_size = empty_space + TCSD_INCR_TXBUF_SIZE;
-			} else {
-				new_bufsize = total_recv_size;
-				recv_chunk_size = total_recv_size - recd_so_far;
-			}
-
-			LogDebug("Increasing communication buffer to %d bytes.", new_bufsize);
-			new_buffer = realloc(data->comm.buf, new_bufsize);
-			if (new_buffer == NULL) {
-				LogError("realloc of %d bytes failed.", new_bufsize);
-				data->comm.buf = NULL;
-				goto no_mem_error;
-			}
-
-			data->comm.buf_size = new_bufsize;
-			data->comm.buf = new_buffer;
-			buffer = data->comm.buf + recd_so_far;
-
-			LogDebug("recv_chunk_size %d recd_so_far %d", recv_chunk_size, recd_so_far);
-			if (recv_from_socket(data->sock, buffer, recv_chunk_size) < 0) {
-				result = TCSERR(TSS_E_INTERNAL_ERROR);
-				goto error;
-			}
-
-			recd_so_far += recv_chunk_size;
-			empty_space = 0;
+	while (!tm->shutdown) {
+		if ((data = tm->ready_head) == NULL) {
+			COND_WAIT(&tm->ready_cond, &tm->lock);
+			continue;
 		}
 
-		if (recd_so_far < total_recv_size) {
-			buffer = data->comm.buf + recd_so_far;
-			recv_chunk_size = total_recv_size - recd_so_far;
+		tm->ready_head = data->next_ready;
+		if (tm->ready_head == NULL)
+			tm->ready_tail = NULL;
+		data->next_ready = NULL;
 
-			LogDebug("recv_chunk_size %d recd_so_far %d", recv_chunk_size, recd_so_far);
+		MUTEX_UNLOCK(tm->lock);
 
-			if (recv_from_socket(data->sock, buffer, recv_chunk_size) < 0) {
-				result = TCSERR(TSS_E_INTERNAL_ERROR);
-				goto error;
-			}
-		}
-		LogDebug("Rx'd packet");
+		if (tcsd_conn_service(data))
+			tcsd_conn_close(data);
+		else
+			tcsd_conn_rearm(data);
 
-		/* create a platform version of the tcsd header */
-		offset = 0;
-		UnloadBlob_UINT32(&offset, &data->comm.hdr.packet_size, data->comm.buf);
-		UnloadBlob_UINT32(&offset, &data->comm.hdr.u.result, data->comm.buf);
-		UnloadBlob_UINT32(&offset, &data->comm.hdr.num_parms, data->comm.buf);
-		UnloadBlob_UINT32(&offset, &data->comm.hdr.type_size, data->comm.buf);
-		UnloadBlob_UINT32(&offset, &data->comm.hdr.type_offset, data->comm.buf);
-		UnloadBlob_UINT32(&offset, &data->comm.hdr.parm_size, data->comm.buf);
-		UnloadBlob_UINT32(&offset, &data->comm.hdr.parm_offset, data->comm.buf);
-
-		result = getTCSDPacket(data);
-error:
-		if (result) {
-			/* something internal to the TCSD went wrong in preparing the packet
-			 * to return to the TSP.  Use our already allocated buffer to return a
-			 * TSS_E_INTERNAL_ERROR return code to the TSP. In the non-error path,
-			 * these LoadBlob's are done in getTCSDPacket().
-			 */
-			/* set everything to zero, fill in what is non-zero */
-			memset(data->comm.buf, 0, data->comm.buf_size);
-			offset = 0;
-			/* load packet size */
-			LoadBlob_UINT32(&offset, sizeof(struct tcsd_packet_hdr), data->comm.buf);
-			/* load result */
-			LoadBlob_UINT32(&offset, result, data->comm.buf);
-		}
-		send_size = Decode_UINT32(data->comm.buf);
-		LogDebug("Sending 0x%X bytes back", send_size);
-		send_size = send_to_socket(data->sock, data->comm.buf, send_size);
-		if (send_size < 0)
-			break;
-
-		/* check for shutdown */
-		if (tm->shutdown) {
-			LogDebug("Thread %ld exiting via shutdown signal!", THREAD_ID);
-			break;
-		}
+		MUTEX_LOCK(tm->lock);
 	}
-no_mem_error:
-	LogDebug("Thread exiting.");
 
-	/* Closing connection to TSP */
-	close(data->sock);
-	data->sock = -1;
-	free(data->comm.buf);
-	data->comm.buf = NULL;
-	data->comm.buf_size = -1;
-	/* If the connection was not shut down cleanly, free TCS resources here */
-	if (data->context != NULL_TCS_HANDLE) {
-		TCS_CloseContext_Internal(data->context);
-		data->context = NULL_TCS_HANDLE;
-	}
-	if(data->hostname != NULL) {
-		free(data->hostname);
-		data->hostname = NULL;
-	}
-
-#ifndef TCSD_SINGLE_THREAD_DEBUG
-	pthread_mutex_lock(&(tm->lock));
+	LogDebug("Thread %ld exiting via shutdown signal!", THREAD_ID);
 	tm->num_active_threads--;
-	/* if we're not in shutdown mode, then nobody is waiting to join this thread, so
-	 * detach it so that its resources are free at pthread_exit() time. */
-	if (!tm->shutdown) {
-		if ((rc = pthread_detach(*(data->thread_id)))) {
-			LogError("pthread_detach failed (errno %d)."
-				 " Resources may not be properly released.", rc);
-		}
-	}
-	free(data->thread_id);
-	data->thread_id = THREAD_NULL;
-	pthread_mutex_unlock(&(tm->lock));
-	pthread_exit(NULL);
-#endif
+	MUTEX_UNLOCK(tm->lock);
+
 	return NULL;
 }
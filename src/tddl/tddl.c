@@ -14,7 +14,9 @@
 #include <stdio.h>
 #include <errno.h>
 #include <string.h>
+#include <poll.h>
 #include <sys/ioctl.h>
+#include <sys/time.h>
 
 #include "trousers/tss.h"
 #include "trousers_types.h"
@@ -43,6 +45,60 @@ struct tcsd_config *_tcsd_options = NULL;
 #include <fcntl.h>
 
 
+/* a software TPM going away must not kill the TCSD with SIGPIPE */
+#ifdef MSG_NOSIGNAL
+#define TDDL_SEND_FLAGS	MSG_NOSIGNAL
+#else
+#define TDDL_SEND_FLAGS	0
+#endif
+
+/* Software TPM connection settings. By default the TCP connection is re-established for every
+ * command, since some emulators only service one command per connection. With
+ * TCSD_TCP_DEVICE_PERSISTENT set, the connection is kept open and only re-established when
+ * it has been found to be broken. */
+static TSS_BOOL tcp_device_persistent = FALSE;
+static int tcp_device_timeout = TDDL_TCP_DEFAULT_TIMEOUT;
+static struct sockaddr_in tcp_device_addr;
+static TSS_BOOL tcp_device_resolved = FALSE;
+
+static int
+tcp_device_connect(char *hostname, int port)
+{
+	struct timeval tv;
+	int fd;
+
+	/* the address only needs to be looked up once */
+	if (!tcp_device_resolved) {
+		struct hostent *host = gethostbyname(hostname);
+
+		if (host == NULL)
+			return -1;
+
+		memset(&tcp_device_addr, 0x0, sizeof(tcp_device_addr));
+		tcp_device_addr.sin_family = host->h_addrtype;
+		tcp_device_addr.sin_port   = htons(port);
+		memcpy(&tcp_device_addr.sin_addr, host->h_addr, host->h_length);
+		tcp_device_resolved = TRUE;
+	}
+
+	if ((fd = socket(AF_INET, SOCK_STREAM, 0)) < 0)
+		return -1;
+
+	/* on Linux, the send timeout also bounds connect() */
+	tv.tv_sec = tcp_device_timeout;
+	tv.tv_usec = 0;
+	if (setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv)) ||
+	    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)))
+		LogWarn("Could not set TPM socket timeouts: %s", strerror(errno));
+
+	if (connect(fd, (struct sockaddr *)&tcp_device_addr, sizeof(tcp_device_addr)) < 0) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
 int
 open_device()
 {
@@ -50,6 +106,7 @@ open_device()
 	char *tcp_device_hostname = NULL;
 	char *un_socket_device_path = NULL;
 	char *tcp_device_port_string = NULL;
+	char *tcp_device_timeout_string = NULL;
 	
 	if (getenv("TCSD_USE_TCP_DEVICE")) {
 		if ((tcp_device_hostname = getenv("TCSD_TCP_DEVICE_HOSTNAME")) == NULL)
@@ -60,30 +117,14 @@ open_device()
 			tcp_device_port = atoi(tcp_device_port_string);
 		else
 			tcp_device_port = 6545;
+		if ((tcp_device_timeout_string = getenv("TCSD_TCP_DEVICE_TIMEOUT")) != NULL &&
+		    atoi(tcp_device_timeout_string) > 0)
+			tcp_device_timeout = atoi(tcp_device_timeout_string);
+		if (getenv("TCSD_TCP_DEVICE_PERSISTENT"))
+			tcp_device_persistent = TRUE;
 	 
-		
-		fd = socket(AF_INET, SOCK_STREAM, 0);
-		if (fd > 0) {
-			struct hostent *host = gethostbyname(tcp_device_hostname);
-			if (host != NULL) {   
-				struct sockaddr_in addr;
-				memset(&addr, 0x0, sizeof(addr));
-				addr.sin_family = host->h_addrtype;
-				addr.sin_port   = htons(tcp_device_port);
-				memcpy(&addr.sin_addr,
-						host->h_addr,
-						host->h_length);
-				if (connect(fd,	(struct sockaddr *)&addr,
-					    sizeof(addr)) < 0) {
-					close(fd);
-					fd = -1;
-				} else
-					use_in_socket = TRUE;
-			} else {
-				close (fd);
-				fd = -1;
-			}
-		}
+		if ((fd = tcp_device_connect(tcp_device_hostname, tcp_device_port)) >= 0)
+			use_in_socket = TRUE;
 	       
 		if (fd < 0) {
 			struct sockaddr_un addr;
@@ -156,6 +197,93 @@ Tddli_Close()
 	return TSS_SUCCESS;
 }
 
+/* Returns TRUE if the peer of a persistent connection hasn't closed it. Any data waiting to be
+ * read before a command has been sent also means the stream is out of sync. */
+static TSS_BOOL
+socket_is_alive(int fd)
+{
+	struct pollfd pfd;
+
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+
+	if (poll(&pfd, 1, 0) < 0)
+		return FALSE;
+
+	return pfd.revents ? FALSE : TRUE;
+}
+
+static int
+socket_read_all(int fd, BYTE *buf, UINT32 size)
+{
+	UINT32 total = 0;
+	int rc;
+
+	while (total < size) {
+		if ((rc = read(fd, buf + total, size - total)) < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		} else if (rc == 0)
+			break;
+
+		total += rc;
+	}
+
+	return total;
+}
+
+/* Send a command to a software TPM over a stream socket and read back exactly one response,
+ * using the paramSize field of the response header to find its end. Returns the response size,
+ * 0 if the peer had closed the connection before any of the command was delivered or -1 on
+ * error. Once the command has been sent the TPM may have executed it, so losing the connection
+ * after that is an error, not a reason to send it again. */
+static int
+socket_transmit(int fd, UINT32 len)
+{
+	UINT32 total = 0, rsp_size;
+	int rc, err;
+
+	while (total < len) {
+		if ((rc = send(fd, txBuffer + total, len - total, TDDL_SEND_FLAGS)) < 0) {
+			if ((err = errno) == EINTR)
+				continue;
+			LogError("write to TPM socket failed: %s", strerror(err));
+			return (total || (err != EPIPE && err != ECONNRESET)) ? -1 : 0;
+		}
+		total += rc;
+	}
+
+	if ((rc = socket_read_all(fd, txBuffer, TDDL_RSP_HDR_LEN)) < 0) {
+		LogError("read from TPM socket failed: %s", strerror(errno));
+		return -1;
+	} else if (rc == 0) {
+		LogError("TPM socket closed before a response was received");
+		return -1;
+	} else if (rc != TDDL_RSP_HDR_LEN) {
+		LogError("Short response header from TPM socket (%d bytes)", rc);
+		return -1;
+	}
+
+	rsp_size = ((UINT32)txBuffer[2] << 24) | ((UINT32)txBuffer[3] << 16) |
+		   ((UINT32)txBuffer[4] << 8) | (UINT32)txBuffer[5];
+	if (rsp_size < TDDL_RSP_HDR_LEN || rsp_size > TDDL_TXBUF_SIZE) {
+		LogError("Invalid response size from TPM socket (%u bytes)", rsp_size);
+		return -1;
+	}
+
+	if ((rc = socket_read_all(fd, txBuffer + TDDL_RSP_HDR_LEN,
+				  rsp_size - TDDL_RSP_HDR_LEN)) !=
+	    (int)(rsp_size - TDDL_RSP_HDR_LEN)) {
+		LogError("Short response from TPM socket (%u of %u bytes)",
+			 TDDL_RSP_HDR_LEN + (rc > 0 ? rc : 0), rsp_size);
+		return -1;
+	}
+
+	return rsp_size;
+}
+
 TSS_RESULT
 Tddli_TransmitData(BYTE * pTransmitBuf, UINT32 TransmitBufLen, BYTE * pReceiveBuf,
 		   UINT32 * pReceiveBufLen)
@@ -171,12 +299,39 @@ Tddli_TransmitData(BYTE * pTransmitBuf, UINT32 TransmitBufLen, BYTE * pReceiveBu
 	LogDebug("Calling write to driver");
 
 	if (use_in_socket) {
-		Tddli_Close();
-		if (Tddli_Open())
-			return TDDLERR(TDDL_E_IOERROR);
+		if (opened_device == NULL || !tcp_device_persistent ||
+		    !socket_is_alive(opened_device->fd)) {
+			LogDebug("(Re)connecting to the software TPM");
+
+			Tddli_Close();
+			if (Tddli_Open())
+				return TDDLERR(TDDL_E_IOERROR);
+		}
 	}
 
-	switch (opened_device->transmit) {
+	if (use_in_socket) {
+		/* An emulator that drops idle connections does so without reading the next
+		 * command, so if none of the command could be sent it is sent again on a new
+		 * connection. */
+		if ((sizeResult = socket_transmit(opened_device->fd, TransmitBufLen)) == 0 &&
+		    tcp_device_persistent) {
+			LogDebug("Software TPM closed the connection, retrying");
+
+			Tddli_Close();
+			if (Tddli_Open())
+				return TDDLERR(TDDL_E_IOERROR);
+
+			memcpy(txBuffer, pTransmitBuf, TransmitBufLen);
+			sizeResult = socket_transmit(opened_device->fd, TransmitBufLen);
+		}
+
+		/* socket_transmit() has logged why. Whatever is left of the response would be
+		 * read as the reply to the next command, so the connection can't be reused. */
+		if (sizeResult <= 0) {
+			Tddli_Close();
+			return TDDLERR(TDDL_E_IOERROR);
+		}
+	} else switch (opened_device->transmit) {
 		case TDDL_UNDEF:
 			/* fall through */
 		case TDDL_TRANSMIT_IOCTL:
@@ -145,7 +145,7 @@ Trspi_HashUpdate(Trspi_HashCtx *ctx, UINT32 size, BYTE *data)
 	rv = EVP_DigestUpdate(ctx->ctx, data, size);
 	if (rv != EVP_SUCCESS) {
 		DEBUG_print_openssl_errors();
-		free(ctx->ctx);
+		EVP_MD_CTX_destroy(ctx->ctx);
 		ctx->ctx = NULL;
 		return TSPERR(TSS_E_INTERNAL_ERROR);
 	}
@@ -164,11 +164,30 @@ Trspi_HashFinal(Trspi_HashCtx *ctx, BYTE *digest)
 
 	result_size = EVP_MD_CTX_size((EVP_MD_CTX *)ctx->ctx);
 	rv = EVP_DigestFinal(ctx->ctx, digest, &result_size);
+	EVP_MD_CTX_destroy(ctx->ctx);
+	ctx->ctx = NULL;
+
 	if (rv != EVP_SUCCESS)
 		return TSPERR(TSS_E_INTERNAL_ERROR);
 
-	free(ctx->ctx);
-	ctx->ctx = NULL;
+	return TSS_SUCCESS;
+}
+
+TSS_RESULT
+Trspi_HashCopy(Trspi_HashCtx *dst, Trspi_HashCtx *src)
+{
+	if (src == NULL || src->ctx == NULL)
+		return TSPERR(TSS_E_INTERNAL_ERROR);
+
+	if ((dst->ctx = EVP_MD_CTX_create()) == NULL)
+		return TSPERR(TSS_E_OUTOFMEMORY);
+
+	if (EVP_MD_CTX_copy_ex(dst->ctx, src->ctx) != EVP_SUCCESS) {
+		DEBUG_print_openssl_errors();
+		EVP_MD_CTX_destroy(dst->ctx);
+		dst->ctx = NULL;
+		return TSPERR(TSS_E_INTERNAL_ERROR);
+	}
 
 	return TSS_SUCCESS;
 }
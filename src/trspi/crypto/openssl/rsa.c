@@ -15,6 +15,7 @@
  *
  */
 
+#include <stdlib.h>
 #include <string.h>
 
 #include <openssl/evp.h>
@@ -27,6 +28,7 @@
 #include "trousers_types.h"
 #include "spi_utils.h"
 #include "tsplog.h"
+#include "threads.h"
 
 #ifdef TSS_DEBUG
 #define DEBUG_print_openssl_errors() \
@@ -64,47 +66,45 @@ RSA_set0_key(RSA *r, BIGNUM *n, BIGNUM *e, BIGNUM *d)
  */
 #define EVP_SUCCESS 1
 
-/* XXX int set to unsigned int values */
-int
-Trspi_RSA_Encrypt(unsigned char *dataToEncrypt, /* in */
-		unsigned int dataToEncryptLen,  /* in */
-		unsigned char *encryptedData,   /* out */
-		unsigned int *encryptedDataLen, /* out */
-		unsigned char *publicKey,
-		unsigned int keysize)
+/* build an OpenSSL public key object from a modulus and the TPM's default exponent */
+static RSA *
+rsa_pub_new(unsigned char *modulus, unsigned int size)
 {
-	int rv;
 	unsigned char exp[] = { 0x01, 0x00, 0x01 }; /* 65537 hex */
-	unsigned char oaepPad[] = "TCPA";
-	int oaepPadLen = 4;
 	RSA *rsa = RSA_new();
-	BYTE encodedData[256];
-	int encodedDataLen;
 	BIGNUM *rsa_n = NULL, *rsa_e = NULL;
 
-	if (rsa == NULL) {
-		rv = TSPERR(TSS_E_OUTOFMEMORY);
-		goto err;
-	}
+	if (rsa == NULL)
+		return NULL;
 
 	/* set the public key value in the OpenSSL object */
-	rsa_n = BN_bin2bn(publicKey, keysize, NULL);
+	rsa_n = BN_bin2bn(modulus, size, NULL);
 	/* set the public exponent */
 	rsa_e = BN_bin2bn(exp, sizeof(exp), NULL);
 
-	if (rsa_n == NULL || rsa_e == NULL) {
-		rv = TSPERR(TSS_E_OUTOFMEMORY);
-		BN_free(rsa_n);
-		BN_free(rsa_e);
-		goto err;
-	}
-	if (!RSA_set0_key(rsa, rsa_n, rsa_e, NULL)) {
-		rv = TSPERR(TSS_E_FAIL);
+	if (rsa_n == NULL || rsa_e == NULL || !RSA_set0_key(rsa, rsa_n, rsa_e, NULL)) {
 		BN_free(rsa_n);
 		BN_free(rsa_e);
-		goto err;
+		RSA_free(rsa);
+		return NULL;
 	}
 
+	return rsa;
+}
+
+static int
+rsa_tcpa_oaep_encrypt(RSA *rsa,
+		      unsigned char *dataToEncrypt,
+		      unsigned int dataToEncryptLen,
+		      unsigned char *encryptedData,
+		      unsigned int *encryptedDataLen)
+{
+	int rv;
+	unsigned char oaepPad[] = "TCPA";
+	int oaepPadLen = 4;
+	BYTE encodedData[256];
+	int encodedDataLen;
+
 	/* padding constraint for PKCS#1 OAEP padding */
 	if ((int)dataToEncryptLen >= (RSA_size(rsa) - ((2 * SHA_DIGEST_LENGTH) + 1))) {
 		rv = TSPERR(TSS_E_INTERNAL_ERROR);
@@ -131,32 +131,19 @@ Trspi_RSA_Encrypt(unsigned char *dataToEncrypt, /* in */
 
 	/* RSA_public_encrypt returns the size of the encrypted data */
 	*encryptedDataLen = rv;
-	rv = TSS_SUCCESS;
-	goto out;
+	return TSS_SUCCESS;
 
 err:
 	DEBUG_print_openssl_errors();
-out:
-	if (rsa)
-		RSA_free(rsa);
-        return rv;
+	return rv;
 }
 
-TSS_RESULT
-Trspi_Verify(UINT32 HashType, BYTE *pHash, UINT32 iHashLength,
-	     unsigned char *pModulus, int iKeyLength,
-	     BYTE *pSignature, UINT32 sig_len)
+static TSS_RESULT
+rsa_verify(RSA *rsa, UINT32 HashType, BYTE *pHash, UINT32 iHashLength,
+	   BYTE *pSignature, UINT32 sig_len)
 {
 	int rv, nid;
-	unsigned char exp[] = { 0x01, 0x00, 0x01 }; /* The default public exponent for the TPM */
 	unsigned char buf[256];
-	RSA *rsa = RSA_new();
-	BIGNUM *rsa_n = NULL, *rsa_e = NULL;
-
-	if (rsa == NULL) {
-		rv = TSPERR(TSS_E_OUTOFMEMORY);
-		goto err;
-	}
 
 	/* We assume we're verifying data from a TPM, so there are only
 	 * two options, SHA1 data and PKCSv1.5 encoded signature data.
@@ -169,58 +156,125 @@ Trspi_Verify(UINT32 HashType, BYTE *pHash, UINT32 iHashLength,
 			nid = NID_undef;
 			break;
 		default:
-			rv = TSPERR(TSS_E_BAD_PARAMETER);
-			goto out;
+			return TSPERR(TSS_E_BAD_PARAMETER);
 			break;
 	}
 
-	/* set the public key value in the OpenSSL object */
-	rsa_n = BN_bin2bn(pModulus, iKeyLength, NULL);
-	/* set the public exponent */
-	rsa_e = BN_bin2bn(exp, sizeof(exp), NULL);
-
-	if (rsa_n == NULL || rsa_e == NULL) {
-		rv = TSPERR(TSS_E_OUTOFMEMORY);
-		BN_free(rsa_n);
-		BN_free(rsa_e);
-		goto err;
-	}
-	if (!RSA_set0_key(rsa, rsa_n, rsa_e, NULL)) {
-		rv = TSPERR(TSS_E_FAIL);
-		BN_free(rsa_n);
-		BN_free(rsa_e);
-		goto err;
-	}
-
 	/* if we don't know the structure of the data we're verifying, do a public decrypt
 	 * and compare manually. If we know we're looking for a SHA1 hash, allow OpenSSL
 	 * to do the work for us.
 	 */
 	if (nid == NID_undef) {
 		rv = RSA_public_decrypt(sig_len, pSignature, buf, rsa, RSA_PKCS1_PADDING);
-		if ((UINT32)rv != iHashLength) {
-			rv = TSPERR(TSS_E_FAIL);
-			goto out;
-		} else if (memcmp(pHash, buf, iHashLength)) {
-			rv = TSPERR(TSS_E_FAIL);
-			goto out;
-		}
+		if ((UINT32)rv != iHashLength)
+			return TSPERR(TSS_E_FAIL);
+		else if (memcmp(pHash, buf, iHashLength))
+			return TSPERR(TSS_E_FAIL);
 	} else {
-		if ((rv = RSA_verify(nid, pHash, iHashLength, pSignature, sig_len, rsa)) == 0) {
-			rv = TSPERR(TSS_E_FAIL);
-			goto out;
-		}
+		if ((rv = RSA_verify(nid, pHash, iHashLength, pSignature, sig_len, rsa)) == 0)
+			return TSPERR(TSS_E_FAIL);
 	}
 
-	rv = TSS_SUCCESS;
-	goto out;
+	return TSS_SUCCESS;
+}
 
-err:
-	DEBUG_print_openssl_errors();
-out:
-	if (rsa)
-		RSA_free(rsa);
-        return rv;
+/*
+ * Public key objects, so that a key object that is used over and over again only has its
+ * OpenSSL key (and the Montgomery values OpenSSL computes on first use) built once. The
+ * returned object is reference counted: __tspi_rsa_pubkey_get() takes a reference and
+ * __tspi_rsa_pubkey_put() drops one, freeing the object with the last one. The count is
+ * kept here rather than in the RSA object, since RSA_up_ref() is deprecated in OpenSSL 3.
+ */
+struct rsa_pubkey
+{
+	RSA *rsa;
+	UINT32 refs;
+};
+
+static MUTEX_DECLARE_INIT(rsa_pubkey_lock);
+
+void *
+__tspi_rsa_pubkey_new(BYTE *modulus, UINT32 size)
+{
+	struct rsa_pubkey *key;
+
+	if ((key = malloc(sizeof(struct rsa_pubkey))) == NULL) {
+		LogError("malloc of %zd bytes failed.", sizeof(struct rsa_pubkey));
+		return NULL;
+	}
+
+	if ((key->rsa = rsa_pub_new(modulus, size)) == NULL) {
+		DEBUG_print_openssl_errors();
+		free(key);
+		return NULL;
+	}
+	key->refs = 1;
+
+	return key;
+}
+
+void
+__tspi_rsa_pubkey_get(void *key)
+{
+	MUTEX_LOCK(rsa_pubkey_lock);
+	((struct rsa_pubkey *)key)->refs++;
+	MUTEX_UNLOCK(rsa_pubkey_lock);
+}
+
+void
+__tspi_rsa_pubkey_put(void *key)
+{
+	struct rsa_pubkey *k = (struct rsa_pubkey *)key;
+	UINT32 refs;
+
+	MUTEX_LOCK(rsa_pubkey_lock);
+	refs = --k->refs;
+	MUTEX_UNLOCK(rsa_pubkey_lock);
+
+	if (refs)
+		return;
+
+	RSA_free(k->rsa);
+	free(k);
+}
+
+/* XXX int set to unsigned int values */
+int
+Trspi_RSA_Encrypt(unsigned char *dataToEncrypt, /* in */
+		unsigned int dataToEncryptLen,  /* in */
+		unsigned char *encryptedData,   /* out */
+		unsigned int *encryptedDataLen, /* out */
+		unsigned char *publicKey,
+		unsigned int keysize)
+{
+	int rv;
+	struct rsa_pubkey *key;
+
+	if ((key = __tspi_rsa_pubkey_new(publicKey, keysize)) == NULL)
+		return TSPERR(TSS_E_OUTOFMEMORY);
+
+	rv = rsa_tcpa_oaep_encrypt(key->rsa, dataToEncrypt, dataToEncryptLen, encryptedData,
+				   encryptedDataLen);
+	__tspi_rsa_pubkey_put(key);
+
+	return rv;
+}
+
+TSS_RESULT
+Trspi_Verify(UINT32 HashType, BYTE *pHash, UINT32 iHashLength,
+	     unsigned char *pModulus, int iKeyLength,
+	     BYTE *pSignature, UINT32 sig_len)
+{
+	TSS_RESULT result;
+	struct rsa_pubkey *key;
+
+	if ((key = __tspi_rsa_pubkey_new(pModulus, iKeyLength)) == NULL)
+		return TSPERR(TSS_E_OUTOFMEMORY);
+
+	result = rsa_verify(key->rsa, HashType, pHash, iHashLength, pSignature, sig_len);
+	__tspi_rsa_pubkey_put(key);
+
+	return result;
 }
 
 int
@@ -310,3 +364,32 @@ out:
 		RSA_free(rsa);
         return rv;
 }
+
+/* encrypt with the padding a TPM expects for keys with encryption scheme @es */
+TSS_RESULT
+__tspi_rsa_pubkey_encrypt(void *key, UINT16 es, UINT32 inDataLen, BYTE *inData,
+			  UINT32 *outDataLen, BYTE *outData)
+{
+	int rv;
+
+	if (es == TPM_ES_RSAESPKCSv15 || es == TSS_ES_RSAESPKCSV15) {
+		rv = RSA_public_encrypt(inDataLen, inData, outData,
+					((struct rsa_pubkey *)key)->rsa, RSA_PKCS1_PADDING);
+		if (rv == -1) {
+			DEBUG_print_openssl_errors();
+			return TSPERR(TSS_E_INTERNAL_ERROR);
+		}
+
+		*outDataLen = rv;
+		return TSS_SUCCESS;
+	}
+
+	return rsa_tcpa_oaep_encrypt(((struct rsa_pubkey *)key)->rsa, inData, inDataLen, outData, outDataLen);
+}
+
+TSS_RESULT
+__tspi_rsa_pubkey_verify(void *key, UINT32 HashType, UINT32 hashLen, BYTE *hash, UINT32 sigLen,
+			 BYTE *sig)
+{
+	return rsa_verify(((struct rsa_pubkey *)key)->rsa, HashType, hash, hashLen, sig, sigLen);
+}
@@ -21,9 +21,15 @@
 #include "tsplog.h"
 #include "obj.h"
 
-UINT32 nextObjectHandle = 0xC0000000;
+/* The handle table maps an object handle straight to its object. Slots are handed out
+ * oldest-freed first, so a handle to a closed object isn't reused any sooner than it has
+ * to be. obj_table_lock is only ever taken with the object's list lock already held. */
+static struct obj_slot *obj_pages[TSP_OBJ_MAX_PAGES];
+static UINT32 obj_num_slots = 0;
+static UINT32 obj_free_head = TSP_OBJ_SLOT_MASK;
+static UINT32 obj_free_tail = TSP_OBJ_SLOT_MASK;
 
-MUTEX_DECLARE_INIT(handle_lock);
+RWLOCK_DECLARE_INIT(obj_table_lock);
 
 TPM_LIST_DECLARE;
 CONTEXT_LIST_DECLARE;
@@ -64,19 +70,101 @@ __tspi_obj_list_init()
 	MIGDATA_LIST_INIT();
 }
 
-TSS_HOBJECT
-obj_get_next_handle()
+#define OBJ_SLOT(i)	(&obj_pages[(i) / TSP_OBJ_PAGE_SLOTS][(i) % TSP_OBJ_PAGE_SLOTS])
+
+/* return the object @handle refers to, or NULL. caller must hold obj_table_lock */
+static struct tsp_object *
+obj_table_lookup(UINT32 handle)
+{
+	UINT32 i = handle & TSP_OBJ_SLOT_MASK;
+	struct tsp_object *obj;
+
+	if ((handle & TSP_OBJ_HANDLE_BASE) != TSP_OBJ_HANDLE_BASE || i >= obj_num_slots)
+		return NULL;
+
+	if ((obj = OBJ_SLOT(i)->obj) == NULL || obj->handle != handle)
+		return NULL;
+
+	return obj;
+}
+
+/* put @obj in a free slot, adding a page of slots to the table if there are none, and
+ * give it the handle for that slot. caller must hold obj_table_lock for writing */
+static TSS_RESULT
+obj_table_add(struct tsp_object *obj)
+{
+	struct obj_slot *slot, *page;
+	UINT32 i;
+
+	if (obj_free_head == TSP_OBJ_SLOT_MASK) {
+		if (obj_num_slots == TSP_OBJ_MAX_PAGES * TSP_OBJ_PAGE_SLOTS) {
+			LogError("The object handle table is full.");
+			return TSPERR(TSS_E_OUTOFMEMORY);
+		}
+
+		if ((page = calloc(TSP_OBJ_PAGE_SLOTS, sizeof(struct obj_slot))) == NULL) {
+			LogError("malloc of %zd bytes failed.",
+				 TSP_OBJ_PAGE_SLOTS * sizeof(struct obj_slot));
+			return TSPERR(TSS_E_OUTOFMEMORY);
+		}
+
+		for (i = 0; i < TSP_OBJ_PAGE_SLOTS; i++)
+			page[i].next_free = obj_num_slots + i + 1;
+		page[TSP_OBJ_PAGE_SLOTS - 1].next_free = TSP_OBJ_SLOT_MASK;
+
+		obj_pages[obj_num_slots / TSP_OBJ_PAGE_SLOTS] = page;
+		obj_free_head = obj_num_slots;
+		obj_free_tail = obj_num_slots + TSP_OBJ_PAGE_SLOTS - 1;
+		obj_num_slots += TSP_OBJ_PAGE_SLOTS;
+	}
+
+	i = obj_free_head;
+	slot = OBJ_SLOT(i);
+	if ((obj_free_head = slot->next_free) == TSP_OBJ_SLOT_MASK)
+		obj_free_tail = TSP_OBJ_SLOT_MASK;
+
+	slot->obj = obj;
+	slot->children = NULL;
+	obj->handle = TSP_OBJ_HANDLE_BASE | (slot->gen << TSP_OBJ_SLOT_BITS) | i;
+
+	return TSS_SUCCESS;
+}
+
+/* take @obj out of the handle table, its context's chain and its list. caller must hold
+ * the list's lock and obj_table_lock for writing */
+static void
+obj_table_remove(struct tsp_object *obj)
 {
-	MUTEX_LOCK(handle_lock);
+	UINT32 i = obj->handle & TSP_OBJ_SLOT_MASK;
+	struct obj_slot *slot = OBJ_SLOT(i);
+	struct tsp_object *child;
+
+	/* anything still chained to a context that's going away is cut loose */
+	for (child = slot->children; child; child = child->ctx_next)
+		child->ctx_pprev = NULL;
 
-	/* return any object handle except NULL_HOBJECT */
-	do {
-		nextObjectHandle++;
-	} while (nextObjectHandle == NULL_HOBJECT);
+	slot->obj = NULL;
+	slot->children = NULL;
+	slot->gen = (slot->gen + 1) & TSP_OBJ_GEN_MASK;
+	slot->next_free = TSP_OBJ_SLOT_MASK;
 
-	MUTEX_UNLOCK(handle_lock);
+	if (obj_free_tail == TSP_OBJ_SLOT_MASK)
+		obj_free_head = i;
+	else
+		OBJ_SLOT(obj_free_tail)->next_free = i;
+	obj_free_tail = i;
+
+	if (obj->ctx_pprev) {
+		if ((*obj->ctx_pprev = obj->ctx_next))
+			obj->ctx_next->ctx_pprev = obj->ctx_pprev;
+	}
 
-	return nextObjectHandle;
+	if (obj->prev)
+		obj->prev->next = obj->next;
+	else
+		obj->list->head = obj->next;
+	if (obj->next)
+		obj->next->prev = obj->prev;
 }
 
 /* search through the provided list for an object with handle matching
@@ -91,10 +179,12 @@ obj_list_get_obj(struct obj_list *list, UINT32 handle)
 
 	MUTEX_LOCK(list->lock);
 
-	for (obj = list->head; obj; obj = obj->next) {
-		if (obj->handle == handle)
-			break;
-	}
+	/* an object on another list could be freed as soon as the table is unlocked, so
+	 * check which list it's on first */
+	RWLOCK_RDLOCK(obj_table_lock);
+	if ((obj = obj_table_lookup(handle)) && obj->list != list)
+		obj = NULL;
+	RWLOCK_UNLOCK(obj_table_lock);
 
 	if (obj == NULL)
 		MUTEX_UNLOCK(list->lock);
@@ -114,10 +204,18 @@ obj_list_get_tspcontext(struct obj_list *list, UINT32 tspContext)
 
 	MUTEX_LOCK(list->lock);
 
-	for (obj = list->head; obj; obj = obj->next) {
-		if (obj->tspContext == tspContext)
-			break;
+	RWLOCK_RDLOCK(obj_table_lock);
+	if ((obj = obj_table_lookup(tspContext)) && obj->list != list) {
+		for (obj = OBJ_SLOT(tspContext & TSP_OBJ_SLOT_MASK)->children; obj;
+		     obj = obj->ctx_next) {
+			if (obj->list == list)
+				break;
+		}
 	}
+	RWLOCK_UNLOCK(obj_table_lock);
+
+	if (obj == NULL)
+		MUTEX_UNLOCK(list->lock);
 
 	return obj;
 }
@@ -133,7 +231,8 @@ TSS_RESULT
 obj_list_add(struct obj_list *list, UINT32 tsp_context, TSS_FLAG flags, void *data,
 	     TSS_HOBJECT *phObject)
 {
-        struct tsp_object *new_obj, *tmp;
+        struct tsp_object *new_obj;
+	TSS_RESULT result;
 
         new_obj = calloc(1, sizeof(struct tsp_object));
         if (new_obj == NULL) {
@@ -141,24 +240,41 @@ obj_list_add(struct obj_list *list, UINT32 tsp_context, TSS_FLAG flags, void *da
                 return TSPERR(TSS_E_OUTOFMEMORY);
         }
 
-        new_obj->handle = obj_get_next_handle();
 	new_obj->flags = flags;
         new_obj->data = data;
+	new_obj->list = list;
+
+        MUTEX_LOCK(list->lock);
+	RWLOCK_WRLOCK(obj_table_lock);
+
+	if ((result = obj_table_add(new_obj))) {
+		RWLOCK_UNLOCK(obj_table_lock);
+		MUTEX_UNLOCK(list->lock);
+		free(new_obj);
+		return result;
+	}
 
 	if (list == &context_list)
 		new_obj->tspContext = new_obj->handle;
-	else
+	else {
 		new_obj->tspContext = tsp_context;
 
-        MUTEX_LOCK(list->lock);
+		/* chain the object to its context so that closing the context finds it */
+		if (obj_table_lookup(tsp_context)) {
+			struct obj_slot *slot = OBJ_SLOT(tsp_context & TSP_OBJ_SLOT_MASK);
 
-        if (list->head == NULL) {
-                list->head = new_obj;
-        } else {
-                tmp = list->head;
-                list->head = new_obj;
-                new_obj->next = tmp;
-        }
+			if ((new_obj->ctx_next = slot->children))
+				slot->children->ctx_pprev = &new_obj->ctx_next;
+			slot->children = new_obj;
+			new_obj->ctx_pprev = &slot->children;
+		}
+	}
+
+	RWLOCK_UNLOCK(obj_table_lock);
+
+	if ((new_obj->next = list->head))
+		list->head->prev = new_obj;
+	list->head = new_obj;
 
         MUTEX_UNLOCK(list->lock);
 
@@ -170,64 +286,69 @@ obj_list_add(struct obj_list *list, UINT32 tsp_context, TSS_FLAG flags, void *da
 TSS_RESULT
 obj_list_remove(struct obj_list *list, void (*freeFcn)(void *), TSS_HOBJECT hObject, TSS_HCONTEXT tspContext)
 {
-	struct tsp_object *obj, *prev = NULL;
+	struct tsp_object *obj;
 
 	MUTEX_LOCK(list->lock);
+	RWLOCK_WRLOCK(obj_table_lock);
 
-	for (obj = list->head; obj; prev = obj, obj = obj->next) {
-		if (obj->handle == hObject) {
-			/* validate tspContext */
-			if (obj->tspContext != tspContext)
-				break;
+	/* validate tspContext */
+	if ((obj = obj_table_lookup(hObject)) == NULL || obj->list != list ||
+	    obj->tspContext != tspContext) {
+		RWLOCK_UNLOCK(obj_table_lock);
+		MUTEX_UNLOCK(list->lock);
+		return TSPERR(TSS_E_INVALID_HANDLE);
+	}
 
-			(*freeFcn)(obj->data);
+	obj_table_remove(obj);
 
-			if (prev)
-				prev->next = obj->next;
-			else
-				list->head = obj->next;
-			free(obj);
+	RWLOCK_UNLOCK(obj_table_lock);
 
-			MUTEX_UNLOCK(list->lock);
-			return TSS_SUCCESS;
-		}
-	}
+	(*freeFcn)(obj->data);
+	free(obj);
 
 	MUTEX_UNLOCK(list->lock);
 
-	return TSPERR(TSS_E_INVALID_HANDLE);
+	return TSS_SUCCESS;
 }
 
 /* a generic routine for removing all members of a list who's tsp context
- * matches @tspContext */
+ * matches @tspContext. Only the objects chained to @tspContext are looked at,
+ * not the whole list */
 void
 obj_list_close(struct obj_list *list, void (*freeFcn)(void *), TSS_HCONTEXT tspContext)
 {
-	struct tsp_object *index;
-	struct tsp_object *next = NULL;
-	struct tsp_object *toKill;
-	struct tsp_object *prev = NULL;
+	struct tsp_object *index, *next, *ctx_obj;
+	struct tsp_object *toKill = NULL;
 
 	MUTEX_LOCK(list->lock);
+	RWLOCK_WRLOCK(obj_table_lock);
 
-	for (index = list->head; index; ) {
-		next = index->next;
-		if (index->tspContext == tspContext) {
+	if ((ctx_obj = obj_table_lookup(tspContext))) {
+		for (index = OBJ_SLOT(tspContext & TSP_OBJ_SLOT_MASK)->children; index;
+		     index = next) {
+			next = index->ctx_next;
+			if (index->list != list)
+				continue;
+
+			obj_table_remove(index);
+			index->next = toKill;
 			toKill = index;
-			if (prev == NULL) {
-				list->head = toKill->next;
-			} else {
-				prev->next = toKill->next;
-			}
-
-			(*freeFcn)(toKill->data);
-			free(toKill);
-
-			index = next;
-		} else {
-			prev = index;
-			index = next;
 		}
+
+		/* the context object itself, which must go after its children */
+		if (ctx_obj->list == list) {
+			obj_table_remove(ctx_obj);
+			ctx_obj->next = toKill;
+			toKill = ctx_obj;
+		}
+	}
+
+	RWLOCK_UNLOCK(obj_table_lock);
+
+	for (; toKill; toKill = next) {
+		next = toKill->next;
+		(*freeFcn)(toKill->data);
+		free(toKill);
 	}
 
 	MUTEX_UNLOCK(list->lock);
@@ -237,7 +358,6 @@ void
 obj_close_context(TSS_HCONTEXT tspContext)
 {
 	TPM_LIST_CLOSE(tspContext);
-	CONTEXT_LIST_CLOSE(tspContext);
 	HASH_LIST_CLOSE(tspContext);
 	PCRS_LIST_CLOSE(tspContext);
 	POLICY_LIST_CLOSE(tspContext);
@@ -249,6 +369,8 @@ obj_close_context(TSS_HCONTEXT tspContext)
 	NVSTORE_LIST_CLOSE(tspContext);
 	DELFAMILY_LIST_CLOSE(tspContext);
 	MIGDATA_LIST_CLOSE(tspContext);
+	/* last, since the other objects are found through the context's handle */
+	CONTEXT_LIST_CLOSE(tspContext);
 }
 
 /* When a policy object is closed, all references to it must be removed. This function
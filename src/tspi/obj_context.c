@@ -142,6 +142,9 @@ obj_context_close(TSS_HCONTEXT tspContext)
 	}
 #endif
 
+	/* the TCS closes the pooled auth sessions along with the TCS context */
+	context->num_auth_idle = context->num_auth_busy = 0;
+
 	obj_list_put(&context_list);
 }
 
@@ -1530,3 +1533,161 @@ obj_context_get_loadkey_ordinal(TSS_HCONTEXT tspContext, TPM_COMMAND_CODE *ordin
 	return TSS_SUCCESS;
 }
 
+
+static void
+auth_pool_add_busy(struct tr_context_obj *context, TPM_AUTH *auth, TSS_BOOL reused)
+{
+	struct tr_auth_pool_entry *e;
+
+	/* a session whose command failed before it got validated is never handed back. Forget
+	 * the oldest such record rather than let them fill up the busy list */
+	if (context->num_auth_busy == TSP_AUTH_POOL_SIZE) {
+		LogDebugFn("forgetting busy auth session %x", context->auth_busy[0].handle);
+		memmove(&context->auth_busy[0], &context->auth_busy[1],
+			(TSP_AUTH_POOL_SIZE - 1) * sizeof(struct tr_auth_pool_entry));
+		context->num_auth_busy--;
+	}
+
+	e = &context->auth_busy[context->num_auth_busy++];
+	e->handle = auth->AuthHandle;
+	memcpy(&e->nonce, &auth->NonceOdd, sizeof(TPM_NONCE));
+	e->reused = reused;
+}
+
+/* take the most recently used idle session of tspContext's pool for auth, whose NonceOdd must
+ * already be set. Returns FALSE if the pool has no idle session. */
+TSS_BOOL
+obj_context_auth_pool_get(TSS_HCONTEXT tspContext, TPM_AUTH *auth)
+{
+	struct tsp_object *obj;
+	struct tr_context_obj *context;
+	struct tr_auth_pool_entry *e;
+	TSS_BOOL answer = FALSE;
+
+	if ((obj = obj_list_get_obj(&context_list, tspContext)) == NULL)
+		return FALSE;
+
+	context = (struct tr_context_obj *)obj->data;
+
+	if (context->num_auth_idle > 0) {
+		e = &context->auth_idle[--context->num_auth_idle];
+		auth->AuthHandle = e->handle;
+		memcpy(&auth->NonceEven, &e->nonce, sizeof(TPM_NONCE));
+		auth_pool_add_busy(context, auth, TRUE);
+		answer = TRUE;
+	}
+
+	obj_list_put(&context_list);
+
+	return answer;
+}
+
+/* record auth, a session that was just opened, as belonging to tspContext's pool */
+void
+obj_context_auth_pool_busy(TSS_HCONTEXT tspContext, TPM_AUTH *auth)
+{
+	struct tsp_object *obj;
+
+	if ((obj = obj_list_get_obj(&context_list, tspContext)) == NULL)
+		return;
+
+	auth_pool_add_busy((struct tr_context_obj *)obj->data, auth, FALSE);
+
+	obj_list_put(&context_list);
+}
+
+/* the command that auth was used for is done. Returns TRUE if auth is a session of
+ * tspContext's pool, setting *reused to whether it had been used for a command before. */
+TSS_BOOL
+obj_context_auth_pool_done(TSS_HCONTEXT tspContext, TPM_AUTH *auth, TSS_BOOL *reused)
+{
+	struct tsp_object *obj;
+	struct tr_context_obj *context;
+	TSS_BOOL answer = FALSE;
+	UINT32 i;
+
+	if ((obj = obj_list_get_obj(&context_list, tspContext)) == NULL)
+		return FALSE;
+
+	context = (struct tr_context_obj *)obj->data;
+
+	/* the NonceOdd tells the pool's session apart from one the caller opened itself under a
+	 * handle that was recycled */
+	for (i = 0; i < context->num_auth_busy; i++) {
+		if (context->auth_busy[i].handle == auth->AuthHandle &&
+		    !memcmp(&context->auth_busy[i].nonce, &auth->NonceOdd, sizeof(TPM_NONCE))) {
+			*reused = context->auth_busy[i].reused;
+			memmove(&context->auth_busy[i], &context->auth_busy[i + 1],
+				(context->num_auth_busy - i - 1) *
+				sizeof(struct tr_auth_pool_entry));
+			context->num_auth_busy--;
+			answer = TRUE;
+			break;
+		}
+	}
+
+	obj_list_put(&context_list);
+
+	return answer;
+}
+
+/* make auth, continued by the TPM with a new NonceEven, an idle session of tspContext's pool.
+ * If the pool already holds limit idle sessions, its least recently used session is evicted to
+ * make room for auth and TRUE is returned with the session to terminate in *evicted. */
+TSS_BOOL
+obj_context_auth_pool_put(TSS_HCONTEXT tspContext, TPM_AUTH *auth, UINT32 limit,
+			  TCS_AUTHHANDLE *evicted)
+{
+	struct tsp_object *obj;
+	struct tr_context_obj *context;
+	struct tr_auth_pool_entry *e;
+	TSS_BOOL answer = FALSE;
+
+	if ((obj = obj_list_get_obj(&context_list, tspContext)) == NULL) {
+		*evicted = auth->AuthHandle;
+		return TRUE;
+	}
+
+	context = (struct tr_context_obj *)obj->data;
+
+	if (context->num_auth_idle >= MIN(MAX(limit, 1U), (UINT32)TSP_AUTH_POOL_SIZE)) {
+		*evicted = context->auth_idle[0].handle;
+		memmove(&context->auth_idle[0], &context->auth_idle[1],
+			(context->num_auth_idle - 1) * sizeof(struct tr_auth_pool_entry));
+		context->num_auth_idle--;
+		answer = TRUE;
+	}
+
+	e = &context->auth_idle[context->num_auth_idle++];
+	e->handle = auth->AuthHandle;
+	memcpy(&e->nonce, &auth->NonceEven, sizeof(TPM_NONCE));
+	e->reused = TRUE;
+
+	obj_list_put(&context_list);
+
+	return answer;
+}
+
+/* take all the idle sessions out of tspContext's pool, returning how many were put in handles[],
+ * which has room for TSP_AUTH_POOL_SIZE. The caller terminates them. */
+UINT32
+obj_context_auth_pool_flush(TSS_HCONTEXT tspContext, TCS_AUTHHANDLE *handles)
+{
+	struct tsp_object *obj;
+	struct tr_context_obj *context;
+	UINT32 i, num;
+
+	if ((obj = obj_list_get_obj(&context_list, tspContext)) == NULL)
+		return 0;
+
+	context = (struct tr_context_obj *)obj->data;
+
+	num = context->num_auth_idle;
+	for (i = 0; i < num; i++)
+		handles[i] = context->auth_idle[i].handle;
+	context->num_auth_idle = 0;
+
+	obj_list_put(&context_list);
+
+	return num;
+}
@@ -106,6 +106,7 @@ obj_hash_set_value(TSS_HHASH hHash, UINT32 size, BYTE *value)
 	}
 	hash->hashSize = size;
 	memcpy(hash->hashData, value, size);
+	hash->hashUpdatePending = FALSE;
 
 done:
 	obj_list_put(&hash_list);
@@ -125,6 +126,26 @@ obj_hash_get_value(TSS_HHASH hHash, UINT32 *size, BYTE **value)
 
 	hash = (struct tr_hash_obj *)obj->data;
 
+	if (hash->hashUpdatePending) {
+		/* finish a copy of the running hash, so that more data can still be added */
+		Trspi_HashCtx snapshot;
+
+		if (hash->hashData == NULL) {
+			hash->hashData = calloc(1, TCPA_SHA1_160_HASH_LEN);
+			if (hash->hashData == NULL) {
+				LogError("malloc of %d bytes failed.", TCPA_SHA1_160_HASH_LEN);
+				result = TSPERR(TSS_E_OUTOFMEMORY);
+				goto done;
+			}
+		}
+
+		if ((result = Trspi_HashCopy(&snapshot, &hash->hashUpdateCtx)))
+			goto done;
+		if ((result = Trspi_HashFinal(&snapshot, hash->hashData)))
+			goto done;
+		hash->hashUpdatePending = FALSE;
+	}
+
 	if (hash->hashData == NULL) {
 		result = TSPERR(TSS_E_HASH_NO_DATA);
 		goto done;
@@ -162,38 +183,16 @@ obj_hash_update_value(TSS_HHASH hHash, UINT32 size, BYTE *data)
 		goto done;
 	}
 
-	if (hash->hashUpdateBuffer == NULL) {
-		hash->hashUpdateBuffer = calloc(1, size);
-		if (hash->hashUpdateBuffer == NULL) {
-			LogError("malloc of %u bytes failed.", size);
-			result = TSPERR(TSS_E_OUTOFMEMORY);
-			goto done;
-		}
-	} else {
-		hash->hashUpdateBuffer = realloc(hash->hashUpdateBuffer,
-				size + hash->hashUpdateSize);
-
-		if (hash->hashUpdateBuffer == NULL) {
-			LogError("malloc of %u bytes failed.", size + hash->hashUpdateSize);
-			result = TSPERR(TSS_E_OUTOFMEMORY);
-			goto done;
-		}
-	}
-
-	memcpy(&hash->hashUpdateBuffer[hash->hashUpdateSize], data, size);
-	hash->hashUpdateSize += size;
+	/* the data is hashed as it arrives and the digest is only produced when it's asked
+	 * for, in obj_hash_get_value() */
+	if (hash->hashUpdateCtx.ctx == NULL &&
+	    (result = Trspi_HashInit(&hash->hashUpdateCtx, TSS_HASH_SHA1)))
+		goto done;
 
-	if (hash->hashData == NULL) {
-		hash->hashData = calloc(1, TCPA_SHA1_160_HASH_LEN);
-		if (hash->hashData == NULL) {
-			LogError("malloc of %d bytes failed.", TCPA_SHA1_160_HASH_LEN);
-			result = TSPERR(TSS_E_OUTOFMEMORY);
-			goto done;
-		}
-	}
+	if ((result = Trspi_HashUpdate(&hash->hashUpdateCtx, size, data)))
+		goto done;
 
-	result = Trspi_Hash(TSS_HASH_SHA1, hash->hashUpdateSize, hash->hashUpdateBuffer,
-			    hash->hashData);
+	hash->hashUpdatePending = TRUE;
 
 done:
 	obj_list_put(&hash_list);
@@ -207,7 +206,12 @@ __tspi_hash_free(void *data)
 	struct tr_hash_obj *hash = (struct tr_hash_obj *)data;
 
 	free(hash->hashData);
-	free(hash->hashUpdateBuffer);
+	if (hash->hashUpdateCtx.ctx) {
+		BYTE digest[TCPA_SHA1_160_HASH_LEN];
+
+		/* finishing the hash is the only way to release its context */
+		Trspi_HashFinal(&hash->hashUpdateCtx, digest);
+	}
 	free(hash);
 }
 
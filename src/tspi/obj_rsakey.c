@@ -23,6 +23,20 @@
 #include "tsplog.h"
 #include "obj.h"
 
+#ifdef TSS_BUILD_ASYM_CRYPTO
+/* drop the cached OpenSSL key once the public key it was built from changes */
+static void
+rsakey_flush_pub_rsa(struct tr_rsakey_obj *rsakey)
+{
+	if (rsakey->pubKeyCache) {
+		__tspi_rsa_pubkey_put(rsakey->pubKeyCache);
+		rsakey->pubKeyCache = NULL;
+	}
+}
+#else
+#define rsakey_flush_pub_rsa(rsakey)
+#endif
+
 TSS_RESULT
 obj_rsakey_add(TSS_HCONTEXT tspContext, TSS_FLAG initFlags, TSS_HOBJECT *phObject)
 {
@@ -281,6 +295,7 @@ obj_rsakey_set_size(TSS_HKEY hKey, UINT32 len)
 	}
 
 	rsakey = (struct tr_rsakey_obj *)obj->data;
+	rsakey_flush_pub_rsa(rsakey);
 	rsakey->key.pubKey.keyLength = len/8;
 done:
 	obj_list_put(&rsakey_list);
@@ -1187,6 +1202,8 @@ obj_rsakey_set_modulus(TSS_HKEY hKey, UINT32 size, BYTE *data)
 	}
 	rsakey->key.pubKey.keyLength = size;
 	memcpy(rsakey->key.pubKey.key, data, size);
+	free(free_ptr);
+	rsakey_flush_pub_rsa(rsakey);
 
 done:
 	obj_list_put(&rsakey_list);
@@ -1194,6 +1211,59 @@ done:
 	return result;
 }
 
+#ifdef TSS_BUILD_ASYM_CRYPTO
+/* Return a reference to an OpenSSL object for the key's public key, building it on first
+ * use, along with the TPM key fields that decide how it may be used. Any of usage, es and
+ * size may be NULL. Release the object with __tspi_rsa_pubkey_put(). */
+TSS_RESULT
+obj_rsakey_get_pub_rsa(TSS_HKEY hKey, UINT16 *usage, UINT16 *es, UINT32 *size, void **rsa)
+{
+	struct tsp_object *obj;
+	struct tr_rsakey_obj *rsakey;
+	TSS_RESULT result = TSS_SUCCESS;
+
+	if ((obj = obj_list_get_obj(&rsakey_list, hKey)) == NULL)
+		return TSPERR(TSS_E_INVALID_HANDLE);
+
+	rsakey = (struct tr_rsakey_obj *)obj->data;
+
+	if (rsakey->pubKeyCache == NULL) {
+		/* as in obj_rsakey_get_pub_blob(), don't use an SRK public key that hasn't
+		 * been read from the TPM yet */
+		if (rsakey->tcsHandle == TPM_KEYHND_SRK) {
+			BYTE zeroBlob[2048] = { 0, };
+
+			if (!memcmp(rsakey->key.pubKey.key, zeroBlob,
+				    rsakey->key.pubKey.keyLength)) {
+				result = TSPERR(TSS_E_BAD_PARAMETER);
+				goto done;
+			}
+		}
+
+		rsakey->pubKeyCache = __tspi_rsa_pubkey_new(rsakey->key.pubKey.key,
+							    rsakey->key.pubKey.keyLength);
+		if (rsakey->pubKeyCache == NULL) {
+			result = TSPERR(TSS_E_INTERNAL_ERROR);
+			goto done;
+		}
+	}
+
+	__tspi_rsa_pubkey_get(rsakey->pubKeyCache);
+	*rsa = rsakey->pubKeyCache;
+
+	if (usage)
+		*usage = rsakey->key.keyUsage;
+	if (es)
+		*es = rsakey->key.algorithmParms.encScheme;
+	if (size)
+		*size = rsakey->key.pubKey.keyLength;
+done:
+	obj_list_put(&rsakey_list);
+
+	return result;
+}
+#endif
+
 TSS_RESULT
 obj_rsakey_get_pub_blob(TSS_HKEY hKey, UINT32 *size, BYTE **data)
 {
@@ -1482,6 +1552,7 @@ obj_rsakey_set_tcpakey(TSS_HKEY hKey, UINT32 size, BYTE *data)
 	rsakey = (struct tr_rsakey_obj *)obj->data;
 
 	free_key_refs(&rsakey->key);
+	rsakey_flush_pub_rsa(rsakey);
 
 	offset = 0;
 	if ((result = UnloadBlob_TSS_KEY(&offset, data, &rsakey->key)))
@@ -1687,6 +1758,7 @@ rsakey_set_pubkey(struct tr_rsakey_obj *rsakey, BYTE *pubkey)
 
 	free(rsakey->key.pubKey.key);
 	free(rsakey->key.algorithmParms.parms);
+	rsakey_flush_pub_rsa(rsakey);
 
 	memcpy(&rsakey->key.pubKey, &pub.pubKey, sizeof(TPM_STORE_PUBKEY));
 	memcpy(&rsakey->key.algorithmParms, &pub.algorithmParms, sizeof(TPM_KEY_PARMS));
@@ -1824,6 +1896,7 @@ __tspi_rsakey_free(void *data)
 	free(rsakey->key.encData);
 	free(rsakey->key.PCRInfo);
 	free(rsakey->key.pubKey.key);
+	rsakey_flush_pub_rsa(rsakey);
 	free(rsakey);
 }
 
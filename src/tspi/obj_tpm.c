@@ -26,7 +26,11 @@ void
 tpm_free(void *data)
 {
 	struct tr_tpm_obj *tpm = (struct tr_tpm_obj *)data;
+	UINT32 i;
 
+	for (i = 0; i < tpm->num_replay_pcrs; i++)
+		free(tpm->replay[i].values);
+	free(tpm->replay);
 	free(tpm);
 }
 
@@ -529,3 +533,144 @@ done:
 }
 #endif
 
+
+#ifdef TSS_BUILD_PCR_EVENTS
+/* get how many of pcr's events have been replayed so far and the value they extend it to. A
+ * PCR that hasn't been replayed yet has no events and a value of all zeros. */
+TSS_RESULT
+obj_tpm_get_replay(TSS_HTPM hTPM, UINT32 pcr, UINT32 *num_events, TPM_DIGEST *value)
+{
+	struct tsp_object *obj;
+	struct tr_tpm_obj *tpm;
+	struct tr_evlog_replay *tmp;
+	TSS_RESULT result = TSS_SUCCESS;
+
+	if ((obj = obj_list_get_obj(&tpm_list, hTPM)) == NULL)
+		return TSPERR(TSS_E_INVALID_HANDLE);
+
+	tpm = (struct tr_tpm_obj *)obj->data;
+
+	if (pcr >= tpm->num_replay_pcrs) {
+		if ((tmp = realloc(tpm->replay, (pcr + 1) * sizeof(struct tr_evlog_replay)))
+		    == NULL) {
+			LogError("malloc of %zd bytes failed.",
+				 (pcr + 1) * sizeof(struct tr_evlog_replay));
+			result = TSPERR(TSS_E_OUTOFMEMORY);
+			goto done;
+		}
+		memset(&tmp[tpm->num_replay_pcrs], 0,
+		       (pcr + 1 - tpm->num_replay_pcrs) * sizeof(struct tr_evlog_replay));
+		tpm->replay = tmp;
+		tpm->num_replay_pcrs = pcr + 1;
+	}
+
+	*num_events = tpm->replay[pcr].num_events;
+	if (*num_events)
+		memcpy(value, &tpm->replay[pcr].values[tpm->replay[pcr].num_values - 1],
+		       sizeof(TPM_DIGEST));
+	else
+		__tspi_memset(value, 0, sizeof(TPM_DIGEST));
+done:
+	obj_list_put(&tpm_list);
+
+	return result;
+}
+
+/* store the result of replaying pcr's events first through num_events - 1, whose values
+ * are in values[]. Anything replayed before from event first on is dropped, and so are all
+ * but the last TR_EVLOG_REPLAY_HISTORY values. If another thread has moved the replay on from
+ * old_num_events in the meantime, its result is kept instead. */
+TSS_RESULT
+obj_tpm_set_replay(TSS_HTPM hTPM, UINT32 pcr, UINT32 old_num_events, UINT32 first,
+		   UINT32 num_events, TPM_DIGEST *values)
+{
+	struct tsp_object *obj;
+	struct tr_tpm_obj *tpm;
+	struct tr_evlog_replay *replay;
+	TPM_DIGEST *tmp;
+	UINT32 base, keep, total, drop;
+	TSS_RESULT result = TSS_SUCCESS;
+
+	if ((obj = obj_list_get_obj(&tpm_list, hTPM)) == NULL)
+		return TSPERR(TSS_E_INVALID_HANDLE);
+
+	tpm = (struct tr_tpm_obj *)obj->data;
+
+	if (pcr >= tpm->num_replay_pcrs || tpm->replay[pcr].num_events != old_num_events ||
+	    first > old_num_events || num_events < first)
+		goto done;
+
+	replay = &tpm->replay[pcr];
+
+	if (num_events == 0) {
+		free(replay->values);
+		replay->values = NULL;
+		replay->num_events = replay->num_values = 0;
+		goto done;
+	}
+
+	/* keep the stored values of the events before first, then add the new ones and drop
+	 * the oldest of them all over the limit */
+	base = replay->num_events - replay->num_values;
+	keep = first > base ? first - base : 0;
+	total = keep + num_events - first;
+	drop = total > TR_EVLOG_REPLAY_HISTORY ? total - TR_EVLOG_REPLAY_HISTORY : 0;
+
+	if ((tmp = malloc((total - drop) * sizeof(TPM_DIGEST))) == NULL) {
+		LogError("malloc of %zd bytes failed.", (total - drop) * sizeof(TPM_DIGEST));
+		result = TSPERR(TSS_E_OUTOFMEMORY);
+		goto done;
+	}
+
+	if (drop < keep) {
+		memcpy(tmp, &replay->values[drop], (keep - drop) * sizeof(TPM_DIGEST));
+		memcpy(&tmp[keep - drop], values, (num_events - first) * sizeof(TPM_DIGEST));
+	} else
+		memcpy(tmp, &values[drop - keep], (total - drop) * sizeof(TPM_DIGEST));
+
+	free(replay->values);
+	replay->values = tmp;
+	replay->num_values = total - drop;
+	replay->num_events = num_events;
+done:
+	obj_list_put(&tpm_list);
+
+	return result;
+}
+
+/* return a copy of the values pcr has been replayed through, which the caller frees. The
+ * last of the *num_values values is the one after all *num_events events replayed so far. */
+TSS_RESULT
+obj_tpm_get_replay_values(TSS_HTPM hTPM, UINT32 pcr, UINT32 *num_events, UINT32 *num_values,
+			  TPM_DIGEST **values)
+{
+	struct tsp_object *obj;
+	struct tr_tpm_obj *tpm;
+	TSS_RESULT result = TSS_SUCCESS;
+
+	if ((obj = obj_list_get_obj(&tpm_list, hTPM)) == NULL)
+		return TSPERR(TSS_E_INVALID_HANDLE);
+
+	tpm = (struct tr_tpm_obj *)obj->data;
+
+	*num_events = *num_values = 0;
+	*values = NULL;
+	if (pcr >= tpm->num_replay_pcrs || tpm->replay[pcr].num_events == 0)
+		goto done;
+
+	if ((*values = malloc(tpm->replay[pcr].num_values * sizeof(TPM_DIGEST))) == NULL) {
+		LogError("malloc of %zd bytes failed.",
+			 tpm->replay[pcr].num_values * sizeof(TPM_DIGEST));
+		result = TSPERR(TSS_E_OUTOFMEMORY);
+		goto done;
+	}
+
+	*num_events = tpm->replay[pcr].num_events;
+	*num_values = tpm->replay[pcr].num_values;
+	memcpy(*values, tpm->replay[pcr].values, *num_values * sizeof(TPM_DIGEST));
+done:
+	obj_list_put(&tpm_list);
+
+	return result;
+}
+#endif
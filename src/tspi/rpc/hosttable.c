@@ -14,6 +14,7 @@
 #include <string.h>
 
 #include "trousers/tss.h"
+#include "trousers/trousers.h"
 #include "trousers_types.h"
 #include "tsplog.h"
 #include "hosttable.h"
@@ -21,9 +22,17 @@
 
 static struct host_table *ht = NULL;
 
+static struct host_table_bucket *
+host_table_bucket(TSS_HCONTEXT tspContext)
+{
+	return &ht->buckets[((tspContext * 2654435761U) >> 24) & (HOST_TABLE_BUCKETS - 1)];
+}
+
 TSS_RESULT
 host_table_init()
 {
+	int i;
+
 	ht = calloc(1, sizeof(struct host_table));
 	if (ht == NULL) {
 		LogError("malloc of %zd bytes failed.", sizeof(struct host_table));
@@ -31,6 +40,8 @@ host_table_init()
 	}
 
 	MUTEX_INIT(ht->lock);
+	for (i = 0; i < HOST_TABLE_BUCKETS; i++)
+		MUTEX_INIT(ht->buckets[i].lock);
 
 	return TSS_SUCCESS;
 }
@@ -50,17 +61,19 @@ void
 host_table_final()
 {
 	struct host_table_entry *hte, *next = NULL;
+	int i;
 
 	MUTEX_LOCK(ht->lock);
 
-	for (hte = ht->entries; hte; hte = next) {
-		if (hte)
+	for (i = 0; i < HOST_TABLE_BUCKETS; i++) {
+		for (hte = ht->buckets[i].entries; hte; hte = next) {
 			next = hte->next;
-		if (hte->hostname)
-			free(hte->hostname);
-		if (hte->comm.buf)
-			free(hte->comm.buf);
-		free(hte);
+			if (hte->hostname)
+				free(hte->hostname);
+			if (hte->comm.buf)
+				free(hte->comm.buf);
+			free(hte);
+		}
 	}
 
 	MUTEX_UNLOCK(ht->lock);
@@ -83,6 +96,7 @@ TSS_RESULT
 __tspi_add_table_entry(TSS_HCONTEXT tspContext, BYTE *host, int type, struct host_table_entry **ret)
 {
     struct host_table_entry *entry, *tmp;
+    struct host_table_bucket *bucket;
     int hostlen;
 
     entry = calloc(1, sizeof(struct host_table_entry));
@@ -112,11 +126,15 @@ __tspi_add_table_entry(TSS_HCONTEXT tspContext, BYTE *host, int type, struct hos
     }
     MUTEX_INIT(entry->lock);
 
+	bucket = host_table_bucket(tspContext);
+
 	MUTEX_LOCK(ht->lock);
+	MUTEX_LOCK(bucket->lock);
 
-	for (tmp = ht->entries; tmp; tmp = tmp->next) {
+	for (tmp = bucket->entries; tmp; tmp = tmp->next) {
 		if (tmp->tspContext == tspContext) {
 			LogError("Tspi_Context_Connect attempted on an already connected context!");
+			MUTEX_UNLOCK(bucket->lock);
 			MUTEX_UNLOCK(ht->lock);
 			free(entry->hostname);
 			free(entry->comm.buf);
@@ -125,13 +143,10 @@ __tspi_add_table_entry(TSS_HCONTEXT tspContext, BYTE *host, int type, struct hos
 		}
 	}
 
-	if( ht->entries == NULL ) {
-		ht->entries = entry;
-	} else {
-		for (tmp = ht->entries; tmp->next; tmp = tmp->next)
-			;
-		tmp->next = entry;
-	}
+	entry->next = bucket->entries;
+	bucket->entries = entry;
+
+	MUTEX_UNLOCK(bucket->lock);
 	MUTEX_UNLOCK(ht->lock);
 
 	*ret = entry;
@@ -142,16 +157,18 @@ __tspi_add_table_entry(TSS_HCONTEXT tspContext, BYTE *host, int type, struct hos
 void
 remove_table_entry(TSS_HCONTEXT tspContext)
 {
+	struct host_table_bucket *bucket = host_table_bucket(tspContext);
 	struct host_table_entry *hte, *prev = NULL;
 
 	MUTEX_LOCK(ht->lock);
+	MUTEX_LOCK(bucket->lock);
 
-	for (hte = ht->entries; hte; prev = hte, hte = hte->next) {
+	for (hte = bucket->entries; hte; prev = hte, hte = hte->next) {
 		if (hte->tspContext == tspContext) {
 			if (prev != NULL)
 				prev->next = hte->next;
 			else
-				ht->entries = hte->next;
+				bucket->entries = hte->next;
 			if (hte->hostname)
 				free(hte->hostname);
 			free(hte->comm.buf);
@@ -160,17 +177,19 @@ remove_table_entry(TSS_HCONTEXT tspContext)
 		}
 	}
 
+	MUTEX_UNLOCK(bucket->lock);
 	MUTEX_UNLOCK(ht->lock);
 }
 
 struct host_table_entry *
 get_table_entry(TSS_HCONTEXT tspContext)
 {
+	struct host_table_bucket *bucket = host_table_bucket(tspContext);
 	struct host_table_entry *index = NULL;
 
-	MUTEX_LOCK(ht->lock);
+	MUTEX_LOCK(bucket->lock);
 
-	for (index = ht->entries; index; index = index->next) {
+	for (index = bucket->entries; index; index = index->next) {
 		if (index->tspContext == tspContext)
 			break;
 	}
@@ -178,7 +197,7 @@ get_table_entry(TSS_HCONTEXT tspContext)
 	if (index)
 		MUTEX_LOCK(index->lock);
 
-	MUTEX_UNLOCK(ht->lock);
+	MUTEX_UNLOCK(bucket->lock);
 
 	return index;
 }
@@ -233,6 +233,33 @@ TSS_RESULT RPC_GetPcrEventLog(TSS_HCONTEXT tspContext,	/* in */
 	return result;
 }
 
+TSS_RESULT RPC_GetPcrEventLogPage(TSS_HCONTEXT tspContext,	/* in */
+				  UINT32 * pPcrIndex,		/* in, out */
+				  UINT32 * pEventIndex,	/* in, out */
+				  UINT32 MaxBytes,		/* in */
+				  UINT32 * pEventCount,	/* in, out */
+				  TSS_PCR_EVENT ** ppEvents)	/* out */
+{
+	TSS_RESULT result = (TSS_E_INTERNAL_ERROR | TSS_LAYER_TSP);
+	struct host_table_entry *entry = get_table_entry(tspContext);
+
+	if (entry == NULL)
+		return TSPERR(TSS_E_NO_CONNECTION);
+
+	switch (entry->type) {
+		case CONNECTION_TYPE_TCP_PERSISTANT:
+			result = RPC_GetPcrEventLogPage_TP(entry, pPcrIndex, pEventIndex, MaxBytes,
+							   pEventCount, ppEvents);
+			break;
+		default:
+			break;
+	}
+
+	put_table_entry(entry);
+
+	return result;
+}
+
 TSS_RESULT RPC_RegisterKey(TSS_HCONTEXT tspContext,	/* in */
 			   TSS_UUID WrappingKeyUUID,	/* in */
 			   TSS_UUID KeyUUID,	/* in */
@@ -928,6 +955,30 @@ TSS_RESULT RPC_PcrRead(TSS_HCONTEXT tspContext,	/* in */
 	return result;
 }
 
+TSS_RESULT RPC_PcrReadBatch(TSS_HCONTEXT tspContext,	/* in */
+			    UINT32 count,		/* in */
+			    UINT32 * pcrNums,		/* in */
+			    TCPA_PCRVALUE * outDigests)	/* out */
+{
+	TSS_RESULT result = (TSS_E_INTERNAL_ERROR | TSS_LAYER_TSP);
+	struct host_table_entry *entry = get_table_entry(tspContext);
+
+	if (entry == NULL)
+		return TSPERR(TSS_E_NO_CONNECTION);
+
+	switch (entry->type) {
+		case CONNECTION_TYPE_TCP_PERSISTANT:
+			result = RPC_PcrReadBatch_TP(entry, count, pcrNums, outDigests);
+			break;
+		default:
+			break;
+	}
+
+	put_table_entry(entry);
+
+	return result;
+}
+
 TSS_RESULT RPC_PcrReset(TSS_HCONTEXT tspContext,	/* in */
 			UINT32 pcrDataSizeIn,		/* in */
 			BYTE * pcrDataIn)		/* in */
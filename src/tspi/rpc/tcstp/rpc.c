@@ -248,19 +248,42 @@ getData(TCSD_PACKET_TYPE dataType,
 	return TSS_SUCCESS;
 }
 
+/* write the request header into the front of the comm buffer */
+static void
+loadHeader(struct tcsd_comm_data *comm)
+{
+	UINT64 offset = 0;
+
+	Trspi_LoadBlob_UINT32(&offset, comm->hdr.packet_size, comm->buf);
+	Trspi_LoadBlob_UINT32(&offset, comm->hdr.u.ordinal, comm->buf);
+	Trspi_LoadBlob_UINT32(&offset, comm->hdr.num_parms, comm->buf);
+	Trspi_LoadBlob_UINT32(&offset, comm->hdr.type_size, comm->buf);
+	Trspi_LoadBlob_UINT32(&offset, comm->hdr.type_offset, comm->buf);
+	Trspi_LoadBlob_UINT32(&offset, comm->hdr.parm_size, comm->buf);
+	Trspi_LoadBlob_UINT32(&offset, comm->hdr.parm_offset, comm->buf);
+}
+
+/* create a platform version of the reply header in the comm buffer */
+static void
+unloadHeader(struct tcsd_comm_data *comm)
+{
+	UINT64 offset = 0;
+
+	Trspi_UnloadBlob_UINT32(&offset, &comm->hdr.packet_size, comm->buf);
+	Trspi_UnloadBlob_UINT32(&offset, &comm->hdr.u.result, comm->buf);
+	Trspi_UnloadBlob_UINT32(&offset, &comm->hdr.num_parms, comm->buf);
+	Trspi_UnloadBlob_UINT32(&offset, &comm->hdr.type_size, comm->buf);
+	Trspi_UnloadBlob_UINT32(&offset, &comm->hdr.type_offset, comm->buf);
+	Trspi_UnloadBlob_UINT32(&offset, &comm->hdr.parm_size, comm->buf);
+	Trspi_UnloadBlob_UINT32(&offset, &comm->hdr.parm_offset, comm->buf);
+}
+
 TSS_RESULT
 sendTCSDPacket(struct host_table_entry *hte)
 {
 	TSS_RESULT rc;
-	UINT64 offset = 0;
 
-	Trspi_LoadBlob_UINT32(&offset, hte->comm.hdr.packet_size, hte->comm.buf);
-	Trspi_LoadBlob_UINT32(&offset, hte->comm.hdr.u.ordinal, hte->comm.buf);
-	Trspi_LoadBlob_UINT32(&offset, hte->comm.hdr.num_parms, hte->comm.buf);
-	Trspi_LoadBlob_UINT32(&offset, hte->comm.hdr.type_size, hte->comm.buf);
-	Trspi_LoadBlob_UINT32(&offset, hte->comm.hdr.type_offset, hte->comm.buf);
-	Trspi_LoadBlob_UINT32(&offset, hte->comm.hdr.parm_size, hte->comm.buf);
-	Trspi_LoadBlob_UINT32(&offset, hte->comm.hdr.parm_offset, hte->comm.buf);
+	loadHeader(&hte->comm);
 
 #if 0
 	/* ---  Send it */
@@ -283,14 +306,73 @@ sendTCSDPacket(struct host_table_entry *hte)
 	}
 
 	/* create a platform version of the tcsd header */
-	offset = 0;
-	Trspi_UnloadBlob_UINT32(&offset, &hte->comm.hdr.packet_size, hte->comm.buf);
-	Trspi_UnloadBlob_UINT32(&offset, &hte->comm.hdr.u.result, hte->comm.buf);
-	Trspi_UnloadBlob_UINT32(&offset, &hte->comm.hdr.num_parms, hte->comm.buf);
-	Trspi_UnloadBlob_UINT32(&offset, &hte->comm.hdr.type_size, hte->comm.buf);
-	Trspi_UnloadBlob_UINT32(&offset, &hte->comm.hdr.type_offset, hte->comm.buf);
-	Trspi_UnloadBlob_UINT32(&offset, &hte->comm.hdr.parm_size, hte->comm.buf);
-	Trspi_UnloadBlob_UINT32(&offset, &hte->comm.hdr.parm_offset, hte->comm.buf);
+	unloadHeader(&hte->comm);
+
+	return TSS_SUCCESS;
+}
+
+/*
+ * Send up to TCSD_BATCH_MAX_REQS requests to the TCSD in one TCSD_ORD_BATCH packet. Each
+ * of reqs[] is built with initData()/setData() as for sendTCSDPacket(), but in its own
+ * comm buffer (start with buf == NULL and buf_size == 0). On success each of reqs[] holds
+ * its reply, ready for getData(), and its hdr.u.result must be checked separately. The
+ * caller frees the reqs[] buffers.
+ */
+TSS_RESULT
+sendTCSDBatch(struct host_table_entry *hte, UINT32 count, struct tcsd_comm_data *reqs)
+{
+	TSS_RESULT result;
+	UINT32 i, size;
+	BYTE *buffer;
+
+	if (count == 0 || count > TCSD_BATCH_MAX_REQS)
+		return TSPERR(TSS_E_BAD_PARAMETER);
+
+	initData(&hte->comm, 1 + (2 * count));
+	hte->comm.hdr.u.ordinal = TCSD_ORD_BATCH;
+
+	if (setData(TCSD_PACKET_TYPE_UINT32, 0, &count, 0, &hte->comm))
+		return TSPERR(TSS_E_INTERNAL_ERROR);
+	for (i = 0; i < count; i++) {
+		loadHeader(&reqs[i]);
+		if (setData(TCSD_PACKET_TYPE_UINT32, 1 + (2 * i), &reqs[i].hdr.packet_size, 0,
+			    &hte->comm))
+			return TSPERR(TSS_E_INTERNAL_ERROR);
+		if (setData(TCSD_PACKET_TYPE_PBYTE, 2 + (2 * i), reqs[i].buf,
+			    reqs[i].hdr.packet_size, &hte->comm))
+			return TSPERR(TSS_E_INTERNAL_ERROR);
+	}
+
+	if ((result = sendTCSDPacket(hte)))
+		return result;
+
+	if ((result = hte->comm.hdr.u.result))
+		return result;
+
+	if (getData(TCSD_PACKET_TYPE_UINT32, 0, &size, 0, &hte->comm) || size != count)
+		return TSPERR(TSS_E_INTERNAL_ERROR);
+
+	for (i = 0; i < count; i++) {
+		if (getData(TCSD_PACKET_TYPE_UINT32, 1 + (2 * i), &size, 0, &hte->comm) ||
+		    size < sizeof(struct tcsd_packet_hdr) || size > hte->comm.hdr.parm_size)
+			return TSPERR(TSS_E_INTERNAL_ERROR);
+
+		if (size > reqs[i].buf_size) {
+			if ((buffer = realloc(reqs[i].buf, size)) == NULL) {
+				LogError("realloc of %u bytes failed.", size);
+				return TSPERR(TSS_E_OUTOFMEMORY);
+			}
+			reqs[i].buf = buffer;
+			reqs[i].buf_size = size;
+		}
+
+		if (getData(TCSD_PACKET_TYPE_PBYTE, 2 + (2 * i), reqs[i].buf, size, &hte->comm))
+			return TSPERR(TSS_E_INTERNAL_ERROR);
+
+		unloadHeader(&reqs[i]);
+		if (reqs[i].hdr.packet_size != size)
+			return TSPERR(TSS_E_INTERNAL_ERROR);
+	}
 
 	return TSS_SUCCESS;
 }
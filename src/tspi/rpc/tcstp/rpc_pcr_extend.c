@@ -86,6 +86,51 @@ RPC_PcrRead_TP(struct host_table_entry *hte,
 	return result;
 }
 
+/* read several PCRs with one round trip to the TCSD per TCSD_BATCH_MAX_REQS of them */
+TSS_RESULT
+RPC_PcrReadBatch_TP(struct host_table_entry *hte,
+		    UINT32 count,		/* in */
+		    UINT32 *pcrNums,		/* in */
+		    TCPA_PCRVALUE *outDigests)	/* out */
+{
+	struct tcsd_comm_data reqs[TCSD_BATCH_MAX_REQS];
+	TSS_RESULT result = TSS_SUCCESS;
+	UINT32 i, done, batch;
+
+	__tspi_memset(reqs, 0, sizeof(reqs));
+	LogDebugFn("TCS Context: 0x%x", hte->tcsContext);
+
+	for (done = 0; done < count && result == TSS_SUCCESS; done += batch) {
+		batch = MIN(count - done, TCSD_BATCH_MAX_REQS);
+
+		for (i = 0; i < batch; i++) {
+			initData(&reqs[i], 2);
+			reqs[i].hdr.u.ordinal = TCSD_ORD_PCRREAD;
+
+			if (setData(TCSD_PACKET_TYPE_UINT32, 0, &hte->tcsContext, 0, &reqs[i]) ||
+			    setData(TCSD_PACKET_TYPE_UINT32, 1, &pcrNums[done + i], 0, &reqs[i])) {
+				result = TSPERR(TSS_E_INTERNAL_ERROR);
+				goto done;
+			}
+		}
+
+		if ((result = sendTCSDBatch(hte, batch, reqs)))
+			break;
+
+		for (i = 0; i < batch && result == TSS_SUCCESS; i++) {
+			if ((result = reqs[i].hdr.u.result))
+				break;
+			if (getData(TCSD_PACKET_TYPE_DIGEST, 0, &outDigests[done + i], 0, &reqs[i]))
+				result = TSPERR(TSS_E_INTERNAL_ERROR);
+		}
+	}
+done:
+	for (i = 0; i < TCSD_BATCH_MAX_REQS; i++)
+		free(reqs[i].buf);
+
+	return result;
+}
+
 TSS_RESULT
 RPC_PcrReset_TP(struct host_table_entry *hte,
 		 UINT32 pcrDataSizeIn,		 /* in */
@@ -15,7 +15,11 @@
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/mman.h>
+#include <fcntl.h>
 #include <errno.h>
+#ifdef HAVE_GETRANDOM
+#include <sys/random.h>
+#endif
 
 #include "trousers/tss.h"
 #include "trousers/trousers.h"
@@ -65,6 +69,7 @@ struct tcs_api_table tcs_normal_api = {
 #ifdef TSS_BUILD_PCR_EXTEND
 	.Extend = RPC_Extend,
 	.PcrRead = RPC_PcrRead,
+	.PcrReadBatch = RPC_PcrReadBatch,
 	.PcrReset = RPC_PcrReset,
 #endif
 #ifdef TSS_BUILD_QUOTE
@@ -421,39 +426,125 @@ UnloadBlob_AUTH(UINT64 *offset, BYTE *blob, TPM_AUTH *auth)
 	Trspi_UnloadBlob(offset, 20, blob, (BYTE *)&auth->HMAC);
 }
 
+/* Random bytes for nonces are handed out of a per-thread buffer, so that getting one doesn't
+ * take a system call. random_forks is bumped in the child of a fork() so that the child throws
+ * away the buffer it inherited instead of handing out the same bytes as its parent. */
+static THREAD_LOCAL BYTE random_buf[TSS_LOCAL_RANDOM_BUF_SIZE];
+static THREAD_LOCAL UINT32 random_avail = 0;
+static THREAD_LOCAL UINT32 random_fork_gen = 0;
+static volatile UINT32 random_forks = 0;
+static THREAD_ONCE_DECLARE_INIT(random_once);
+
+static void
+random_atfork_child(void)
+{
+	random_forks++;
+}
+
+static void
+random_init(void)
+{
+	THREAD_ATFORK(NULL, NULL, random_atfork_child);
+}
+
+/* fill buf from the kernel's CSPRNG */
+static TSS_RESULT
+read_local_random(BYTE *buf, UINT32 size)
+{
+	ssize_t rc;
+	int fd;
+
+#ifdef HAVE_GETRANDOM
+	while (size > 0) {
+		if ((rc = getrandom(buf, size, 0)) < 0) {
+			if (errno == EINTR)
+				continue;
+			/* an older kernel, fall back to the device */
+			if (errno == ENOSYS)
+				break;
+			LogError("getrandom of %u bytes failed: %s", size, strerror(errno));
+			return TSPERR(TSS_E_INTERNAL_ERROR);
+		}
+		buf += rc;
+		size -= rc;
+	}
+
+	if (size == 0)
+		return TSS_SUCCESS;
+#endif
+	if ((fd = open(TSS_LOCAL_RANDOM_DEVICE, O_RDONLY)) < 0) {
+		LogError("open of %s failed: %s", TSS_LOCAL_RANDOM_DEVICE, strerror(errno));
+		return TSPERR(TSS_E_INTERNAL_ERROR);
+	}
+
+	while (size > 0) {
+		if ((rc = read(fd, buf, size)) <= 0) {
+			if (rc < 0 && errno == EINTR)
+				continue;
+			LogError("read of %s failed: %s", TSS_LOCAL_RANDOM_DEVICE,
+				 rc < 0 ? strerror(errno) : "end of file");
+			close(fd);
+			return TSPERR(TSS_E_INTERNAL_ERROR);
+		}
+		buf += rc;
+		size -= rc;
+	}
+
+	close(fd);
+
+	return TSS_SUCCESS;
+}
+
 /* If alloc is true, we allocate a new buffer for the bytes and set *data to that.
  * If alloc is false, data is really a BYTE*, so write the bytes directly to that buffer */
 TSS_RESULT
 get_local_random(TSS_HCONTEXT tspContext, TSS_BOOL alloc, UINT32 size, BYTE **data)
 {
-	FILE *f = NULL;
+	TSS_RESULT result = TSS_SUCCESS;
 	BYTE *buf = NULL;
 
-	f = fopen(TSS_LOCAL_RANDOM_DEVICE, "r");
-	if (f == NULL) {
-		LogError("open of %s failed: %s", TSS_LOCAL_RANDOM_DEVICE, strerror(errno));
-		return TSPERR(TSS_E_INTERNAL_ERROR);
-	}
+	THREAD_ONCE(random_once, random_init);
 
 	if (alloc) {
 		buf = calloc_tspi(tspContext, size);
 		if (buf == NULL) {
 			LogError("malloc of %u bytes failed", size);
-			fclose(f);
 			return TSPERR(TSS_E_OUTOFMEMORY);
 		}
 	} else
 		buf = (BYTE *)data;
 
-	if (fread(buf, size, 1, f) == 0) {
-		LogError("fread of %s failed: %s", TSS_LOCAL_RANDOM_DEVICE, strerror(errno));
-		fclose(f);
-		return TSPERR(TSS_E_INTERNAL_ERROR);
+	if (size > TSS_LOCAL_RANDOM_BUF_SIZE / 2) {
+		/* not worth buffering */
+		result = read_local_random(buf, size);
+	} else {
+		if (random_fork_gen != random_forks) {
+			random_fork_gen = random_forks;
+			random_avail = 0;
+		}
+
+		if (random_avail < size) {
+			result = read_local_random(random_buf, sizeof(random_buf));
+			random_avail = result ? 0 : sizeof(random_buf);
+		}
+
+		if (result == TSS_SUCCESS) {
+			/* take the bytes off the end of the buffer and wipe them there, so they
+			 * can't be handed out again */
+			random_avail -= size;
+			memcpy(buf, &random_buf[random_avail], size);
+			__tspi_memset(&random_buf[random_avail], 0, size);
+		}
+	}
+
+	if (result) {
+		if (alloc)
+			free_tspi(tspContext, buf);
+		return result;
 	}
 
 	if (alloc)
 		*data = buf;
-	fclose(f);
 
 	return TSS_SUCCESS;
 }
@@ -30,49 +30,25 @@ __tspi_rsa_encrypt(TSS_HKEY key,
 	    UINT32*  outDataLen,
 	    BYTE*    outData)
 {
-	BYTE *blob;
-	UINT32 blobLen;
-	UINT64 offset;
 	TSS_RESULT result;
-	TSS_HCONTEXT tspContext;
-	TPM_PUBKEY pubKey;
+	UINT32 keyLength;
+	UINT16 encScheme;
+	void *rsa;
 
 	if (!inData || !outDataLen || !outData)
 		return TSPERR(TSS_E_INTERNAL_ERROR);
 
-	if ((result = obj_rsakey_get_tsp_context(key, &tspContext)))
+	if ((result = obj_rsakey_get_pub_rsa(key, NULL, &encScheme, &keyLength, &rsa)))
 		return result;
 
-	if ((result = obj_rsakey_get_pub_blob(key, &blobLen, &blob)))
-		return result;
-
-	offset = 0;
-	if ((result = Trspi_UnloadBlob_PUBKEY(&offset, blob, &pubKey))) {
-		free_tspi(tspContext, blob);
-		return result;
-	}
-	free_tspi(tspContext, blob);
-
-	if (pubKey.pubKey.keyLength < inDataLen) {
+	if (keyLength < inDataLen) {
 		result = TSPERR(TSS_E_ENC_INVALID_LENGTH);
 		goto done;
 	}
 
-	if (pubKey.algorithmParms.encScheme == TPM_ES_RSAESPKCSv15 ||
-	    pubKey.algorithmParms.encScheme == TSS_ES_RSAESPKCSV15) {
-		if ((result = Trspi_RSA_PKCS15_Encrypt(inData, inDataLen, outData, outDataLen,
-						       pubKey.pubKey.key, pubKey.pubKey.keyLength)))
-			goto done;
-	} else {
-		if ((result = Trspi_TPM_RSA_OAEP_Encrypt(inData, inDataLen, outData, outDataLen,
-							 pubKey.pubKey.key,
-							 pubKey.pubKey.keyLength)))
-			goto done;
-	}
-
+	result = __tspi_rsa_pubkey_encrypt(rsa, encScheme, inDataLen, inData, outDataLen, outData);
 done:
-	free(pubKey.pubKey.key);
-	free(pubKey.algorithmParms.parms);
+	__tspi_rsa_pubkey_put(rsa);
 	return result;
 }
 
@@ -84,34 +60,17 @@ __tspi_rsa_verify(TSS_HKEY key,
 	   UINT32   sigLen,
 	   BYTE*    sig)
 {
-	BYTE *blob;
-	UINT32 blobLen;
-	UINT64 offset;
 	TSS_RESULT result;
-	TSS_HCONTEXT tspContext;
-	TPM_PUBKEY pubKey;
+	void *rsa;
 
 	if (!hash || !sig)
 		return TSPERR(TSS_E_INTERNAL_ERROR);
 
-	if ((result = obj_rsakey_get_tsp_context(key, &tspContext)))
+	if ((result = obj_rsakey_get_pub_rsa(key, NULL, NULL, NULL, &rsa)))
 		return result;
 
-	if ((result = obj_rsakey_get_pub_blob(key, &blobLen, &blob)))
-		return result;
-
-	offset = 0;
-	if ((result = Trspi_UnloadBlob_PUBKEY(&offset, blob, &pubKey))) {
-		free_tspi(tspContext, blob);
-		return result;
-	}
-	free_tspi(tspContext, blob);
-
-	result = Trspi_Verify(type, hash, hashLen, pubKey.pubKey.key, pubKey.pubKey.keyLength,
-			      sig, sigLen);
-
-	free(pubKey.pubKey.key);
-	free(pubKey.algorithmParms.parms);
+	result = __tspi_rsa_pubkey_verify(rsa, type, hashLen, hash, sigLen, sig);
+	__tspi_rsa_pubkey_put(rsa);
 
 	return result;
 }
@@ -27,16 +27,64 @@
 #include "authsess.h"
 
 
-TSS_RESULT
-secret_PerformAuth_OIAP(TSS_HOBJECT hAuthorizedObject,
-			UINT32 ulPendingFn,
-			TSS_HPOLICY hPolicy,
-			TSS_BOOL cas, /* continue auth session */
-			TCPA_DIGEST *hashDigest,
-			TPM_AUTH *auth)
+/* how many idle sessions a context's OIAP pool keeps. The TCS lets a context have MAX(2, n/2) of
+ * the TPM's n auth sessions open at once (see auth_req_new()), and the pool leaves one of those
+ * for the sessions that aren't pooled, such as OSAP ones */
+static UINT32
+auth_pool_limit(TSS_HCONTEXT tspContext)
+{
+	static UINT32 ret = 0;
+	UINT32 subCap, respSize, max;
+	BYTE *resp;
+
+	if (ret != 0)
+		return ret;
+
+	subCap = endian32(TPM_CAP_PROP_MAX_AUTHSESS);
+	if (TCS_API(tspContext)->GetTPMCapability(tspContext, TPM_CAP_PROPERTY, sizeof(UINT32),
+						  (BYTE *)&subCap, &respSize, &resp)) {
+		/* a 1.1 TPM doesn't say, keep one session without remembering that */
+		return 1;
+	}
+
+	max = respSize >= sizeof(UINT32) ? Decode_UINT32(resp) : 0;
+	free(resp);
+
+	ret = MIN(MAX(2U, max / 2) - 1, (UINT32)TSP_AUTH_POOL_SIZE);
+	LogDebugFn("keeping up to %u pooled auth sessions per context", ret);
+
+	return ret;
+}
+
+/* close the idle sessions of tspContext's pool, so that the auth slots they hold are free for a
+ * session the TPM has run out of room for. Returns TRUE if there were any. */
+static TSS_BOOL
+auth_pool_flush(TSS_HCONTEXT tspContext)
+{
+	TCS_AUTHHANDLE handles[TSP_AUTH_POOL_SIZE];
+	UINT32 num, i;
+
+	num = obj_context_auth_pool_flush(tspContext, handles);
+	for (i = 0; i < num; i++) {
+		LogDebugFn("closing pooled auth session %x to free its slot", handles[i]);
+		TCS_API(tspContext)->TerminateHandle(tspContext, handles[i]);
+	}
+
+	return num ? TRUE : FALSE;
+}
+
+
+static TSS_RESULT
+perform_auth_oiap(TSS_HOBJECT hAuthorizedObject,
+		  UINT32 ulPendingFn,
+		  TSS_HPOLICY hPolicy,
+		  TSS_BOOL cas, /* continue auth session */
+		  TSS_BOOL pooled,
+		  TCPA_DIGEST *hashDigest,
+		  TPM_AUTH *auth)
 {
 	TSS_RESULT result;
-	TSS_BOOL bExpired;
+	TSS_BOOL bExpired, reused;
 	UINT32 mode;
 	TCPA_SECRET secret;
 	TSS_HCONTEXT tspContext;
@@ -68,6 +116,14 @@ secret_PerformAuth_OIAP(TSS_HOBJECT hAuthorizedObject,
 		TerminateHandle = TCS_API(tspContext)->TerminateHandle;
 	}
 
+	/* a pooled session is kept open across commands, so it takes no OIAP at all once the
+	 * pool has an idle one */
+	if (pooled) {
+		auth->fContinueAuthSession = TRUE;
+		if (obj_context_auth_pool_get(tspContext, auth))
+			goto hmac;
+	}
+
 	/* added retry logic */
 	if ((result = OIAP(tspContext, &auth->AuthHandle, &auth->NonceEven))) {
 		if (result == TCPA_E_RESOURCES) {
@@ -76,7 +132,10 @@ secret_PerformAuth_OIAP(TSS_HOBJECT hAuthorizedObject,
 				/* POSIX sleep time, { secs, nanosecs } */
 				struct timespec t = { 0, AUTH_RETRY_NANOSECS };
 
-				nanosleep(&t, NULL);
+				/* idle sessions this context keeps in its pool may be what's
+				 * holding the slots, free those before waiting on others */
+				if (!auth_pool_flush(tspContext))
+					nanosleep(&t, NULL);
 
 				result = OIAP(tspContext, &auth->AuthHandle, &auth->NonceEven);
 			} while (result == TCPA_E_RESOURCES && ++retry < AUTH_RETRY_COUNT);
@@ -86,6 +145,10 @@ secret_PerformAuth_OIAP(TSS_HOBJECT hAuthorizedObject,
 			return result;
 	}
 
+	if (pooled)
+		obj_context_auth_pool_busy(tspContext, auth);
+
+hmac:
 	switch (mode) {
 		case TSS_SECRET_MODE_CALLBACK:
 			result = obj_policy_do_hmac(hPolicy, hAuthorizedObject,
@@ -115,12 +178,90 @@ secret_PerformAuth_OIAP(TSS_HOBJECT hAuthorizedObject,
 	}
 
 	if (result) {
+		if (pooled)
+			obj_context_auth_pool_done(tspContext, auth, &reused);
 		TerminateHandle(tspContext, auth->AuthHandle);
 		return result;
 	}
 
 	return obj_policy_dec_counter(hPolicy);
 }
+
+TSS_RESULT
+secret_PerformAuth_OIAP(TSS_HOBJECT hAuthorizedObject,
+			UINT32 ulPendingFn,
+			TSS_HPOLICY hPolicy,
+			TSS_BOOL cas, /* continue auth session */
+			TCPA_DIGEST *hashDigest,
+			TPM_AUTH *auth)
+{
+	return perform_auth_oiap(hAuthorizedObject, ulPendingFn, hPolicy, cas, FALSE, hashDigest,
+				 auth);
+}
+
+/*
+ * Like secret_PerformAuth_OIAP() for a session the caller doesn't continue, but the session
+ * comes from a per-context pool of continued OIAP sessions, so that a command costs one
+ * round trip to the TPM instead of two. obj_policy_validate_auth_oiap() hands the session
+ * back to the pool, rolled forward to the TPM's new NonceEven. If the command fails, the
+ * caller must pass the result to auth_pool_retry().
+ */
+TSS_RESULT
+secret_PerformAuth_OIAP_Pooled(TSS_HOBJECT hAuthorizedObject,
+			       UINT32 ulPendingFn,
+			       TSS_HPOLICY hPolicy,
+			       TCPA_DIGEST *hashDigest,
+			       TPM_AUTH *auth)
+{
+	return perform_auth_oiap(hAuthorizedObject, ulPendingFn, hPolicy, FALSE, TRUE, hashDigest,
+				 auth);
+}
+
+/* Take auth, used for a command that failed with result, out of the pool. Returns TRUE if it
+ * was a pooled session the TCS or TPM no longer knows about, so that the command can be sent
+ * again with a fresh session. */
+TSS_BOOL
+auth_pool_retry(TSS_HCONTEXT tspContext, TSS_RESULT result, TPM_AUTH *auth)
+{
+	TSS_BOOL reused;
+
+	if (auth == NULL || !obj_context_auth_pool_done(tspContext, auth, &reused))
+		return FALSE;
+
+	if (result == TPM_E_INVALID_AUTHHANDLE) {
+		LogDebugFn("pooled auth session %x is gone", auth->AuthHandle);
+		return reused;
+	}
+
+	/* the command may not have reached the TPM, which closes the session otherwise */
+	TCS_API(tspContext)->TerminateHandle(tspContext, auth->AuthHandle);
+
+	return FALSE;
+}
+
+/* hand auth back to the pool if it's a pooled session the TPM continued and result says its
+ * response was authentic, else close it */
+static void
+auth_pool_release(TSS_HCONTEXT tspContext, TSS_RESULT result, TPM_AUTH *auth)
+{
+	TCS_AUTHHANDLE evicted;
+	TSS_BOOL reused;
+
+	if (!obj_context_auth_pool_done(tspContext, auth, &reused))
+		return;
+
+	if (!auth->fContinueAuthSession)
+		return;
+
+	if (result == TSS_SUCCESS) {
+		if (!obj_context_auth_pool_put(tspContext, auth, auth_pool_limit(tspContext),
+					       &evicted))
+			return;
+	} else
+		evicted = auth->AuthHandle;
+
+	TCS_API(tspContext)->TerminateHandle(tspContext, evicted);
+}
 #if 0
 TSS_RESULT
 secret_PerformXOR_OSAP(TSS_HPOLICY hPolicy, TSS_HPOLICY hUsagePolicy,
@@ -407,7 +548,10 @@ OSAP_Calc(TSS_HCONTEXT tspContext, UINT16 EntityType, UINT32 EntityValue,
 				/* POSIX sleep time, { secs, nanosecs } */
 				struct timespec t = { 0, AUTH_RETRY_NANOSECS };
 
-				nanosleep(&t, NULL);
+				/* idle sessions this context keeps in its pool may be what's
+				 * holding the slots, free those before waiting on others */
+				if (!auth_pool_flush(tspContext))
+					nanosleep(&t, NULL);
 
 				rc = TCS_API(tspContext)->OSAP(tspContext, EntityType, EntityValue,
 							       &auth->NonceOdd, &auth->AuthHandle,
@@ -452,12 +596,14 @@ obj_policy_validate_auth_oiap(TSS_HPOLICY hPolicy, TCPA_DIGEST *hashDigest, TPM_
 	TSS_RESULT result = TSS_SUCCESS;
 	struct tsp_object *obj;
 	struct tr_policy_obj *policy;
+	TSS_HCONTEXT tspContext;
 	BYTE wellKnown[TCPA_SHA1_160_HASH_LEN] = TSS_WELL_KNOWN_SECRET;
 
 	if ((obj = obj_list_get_obj(&policy_list, hPolicy)) == NULL)
 		return TSPERR(TSS_E_INVALID_HANDLE);
 
 	policy = (struct tr_policy_obj *)obj->data;
+	tspContext = obj->tspContext;
 
 	switch (policy->SecretMode) {
 		case TSS_SECRET_MODE_CALLBACK:
@@ -491,6 +637,8 @@ obj_policy_validate_auth_oiap(TSS_HPOLICY hPolicy, TCPA_DIGEST *hashDigest, TPM_
 
 	obj_list_put(&policy_list);
 
+	auth_pool_release(tspContext, result, auth);
+
 	return result;
 }
 
@@ -625,7 +773,10 @@ authsess_do_dsap(struct authsess *sess)
 				/* POSIX sleep time, { secs, nanosecs } */
 				struct timespec t = { 0, AUTH_RETRY_NANOSECS };
 
-				nanosleep(&t, NULL);
+				/* idle sessions this context keeps in its pool may be what's
+				 * holding the slots, free those before waiting on others */
+				if (!auth_pool_flush(sess->tspContext))
+					nanosleep(&t, NULL);
 
 				result = TCS_API(sess->tspContext)->DSAP(sess->tspContext,
 									 sess->entity_type,
@@ -660,7 +811,10 @@ authsess_do_osap(struct authsess *sess)
 				/* POSIX sleep time, { secs, nanosecs } */
 				struct timespec t = { 0, AUTH_RETRY_NANOSECS };
 
-				nanosleep(&t, NULL);
+				/* idle sessions this context keeps in its pool may be what's
+				 * holding the slots, free those before waiting on others */
+				if (!auth_pool_flush(sess->tspContext))
+					nanosleep(&t, NULL);
 
 				result = TCS_API(sess->tspContext)->OSAP(sess->tspContext,
 									 sess->entity_type,
@@ -12,6 +12,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdint.h>
 
 #include "trousers/tss.h"
 #include "trousers_types.h"
@@ -21,8 +22,18 @@
 #include "tsplog.h"
 #include "obj.h"
 
+#define MEMTABLE_BUCKET(ctx)	((ctx) % TSP_MEMTABLE_BUCKETS)
+
+static UINT32
+mem_hash(struct memTable *table, void *pointer)
+{
+	/* the low bits of a pointer are mostly alignment, so mix them out */
+	return (UINT32)((((uintptr_t)pointer >> 4) * 2654435761U) & (table->numBuckets - 1));
+}
+
+/* caller needs to lock memtable lock */
 static struct memTable *
-__tspi_createTable()
+__tspi_createTable(TSS_HCONTEXT tspContext)
 {
 	struct memTable *table = NULL;
 	/*
@@ -34,124 +45,173 @@ __tspi_createTable()
 		LogError("malloc of %zd bytes failed.", sizeof(struct memTable));
 		return NULL;
 	}
-	return (table);
+
+	table->entries = calloc(TSP_MEM_MIN_ENTRY_BUCKETS, sizeof(struct memEntry *));
+	if (table->entries == NULL) {
+		LogError("malloc of %zd bytes failed.",
+			 TSP_MEM_MIN_ENTRY_BUCKETS * sizeof(struct memEntry *));
+		free(table);
+		return NULL;
+	}
+	table->numBuckets = TSP_MEM_MIN_ENTRY_BUCKETS;
+	table->tspContext = tspContext;
+
+	table->nextTable = SpiMemoryTable[MEMTABLE_BUCKET(tspContext)];
+	SpiMemoryTable[MEMTABLE_BUCKET(tspContext)] = table;
+
+	return table;
 }
 
 /* caller needs to lock memtable lock */
-struct memTable *
+static struct memTable *
 getTable(TSS_HCONTEXT tspContext)
 {
 	struct memTable *tmp;
 
-	for (tmp = SpiMemoryTable; tmp; tmp = tmp->nextTable)
+	for (tmp = SpiMemoryTable[MEMTABLE_BUCKET(tspContext)]; tmp; tmp = tmp->nextTable)
 		if (tmp->tspContext == tspContext)
 			return tmp;
 
 	return NULL;
 }
 
-/* caller needs to lock memtable lock */
-static void
-__tspi_addTable(struct memTable *new)
+/* carve @size bytes out of @table's current chunk, starting a new chunk if there isn't
+ * room. @size must be no bigger than TSP_MEM_CHUNK_SIZE. caller needs to lock memtable lock */
+static void *
+mem_bump(struct memTable *table, UINT32 size)
 {
-	struct memTable *tmp = SpiMemoryTable;
+	struct memChunk *chunk = table->chunks;
+	void *ret;
 
-	/* base case, this is the first table */
-	if (SpiMemoryTable == NULL) {
-		SpiMemoryTable = new;
-		return;
-	}
+	/* keep every block 16 byte aligned */
+	size = (size + 15) & ~15;
 
-	/* else add @new onto the end */
-	for (; tmp; tmp = tmp->nextTable)
-		if (tmp->nextTable == NULL) {
-			tmp->nextTable = new;
-			break;
+	if (chunk == NULL || chunk->size - chunk->used < size) {
+		chunk = malloc(sizeof(struct memChunk) + TSP_MEM_CHUNK_SIZE);
+		if (chunk == NULL) {
+			LogError("malloc of %zd bytes failed.",
+				 sizeof(struct memChunk) + TSP_MEM_CHUNK_SIZE);
+			return NULL;
 		}
+		chunk->used = 0;
+		chunk->size = TSP_MEM_CHUNK_SIZE;
+		chunk->next = table->chunks;
+		table->chunks = chunk;
+	}
+
+	ret = &chunk->data[chunk->used];
+	chunk->used += size;
+
+	return ret;
 }
 
-/* caller needs to lock memtable lock and be sure the context mem slot for
- * @tspContext exists before calling.
- */
-void
-__tspi_addEntry(TSS_HCONTEXT tspContext, struct memEntry *new)
+/* double the number of hash buckets once the chains get long. failing to is harmless, the
+ * chains just stay long. caller needs to lock memtable lock */
+static void
+mem_grow(struct memTable *table)
 {
-	struct memTable *tmp = getTable(tspContext);
-	struct memEntry *tmp_entry;
-
-	if (tmp == NULL) {
-		if ((tmp = __tspi_createTable()) == NULL)
-			return;
-		tmp->tspContext = tspContext;
-		__tspi_addTable(tmp);
-	}
+	struct memEntry **old = table->entries, *entry, *next;
+	UINT32 i, old_buckets = table->numBuckets;
 
-	tmp_entry = tmp->entries;
+	if (table->numEntries <= 2 * old_buckets)
+		return;
 
-	if (tmp->entries == NULL) {
-		tmp->entries = new;
+	if ((table->entries = calloc(2 * old_buckets, sizeof(struct memEntry *))) == NULL) {
+		table->entries = old;
 		return;
 	}
+	table->numBuckets = 2 * old_buckets;
 
-	/* else tack @new onto the end */
-	for (; tmp_entry; tmp_entry = tmp_entry->nextEntry) {
-		if (tmp_entry->nextEntry == NULL) {
-			tmp_entry->nextEntry = new;
-			break;
+	for (i = 0; i < old_buckets; i++) {
+		for (entry = old[i]; entry; entry = next) {
+			next = entry->nextEntry;
+			entry->nextEntry = table->entries[mem_hash(table, entry->memPointer)];
+			table->entries[mem_hash(table, entry->memPointer)] = entry;
 		}
 	}
+
+	free(old);
 }
 
 /* caller needs to lock memtable lock */
-TSS_RESULT
-__tspi_freeTable(TSS_HCONTEXT tspContext)
+static TSS_RESULT
+__tspi_addEntry(struct memTable *table, void *pointer)
 {
-	struct memTable *prev = NULL, *index = NULL, *next = NULL;
-	struct memEntry *entry = NULL, *entry_next = NULL;
-
-	for(index = SpiMemoryTable; index; index = index->nextTable) {
-		next = index->nextTable;
-		if (index->tspContext == tspContext) {
-			for (entry = index->entries; entry; entry = entry_next) {
-				/* this needs to be set before we do free(entry) */
-				entry_next = entry->nextEntry;
-				free(entry->memPointer);
-				free(entry);
-			}
+	struct memEntry *new;
+	UINT32 bucket;
 
-			if (prev != NULL)
-				prev->nextTable = next;
-			else
-				SpiMemoryTable = NULL;
+	if ((new = table->freeEntries))
+		table->freeEntries = new->nextEntry;
+	else if ((new = mem_bump(table, sizeof(struct memEntry))) == NULL)
+		return TSPERR(TSS_E_OUTOFMEMORY);
+
+	new->memPointer = pointer;
+
+	bucket = mem_hash(table, pointer);
+	new->nextEntry = table->entries[bucket];
+	table->entries[bucket] = new;
+	table->numEntries++;
+
+	mem_grow(table);
+
+	return TSS_SUCCESS;
+}
+
+/* release tspContext's table, and the memory it tracks if free_mem is set. caller needs to
+ * lock memtable lock */
+static TSS_RESULT
+__tspi_freeTable(TSS_HCONTEXT tspContext, TSS_BOOL free_mem)
+{
+	struct memTable **prev, *table;
+	struct memEntry *entry;
+	struct memChunk *chunk, *chunk_next;
+	UINT32 i;
 
-			free(index);
-			break;
+	for (prev = &SpiMemoryTable[MEMTABLE_BUCKET(tspContext)]; (table = *prev);
+	     prev = &table->nextTable) {
+		if (table->tspContext != tspContext)
+			continue;
+
+		*prev = table->nextTable;
+
+		/* the entries themselves live in the chunks */
+		for (i = 0; free_mem && i < table->numBuckets; i++) {
+			for (entry = table->entries[i]; entry; entry = entry->nextEntry)
+				free(entry->memPointer);
+		}
+
+		for (chunk = table->chunks; chunk; chunk = chunk_next) {
+			chunk_next = chunk->next;
+			free(chunk);
 		}
-		prev = index;
+
+		free(table->entries);
+		free(table);
+		break;
 	}
 
 	return TSS_SUCCESS;
 }
 
-TSS_RESULT
+/* caller needs to lock memtable lock */
+static TSS_RESULT
 __tspi_freeEntry(struct memTable *table, void *pointer)
 {
-	struct memEntry *index = NULL;
-	struct memEntry *prev = NULL;
-	struct memEntry *toKill = NULL;
-
-	for (index = table->entries; index; prev = index, index = index->nextEntry) {
-		if (index->memPointer == pointer) {
-			toKill = index;
-			if (prev == NULL)
-				table->entries = toKill->nextEntry;
-			else
-				prev->nextEntry = toKill->nextEntry;
-
-			free(pointer);
-			free(toKill);
-			return TSS_SUCCESS;
-		}
+	struct memEntry **prev, *entry;
+
+	for (prev = &table->entries[mem_hash(table, pointer)]; (entry = *prev);
+	     prev = &entry->nextEntry) {
+		if (entry->memPointer != pointer)
+			continue;
+
+		*prev = entry->nextEntry;
+		table->numEntries--;
+		free(pointer);
+
+		entry->nextEntry = table->freeEntries;
+		table->freeEntries = entry;
+
+		return TSS_SUCCESS;
 	}
 
 	return TSPERR(TSS_E_INVALID_RESOURCE);
@@ -160,21 +220,22 @@ __tspi_freeEntry(struct memTable *table, void *pointer)
 TSS_RESULT
 __tspi_add_mem_entry(TSS_HCONTEXT tspContext, void *allocd_mem)
 {
-	struct memEntry *newEntry = calloc(1, sizeof(struct memEntry));
-	if (newEntry == NULL) {
-		LogError("malloc of %zd bytes failed.", sizeof(struct memEntry));
-		return TSPERR(TSS_E_OUTOFMEMORY);
-	}
-
-	newEntry->memPointer = allocd_mem;
+	struct memTable *table;
+	TSS_RESULT result;
 
 	MUTEX_LOCK(memtable_lock);
 
-	__tspi_addEntry(tspContext, newEntry);
+	if ((table = getTable(tspContext)) == NULL &&
+	    (table = __tspi_createTable(tspContext)) == NULL) {
+		MUTEX_UNLOCK(memtable_lock);
+		return TSPERR(TSS_E_OUTOFMEMORY);
+	}
+
+	result = __tspi_addEntry(table, allocd_mem);
 
 	MUTEX_UNLOCK(memtable_lock);
 
-	return TSS_SUCCESS;
+	return result;
 }
 
 /*
@@ -185,31 +246,18 @@ void *
 calloc_tspi(TSS_HCONTEXT tspContext, UINT32 howMuch)
 {
 	struct memTable *table = NULL;
-	struct memEntry *newEntry = NULL;
+	void *ret;
 
 	MUTEX_LOCK(memtable_lock);
 
-	table = getTable(tspContext);
-	if (table == NULL) {
-		if ((table = __tspi_createTable()) == NULL) {
-			MUTEX_UNLOCK(memtable_lock);
-			return NULL;
-		}
-		table->tspContext = tspContext;
-		__tspi_addTable(table);
-	}
-
-	newEntry = calloc(1, sizeof(struct memEntry));
-	if (newEntry == NULL) {
-		LogError("malloc of %zd bytes failed.", sizeof(struct memEntry));
+	if ((table = getTable(tspContext)) == NULL &&
+	    (table = __tspi_createTable(tspContext)) == NULL) {
 		MUTEX_UNLOCK(memtable_lock);
 		return NULL;
 	}
 
-	newEntry->memPointer = calloc(1, howMuch);
-	if (newEntry->memPointer == NULL) {
-		LogError("malloc of %d bytes failed.", howMuch);
-		free(newEntry);
+	if ((ret = calloc(1, howMuch)) == NULL) {
+		LogError("malloc of %u bytes failed.", howMuch);
 		MUTEX_UNLOCK(memtable_lock);
 		return NULL;
 	}
@@ -217,11 +265,14 @@ calloc_tspi(TSS_HCONTEXT tspContext, UINT32 howMuch)
 	/* this call must happen inside the lock or else another thread could
 	 * remove the context mem slot, causing a segfault
 	 */
-	__tspi_addEntry(tspContext, newEntry);
+	if (__tspi_addEntry(table, ret)) {
+		free(ret);
+		ret = NULL;
+	}
 
 	MUTEX_UNLOCK(memtable_lock);
 
-	return newEntry->memPointer;
+	return ret;
 }
 
 /*
@@ -237,7 +288,7 @@ free_tspi(TSS_HCONTEXT tspContext, void *memPointer)
 	MUTEX_LOCK(memtable_lock);
 
 	if (memPointer == NULL) {
-		result = __tspi_freeTable(tspContext);
+		result = __tspi_freeTable(tspContext, TRUE);
 		MUTEX_UNLOCK(memtable_lock);
 		return result;
 	}
@@ -257,6 +308,16 @@ free_tspi(TSS_HCONTEXT tspContext, void *memPointer)
 	return result;
 }
 
+/* forget about the memory tspContext has handed out, which the app still owns, and release
+ * the bookkeeping for it. Called at context close. */
+void
+__tspi_close_mem_table(TSS_HCONTEXT tspContext)
+{
+	MUTEX_LOCK(memtable_lock);
+	__tspi_freeTable(tspContext, FALSE);
+	MUTEX_UNLOCK(memtable_lock);
+}
+
 /* definition for a memset that cannot be optimized away */
 void * __no_optimize
 __tspi_memset(void *s, int c, size_t n)
@@ -30,14 +30,13 @@ Tspi_Data_Bind(TSS_HENCDATA hEncData,	/* in */
 {
 	UINT32 encDataLength;
 	BYTE encData[256];
-	BYTE *keyData;
-	UINT32 keyDataLength;
 	TCPA_BOUND_DATA boundData;
 	UINT64 offset;
 	BYTE bdblob[256];
 	TCPA_RESULT result;
-	TSS_KEY keyContainer;
-	TSS_HCONTEXT tspContext;
+	UINT16 keyUsage, encScheme;
+	UINT32 keyLength;
+	void *rsa;
 
 	if (rgbDataToBind == NULL)
 		return TSPERR(TSS_E_BAD_PARAMETER);
@@ -45,61 +44,28 @@ Tspi_Data_Bind(TSS_HENCDATA hEncData,	/* in */
 	if (!obj_is_encdata(hEncData))
 		return TSPERR(TSS_E_INVALID_HANDLE);
 
-	if ((result = obj_rsakey_get_tsp_context(hEncKey, &tspContext)))
+	if ((result = obj_rsakey_get_pub_rsa(hEncKey, &keyUsage, &encScheme, &keyLength, &rsa)))
 		return result;
 
-	/* XXX Just get the pubkey here */
-	if ((result = obj_rsakey_get_blob(hEncKey, &keyDataLength, &keyData)))
-		return result;
-
-	offset = 0;
-	if ((result = UnloadBlob_TSS_KEY(&offset, keyData, &keyContainer))) {
-		free_tspi(tspContext, keyData);
-		return result;
-	}
-	free_tspi(tspContext, keyData);
-
-	if (keyContainer.keyUsage != TPM_KEY_BIND &&
-	    keyContainer.keyUsage != TPM_KEY_LEGACY) {
+	if (keyUsage != TPM_KEY_BIND &&
+	    keyUsage != TPM_KEY_LEGACY) {
 		result = TSPERR(TSS_E_INVALID_KEYUSAGE);
 		goto done;
 	}
 
-	if (keyContainer.pubKey.keyLength < ulDataLength) {
+	if (keyLength < ulDataLength) {
 		result = TSPERR(TSS_E_ENC_INVALID_LENGTH);
 		goto done;
 	}
 
-	if (keyContainer.algorithmParms.encScheme == TCPA_ES_RSAESPKCSv15 &&
-	    keyContainer.keyUsage == TPM_KEY_LEGACY) {
-		if ((result = Trspi_RSA_PKCS15_Encrypt(rgbDataToBind, ulDataLength, encData,
-						       &encDataLength, keyContainer.pubKey.key,
-						       keyContainer.pubKey.keyLength)))
-			goto done;
-	} else if (keyContainer.algorithmParms.encScheme == TCPA_ES_RSAESPKCSv15 &&
-		   keyContainer.keyUsage == TPM_KEY_BIND) {
-		boundData.payload = TCPA_PT_BIND;
-
-		memcpy(&boundData.ver, &VERSION_1_1, sizeof(TCPA_VERSION));
-
-		boundData.payloadData = malloc(ulDataLength);
-		if (boundData.payloadData == NULL) {
-			result = TSPERR(TSS_E_OUTOFMEMORY);
-			goto done;
-		}
-		memcpy(boundData.payloadData, rgbDataToBind, ulDataLength);
-
-		offset = 0;
-		Trspi_LoadBlob_BOUND_DATA(&offset, boundData, ulDataLength, bdblob);
-
-		if ((result = Trspi_RSA_PKCS15_Encrypt(bdblob, offset, encData,
-						       &encDataLength, keyContainer.pubKey.key,
-						       keyContainer.pubKey.keyLength))) {
-			free(boundData.payloadData);
+	if (encScheme == TCPA_ES_RSAESPKCSv15 &&
+	    keyUsage == TPM_KEY_LEGACY) {
+		if ((result = __tspi_rsa_pubkey_encrypt(rsa, encScheme, ulDataLength,
+							rgbDataToBind, &encDataLength, encData)))
 			goto done;
-		}
-		free(boundData.payloadData);
 	} else {
+		/* a bind key always gets a TCPA_BOUND_DATA structure, padded for its encryption
+		 * scheme */
 		boundData.payload = TCPA_PT_BIND;
 
 		memcpy(&boundData.ver, &VERSION_1_1, sizeof(TCPA_VERSION));
@@ -115,9 +81,8 @@ Tspi_Data_Bind(TSS_HENCDATA hEncData,	/* in */
 		offset = 0;
 		Trspi_LoadBlob_BOUND_DATA(&offset, boundData, ulDataLength, bdblob);
 
-		if ((result = Trspi_RSA_Encrypt(bdblob, offset, encData, &encDataLength,
-						keyContainer.pubKey.key,
-						keyContainer.pubKey.keyLength))) {
+		if ((result = __tspi_rsa_pubkey_encrypt(rsa, encScheme, offset, bdblob,
+							&encDataLength, encData))) {
 			free(boundData.payloadData);
 			goto done;
 		}
@@ -131,7 +96,7 @@ Tspi_Data_Bind(TSS_HENCDATA hEncData,	/* in */
 		goto done;
 	}
 done:
-	free_key_refs(&keyContainer);
+	__tspi_rsa_pubkey_put(rsa);
 	return result;
 }
 
@@ -170,6 +135,7 @@ Tspi_Data_Unbind(TSS_HENCDATA hEncData,		/* in */
 	if ((result = obj_rsakey_get_tcs_handle(hKey, &tcsKeyHandle)))
 		return result;
 
+retry:
 	if (usesAuth) {
 		result = Trspi_HashInit(&hashCtx, TSS_HASH_SHA1);
 		result |= Trspi_Hash_UINT32(&hashCtx, TPM_ORD_UnBind);
@@ -178,8 +144,8 @@ Tspi_Data_Unbind(TSS_HENCDATA hEncData,		/* in */
 		if ((result |= Trspi_HashFinal(&hashCtx, digest.digest)))
 			return result;
 
-		if ((result = secret_PerformAuth_OIAP(hKey, TPM_ORD_UnBind, hPolicy, FALSE, &digest,
-						      &privAuth)))
+		if ((result = secret_PerformAuth_OIAP_Pooled(hKey, TPM_ORD_UnBind, hPolicy, &digest,
+							     &privAuth)))
 			return result;
 		pPrivAuth = &privAuth;
 	} else {
@@ -188,8 +154,11 @@ Tspi_Data_Unbind(TSS_HENCDATA hEncData,		/* in */
 
 	if ((result = TCS_API(tspContext)->UnBind(tspContext, tcsKeyHandle, encDataSize, encData,
 						  pPrivAuth, pulUnboundDataLength,
-						  prgbUnboundData)))
+						  prgbUnboundData))) {
+		if (auth_pool_retry(tspContext, result, pPrivAuth))
+			goto retry;
 		return result;
+	}
 
 	if (usesAuth) {
 		result = Trspi_HashInit(&hashCtx, TSS_HASH_SHA1);
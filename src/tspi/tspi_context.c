@@ -55,6 +55,9 @@ Tspi_Context_Close(TSS_HCONTEXT tspContext)	/* in */
 	/* Destroy all objects */
 	obj_close_context(tspContext);
 
+	/* Forget about the memory handed to the app, the app owns it now */
+	__tspi_close_mem_table(tspContext);
+
 	/* close the ps file */
 	PS_close();
 
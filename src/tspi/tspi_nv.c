@@ -428,6 +428,7 @@ Tspi_NV_ReadValue(TSS_HNVSTORE hNvstore,	/* in */
 		authread = nv_data_public.permission.attributes & TPM_NV_PER_AUTHREAD;
 
 		if (need_authdata) {
+retry:
 			if (!authread) {
 				result = Trspi_HashInit(&hashCtx, TSS_HASH_SHA1);
 				result |= Trspi_Hash_UINT32(&hashCtx, TPM_ORD_NV_ReadValue);
@@ -438,17 +439,19 @@ Tspi_NV_ReadValue(TSS_HNVSTORE hNvstore,	/* in */
 				if ((result |= Trspi_HashFinal(&hashCtx, digest.digest)))
 					return result;
 
-				if ((result = secret_PerformAuth_OIAP(hNvstore,
-								      TPM_ORD_NV_ReadValue,
-								      hPolicy, FALSE, &digest,
-								      &auth)))
+				if ((result = secret_PerformAuth_OIAP_Pooled(hNvstore,
+								TPM_ORD_NV_ReadValue,
+								hPolicy, &digest, &auth)))
 					return result;
 
 				if ((result = TCS_API(tspContext)->NV_ReadValue(tspContext,
 									nv_data_public.nvIndex,
 									offset, ulDataLength,
-									&auth, rgbDataRead)))
+									&auth, rgbDataRead))) {
+					if (auth_pool_retry(tspContext, result, &auth))
+						goto retry;
 					return result;
+				}
 
 				result = Trspi_HashInit(&hashCtx, TSS_HASH_SHA1);
 				result |= Trspi_Hash_UINT32(&hashCtx, TSS_SUCCESS);
@@ -471,17 +474,19 @@ Tspi_NV_ReadValue(TSS_HNVSTORE hNvstore,	/* in */
 				if ((result |= Trspi_HashFinal(&hashCtx, digest.digest)))
 					return result;
 
-				if ((result = secret_PerformAuth_OIAP(hNvstore,
-								      TPM_ORD_NV_ReadValueAuth,
-								      hPolicy, FALSE, &digest,
-								      &auth)))
+				if ((result = secret_PerformAuth_OIAP_Pooled(hNvstore,
+								TPM_ORD_NV_ReadValueAuth,
+								hPolicy, &digest, &auth)))
 					return result;
 
 				if ((result = TCS_API(tspContext)->NV_ReadValueAuth(tspContext,
 									nv_data_public.nvIndex,
 									offset, ulDataLength,
-									&auth, rgbDataRead)))
+									&auth, rgbDataRead))) {
+					if (auth_pool_retry(tspContext, result, &auth))
+						goto retry;
 					return result;
+				}
 
 				result = Trspi_HashInit(&hashCtx, TSS_HASH_SHA1);
 				result |= Trspi_Hash_UINT32(&hashCtx, TSS_SUCCESS);
@@ -118,3 +118,399 @@ Tspi_TPM_GetEventLog(TSS_HTPM hTPM,			/* in */
 	return TSS_SUCCESS;
 }
 
+TSS_RESULT
+Trspi_TPM_GetEventLogPage(TSS_HTPM hTPM,		/* in */
+			  UINT32 * pulPcrIndex,		/* in, out */
+			  UINT32 * pulFirstEvent,	/* in, out */
+			  UINT32 ulMaxBytes,		/* in */
+			  UINT32 * pulEventNumber,	/* in, out */
+			  TSS_PCR_EVENT ** prgbPcrEvents)	/* out */
+{
+	TSS_HCONTEXT tspContext;
+	TSS_RESULT result;
+
+	if (pulPcrIndex == NULL || pulFirstEvent == NULL || pulEventNumber == NULL ||
+	    prgbPcrEvents == NULL)
+		return TSPERR(TSS_E_BAD_PARAMETER);
+
+	if ((result = obj_tpm_get_tsp_context(hTPM, &tspContext)))
+		return result;
+
+	return RPC_GetPcrEventLogPage(tspContext, pulPcrIndex, pulFirstEvent, ulMaxBytes,
+				      pulEventNumber, prgbPcrEvents);
+}
+
+/* how many events to ask the TCS for at a time while replaying a PCR's event log */
+#define TSP_EVLOG_REPLAY_BATCH	256
+
+/* Bring the replay of pcr up to date with its event log and return the value the PCR should
+ * hold. Only the events logged since the last replay of pcr through hTPM are hashed, unless
+ * restart is set. A log that turns out to be shorter than what was replayed before (the TCSD
+ * was restarted, say) is replayed again from its first event. */
+static TSS_RESULT
+evlog_replay_pcr(TSS_HTPM hTPM, TSS_HCONTEXT tspContext, UINT32 pcr, TSS_BOOL restart,
+		 TPM_PCRVALUE *value)
+{
+	TSS_RESULT result;
+	Trspi_HashCtx hashCtx;
+	TSS_PCR_EVENT *events;
+	TPM_DIGEST *values = NULL, *tmp;
+	UINT32 old_num, first, num, count, total, i;
+
+	if ((result = obj_tpm_get_replay(hTPM, pcr, &old_num, value)))
+		return result;
+
+	first = old_num;
+	if (first > 0 && !restart) {
+		/* the external BIOS and IMA logs don't fail a read past their end, they just
+		 * return no events, so the length has to be checked */
+		if ((result = RPC_GetPcrEvent(tspContext, pcr, &total, NULL)))
+			return result;
+
+		if (total < first) {
+			LogDebugFn("PCR %u has fewer than %u events, replaying it again",
+				   pcr, first);
+			restart = TRUE;
+		}
+	}
+
+	if (restart) {
+		first = 0;
+		__tspi_memset(value, 0, sizeof(TPM_PCRVALUE));
+	}
+
+	num = first;
+	for (;;) {
+		count = TSP_EVLOG_REPLAY_BATCH;
+		events = NULL;
+		if ((result = RPC_GetPcrEventsByPcr(tspContext, pcr, num, &count, &events))) {
+			if (num > 0 && TSS_ERROR_CODE(result) == TSS_E_BAD_PARAMETER) {
+				LogDebugFn("PCR %u has fewer than %u events, replaying it again",
+					   pcr, num);
+				num = first = 0;
+				__tspi_memset(value, 0, sizeof(TPM_PCRVALUE));
+				continue;
+			}
+			goto done;
+		}
+
+		if (count && (tmp = realloc(values, (num + count - first) *
+						    sizeof(TPM_DIGEST))) == NULL) {
+			LogError("malloc of %zd bytes failed.",
+				 (num + count - first) * sizeof(TPM_DIGEST));
+			result = TSPERR(TSS_E_OUTOFMEMORY);
+		} else if (count)
+			values = tmp;
+
+		for (i = 0; i < count && result == TSS_SUCCESS; i++) {
+			if (events[i].ulPcrValueLength != TPM_SHA1_160_HASH_LEN) {
+				LogDebugFn("PCR %u event %u has a %u byte digest", pcr, num + i,
+					   events[i].ulPcrValueLength);
+				result = TSPERR(TSS_E_INTERNAL_ERROR);
+				break;
+			}
+
+			result = Trspi_HashInit(&hashCtx, TSS_HASH_SHA1);
+			result |= Trspi_Hash_DIGEST(&hashCtx, value->digest);
+			result |= Trspi_Hash_DIGEST(&hashCtx, events[i].rgbPcrValue);
+			result |= Trspi_HashFinal(&hashCtx, value->digest);
+			memcpy(&values[num + i - first], value, sizeof(TPM_DIGEST));
+		}
+
+		for (i = 0; i < count; i++) {
+			free(events[i].rgbPcrValue);
+			free(events[i].rgbEvent);
+		}
+		free_tspi(tspContext, events);
+
+		if (result)
+			goto done;
+
+		num += count;
+		if (count < TSP_EVLOG_REPLAY_BATCH)
+			break;
+	}
+
+	result = obj_tpm_set_replay(hTPM, pcr, old_num, first, num, values);
+done:
+	free(values);
+
+	return result;
+}
+
+/* replay the event logs of the PCRs selected in hPcrs. *values is indexed by PCR number
+ * and is only filled in for the selected PCRs. */
+static TSS_RESULT
+evlog_replay_selection(TSS_HTPM hTPM, TSS_HPCRS hPcrs, TSS_BOOL restart,
+		       TPM_PCR_SELECTION *select, TPM_PCRVALUE **values)
+{
+	TSS_HCONTEXT tspContext;
+	TSS_RESULT result;
+	BYTE pcrData[128];
+	UINT32 pcrDataSize, i;
+	UINT64 offset = 0;
+
+	if ((result = obj_tpm_get_tsp_context(hTPM, &tspContext)))
+		return result;
+
+	if ((result = obj_pcrs_get_selection(hPcrs, &pcrDataSize, pcrData)))
+		return result;
+
+	if ((result = Trspi_UnloadBlob_PCR_SELECTION(&offset, pcrData, select)))
+		return result;
+
+	if ((*values = calloc(select->sizeOfSelect * 8, sizeof(TPM_PCRVALUE))) == NULL) {
+		LogError("malloc of %zd bytes failed.",
+			 select->sizeOfSelect * 8 * sizeof(TPM_PCRVALUE));
+		free(select->pcrSelect);
+		return TSPERR(TSS_E_OUTOFMEMORY);
+	}
+
+	for (i = 0; i < select->sizeOfSelect * 8U; i++) {
+		if (!(select->pcrSelect[i / 8] & (1 << (i % 8))))
+			continue;
+
+		if ((result = evlog_replay_pcr(hTPM, tspContext, i, restart, &(*values)[i]))) {
+			free(*values);
+			free(select->pcrSelect);
+			return result;
+		}
+	}
+
+	return TSS_SUCCESS;
+}
+
+/* look for quoted among the values pcr has been replayed through, newest first, and set *count
+ * to the number of pcr's events that extend it to that value. A PCR that was read before its
+ * latest events were logged matches one of the earlier values. All zeros only matches a PCR
+ * that has no events at all. */
+static TSS_RESULT
+evlog_find_value(TSS_HTPM hTPM, UINT32 pcr, BYTE *quoted, TSS_BOOL *found, UINT32 *count)
+{
+	TSS_RESULT result;
+	TPM_DIGEST *values, zero;
+	UINT32 num, num_values, i;
+
+	if ((result = obj_tpm_get_replay_values(hTPM, pcr, &num, &num_values, &values)))
+		return result;
+
+	*found = FALSE;
+	*count = 0;
+
+	if (num == 0) {
+		__tspi_memset(&zero, 0, sizeof(TPM_DIGEST));
+		*found = memcmp(quoted, &zero, TPM_SHA1_160_HASH_LEN) ? FALSE : TRUE;
+	}
+
+	/* values[i - 1] is the value after the first num - num_values + i events */
+	for (i = num_values; i > 0 && !*found; i--) {
+		if (!memcmp(quoted, &values[i - 1], TPM_SHA1_160_HASH_LEN)) {
+			*found = TRUE;
+			*count = num - num_values + i;
+		}
+	}
+
+	free(values);
+
+	return TSS_SUCCESS;
+}
+
+/* look for a composite matching quoted, first the one of the newest values of the PCRs in
+ * select, then among the ones made by holding every PCR at its newest value but one, which
+ * takes each of its earlier values in turn. That finds a quote taken before more events were
+ * logged to one of the PCRs, typically the IMA one. counts[] is set to the number of each
+ * PCR's events that the matching composite covers. Quote2 only leaves the composite, so a
+ * quote that predates events in two of the PCRs can't be told apart from a bad log. */
+static TSS_RESULT
+evlog_find_composite(TSS_HTPM hTPM, TPM_PCR_SELECTION *select, TPM_PCRVALUE *values,
+		     BYTE *quoted, TSS_BOOL *found, UINT32 *counts)
+{
+	TSS_RESULT result = TSS_SUCCESS;
+	TPM_COMPOSITE_HASH digest;
+	TPM_DIGEST *history, newest;
+	UINT32 num, num_values, pcr, i;
+
+	*found = FALSE;
+
+	for (pcr = 0; pcr < select->sizeOfSelect * 8U; pcr++) {
+		if (!(select->pcrSelect[pcr / 8] & (1 << (pcr % 8))))
+			continue;
+
+		if ((result = obj_tpm_get_replay(hTPM, pcr, &counts[pcr], &newest)))
+			return result;
+	}
+
+	if ((result = pcrs_calc_composite(select, values, &digest)))
+		return result;
+
+	if (!memcmp(quoted, &digest, sizeof(TPM_COMPOSITE_HASH))) {
+		*found = TRUE;
+		return TSS_SUCCESS;
+	}
+
+	for (pcr = 0; pcr < select->sizeOfSelect * 8U && !*found && !result; pcr++) {
+		if (!(select->pcrSelect[pcr / 8] & (1 << (pcr % 8))))
+			continue;
+
+		if ((result = obj_tpm_get_replay_values(hTPM, pcr, &num, &num_values,
+							&history)))
+			break;
+
+		memcpy(&newest, &values[pcr], sizeof(TPM_DIGEST));
+
+		/* values[pcr] itself has been tried already, so start one event back */
+		for (i = num_values > 0 ? num_values - 1 : 0; i > 0 && !*found; i--) {
+			memcpy(&values[pcr], &history[i - 1], sizeof(TPM_DIGEST));
+			if ((result = pcrs_calc_composite(select, values, &digest)))
+				break;
+			if (!memcmp(quoted, &digest, sizeof(TPM_COMPOSITE_HASH))) {
+				*found = TRUE;
+				counts[pcr] = num - num_values + i;
+			}
+		}
+
+		memcpy(&values[pcr], &newest, sizeof(TPM_DIGEST));
+		free(history);
+	}
+
+	return result;
+}
+
+/* compare the replayed values against hPcrs and set counts[] to the number of each PCR's
+ * events the match covers. Quote leaves the PCR values in a TSS_PCRS_STRUCT_INFO object,
+ * Quote2 only the composite hash in a TSS_PCRS_STRUCT_INFO_SHORT one, so the values are
+ * compared directly for the former and through their composite hash otherwise. The log may
+ * have grown since the PCRs were read, so a match with the log as it stood at some earlier
+ * event counts too, and counts[] tells the caller where that was. */
+static TSS_RESULT
+evlog_compare(TSS_HTPM hTPM, TSS_HPCRS hPcrs, TPM_PCR_SELECTION *select, TPM_PCRVALUE *values,
+	      TSS_BOOL *pbValid, UINT32 *counts)
+{
+	TSS_HCONTEXT tspContext;
+	TSS_RESULT result;
+	UINT32 type, size, i;
+	BYTE *actual;
+
+	if ((result = obj_pcrs_get_tsp_context(hPcrs, &tspContext)))
+		return result;
+
+	if ((result = obj_pcrs_get_type(hPcrs, &type)))
+		return result;
+
+	*pbValid = TRUE;
+
+	if (type == TSS_PCRS_STRUCT_INFO) {
+		for (i = 0; i < select->sizeOfSelect * 8U && *pbValid; i++) {
+			if (!(select->pcrSelect[i / 8] & (1 << (i % 8))))
+				continue;
+
+			if ((result = obj_pcrs_get_value(hPcrs, i, &size, &actual)))
+				return result;
+
+			result = evlog_find_value(hTPM, i, actual, pbValid, &counts[i]);
+			free_tspi(tspContext, actual);
+
+			if (result)
+				return result;
+			if (!*pbValid) {
+				LogDebugFn("PCR %u doesn't match its event log", i);
+			}
+		}
+
+		return TSS_SUCCESS;
+	}
+
+	if ((result = obj_pcrs_get_digest_at_release(hPcrs, &size, &actual)))
+		return result;
+
+	result = evlog_find_composite(hTPM, select, values, actual, pbValid, counts);
+	free_tspi(tspContext, actual);
+
+	if (result == TSS_SUCCESS && !*pbValid) {
+		LogDebugFn("PCR composite doesn't match the event log");
+	}
+
+	return result;
+}
+
+TSS_RESULT
+Trspi_TPM_ReplayEventLog(TSS_HTPM hTPM,		/* in */
+			 TSS_HPCRS hPcrs)	/* in */
+{
+	TSS_RESULT result;
+	TPM_PCR_SELECTION select;
+	TPM_PCRVALUE *values;
+	UINT32 i;
+
+	if ((result = evlog_replay_selection(hTPM, hPcrs, FALSE, &select, &values)))
+		return result;
+
+	for (i = 0; i < select.sizeOfSelect * 8U; i++) {
+		if (!(select.pcrSelect[i / 8] & (1 << (i % 8))))
+			continue;
+
+		if ((result = obj_pcrs_set_value(hPcrs, i, TPM_SHA1_160_HASH_LEN,
+						 values[i].digest)))
+			break;
+	}
+
+	free(values);
+	free(select.pcrSelect);
+
+	return result;
+}
+
+TSS_RESULT
+Trspi_TPM_VerifyEventLog(TSS_HTPM hTPM,			/* in */
+			 TSS_HPCRS hPcrs,		/* in */
+			 TSS_BOOL * pbValid,		/* out */
+			 UINT32 * pulPcrCount,		/* out */
+			 UINT32 ** prgulEventCounts)	/* out */
+{
+	TSS_HCONTEXT tspContext;
+	TSS_RESULT result;
+	TPM_PCR_SELECTION select;
+	TPM_PCRVALUE *values;
+	UINT32 *counts, num_pcrs;
+	TSS_BOOL restart;
+
+	if (pbValid == NULL || pulPcrCount == NULL || prgulEventCounts == NULL)
+		return TSPERR(TSS_E_BAD_PARAMETER);
+
+	if ((result = obj_tpm_get_tsp_context(hTPM, &tspContext)))
+		return result;
+
+	/* a log that was replaced by one at least as long as the old one isn't noticed while
+	 * replaying, so give a mismatch with every value the log has held one more try from the
+	 * first event */
+	for (restart = FALSE; ; restart = TRUE) {
+		if ((result = evlog_replay_selection(hTPM, hPcrs, restart, &select, &values)))
+			return result;
+
+		num_pcrs = select.sizeOfSelect * 8;
+		if ((counts = calloc_tspi(tspContext, num_pcrs * sizeof(UINT32))) == NULL) {
+			LogError("malloc of %zd bytes failed.", num_pcrs * sizeof(UINT32));
+			result = TSPERR(TSS_E_OUTOFMEMORY);
+		} else
+			result = evlog_compare(hTPM, hPcrs, &select, values, pbValid, counts);
+		free(values);
+		free(select.pcrSelect);
+
+		if (result == TSS_SUCCESS && *pbValid) {
+			*pulPcrCount = num_pcrs;
+			*prgulEventCounts = counts;
+			return TSS_SUCCESS;
+		}
+
+		if (counts)
+			free_tspi(tspContext, counts);
+
+		if (result || restart)
+			break;
+	}
+
+	*pulPcrCount = 0;
+	*prgulEventCounts = NULL;
+
+	return result;
+}
@@ -13,6 +13,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <inttypes.h>
+#include <limits.h>
 
 #include "trousers/tss.h"
 #include "trousers/trousers.h"
@@ -135,6 +136,52 @@ Tspi_TPM_PcrRead(TSS_HTPM hTPM,			/* in */
 	return TSS_SUCCESS;
 }
 
+TSS_RESULT
+Trspi_TPM_PcrReadBatch(TSS_HTPM hTPM,			/* in */
+		       UINT32 ulPcrCount,		/* in */
+		       UINT32 *pulPcrIndices,		/* in */
+		       UINT32 *pulPcrValuesLength,	/* out */
+		       BYTE **prgbPcrValues)		/* out */
+{
+	TCPA_PCRVALUE *outDigests;
+	TSS_RESULT result = TSS_SUCCESS;
+	TSS_HCONTEXT tspContext;
+	UINT32 i;
+
+	if (ulPcrCount == 0 || ulPcrCount > UINT_MAX / sizeof(TCPA_PCRVALUE) ||
+	    pulPcrIndices == NULL || pulPcrValuesLength == NULL || prgbPcrValues == NULL)
+		return TSPERR(TSS_E_BAD_PARAMETER);
+
+	if ((result = obj_tpm_get_tsp_context(hTPM, &tspContext)))
+		return result;
+
+	outDigests = calloc_tspi(tspContext, ulPcrCount * sizeof(TCPA_PCRVALUE));
+	if (outDigests == NULL) {
+		LogError("malloc of %zd bytes failed.", ulPcrCount * sizeof(TCPA_PCRVALUE));
+		return TSPERR(TSS_E_OUTOFMEMORY);
+	}
+
+	/* inside a transport session each read has to be wrapped on its own */
+	if (TCS_API(tspContext)->PcrReadBatch)
+		result = TCS_API(tspContext)->PcrReadBatch(tspContext, ulPcrCount, pulPcrIndices,
+							    outDigests);
+	else {
+		for (i = 0; i < ulPcrCount && result == TSS_SUCCESS; i++)
+			result = TCS_API(tspContext)->PcrRead(tspContext, pulPcrIndices[i],
+							       &outDigests[i]);
+	}
+
+	if (result) {
+		free_tspi(tspContext, outDigests);
+		return result;
+	}
+
+	*prgbPcrValues = (BYTE *)outDigests;
+	*pulPcrValuesLength = ulPcrCount * sizeof(TCPA_PCRVALUE);
+
+	return TSS_SUCCESS;
+}
+
 TSS_RESULT
 Tspi_TPM_PcrReset(TSS_HTPM hTPM,                 /* in */
 		  TSS_HPCRS hPcrComposite)       /* in */
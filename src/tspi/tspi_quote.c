@@ -83,6 +83,7 @@ Tspi_TPM_Quote(TSS_HTPM hTPM,				/* in */
 			return result;
 	}
 
+retry:
 	result = Trspi_HashInit(&hashCtx, TSS_HASH_SHA1);
 	result |= Trspi_Hash_UINT32(&hashCtx, TPM_ORD_Quote);
 	result |= Trspi_HashUpdate(&hashCtx, TPM_SHA1_160_HASH_LEN, antiReplay.nonce);
@@ -91,8 +92,8 @@ Tspi_TPM_Quote(TSS_HTPM hTPM,				/* in */
 		return result;
 
 	if (usesAuth) {
-		if ((result = secret_PerformAuth_OIAP(hIdentKey, TPM_ORD_Quote, hPolicy, FALSE,
-						      &digest, &privAuth))) {
+		if ((result = secret_PerformAuth_OIAP_Pooled(hIdentKey, TPM_ORD_Quote, hPolicy,
+							     &digest, &privAuth))) {
 			return result;
 		}
 		pPrivAuth = &privAuth;
@@ -102,8 +103,11 @@ Tspi_TPM_Quote(TSS_HTPM hTPM,				/* in */
 
 	if ((result = TCS_API(tspContext)->Quote(tspContext, tcsKeyHandle, &antiReplay, pcrDataSize,
 						 pcrData, pPrivAuth, &pcrDataOutSize, &pcrDataOut,
-						 &validationLength, &validationData)))
+						 &validationLength, &validationData))) {
+		if (auth_pool_retry(tspContext, result, pPrivAuth))
+			goto retry;
 		return result;
+	}
 
 	result = Trspi_HashInit(&hashCtx, TSS_HASH_SHA1);
 	result |= Trspi_Hash_UINT32(&hashCtx, result);
@@ -187,11 +191,8 @@ Tspi_TPM_Quote(TSS_HTPM hTPM,				/* in */
 		/* validate the data here */
 		Trspi_Hash(TSS_HASH_SHA1, offset, quoteinfo, digest.digest);
 
-		if ((result = Trspi_Verify(TSS_HASH_SHA1, digest.digest, 20,
-					   keyContainer.pubKey.key,
-					   keyContainer.pubKey.keyLength,
-					   validationData,
-					   validationLength))) {
+		if ((result = __tspi_rsa_verify(hIdentKey, TSS_HASH_SHA1, 20, digest.digest,
+						validationLength, validationData))) {
 			free_key_refs(&keyContainer);
 			free(validationData);
 			return result;
@@ -92,6 +92,7 @@ Tspi_TPM_Quote2(TSS_HTPM        hTPM,            // in
 			return result;
 	}
 
+retry:
 	if (usesAuth) {
 		result = Trspi_HashInit(&hashCtx, TSS_HASH_SHA1);
 		result |= Trspi_Hash_UINT32(&hashCtx, TPM_ORD_Quote2);
@@ -100,8 +101,8 @@ Tspi_TPM_Quote2(TSS_HTPM        hTPM,            // in
 		result |= Trspi_Hash_BOOL(&hashCtx,fAddVersion);
 		if ((result |= Trspi_HashFinal(&hashCtx, digest.digest)))
 			return result;
-		if ((result = secret_PerformAuth_OIAP(hIdentKey, TPM_ORD_Quote2, hPolicy, FALSE,
-						      &digest, &privAuth))) {
+		if ((result = secret_PerformAuth_OIAP_Pooled(hIdentKey, TPM_ORD_Quote2, hPolicy,
+							     &digest, &privAuth))) {
 			return result;
 		}
 		pPrivAuth = &privAuth;
@@ -113,8 +114,11 @@ Tspi_TPM_Quote2(TSS_HTPM        hTPM,            // in
 	if ((result = TCS_API(tspContext)->Quote2(tspContext, tcsKeyHandle, &antiReplay,
 						  pcrDataSize, pcrData, fAddVersion, pPrivAuth,
 						  &pcrDataOutSize, &pcrDataOut, versionInfoSize,
-						  versionInfo, &sigSize, &sig)))
+						  versionInfo, &sigSize, &sig))) {
+		if (auth_pool_retry(tspContext, result, pPrivAuth))
+			goto retry;
 		return result;
+	}
 
 #ifdef TSS_DEBUG
 	LogDebug("Got TCS Response:");
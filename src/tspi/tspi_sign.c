@@ -54,6 +54,7 @@ Tspi_Hash_Sign(TSS_HHASH hHash,			/* in */
 	if ((result = obj_rsakey_get_tcs_handle(hKey, &tcsKeyHandle)))
 		goto done;
 
+retry:
 	if (usesAuth) {
 		result = Trspi_HashInit(&hashCtx, TSS_HASH_SHA1);
 		result |= Trspi_Hash_UINT32(&hashCtx, TPM_ORD_Sign);
@@ -64,16 +65,19 @@ Tspi_Hash_Sign(TSS_HHASH hHash,			/* in */
 
 		pPrivAuth = &privAuth;
 
-		if ((result = secret_PerformAuth_OIAP(hKey, TPM_ORD_Sign, hPolicy, FALSE, &digest,
-						      &privAuth)))
+		if ((result = secret_PerformAuth_OIAP_Pooled(hKey, TPM_ORD_Sign, hPolicy, &digest,
+							     &privAuth)))
 			goto done;
 	} else {
 		pPrivAuth = NULL;
 	}
 
 	if ((result = TCS_API(tspContext)->Sign(tspContext, tcsKeyHandle, ulDataLen, data,
-						pPrivAuth, pulSignatureLength, prgbSignature)))
+						pPrivAuth, pulSignatureLength, prgbSignature))) {
+		if (auth_pool_retry(tspContext, result, pPrivAuth))
+			goto retry;
 		goto done;
+	}
 
 	if (usesAuth) {
 		result = Trspi_HashInit(&hashCtx, TSS_HASH_SHA1);
@@ -107,8 +111,7 @@ Tspi_Hash_VerifySignature(TSS_HHASH hHash,		/* in */
 			  BYTE * rgbSignature)		/* in */
 {
 	TCPA_RESULT result;
-	BYTE *pubKey = NULL;
-	UINT32 pubKeySize;
+	void *rsa;
 	BYTE *hashData = NULL;
 	UINT32 hashDataSize;
 	UINT32 sigScheme;
@@ -120,30 +123,28 @@ Tspi_Hash_VerifySignature(TSS_HHASH hHash,		/* in */
 	if ((result = obj_rsakey_get_tsp_context(hKey, &tspContext)))
 		return result;
 
-	if ((result = obj_rsakey_get_modulus(hKey, &pubKeySize, &pubKey)))
+	if ((result = obj_rsakey_get_ss(hKey, &sigScheme)))
 		return result;
 
-	if ((result = obj_rsakey_get_ss(hKey, &sigScheme))) {
-		free_tspi(tspContext, pubKey);
+	if ((result = obj_hash_get_value(hHash, &hashDataSize, &hashData)))
 		return result;
-	}
 
-	if ((result = obj_hash_get_value(hHash, &hashDataSize, &hashData))) {
-		free_tspi(tspContext, pubKey);
+	if ((result = obj_rsakey_get_pub_rsa(hKey, NULL, NULL, NULL, &rsa))) {
+		free_tspi(tspContext, hashData);
 		return result;
 	}
 
 	if (sigScheme == TSS_SS_RSASSAPKCS1V15_SHA1) {
-		result = Trspi_Verify(TSS_HASH_SHA1, hashData, hashDataSize, pubKey, pubKeySize,
-				      rgbSignature, ulSignatureLength);
+		result = __tspi_rsa_pubkey_verify(rsa, TSS_HASH_SHA1, hashDataSize, hashData,
+						  ulSignatureLength, rgbSignature);
 	} else if (sigScheme == TSS_SS_RSASSAPKCS1V15_DER) {
-		result = Trspi_Verify(TSS_HASH_OTHER, hashData, hashDataSize, pubKey, pubKeySize,
-				      rgbSignature, ulSignatureLength);
+		result = __tspi_rsa_pubkey_verify(rsa, TSS_HASH_OTHER, hashDataSize, hashData,
+						  ulSignatureLength, rgbSignature);
 	} else {
 		result = TSPERR(TSS_E_INVALID_SIGSCHEME);
 	}
 
-	free_tspi(tspContext, pubKey);
+	__tspi_rsa_pubkey_put(rsa);
 	free_tspi(tspContext, hashData);
 
 	return result;